@@ -0,0 +1,41 @@
+# Benchmark settings
+# Benchmarks are built with asserts off into their own directory, so they don't
+# share objects with the assert-enabled test build.
+BENCH_DIR = bench
+BENCH_BUILD_DIR = $(BUILD_DIR)/bench
+BENCH_CFLAGS = -Wall -Wextra -O2 -DNDEBUG -MMD -MP
+
+BENCH_LIB_TARGET = $(BENCH_BUILD_DIR)/bench_lib
+BENCH_SQLITE_TARGET = $(BENCH_BUILD_DIR)/bench_sqlite
+BENCH_SQLITE_EXT = $(BENCH_BUILD_DIR)/crypto_decimal_extension.$(EXTENSION_SUFFIX)
+BENCH_SQLITE_OBJS = $(addprefix $(BENCH_BUILD_DIR)/, $(notdir $(SQLITE_SRCS:.c=.o)))
+BENCH_HEADERS = $(BENCH_DIR)/bench.h
+
+.PHONY: bench clean-bench
+
+# Run all benchmarks; BENCH_ROWS, BENCH_MIN_MS and BENCH_FORMAT=json are passed through
+bench: $(BENCH_LIB_TARGET) $(BENCH_SQLITE_TARGET) $(BENCH_SQLITE_EXT)
+	./$(BENCH_LIB_TARGET)
+	./$(BENCH_SQLITE_TARGET) ./$(BENCH_SQLITE_EXT)
+
+$(BENCH_BUILD_DIR):
+	mkdir -p $(BENCH_BUILD_DIR)
+
+$(BENCH_LIB_TARGET): $(BENCH_DIR)/bench_lib.c $(BENCH_HEADERS) $(LIB_HEADERS) | $(BENCH_BUILD_DIR)
+	$(CC) $(BENCH_CFLAGS) $(INCLUDE_FLAGS) -o $@ $< $(LDFLAGS)
+
+$(BENCH_SQLITE_TARGET): $(BENCH_DIR)/bench_sqlite.c $(BENCH_HEADERS) | $(BENCH_BUILD_DIR)
+	$(CC) $(BENCH_CFLAGS) $(INCLUDE_FLAGS) -o $@ $< $(LDFLAGS)
+
+# Optimized copy of the SQLite extension for the SQL benchmarks
+$(BENCH_SQLITE_EXT): $(BENCH_SQLITE_OBJS) $(SQLITE_HEADERS) | $(BENCH_BUILD_DIR)
+	$(CC) -fPIC $(EXTENSION_FLAGS) $(BENCH_CFLAGS) $(INCLUDE_FLAGS) -o $@ $(BENCH_SQLITE_OBJS) $(LDFLAGS)
+
+$(BENCH_SQLITE_OBJS): $(BENCH_BUILD_DIR)/%.o: $(SRC_DIR)/%.c $(SQLITE_HEADERS) | $(BENCH_BUILD_DIR)
+	$(CC) -fPIC $(BENCH_CFLAGS) $(INCLUDE_FLAGS) -c $< -o $@
+
+# Clean benchmarks
+clean-bench:
+	rm -rf $(BENCH_BUILD_DIR)
+
+-include $(BENCH_SQLITE_OBJS:.o=.d) $(BENCH_LIB_TARGET).d $(BENCH_SQLITE_TARGET).d
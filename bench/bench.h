@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+// Shared helpers for the benchmarks: a monotonic clock, allocation counting and
+// machine-readable output.
+//
+// Every result is one line with the suite, the benchmark name, the number of
+// operations timed, nanoseconds per operation and allocations per operation.
+// Output is CSV by default; set BENCH_FORMAT=json for one JSON object per line.
+// Each benchmark runs for at least BENCH_MIN_MS milliseconds (default 200).
+
+#ifndef CRYPTOMATH_BENCH_H
+#define CRYPTOMATH_BENCH_H
+
+#include <gmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Allocations made since the counter was last read; every hook bumps it
+static uint64_t bench_allocs = 0;
+
+// Results are written through this so the compiler cannot drop the timed work
+static volatile uint64_t bench_sink = 0;
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_env_u64(const char* name, uint64_t fallback) {
+    const char* value = getenv(name);
+    if (value == NULL || *value == '\0') {
+        return fallback;
+    }
+    return strtoull(value, NULL, 10);
+}
+
+static int bench_json(void) {
+    const char* format = getenv("BENCH_FORMAT");
+    return format != NULL && strcmp(format, "json") == 0;
+}
+
+// GMP allocation hooks; GMP's own memory is counted alongside the library's
+static void* bench_gmp_alloc(size_t n) {
+    bench_allocs++;
+    return malloc(n);
+}
+
+static void* bench_gmp_realloc(void* p, size_t old_size, size_t new_size) {
+    (void)old_size;
+    bench_allocs++;
+    return realloc(p, new_size);
+}
+
+static void bench_gmp_free(void* p, size_t size) {
+    (void)size;
+    free(p);
+}
+
+static void bench_install_gmp_hooks(void) {
+    mp_set_memory_functions(bench_gmp_alloc, bench_gmp_realloc, bench_gmp_free);
+}
+
+static void bench_header(void) {
+    if (!bench_json()) {
+        printf("suite,name,ops,ns_per_op,allocs_per_op\n");
+    }
+}
+
+static void bench_report(const char* suite, const char* name, uint64_t ops, uint64_t ns, uint64_t allocs) {
+    double ns_per_op = ops ? (double)ns / (double)ops : 0.0;
+    double allocs_per_op = ops ? (double)allocs / (double)ops : 0.0;
+    if (bench_json()) {
+        printf("{\"suite\":\"%s\",\"name\":\"%s\",\"ops\":%llu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.3f}\n",
+               suite, name, (unsigned long long)ops, ns_per_op, allocs_per_op);
+    } else {
+        printf("%s,%s,%llu,%.2f,%.3f\n", suite, name, (unsigned long long)ops, ns_per_op, allocs_per_op);
+    }
+    fflush(stdout);
+}
+
+// A benchmark body performs n operations on its argument
+typedef void (*bench_fn_t)(void* arg, uint64_t n);
+
+// Time fn, doubling the operation count until a run lasts at least BENCH_MIN_MS,
+// and report the last run.
+static inline void bench_run(const char* suite, const char* name, bench_fn_t fn, void* arg) {
+    uint64_t min_ns = bench_env_u64("BENCH_MIN_MS", 200) * 1000000ULL;
+    uint64_t n = 1;
+    for (;;) {
+        uint64_t allocs_before = bench_allocs;
+        uint64_t start = bench_now_ns();
+        fn(arg, n);
+        uint64_t elapsed = bench_now_ns() - start;
+        if (elapsed >= min_ns || n >= (1ULL << 40)) {
+            bench_report(suite, name, n, elapsed, bench_allocs - allocs_before);
+            return;
+        }
+        n *= 2;
+    }
+}
+
+#endif // CRYPTOMATH_BENCH_H
@@ -0,0 +1,485 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+// Microbenchmarks for the header-only library.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define CRYPTOMATH_IMPLEMENTATION
+#include "cryptomath.h"
+#include "cryptomath_column.h"
+#include "cryptomath_convert.h"
+#include "cryptomath_pipeline.h"
+
+// The library's own allocations go through crypto_set_allocator
+static void* bench_malloc(size_t n) {
+    bench_allocs++;
+    return malloc(n);
+}
+
+static void* bench_realloc(void* p, size_t n) {
+    bench_allocs++;
+    return realloc(p, n);
+}
+
+typedef struct {
+    const char* label;
+    crypto_type_t type;
+    crypto_denom_t denom;
+    const char* decimal;
+} bench_asset_t;
+
+static const bench_asset_t bench_assets[] = {
+    { "btc", CRYPTO_BITCOIN, BTC_DENOM_BITCOIN, "12345.67890123" },
+    { "eth", CRYPTO_ETHEREUM, ETH_DENOM_ETHER, "1234.567890123456789012" },
+    { "dot", CRYPTO_POLKADOT, DOT_DENOM_DOT, "98765.4321098765" },
+};
+
+typedef struct {
+    const bench_asset_t* asset;
+    crypto_val_t a;
+    crypto_val_t b;
+    crypto_val_t r;
+    mpz_t num;
+    mpz_t den;
+    char buf[128];
+    crypto_divisor_t den_prepared;
+} bench_state_t;
+
+static void bench_state_init(bench_state_t* s, const bench_asset_t* asset) {
+    s->asset = asset;
+    crypto_init(&s->a, asset->type);
+    crypto_init(&s->b, asset->type);
+    crypto_init(&s->r, asset->type);
+    crypto_set_from_decimal(&s->a, asset->denom, asset->decimal);
+    crypto_set_from_decimal(&s->b, asset->denom, "0.5");
+    mpz_init_set_ui(s->num, 997);
+    mpz_init_set_ui(s->den, 1000);
+    crypto_divisor_init(&s->den_prepared, s->den);
+}
+
+static void bench_state_clear(bench_state_t* s) {
+    crypto_clear(&s->a);
+    crypto_clear(&s->b);
+    crypto_clear(&s->r);
+    mpz_clear(s->num);
+    mpz_clear(s->den);
+    crypto_divisor_clear(&s->den_prepared);
+}
+
+static void bench_parse(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_set_from_decimal(&s->r, s->asset->denom, s->asset->decimal);
+    }
+    bench_sink += (uint64_t)crypto_gt_zero(&s->r);
+}
+
+// Strings that fail strict parsing take the part-wise path
+static void bench_parse_lenient(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_set_from_decimal(&s->r, s->asset->denom, "12.34x");
+    }
+    bench_sink += (uint64_t)crypto_gt_zero(&s->r);
+}
+
+static void bench_parse_n(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    size_t len = strlen(s->asset->decimal);
+    for (uint64_t i = 0; i < n; i++) {
+        bench_sink += (uint64_t)crypto_parse_decimal(&s->r, s->asset->denom, s->asset->decimal, len, NULL);
+    }
+}
+
+static void bench_to_str(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        char* str = crypto_to_decimal_str(&s->a, s->asset->denom);
+        bench_sink += (uint64_t)str[0];
+        crypto_free(str);
+    }
+}
+
+static void bench_format_to(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        bench_sink += crypto_format_to(s->buf, sizeof(s->buf), &s->a, s->asset->denom);
+    }
+}
+
+static void bench_add(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_add(&s->r, &s->a, &s->b);
+    }
+    bench_sink += (uint64_t)crypto_gt_zero(&s->r);
+}
+
+static void bench_cmp(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        bench_sink += (uint64_t)(crypto_cmp(&s->a, &s->b) + 1);
+    }
+}
+
+static void bench_muldiv(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_mul(&s->r, &s->a, &s->num);
+        crypto_div_truncate(&s->r, &s->r, &s->den);
+    }
+    bench_sink += (uint64_t)crypto_gt_zero(&s->r);
+}
+
+// The same operation with the divisor prepared once, as crypto_div_* SQL calls do
+static void bench_muldiv_prepared(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_mul(&s->r, &s->a, &s->num);
+        crypto_div_by(&s->r, &s->r, &s->den_prepared, CRYPTO_ROUND_TRUNCATE);
+    }
+    bench_sink += (uint64_t)crypto_gt_zero(&s->r);
+}
+
+// The largest inline amount, in wei and as ETH
+static const char bench_max_wei[] =
+    "115792089237316195423570985008687907853269984665640564039457584007913129639935";
+static const char bench_max_eth[] =
+    "115792089237316195423570985008687907853269984665640564039457.584007913129639935";
+
+static void bench_parse_max(void* arg, uint64_t n) {
+    bench_state_t* s = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        bench_sink += (uint64_t)crypto_parse_decimal(&s->r, ETH_DENOM_WEI, bench_max_wei, sizeof(bench_max_wei) - 1, NULL);
+    }
+}
+
+static void bench_is_valid_max(void* arg, uint64_t n) {
+    (void)arg;
+    for (uint64_t i = 0; i < n; i++) {
+        bench_sink += (uint64_t)crypto_is_valid_decimal(bench_max_eth);
+    }
+}
+
+static void bench_type_lookup(void* arg, uint64_t n) {
+    (void)arg;
+    static const char* symbols[] = { "BTC", "ETH", "DOT" };
+    for (uint64_t i = 0; i < n; i++) {
+        bench_sink += (uint64_t)crypto_get_type_for_symbol(symbols[i % 3]);
+    }
+}
+
+static void bench_denom_lookup(void* arg, uint64_t n) {
+    (void)arg;
+    for (uint64_t i = 0; i < n; i++) {
+        bench_sink += (uint64_t)crypto_get_denom_for_symbol(CRYPTO_ETHEREUM, "GWEI");
+    }
+}
+
+// A book of BENCH_BOOK_SIZE ETH positions revalued with the batch API
+#define BENCH_BOOK_SIZE 100000
+
+typedef struct {
+    crypto_val_t* values;
+    crypto_val_t threshold;
+    crypto_val_t sum;
+    mpz_t scalar;
+    uint64_t* mask;
+    crypto_column_t column;
+} bench_book_t;
+
+static void bench_book_init(bench_book_t* book) {
+    book->values = malloc(BENCH_BOOK_SIZE * sizeof(crypto_val_t));
+    book->mask = malloc((BENCH_BOOK_SIZE + 63) / 64 * sizeof(uint64_t));
+    for (size_t i = 0; i < BENCH_BOOK_SIZE; i++) {
+        crypto_init(&book->values[i], CRYPTO_ETHEREUM);
+        crypto_set_from_decimal(&book->values[i], ETH_DENOM_ETHER, bench_assets[1].decimal);
+    }
+    crypto_column_init(&book->column, CRYPTO_ETHEREUM);
+    crypto_column_reserve(&book->column, BENCH_BOOK_SIZE);
+    for (size_t i = 0; i < BENCH_BOOK_SIZE; i++) {
+        crypto_column_append(&book->column, &book->values[i]);
+    }
+    crypto_init(&book->threshold, CRYPTO_ETHEREUM);
+    crypto_init(&book->sum, CRYPTO_ETHEREUM);
+    crypto_set_from_decimal(&book->threshold, ETH_DENOM_ETHER, "1000");
+    mpz_init_set_ui(book->scalar, 1);
+}
+
+static void bench_book_clear(bench_book_t* book) {
+    for (size_t i = 0; i < BENCH_BOOK_SIZE; i++) {
+        crypto_clear(&book->values[i]);
+    }
+    crypto_column_clear(&book->column);
+    crypto_clear(&book->threshold);
+    crypto_clear(&book->sum);
+    mpz_clear(book->scalar);
+    free(book->values);
+    free(book->mask);
+}
+
+static void bench_sum_n(void* arg, uint64_t n) {
+    bench_book_t* book = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_sum_n(&book->sum, book->values, BENCH_BOOK_SIZE);
+    }
+    bench_sink += (uint64_t)crypto_gt_zero(&book->sum);
+}
+
+static void bench_column_sum(void* arg, uint64_t n) {
+    bench_book_t* book = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_column_sum(&book->column, &book->sum);
+    }
+    bench_sink += (uint64_t)crypto_gt_zero(&book->sum);
+}
+
+static void bench_mul_n(void* arg, uint64_t n) {
+    bench_book_t* book = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_mul_n(book->values, book->values, &book->scalar, BENCH_BOOK_SIZE);
+    }
+}
+
+static void bench_cmp_n(void* arg, uint64_t n) {
+    bench_book_t* book = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        bench_sink += crypto_cmp_n(book->mask, book->values, BENCH_BOOK_SIZE, &book->threshold, 1);
+    }
+}
+
+// Bulk conversion of BENCH_BOOK_SIZE newline-separated wei amounts to ETH on every core
+typedef struct {
+    char* input;
+    size_t len;
+} bench_convert_t;
+
+static void bench_convert(void* arg, uint64_t n) {
+    bench_convert_t* c = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_convert_result_t result;
+        crypto_convert(&result, c->input, c->len, '\n', ETH_DENOM_WEI, ETH_DENOM_ETHER, 0);
+        bench_sink += result.output_len;
+        crypto_convert_result_clear(&result);
+    }
+}
+
+// One operation ingests BENCH_INGEST_BATCHES batches of BENCH_INGEST_ITEMS ETH amounts,
+// either inline on the calling thread or handed to a pipeline and flushed
+#define BENCH_INGEST_BATCHES 16
+#define BENCH_INGEST_ITEMS 1024
+
+typedef struct {
+    crypto_pipeline_t* pipeline;     // NULL to run the batches inline
+    crypto_ingest_batch_t batches[BENCH_INGEST_BATCHES];
+    crypto_ingest_item_t items[BENCH_INGEST_BATCHES][BENCH_INGEST_ITEMS];
+    char texts[BENCH_INGEST_ITEMS][32];
+} bench_ingest_t;
+
+static void bench_ingest_done(crypto_ingest_batch_t* batch, void* ctx) {
+    (void)ctx;
+    for (size_t i = 0; i < batch->count; i++) {
+        if (batch->items[i].status == CRYPTO_INGEST_OK) {
+            crypto_clear(&batch->items[i].value);
+        }
+    }
+}
+
+static void bench_ingest_init(bench_ingest_t* b, unsigned workers) {
+    for (size_t i = 0; i < BENCH_INGEST_ITEMS; i++) {
+        snprintf(b->texts[i], sizeof(b->texts[i]), "%zu.%09zu", i * 31, i * 7919);
+    }
+    for (size_t k = 0; k < BENCH_INGEST_BATCHES; k++) {
+        for (size_t i = 0; i < BENCH_INGEST_ITEMS; i++) {
+            b->items[k][i] = (crypto_ingest_item_t){ .asset = "ETH", .denom = "ETH", .text = b->texts[i] };
+        }
+        b->batches[k] = (crypto_ingest_batch_t){ .items = b->items[k], .count = BENCH_INGEST_ITEMS };
+    }
+    b->pipeline = workers ? crypto_pipeline_create(&(crypto_pipeline_config_t){
+        .workers = workers, .capacity = BENCH_INGEST_BATCHES, .on_complete = bench_ingest_done }) : NULL;
+}
+
+static void bench_ingest(void* arg, uint64_t n) {
+    bench_ingest_t* b = arg;
+    for (uint64_t i = 0; i < n; i++) {
+        for (size_t k = 0; k < BENCH_INGEST_BATCHES; k++) {
+            if (b->pipeline) {
+                crypto_pipeline_submit(b->pipeline, &b->batches[k]);
+            } else {
+                crypto_ingest_batch_run(&b->batches[k]);
+                bench_ingest_done(&b->batches[k], NULL);
+            }
+        }
+        if (b->pipeline) {
+            crypto_pipeline_flush(b->pipeline);
+        }
+        bench_sink += b->batches[0].rejected;
+    }
+}
+
+static void bench_ingest_pipelines(void) {
+    static bench_ingest_t ingest;
+    bench_ingest_init(&ingest, 0);
+    bench_run("lib", "ingest_batch_run/16x1k", bench_ingest, &ingest);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    for (unsigned workers = 1; workers <= 8 && (long)workers <= (cores > 1 ? cores : 1); workers *= 2) {
+        char name[64];
+        bench_ingest_init(&ingest, workers);
+        if (ingest.pipeline == NULL) {
+            break;
+        }
+        snprintf(name, sizeof(name), "ingest_pipeline/16x1k/%uw", workers);
+        bench_run("lib", name, bench_ingest, &ingest);
+        crypto_pipeline_destroy(ingest.pipeline);
+    }
+}
+
+// Parallel ingestion: every thread parses, adds and formats its own values
+typedef struct {
+    uint64_t ops;
+} bench_mt_arg_t;
+
+static void bench_mt_body(void* arg, uint64_t n) {
+    (void)arg;
+    char buf[64];
+    crypto_val_t val, sum;
+    crypto_init(&val, CRYPTO_ETHEREUM);
+    crypto_init(&sum, CRYPTO_ETHEREUM);
+    for (uint64_t i = 0; i < n; i++) {
+        crypto_set_from_decimal(&val, ETH_DENOM_ETHER, bench_assets[1].decimal);
+        crypto_add(&sum, &sum, &val);
+        crypto_format_to(buf, sizeof(buf), &sum, ETH_DENOM_ETHER);
+    }
+    crypto_clear(&val);
+    crypto_clear(&sum);
+}
+
+static void* bench_mt_worker(void* arg) {
+    bench_mt_body(NULL, ((bench_mt_arg_t*)arg)->ops);
+    crypto_thread_cleanup();
+    return NULL;
+}
+
+// Time the same per-thread workload on 1, 2, 4, ... threads and finally on every
+// core. ns_per_op is wall time over all operations, so ideal scaling halves it per
+// doubling. Allocations are counted on the single-threaded calibration run, since
+// the counter is not atomic, and scaled by the thread count.
+#define BENCH_MAX_THREADS 256
+
+static void bench_run_threads(long threads, bench_mt_arg_t* arg, uint64_t allocs_per_thread) {
+    pthread_t ids[BENCH_MAX_THREADS];
+    long started = 0;
+    uint64_t start = bench_now_ns();
+    while (started < threads && pthread_create(&ids[started], NULL, bench_mt_worker, arg) == 0) {
+        started++;
+    }
+    for (long t = 0; t < started; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    char name[64];
+    snprintf(name, sizeof(name), "mt_parse_add_format/%ldt", started);
+    bench_report("lib", name, arg->ops * (uint64_t)started, elapsed, allocs_per_thread * (uint64_t)started);
+}
+
+static void bench_threads(void) {
+    uint64_t min_ns = bench_env_u64("BENCH_MIN_MS", 200) * 1000000ULL;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) {
+        cores = 1;
+    } else if (cores > BENCH_MAX_THREADS) {
+        cores = BENCH_MAX_THREADS;
+    }
+
+    bench_mt_arg_t arg = { 1 };
+    uint64_t allocs;
+    for (;;) {
+        uint64_t allocs_before = bench_allocs;
+        uint64_t start = bench_now_ns();
+        bench_mt_body(NULL, arg.ops);
+        allocs = bench_allocs - allocs_before;
+        if (bench_now_ns() - start >= min_ns) {
+            break;
+        }
+        arg.ops *= 2;
+    }
+
+    for (long threads = 1; threads < cores; threads *= 2) {
+        bench_run_threads(threads, &arg, allocs);
+    }
+    bench_run_threads(cores, &arg, allocs);
+}
+
+int main(void) {
+    bench_install_gmp_hooks();
+    crypto_set_allocator(bench_malloc, bench_realloc, free);
+    bench_header();
+
+    static const struct {
+        const char* name;
+        bench_fn_t fn;
+    } per_asset[] = {
+        { "set_from_decimal", bench_parse },
+        { "set_from_decimal_lenient", bench_parse_lenient },
+        { "parse_decimal", bench_parse_n },
+        { "to_decimal_str", bench_to_str },
+        { "format_to", bench_format_to },
+        { "add", bench_add },
+        { "cmp", bench_cmp },
+        { "muldiv", bench_muldiv },
+        { "muldiv_prepared", bench_muldiv_prepared },
+    };
+
+    char name[64];
+    for (size_t a = 0; a < sizeof(bench_assets) / sizeof(bench_assets[0]); a++) {
+        bench_state_t state;
+        bench_state_init(&state, &bench_assets[a]);
+        for (size_t i = 0; i < sizeof(per_asset) / sizeof(per_asset[0]); i++) {
+            snprintf(name, sizeof(name), "%s/%s", per_asset[i].name, bench_assets[a].label);
+            bench_run("lib", name, per_asset[i].fn, &state);
+        }
+        bench_state_clear(&state);
+    }
+
+    bench_state_t max_state;
+    bench_state_init(&max_state, &bench_assets[1]);
+    bench_run("lib", "parse_decimal/max_wei", bench_parse_max, &max_state);
+    bench_state_clear(&max_state);
+    bench_run("lib", "is_valid_decimal/max_eth", bench_is_valid_max, NULL);
+
+    bench_run("lib", "type_for_symbol", bench_type_lookup, NULL);
+    bench_run("lib", "denom_for_symbol", bench_denom_lookup, NULL);
+
+    // Batch benchmarks report time per book of BENCH_BOOK_SIZE positions
+    bench_book_t book;
+    bench_book_init(&book);
+    bench_run("lib", "sum_n/100k", bench_sum_n, &book);
+    bench_run("lib", "column_sum/100k", bench_column_sum, &book);
+    bench_run("lib", "mul_n/100k", bench_mul_n, &book);
+    bench_run("lib", "cmp_n/100k", bench_cmp_n, &book);
+    bench_book_clear(&book);
+
+    bench_convert_t convert;
+    convert.input = malloc(BENCH_BOOK_SIZE * 32);
+    convert.len = 0;
+    for (size_t i = 0; i < BENCH_BOOK_SIZE; i++) {
+        convert.len += (size_t)sprintf(convert.input + convert.len, "%zu%018zu\n", i, i * 7919);
+    }
+    bench_run("lib", "convert_wei_to_eth/100k", bench_convert, &convert);
+    free(convert.input);
+
+    bench_ingest_pipelines();
+    bench_threads();
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+// SQL-level benchmarks for the SQLite extension.
+//
+// Usage: bench_sqlite <path-to-extension>
+//
+// A table of BENCH_ROWS generated ETH amounts (default 10,000,000) is built in
+// memory, then each query is run once over the whole table. Results are
+// reported per row; allocations are SQLite and GMP allocations made while the
+// query runs.
+
+#include <sqlite3.h>
+
+#include "bench.h"
+
+static sqlite3_mem_methods bench_sqlite_default_mem;
+
+static void* bench_sqlite_malloc(int n) {
+    bench_allocs++;
+    return bench_sqlite_default_mem.xMalloc(n);
+}
+
+static void* bench_sqlite_realloc(void* p, int n) {
+    bench_allocs++;
+    return bench_sqlite_default_mem.xRealloc(p, n);
+}
+
+static int bench_install_sqlite_hooks(void) {
+    sqlite3_mem_methods counting;
+    if (sqlite3_config(SQLITE_CONFIG_GETMALLOC, &bench_sqlite_default_mem) != SQLITE_OK) {
+        return SQLITE_ERROR;
+    }
+    counting = bench_sqlite_default_mem;
+    counting.xMalloc = bench_sqlite_malloc;
+    counting.xRealloc = bench_sqlite_realloc;
+    return sqlite3_config(SQLITE_CONFIG_MALLOC, &counting);
+}
+
+static int bench_exec(sqlite3* db, const char* sql) {
+    char* err_msg = NULL;
+    if (sqlite3_exec(db, sql, NULL, NULL, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "bench_sqlite: %s\n  in: %s\n", err_msg, sql);
+        sqlite3_free(err_msg);
+        return 0;
+    }
+    return 1;
+}
+
+// Prepare sql, step through every result row and report the elapsed time per table row
+static int bench_query(sqlite3* db, const char* name, const char* sql, uint64_t rows) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "bench_sqlite: %s\n  in: %s\n", sqlite3_errmsg(db), sql);
+        return 0;
+    }
+
+    uint64_t allocs_before = bench_allocs;
+    uint64_t start = bench_now_ns();
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        bench_sink += (uint64_t)sqlite3_column_bytes(stmt, 0);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    uint64_t allocs = bench_allocs - allocs_before;
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "bench_sqlite: %s\n  in: %s\n", sqlite3_errmsg(db), sql);
+        sqlite3_finalize(stmt);
+        return 0;
+    }
+    sqlite3_finalize(stmt);
+    bench_report("sqlite", name, rows, elapsed, allocs);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    const char* extension = argc > 1 ? argv[1] : "./build/bench/crypto_decimal_extension.so";
+    uint64_t rows = bench_env_u64("BENCH_ROWS", 10000000);
+    sqlite3* db;
+    char* err_msg = NULL;
+
+    bench_install_gmp_hooks();
+    if (bench_install_sqlite_hooks() != SQLITE_OK) {
+        fprintf(stderr, "bench_sqlite: could not install allocation hooks\n");
+        return 1;
+    }
+    if (sqlite3_open(":memory:", &db) != SQLITE_OK) {
+        fprintf(stderr, "bench_sqlite: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    sqlite3_enable_load_extension(db, 1);
+    if (sqlite3_load_extension(db, extension, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "bench_sqlite: could not load %s: %s\n", extension, err_msg);
+        sqlite3_free(err_msg);
+        sqlite3_close(db);
+        return 1;
+    }
+
+    // Amounts up to 99,999 ETH with nine fractional digits, generated deterministically
+    char* populate = sqlite3_mprintf(
+        "CREATE TABLE amounts(amount TEXT NOT NULL);"
+        "INSERT INTO amounts "
+        "WITH RECURSIVE n(x) AS (SELECT 0 UNION ALL SELECT x + 1 FROM n WHERE x + 1 < %llu) "
+        "SELECT printf('%%d.%%09d', x %% 100000, (x * 7919) %% 1000000000) FROM n;",
+        (unsigned long long)rows);
+    // The same amounts spread over 1000 accounts, with balances kept by crypto_balances
+    int ok = bench_exec(db, populate) && bench_exec(db, "SELECT crypto_set_rate('ETH', 'ETH', 'BTC', 'BTC', '0.0655')")
+          && bench_exec(db, "CREATE TABLE ledger(id INTEGER PRIMARY KEY AUTOINCREMENT, account, asset, unit, amount);"
+                            "INSERT INTO ledger(account, asset, unit, amount) "
+                            "SELECT rowid % 1000, 'ETH', 'ETH', amount FROM amounts;"
+                            "CREATE VIRTUAL TABLE balances USING crypto_balances(ledger, account, asset, unit, amount);");
+    sqlite3_free(populate);
+
+    if (ok) {
+        bench_header();
+        ok = bench_query(db, "count_baseline",
+                         "SELECT count(amount) FROM amounts", rows)
+          && bench_query(db, "crypto_sum",
+                         "SELECT crypto_sum('ETH', 'ETH', 'ETH', amount) FROM amounts", rows)
+          && bench_query(db, "crypto_scale_projection",
+                         "SELECT crypto_scale('ETH', 'ETH', 'WEI', amount) FROM amounts", rows)
+          && bench_query(db, "crypto_cmp_where",
+                         "SELECT count(*) FROM amounts WHERE crypto_cmp('ETH', 'ETH', amount, '50000') > 0", rows)
+          && bench_query(db, "same_cell_three_functions",
+                         "SELECT crypto_cmp('ETH', 'ETH', amount, '50000'), crypto_scale('ETH', 'ETH', 'WEI', amount), "
+                         "crypto_add('ETH', 'ETH', amount, amount) FROM amounts", rows)
+          && bench_query(db, "crypto_value_in_sum",
+                         "SELECT crypto_sum('BTC', 'BTC', 'BTC', crypto_value_in('BTC', 'BTC', 'ETH', 'ETH', amount)) "
+                         "FROM amounts", rows)
+          && bench_query(db, "crypto_balances_checkpoint",
+                         "INSERT INTO balances(command) VALUES ('checkpoint')", rows)
+          && bench_query(db, "crypto_balances_read",
+                         "SELECT balance FROM balances", 1000);
+    }
+
+    sqlite3_close(db);
+    return ok ? 0 : 1;
+}
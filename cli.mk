@@ -0,0 +1,25 @@
+# Command-line tools built on the header-only library
+CLI_SRCS = $(SRC_DIR)/crypto_convert.c
+CLI_TARGETS = $(addprefix $(BUILD_DIR)/, $(notdir $(CLI_SRCS:.c=)))
+CLI_DEPS = $(addsuffix .d, $(CLI_TARGETS))
+CLI_HEADERS = $(INCLUDE_DIR)/cryptomath.h $(INCLUDE_DIR)/cryptomath_convert.h
+
+# Distribution files
+DIST_CLI_TARGETS = $(addprefix $(DIST_DIR)/$(DIST_PACKAGE)/bin/, $(notdir $(CLI_TARGETS)))
+
+.PHONY: clean-cli dist-cli
+
+# Build each tool from its single source file
+$(CLI_TARGETS): $(BUILD_DIR)/%: $(SRC_DIR)/%.c $(CLI_HEADERS) | $(BUILD_DIR)
+	$(CC) $(CFLAGS) $(INCLUDE_FLAGS) -o $@ $< $(LDFLAGS)
+
+# Clean command-line tools
+clean-cli:
+	rm -f $(CLI_TARGETS) $(CLI_DEPS)
+
+# Prepare command-line tools for distribution
+dist-cli: $(CLI_TARGETS)
+	mkdir -p $(DIST_DIR)/$(DIST_PACKAGE)/bin
+	cp $(CLI_TARGETS) $(DIST_DIR)/$(DIST_PACKAGE)/bin/
+
+-include $(CLI_DEPS)
@@ -1,9 +1,17 @@
 # Common compiler settings
 CC = gcc
-# -O2 is messing with SHOULD_ASSERT logic in test harness under Linux.
-# I have not bothered to figure out why yet.
-CFLAGS = -Wall -Wextra -O0 -MMD -MP
+# Tests and tools build optimized with asserts on; make debug drops to -O0
+CFLAGS = -Wall -Wextra -O2 -MMD -MP
 DEBUG_CFLAGS = -Wall -Wextra -ggdb -O0 -MMD -MP
+# The shipped extension: asserts off and link-time optimization across its sources
+RELEASE_CFLAGS = -Wall -Wextra -O3 -DNDEBUG -flto=auto -fno-semantic-interposition -MMD -MP
+
+# make CRYPTO_STATS=1 compiles the crypto_stats counters into the extension
+ifeq ($(CRYPTO_STATS),1)
+	CFLAGS += -DCRYPTO_STATS
+	DEBUG_CFLAGS += -DCRYPTO_STATS
+	RELEASE_CFLAGS += -DCRYPTO_STATS
+endif
 
 #── 1) detect platform ────────────────────────────────────────────────────────────
 UNAME_S := $(shell uname -s)
@@ -24,7 +32,9 @@ ifeq ($(UNAME_S),Darwin)
 	endif
 else
 	EXTENSION_SUFFIX = so
-	EXTENSION_FLAGS = -shared
+	# nodelete keeps the extension mapped after sqlite3_close, since worker threads
+	# still run its thread-exit destructor for per-thread scratch
+	EXTENSION_FLAGS = -shared -Wl,-z,nodelete
 endif
 
 # Default settings
@@ -61,7 +71,7 @@ DIST_TARBALL = $(DIST_PACKAGE).tar.gz
 
 # Common flags
 INCLUDE_FLAGS = -I$(INCLUDE_DIR) -I$(SQLITE_INCLUDE_DIR) -I$(GMP_INCLUDE_DIR)
-LDFLAGS = -L$(SQLITE_LIB_DIR) -L$(GMP_LIB_DIR) -lgmp -lsqlite3
+LDFLAGS = -L$(SQLITE_LIB_DIR) -L$(GMP_LIB_DIR) -lgmp -lsqlite3 -lpthread
 
 # Common targets
 .PHONY: all clean test debug
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+#ifndef CRYPTO_BALANCES_H
+#define CRYPTO_BALANCES_H
+
+#include <sqlite3.h>
+
+// The module definition for the crypto_balances virtual table.
+extern sqlite3_module cryptoBalancesModule;
+
+#endif /* CRYPTO_BALANCES_H */
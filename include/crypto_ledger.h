@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+#ifndef CRYPTO_LEDGER_H
+#define CRYPTO_LEDGER_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+#include "cryptomath.h"
+
+// Reading (asset, denomination, amount) rows of a ledger, shared by the
+// crypto_sum_all and crypto_balances virtual tables.
+
+// Longest symbol remembered between rows; longer symbols are looked up every row
+#define CRYPTO_LEDGER_SYMBOL_MAX 16
+
+// A symbol remembered from the previous row with what it resolved to
+typedef struct {
+    char bytes[CRYPTO_LEDGER_SYMBOL_MAX];
+    int len;              // -1 when nothing is remembered
+    crypto_type_t type;   // Type the symbol was resolved against
+    int resolved;         // crypto_type_t or crypto_denom_t
+} crypto_ledger_symbol_t;
+
+// Symbols of the previous row. Ledgers are usually clustered by asset, so the
+// previous row's symbols almost always match and the hash lookups are skipped.
+typedef struct {
+    crypto_ledger_symbol_t asset;
+    crypto_ledger_symbol_t unit;
+} crypto_ledger_reader_t;
+
+void crypto_ledger_reader_init(crypto_ledger_reader_t* reader);
+
+// Reads the asset, denomination and amount (decimal TEXT or crypto BLOB) in columns
+// iCol to iCol+2 of pStmt's current row. On a parsed amount, returns SQLITE_OK with
+// *pParsed true and val initialized to it; the caller clears val. A row with a NULL
+// column or an invalid amount is skipped, as in crypto_sum: SQLITE_OK with *pParsed
+// false. An unknown asset or denomination is SQLITE_ERROR, with *pzErr set to a
+// message prefixed by zFunc.
+int crypto_ledger_read(crypto_ledger_reader_t* reader, sqlite3_stmt* pStmt, int iCol,
+                       const char* zFunc, crypto_val_t* val, bool* pParsed, char** pzErr);
+
+// The denomination totals are kept and shown in: the asset's base unit
+crypto_denom_t crypto_ledger_denom(crypto_type_t type);
+
+// Formats val in denom into buf when it fits, and otherwise into memory the caller
+// releases with crypto_free. Sets *pn to the length; returns NULL when out of memory.
+char* crypto_ledger_format(const crypto_val_t* val, crypto_denom_t denom,
+                           char* buf, size_t cap, int* pn);
+
+#endif /* CRYPTO_LEDGER_H */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+#ifndef CRYPTO_STATS_H
+#define CRYPTO_STATS_H
+
+#include <sqlite3.h>
+#include <stdint.h>
+
+// The module definition for the crypto_stats virtual table.
+extern sqlite3_module cryptoStatsModule;
+
+// Instrumented SQL functions; the first six match crypto_arithmetic_op_t
+typedef enum {
+    CRYPTO_STATS_FN_ADD,
+    CRYPTO_STATS_FN_SUB,
+    CRYPTO_STATS_FN_MUL,
+    CRYPTO_STATS_FN_DIV_TRUNC,
+    CRYPTO_STATS_FN_DIV_FLOOR,
+    CRYPTO_STATS_FN_DIV_CEIL,
+    CRYPTO_STATS_FN_MULDIV,
+    CRYPTO_STATS_FN_SCALE,
+    CRYPTO_STATS_FN_CMP,
+    CRYPTO_STATS_FN_TO_BLOB,
+    CRYPTO_STATS_FN_FROM_BLOB,
+    CRYPTO_STATS_FN_SUM,
+    CRYPTO_STATS_FN_MAX,
+    CRYPTO_STATS_FN_MIN,
+    CRYPTO_STATS_FN_COUNT
+} crypto_stats_fn_t;
+
+// Counters that are not per function
+typedef enum {
+    CRYPTO_STATS_PARSE_FAILURES,  // Operands rejected or skipped as invalid
+    CRYPTO_STATS_ALLOCS,          // Library allocations through SQLite
+    CRYPTO_STATS_ALLOC_BYTES,     // Bytes requested by those allocations
+    CRYPTO_STATS_AUXDATA_HITS,    // Symbols and scalars reused from auxdata
+    CRYPTO_STATS_AUXDATA_MISSES,  // Symbols and scalars resolved or parsed again
+    CRYPTO_STATS_MEMO_HITS,       // Decimal operands answered from the parse memo
+    CRYPTO_STATS_MEMO_MISSES,     // Decimal operands parsed
+    CRYPTO_STATS_FAST_PATH,       // Arithmetic done inline on mpn primitives
+    CRYPTO_STATS_GMP_FALLBACK,    // Arithmetic done on promoted mpz values
+    CRYPTO_STATS_COUNTER_COUNT
+} crypto_stats_counter_t;
+
+// One call in 2^CRYPTO_STATS_SAMPLE_SHIFT is timed; its time is scaled up to stand
+// in for the calls that were not
+#define CRYPTO_STATS_SAMPLE_SHIFT 6
+
+#ifdef CRYPTO_STATS
+#include <stdatomic.h>
+
+// Relaxed atomics: the counters are statistics, so no ordering is needed and
+// increments stay a single locked add
+extern _Atomic uint64_t crypto_stats_counters[CRYPTO_STATS_COUNTER_COUNT];
+extern _Atomic uint64_t crypto_stats_calls[CRYPTO_STATS_FN_COUNT];
+extern _Atomic uint64_t crypto_stats_ns[CRYPTO_STATS_FN_COUNT];
+
+uint64_t crypto_stats_begin(crypto_stats_fn_t fn);
+void crypto_stats_end(crypto_stats_fn_t fn, uint64_t start);
+
+#define CRYPTO_STATS_ADD(counter, n) \
+    atomic_fetch_add_explicit(&crypto_stats_counters[counter], (uint64_t)(n), memory_order_relaxed)
+
+// Define an instrumented wrapper of an SQL function implementation for one function id
+#define CRYPTO_STATS_WRAP(impl, fn)                                          \
+    static void impl##_##fn(sqlite3_context *c, int argc, sqlite3_value **argv) { \
+        uint64_t start = crypto_stats_begin(fn);                             \
+        impl(c, argc, argv);                                                 \
+        crypto_stats_end(fn, start);                                         \
+    }
+// The implementation to register: the wrapper defined by CRYPTO_STATS_WRAP
+#define CRYPTO_STATS_FUNC(impl, fn) impl##_##fn
+
+#else
+
+#define CRYPTO_STATS_ADD(counter, n) ((void)0)
+#define CRYPTO_STATS_WRAP(impl, fn)
+#define CRYPTO_STATS_FUNC(impl, fn) impl
+
+#endif /* CRYPTO_STATS */
+
+void crypto_stats_reset(void);
+
+#endif /* CRYPTO_STATS_H */
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+#ifndef CRYPTO_SUM_ALL_H
+#define CRYPTO_SUM_ALL_H
+
+#include <sqlite3.h>
+
+// The module definition for the crypto_sum_all table-valued function.
+extern sqlite3_module cryptoSumAllModule;
+
+#endif /* CRYPTO_SUM_ALL_H */
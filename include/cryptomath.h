@@ -25,22 +25,28 @@
 // crypto_clear(&val1);
 // crypto_clear(&val2);
 // crypto_clear(&result);
+//
+// Thread safety: every function may be called from any number of threads at once,
+// provided a value (or column) written by one thread is not used by another at the
+// same time. Shared tables are built once under pthread_once and temporaries live
+// in per-thread scratch. crypto_set_allocator is the one exception and must be called
+// before other threads use the library. Link with -lpthread.
 
 #ifndef CRYPTOMATH_H
 #define CRYPTOMATH_H
 
 #include <gmp.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <stdlib.h>
+#include <pthread.h>
 
-// TODO: Perhaps this metadata could be stored in a database or file?
-// If so, how could we make it type safe?
-// Perhaps codegen from a schema?
-// Load into a hash table?
-// Enumeration of supported cryptocurrencies
+// Enumeration of the built-in cryptocurrencies. More can be registered at runtime;
+// see crypto_register_type.
 typedef enum {
     CRYPTO_BITCOIN,
     CRYPTO_ETHEREUM,
@@ -106,9 +112,54 @@ typedef enum {
     DENOM_COUNT  // Keep this as the last entry
 } crypto_denom_t;
 
+#if GMP_NAIL_BITS != 0
+#error "cryptomath requires a GMP build without nail bits"
+#endif
+
+// Values whose magnitude fits in CRYPTO_INLINE_BITS are stored inline, which covers
+// every real balance (BTC sats fit in 64 bits, EVM amounts are uint256). Only values
+// that overflow the inline limbs are promoted to a heap-allocated mpz_t.
+#define CRYPTO_INLINE_BITS 256
+#define CRYPTO_INLINE_LIMBS (CRYPTO_INLINE_BITS / GMP_NUMB_BITS)
+// Decimal digits needed for the largest inline magnitude (2^256 - 1 has 78 digits)
+#define CRYPTO_INLINE_DIGITS 78
+// Largest power of ten in the shared table; 10^77 is the largest that fits inline
+#define CRYPTO_POW10_MAX 77
+// Largest power of ten that fits in a uint64_t
+#define CRYPTO_POW10_U64_MAX 19
+// Returned by crypto_format_to when a value wider than CRYPTO_INLINE_BITS needs
+// scratch memory and none can be allocated
+#define CRYPTO_FORMAT_NOMEM SIZE_MAX
+
+// Instrumentation hook called with true when arithmetic runs inline on mpn primitives
+// and false when it falls back to mpz. Define it before including this header to count
+// the two; by default it compiles to nothing.
+#ifndef CRYPTO_STAT_PATH
+#define CRYPTO_STAT_PATH(fast) ((void)0)
+#endif
+
+// Binary amount encoding produced by crypto_to_blob. Built-in types are written by
+// id, registered types by symbol, so their blobs do not depend on registration order.
+#define CRYPTO_BLOB_VERSION 1
+#define CRYPTO_BLOB_VERSION_SYMBOL 2
+#define CRYPTO_BLOB_HEADER_SIZE 4
+#define CRYPTO_BLOB_HEADER_MAX (3 + CRYPTO_SYMBOL_MAX)
+#define CRYPTO_BLOB_MAX_MAGNITUDE 127
+// Encoded size of any inline value
+#define CRYPTO_BLOB_INLINE_MAX (CRYPTO_BLOB_HEADER_MAX + CRYPTO_INLINE_BITS / 8)
+
+// Partial encoding produced by crypto_partial_to_blob
+#define CRYPTO_PARTIAL_VERSION 0x50
+#define CRYPTO_PARTIAL_HEADER_SIZE 9
+// Encoded size of any partial whose sum, min and max are inline
+#define CRYPTO_PARTIAL_INLINE_MAX (CRYPTO_PARTIAL_HEADER_SIZE + 3 * CRYPTO_BLOB_INLINE_MAX)
+
 typedef struct {
-    crypto_type_t crypto_type;
-    mpz_t value;
+    crypto_type_t crypto_type;             // Type of cryptocurrency
+    int size;                              // Signed limb count of the inline value (GMP _mp_size convention)
+    bool is_big;                           // True once the value has been promoted to big
+    mp_limb_t limbs[CRYPTO_INLINE_LIMBS];  // Inline magnitude, least significant limb first
+    mpz_t big;                             // Promoted value; only initialized when is_big is true
 } crypto_val_t;
 
 typedef struct {
@@ -430,65 +481,475 @@ static const crypto_denom_def_t crypto_denoms[] = {
     }
 };
 
+// Types and denominations registered at runtime live alongside the built-in tables.
+// Their ids follow the CRYPTO_COUNT and DENOM_COUNT sentinels, which keep meaning
+// "unknown", so registered type k has id CRYPTO_TYPE_FIRST_REGISTERED + k. Ids are
+// assigned in registration order and are never reused.
+#define CRYPTO_REGISTRY_MAX_TYPES 2048
+#define CRYPTO_REGISTRY_MAX_DENOMS 8192
+#define CRYPTO_TYPE_FIRST_REGISTERED (CRYPTO_COUNT + 1)
+#define CRYPTO_DENOM_FIRST_REGISTERED (DENOM_COUNT + 1)
+// Longest symbol a registered type or denomination may have, in bytes
+#define CRYPTO_SYMBOL_MAX 32
+
+extern crypto_def_t crypto_registry_types[CRYPTO_REGISTRY_MAX_TYPES];
+extern crypto_denom_def_t crypto_registry_denoms[CRYPTO_REGISTRY_MAX_DENOMS];
+
+// Definition of a valid type, built-in or registered. One compare and one load, so it
+// is as cheap on the hot path as indexing crypto_defs.
+static inline const crypto_def_t* crypto_type_def(crypto_type_t type) {
+    return (unsigned)type < CRYPTO_COUNT ? &crypto_defs[type]
+                                         : &crypto_registry_types[type - CRYPTO_TYPE_FIRST_REGISTERED];
+}
+
+// Definition of a valid denomination, built-in or registered
+static inline const crypto_denom_def_t* crypto_denom_def(crypto_denom_t denom) {
+    return (unsigned)denom < DENOM_COUNT ? &crypto_denoms[denom]
+                                         : &crypto_registry_denoms[denom - CRYPTO_DENOM_FIRST_REGISTERED];
+}
+
+// Dense index of a valid type in [0, crypto_type_count()), for per-type arrays;
+// built-in types keep their enum value
+static inline size_t crypto_type_index(crypto_type_t type) {
+    return (unsigned)type < CRYPTO_COUNT ? (size_t)type : (size_t)type - 1;
+}
+
+static inline crypto_type_t crypto_type_at(size_t index) {
+    return (crypto_type_t)(index < CRYPTO_COUNT ? index : index + 1);
+}
+
+static inline size_t crypto_denom_index(crypto_denom_t denom) {
+    return (unsigned)denom < DENOM_COUNT ? (size_t)denom : (size_t)denom - 1;
+}
+
+static inline crypto_denom_t crypto_denom_at(size_t index) {
+    return (crypto_denom_t)(index < DENOM_COUNT ? index : index + 1);
+}
+
+// Result of crypto_register_type, crypto_register_denom and crypto_registry_load
+typedef enum {
+    CRYPTO_REGISTRY_OK = 0,            // Registered, or already registered identically
+    CRYPTO_REGISTRY_INVALID_SYMBOL,    // Empty, too long, or containing spaces or control bytes
+    CRYPTO_REGISTRY_INVALID_NAME,      // Empty name or containing control bytes
+    CRYPTO_REGISTRY_INVALID_DECIMALS,  // More than CRYPTO_POW10_MAX decimal places
+    CRYPTO_REGISTRY_UNKNOWN_TYPE,      // Denomination for a type that does not exist
+    CRYPTO_REGISTRY_CONFLICT,          // Symbol already registered with other decimals
+    CRYPTO_REGISTRY_FULL,              // CRYPTO_REGISTRY_MAX_TYPES or _MAX_DENOMS reached
+    CRYPTO_REGISTRY_NOMEM,             // Out of memory
+    CRYPTO_REGISTRY_SYNTAX,            // Malformed line in a registry file
+    CRYPTO_REGISTRY_IO_ERROR           // Registry file could not be read; see errno
+} crypto_registry_status_t;
+
+// Result of crypto_parse_decimal
+typedef enum {
+    CRYPTO_PARSE_OK = 0,         // Parsed successfully
+    CRYPTO_PARSE_EMPTY,          // Empty or whitespace-only input
+    CRYPTO_PARSE_NO_DIGITS,      // Sign and/or decimal point without any digits
+    CRYPTO_PARSE_INVALID_CHAR,   // Character that is not part of a decimal number
+    CRYPTO_PARSE_MULTIPLE_DOTS,  // More than one decimal point
+    CRYPTO_PARSE_NOMEM           // Out of memory storing the value (crypto_column_parse)
+} crypto_parse_status_t;
+
+// Rounding of a quotient that is not exact
+typedef enum {
+    CRYPTO_ROUND_TRUNCATE,  // Toward zero
+    CRYPTO_ROUND_FLOOR,     // Toward negative infinity
+    CRYPTO_ROUND_CEIL,      // Toward positive infinity
+    CRYPTO_ROUND_HALF_UP,   // To nearest, ties away from zero
+    CRYPTO_ROUND_HALF_EVEN  // To nearest, ties to the even neighbour
+} crypto_rounding_t;
+
+// A divisor prepared once for many divisions by crypto_divisor_init. When its magnitude
+// fits one limb, inline dividends are divided with a precomputed reciprocal: a few
+// multiplies per limb instead of a hardware or bignum division.
+typedef struct {
+    mpz_t value;      // The divisor
+    bool word;        // True when the reciprocal below is usable
+    bool negative;    // True when the divisor is negative
+    unsigned shift;   // Leading zero bits of the divisor's magnitude
+    mp_limb_t norm;   // Magnitude shifted left by shift, so its top bit is set
+    mp_limb_t inv;    // floor((B^2 - 1) / norm) - B, with B = 2^GMP_NUMB_BITS
+} crypto_divisor_t;
+
+// Mergeable summary of amounts of one crypto type. Partials of disjoint sets of
+// amounts, e.g. shards of a ledger summed in different processes, merge in any order
+// into exactly the partial of their union.
+typedef struct {
+    uint64_t count;    // Number of amounts added
+    crypto_val_t sum;  // Exact sum; its crypto type is the partial's
+    crypto_val_t min;  // Smallest amount added; zero while count is 0
+    crypto_val_t max;  // Largest amount added; zero while count is 0
+} crypto_partial_t;
+
+// Allocator used for every heap allocation the library makes itself; see crypto_set_allocator
+typedef void* (*crypto_malloc_fn)(size_t size);
+typedef void* (*crypto_realloc_fn)(void* ptr, size_t size);
+typedef void (*crypto_free_fn)(void* ptr);
+
 // Public API
+void crypto_set_allocator(crypto_malloc_fn malloc_fn, crypto_realloc_fn realloc_fn, crypto_free_fn free_fn);
+void* crypto_malloc(size_t size);
+void* crypto_realloc(void* ptr, size_t size);
+void crypto_free(void* ptr);
+void crypto_thread_cleanup(void);
 int crypto_is_valid_type(crypto_type_t type);
 int crypto_is_valid_denom(crypto_denom_t denom);
 void crypto_init(crypto_val_t* val, crypto_type_t type);
 void crypto_clear(crypto_val_t* val);
 void crypto_set(crypto_val_t* to, const crypto_val_t* from);
-void crypto_set_from_decimal(crypto_val_t* val, crypto_denom_t denom, const char* decimal_str);
+void crypto_set_mpz(crypto_val_t* val, const mpz_t op);
+void crypto_get_mpz(mpz_t rop, const crypto_val_t* val);
+mpz_srcptr crypto_view(const crypto_val_t* val, mpz_ptr view);
+bool crypto_set_from_decimal(crypto_val_t* val, crypto_denom_t denom, const char* decimal_str);
+crypto_parse_status_t crypto_parse_decimal(crypto_val_t* val, crypto_denom_t denom, const char* str, size_t len, size_t* error_pos);
+const char* crypto_parse_status_str(crypto_parse_status_t status);
 char* crypto_to_decimal_str(crypto_val_t* val, crypto_denom_t denom);
+size_t crypto_format_to(char* buf, size_t cap, const crypto_val_t* val, crypto_denom_t denom);
+size_t crypto_format_max_len(crypto_denom_t denom);
+size_t crypto_to_blob(unsigned char* buf, size_t cap, const crypto_val_t* val);
+crypto_type_t crypto_blob_type(const unsigned char* buf, size_t len);
+bool crypto_from_blob(crypto_val_t* val, const unsigned char* buf, size_t len);
+void crypto_partial_init(crypto_partial_t* p, crypto_type_t type);
+void crypto_partial_clear(crypto_partial_t* p);
+void crypto_partial_add(crypto_partial_t* p, const crypto_val_t* val);
+void crypto_partial_merge(crypto_partial_t* p, const crypto_partial_t* other);
+size_t crypto_partial_to_blob(unsigned char* buf, size_t cap, const crypto_partial_t* p);
+crypto_type_t crypto_partial_blob_type(const unsigned char* buf, size_t len);
+bool crypto_partial_from_blob(crypto_partial_t* p, const unsigned char* buf, size_t len);
 void crypto_add(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b);
 void crypto_sub(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b);
 void crypto_mul(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b);
 void crypto_div_truncate(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b);
 void crypto_div_floor(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b);
 void crypto_div_ceil(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b);
+void crypto_divisor_init(crypto_divisor_t* d, const mpz_t value);
+void crypto_divisor_clear(crypto_divisor_t* d);
+void crypto_div_by(crypto_val_t* r, const crypto_val_t* a, const crypto_divisor_t* d, crypto_rounding_t rounding);
+void crypto_muldiv(crypto_val_t* r, const crypto_val_t* a, const mpz_t* num, const mpz_t* den, crypto_rounding_t rounding);
 int crypto_cmp(const crypto_val_t* a, const crypto_val_t* b);
 int crypto_gt_zero(const crypto_val_t* a);
 int crypto_lt_zero(const crypto_val_t* a);
 int crypto_eq_zero(const crypto_val_t* a);
+void crypto_add_n(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b, size_t n);
+void crypto_sub_n(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b, size_t n);
+void crypto_mul_n(crypto_val_t* r, const crypto_val_t* a, const mpz_t* b, size_t n);
+void crypto_sum_n(crypto_val_t* r, const crypto_val_t* a, size_t n);
+size_t crypto_cmp_n(uint64_t* mask, const crypto_val_t* a, size_t n, const crypto_val_t* threshold, int sign);
 crypto_denom_t crypto_get_denom_for_symbol(crypto_type_t type, const char* symbol);
 crypto_type_t crypto_get_type_for_symbol(const char* symbol);
+crypto_denom_t crypto_get_denom_for_symbol_n(crypto_type_t type, const char* symbol, size_t len);
+crypto_type_t crypto_get_type_for_symbol_n(const char* symbol, size_t len);
+crypto_denom_t crypto_first_denom(crypto_type_t type);
+crypto_denom_t crypto_next_denom(crypto_denom_t denom);
+size_t crypto_type_count(void);
+size_t crypto_denom_count(void);
+crypto_registry_status_t crypto_register_type(const char* symbol, const char* name, unsigned decimals, crypto_type_t* type);
+crypto_registry_status_t crypto_register_denom(crypto_type_t type, const char* symbol, const char* name, unsigned decimals, crypto_denom_t* denom);
+crypto_registry_status_t crypto_registry_load_buffer(const char* data, size_t len, size_t* error_line);
+crypto_registry_status_t crypto_registry_load(const char* path, size_t* error_line);
+const char* crypto_registry_status_str(crypto_registry_status_t status);
 bool crypto_is_valid_decimal(const char* str);
 uint8_t crypto_scale_by_precision(const char* str, mpz_t* result);
 bool crypto_has_nonzero_fraction(const char* str);
+uint64_t crypto_pow10_u64(unsigned k);
+const mpz_t* crypto_pow10(unsigned k);
+uint64_t crypto_denom_scale_u64(crypto_denom_t denom);
+const mpz_t* crypto_denom_scale(crypto_denom_t denom);
 
 // Begin implementation section
 #ifdef CRYPTOMATH_IMPLEMENTATION
 
-// Note: I assume that decimals will not exceed 18 places.
-// No token I can find has more than 18 decimal places.
-// If you need more, you can change the return to a mpz_t.
-uint64_t power(uint64_t base, uint64_t exp)
-{
-    uint64_t result = 1;
-    while(exp) 
-    {   
-        result = result * base; 
-        exp--; 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static crypto_malloc_fn crypto_malloc_hook = malloc;
+static crypto_realloc_fn crypto_realloc_hook = realloc;
+static crypto_free_fn crypto_free_hook = free;
+
+// Route the library's own heap allocations (returned strings, column storage and
+// the per-thread scratch below) through the given functions; NULLs restore libc.
+// GMP's allocations are not affected: its hooks are process-wide, so changing them
+// belongs to the application. Set the allocator before other threads use the
+// library; the calling thread's scratch is released so nothing is freed by the
+// wrong allocator.
+void crypto_set_allocator(crypto_malloc_fn malloc_fn, crypto_realloc_fn realloc_fn, crypto_free_fn free_fn) {
+    assert((malloc_fn == NULL) == (realloc_fn == NULL) && (malloc_fn == NULL) == (free_fn == NULL));
+    if (malloc_fn == NULL) {
+        malloc_fn = malloc;
+        realloc_fn = realloc;
+        free_fn = free;
+    }
+    if (malloc_fn == crypto_malloc_hook && realloc_fn == crypto_realloc_hook && free_fn == crypto_free_hook) {
+        return;
+    }
+    crypto_thread_cleanup();
+    crypto_malloc_hook = malloc_fn;
+    crypto_realloc_hook = realloc_fn;
+    crypto_free_hook = free_fn;
+}
+
+void* crypto_malloc(size_t size) {
+    return crypto_malloc_hook(size);
+}
+
+void* crypto_realloc(void* ptr, size_t size) {
+    return crypto_realloc_hook(ptr, size);
+}
+
+// Free memory returned by the library, such as crypto_to_decimal_str results
+void crypto_free(void* ptr) {
+    if (ptr != NULL) {
+        crypto_free_hook(ptr);
+    }
+}
+
+// Per-thread scratch reused across calls instead of allocating temporaries each time:
+// a small LIFO pool of mpz_t, pre-sized for two inline values, and a bump buffer for
+// byte temporaries that is reset by every call that carves it. Each thread's scratch
+// is registered with a pthread key when it first allocates, so it is released when
+// the thread exits.
+#define CRYPTO_SCRATCH_MPZ 4
+
+typedef struct {
+    mpz_t mpz[CRYPTO_SCRATCH_MPZ];
+    int mpz_ready;            // Pool entries initialized so far
+    int mpz_used;             // Pool entries currently handed out
+    unsigned char* bytes;     // Bump buffer from crypto_malloc
+    size_t bytes_cap;
+    bool registered;          // Set in the thread's crypto_scratch_key slot
+} crypto_scratch_t;
+
+static _Thread_local crypto_scratch_t crypto_scratch;
+static pthread_key_t crypto_scratch_key;
+static pthread_once_t crypto_scratch_key_once = PTHREAD_ONCE_INIT;
+
+static void crypto_scratch_free(crypto_scratch_t* s) {
+    assert(s->mpz_used == 0);
+    for (int i = 0; i < s->mpz_ready; i++) {
+        mpz_clear(s->mpz[i]);
+    }
+    crypto_free(s->bytes);
+    memset(s, 0, sizeof(*s));
+}
+
+// Thread-exit destructor for the crypto_scratch_key slot
+static void crypto_scratch_destroy(void* p) {
+    crypto_scratch_free((crypto_scratch_t*)p);
+}
+
+static void crypto_scratch_key_create(void) {
+    int rc = pthread_key_create(&crypto_scratch_key, crypto_scratch_destroy);
+    assert(rc == 0);
+    (void)rc;
+}
+
+static void crypto_scratch_register(crypto_scratch_t* s) {
+    if (!s->registered) {
+        pthread_once(&crypto_scratch_key_once, crypto_scratch_key_create);
+        pthread_setspecific(crypto_scratch_key, s);
+        s->registered = true;
+    }
+}
+
+// Take an mpz_t from the pool; release in reverse order of acquisition.
+static mpz_ptr crypto_scratch_mpz(void) {
+    crypto_scratch_t* s = &crypto_scratch;
+    assert(s->mpz_used < CRYPTO_SCRATCH_MPZ);
+    if (s->mpz_used == s->mpz_ready) {
+        crypto_scratch_register(s);
+        mpz_init2(s->mpz[s->mpz_ready++], 2 * CRYPTO_INLINE_BITS);
+    }
+    return s->mpz[s->mpz_used++];
+}
+
+static void crypto_scratch_mpz_release(mpz_ptr z) {
+    crypto_scratch_t* s = &crypto_scratch;
+    (void)z;
+    assert(s->mpz_used > 0 && z == s->mpz[s->mpz_used - 1]);
+    s->mpz_used--;
+}
+
+// Reset the bump buffer and return at least size bytes of it, or NULL if it
+// cannot grow, leaving the old buffer in place. Anything carved from an earlier
+// call is invalidated, so callers must not nest.
+static unsigned char* crypto_scratch_bytes(size_t size) {
+    crypto_scratch_t* s = &crypto_scratch;
+    if (size > s->bytes_cap) {
+        size_t cap = s->bytes_cap ? s->bytes_cap : 256;
+        while (cap < size) {
+            cap *= 2;
+        }
+        unsigned char* bytes = crypto_malloc(cap);
+        if (bytes == NULL) {
+            return NULL;
+        }
+        crypto_scratch_register(s);
+        crypto_free(s->bytes);
+        s->bytes = bytes;
+        s->bytes_cap = cap;
+    }
+    return s->bytes;
+}
+
+// Release the calling thread's scratch memory now rather than at thread exit; the
+// next call into the library rebuilds what it needs. Threads that exit through
+// pthread_exit or by returning release it automatically.
+void crypto_thread_cleanup(void) {
+    crypto_scratch_t* s = &crypto_scratch;
+    if (s->registered) {
+        pthread_setspecific(crypto_scratch_key, NULL);
+    }
+    crypto_scratch_free(s);
+}
+
+static const uint64_t crypto_pow10_u64_table[CRYPTO_POW10_U64_MAX + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// 10^0 .. 10^CRYPTO_POW10_MAX as inline limbs, exposed through read-only mpz_t views.
+// Built once, on first use, under pthread_once and read-only afterwards.
+static mp_limb_t crypto_pow10_limbs[CRYPTO_POW10_MAX + 1][CRYPTO_INLINE_LIMBS];
+static mpz_t crypto_pow10_table[CRYPTO_POW10_MAX + 1];
+static pthread_once_t crypto_pow10_once = PTHREAD_ONCE_INIT;
+
+static void crypto_pow10_build(void) {
+    mp_size_t n = 1;
+    crypto_pow10_limbs[0][0] = 1;
+    mpz_roinit_n(crypto_pow10_table[0], crypto_pow10_limbs[0], n);
+    for (unsigned k = 1; k <= CRYPTO_POW10_MAX; k++) {
+        mp_limb_t carry = mpn_mul_1(crypto_pow10_limbs[k], crypto_pow10_limbs[k - 1], n, 10);
+        if (carry != 0) {
+            crypto_pow10_limbs[k][n++] = carry;
+        }
+        mpz_roinit_n(crypto_pow10_table[k], crypto_pow10_limbs[k], n);
     }
-    return result;
 }
 
+// 10^k as a native integer, for k <= CRYPTO_POW10_U64_MAX.
+uint64_t crypto_pow10_u64(unsigned k) {
+    assert(k <= CRYPTO_POW10_U64_MAX);
+    return crypto_pow10_u64_table[k];
+}
+
+// 10^k as a read-only mpz_t, for k <= CRYPTO_POW10_MAX. The result must not be
+// modified or cleared; it can be passed directly to crypto_mul and crypto_div_*.
+const mpz_t* crypto_pow10(unsigned k) {
+    assert(k <= CRYPTO_POW10_MAX);
+    pthread_once(&crypto_pow10_once, crypto_pow10_build);
+    return (const mpz_t*)&crypto_pow10_table[k];
+}
+
+// 10^decimals for a denom as a native integer, or 0 if it does not fit: registered
+// denoms may have up to CRYPTO_POW10_MAX decimals, so callers check for 0 and use
+// crypto_denom_scale instead.
+uint64_t crypto_denom_scale_u64(crypto_denom_t denom) {
+    assert(crypto_is_valid_denom(denom));
+    unsigned decimals = crypto_denom_def(denom)->decimals;
+    return decimals <= CRYPTO_POW10_U64_MAX ? crypto_pow10_u64(decimals) : 0;
+}
+
+// 10^decimals for a denom as a read-only mpz_t.
+const mpz_t* crypto_denom_scale(crypto_denom_t denom) {
+    assert(crypto_is_valid_denom(denom));
+    return crypto_pow10(crypto_denom_def(denom)->decimals);
+}
+
+// Registered types and denominations. Entries are written under crypto_registry_lock
+// and published by a release store of the count, so readers never take the lock.
+crypto_def_t crypto_registry_types[CRYPTO_REGISTRY_MAX_TYPES];
+crypto_denom_def_t crypto_registry_denoms[CRYPTO_REGISTRY_MAX_DENOMS];
+static unsigned crypto_registry_type_n;
+static unsigned crypto_registry_denom_n;
+static pthread_mutex_t crypto_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
 int crypto_is_valid_type(crypto_type_t type) {
-    return (type >= 0 && type < CRYPTO_COUNT);
+    unsigned t = (unsigned)type;
+    return t < CRYPTO_COUNT ||
+           (t >= CRYPTO_TYPE_FIRST_REGISTERED &&
+            t - CRYPTO_TYPE_FIRST_REGISTERED < __atomic_load_n(&crypto_registry_type_n, __ATOMIC_ACQUIRE));
 }
 
 int crypto_is_valid_denom(crypto_denom_t denom) {
-    return (denom >= 0 && denom < DENOM_COUNT);
+    unsigned d = (unsigned)denom;
+    return d < DENOM_COUNT ||
+           (d >= CRYPTO_DENOM_FIRST_REGISTERED &&
+            d - CRYPTO_DENOM_FIRST_REGISTERED < __atomic_load_n(&crypto_registry_denom_n, __ATOMIC_ACQUIRE));
+}
+
+// Number of types, built-in and registered; crypto_type_at maps [0, count) to ids
+size_t crypto_type_count(void) {
+    return CRYPTO_COUNT + __atomic_load_n(&crypto_registry_type_n, __ATOMIC_ACQUIRE);
+}
+
+// Number of denominations, built-in and registered
+size_t crypto_denom_count(void) {
+    return DENOM_COUNT + __atomic_load_n(&crypto_registry_denom_n, __ATOMIC_ACQUIRE);
 }
 
 void crypto_init(crypto_val_t* val, crypto_type_t type) {
     assert(val != NULL);
     assert(crypto_is_valid_type(type));
     val->crypto_type = type;
-    mpz_init(val->value);
+    val->size = 0;
+    val->is_big = false;
 }
 
 void crypto_clear(crypto_val_t* val) {
     assert(val != NULL);
-    mpz_clear(val->value);
+    if (val->is_big) {
+        mpz_clear(val->big);
+    }
+    val->size = 0;
+    val->is_big = false;
+}
+
+// Get a read-only mpz view of a crypto_val_t without copying.
+// For inline values the view aliases val->limbs, so it is only valid while val is
+// unchanged, and it must never be written to or cleared.
+mpz_srcptr crypto_view(const crypto_val_t* val, mpz_ptr view) {
+    assert(val != NULL);
+    assert(view != NULL);
+    if (val->is_big) {
+        return val->big;
+    }
+    return mpz_roinit_n(view, val->limbs, val->size);
+}
+
+// Move a value onto the GMP representation. Values stay promoted until cleared.
+static void crypto_promote(crypto_val_t* val) {
+    if (val->is_big) {
+        return;
+    }
+    mpz_t view;
+    mpz_init2(val->big, 2 * CRYPTO_INLINE_BITS);
+    mpz_set(val->big, crypto_view(val, view));
+    val->is_big = true;
+}
+
+// Store a magnitude of n limbs with the given sign, keeping it inline when it fits.
+// p must not alias val->limbs.
+static void crypto_store_limbs(crypto_val_t* val, const mp_limb_t* p, mp_size_t n, bool negative) {
+    while (n > 0 && p[n - 1] == 0) {
+        n--;
+    }
+    if (!val->is_big && n <= CRYPTO_INLINE_LIMBS) {
+        if (n > 0) {
+            memcpy(val->limbs, p, n * sizeof(mp_limb_t));
+        }
+        val->size = (int)(negative ? -n : n);
+        return;
+    }
+    mpz_t view;
+    crypto_promote(val);
+    mpz_set(val->big, mpz_roinit_n(view, p, negative ? -n : n));
 }
 
 // Set the value of a crypto_val_t from another crypto_val_t.
@@ -497,19 +958,50 @@ void crypto_set(crypto_val_t* to, const crypto_val_t* from) {
     assert(to != NULL);
     assert(from != NULL);
     assert(to->crypto_type == from->crypto_type);
-    mpz_set(to->value, from->value);
+    if (to == from) {
+        return;
+    }
+    if (!to->is_big && !from->is_big) {
+        to->size = from->size;
+        memcpy(to->limbs, from->limbs, sizeof(to->limbs));
+        return;
+    }
+    mpz_t view;
+    crypto_promote(to);
+    mpz_set(to->big, crypto_view(from, view));
 }
 
-// Set the value of a crypto_val_t from a decimal string.
-// Note that val will be stored in the smallest unit of the crypto type.
-// For example, if the decimal string is "1.23456789" and the denom is BTC_DENOM_BITCOIN,
-// val will be set to 123456789.
-void crypto_set_from_decimal(crypto_val_t* val, crypto_denom_t denom, const char* decimal_str) {
+// Set the value of a crypto_val_t, in the smallest unit of its crypto type, from a GMP integer.
+void crypto_set_mpz(crypto_val_t* val, const mpz_t op) {
     assert(val != NULL);
-    assert(crypto_is_valid_denom(denom));
-    assert(decimal_str != NULL);
-    assert(val->crypto_type == crypto_denoms[denom].crypto_type);
+    assert(op != NULL);
+    if (val->is_big) {
+        mpz_set(val->big, op);
+        return;
+    }
+    mp_size_t n = mpz_size(op);
+    if (n <= CRYPTO_INLINE_LIMBS) {
+        if (n > 0) {
+            memcpy(val->limbs, mpz_limbs_read(op), n * sizeof(mp_limb_t));
+        }
+        val->size = (int)(mpz_sgn(op) < 0 ? -n : n);
+        return;
+    }
+    crypto_promote(val);
+    mpz_set(val->big, op);
+}
+
+// Copy the value of a crypto_val_t, in the smallest unit of its crypto type, into a GMP integer.
+void crypto_get_mpz(mpz_t rop, const crypto_val_t* val) {
+    assert(rop != NULL);
+    assert(val != NULL);
+    mpz_t view;
+    mpz_set(rop, crypto_view(val, view));
+}
 
+// Part-wise parse used by crypto_set_from_decimal for strings that are not valid decimals.
+// Returns false, leaving val unchanged, if the scratch buffer cannot grow.
+static bool crypto_set_from_decimal_lenient(crypto_val_t* val, crypto_denom_t denom, const char* decimal_str) {
     // 1. Truncate spaces from decimal_str
     while (*decimal_str == ' ') {
         decimal_str++;
@@ -524,331 +1016,2140 @@ void crypto_set_from_decimal(crypto_val_t* val, crypto_denom_t denom, const char
         decimal_str++;
     }
     
-    // 3. Parse the decimal string
+    // 3. Parse the decimal string; scratch values are reused, so a part that is not
+    // a number is reset to zero explicitly
+    mpz_ptr value = crypto_scratch_mpz();
     const char *dot = strchr(decimal_str, '.');
     if (dot == NULL) {
         // No decimal point, just set the value
-        mpz_set_str(val->value, decimal_str, 10);
+        if (mpz_set_str(value, decimal_str, 10) != 0) {
+            mpz_set_ui(value, 0);
+        }
         // Scale the whole number by the number of decimal places
-        // TODO: Pre-calculate the power of 10 for the denom
-        mpz_mul_ui(val->value, val->value, power(10, crypto_denoms[denom].decimals));
+        mpz_mul(value, value, *crypto_denom_scale(denom));
     } else {
-        // Parse whole number and fraction separately
-        mpz_t whole_part;
-        mpz_t fraction_part;
-        mpz_init(whole_part);
-        mpz_init(fraction_part);
-        
+        // Parse whole number and fraction separately, with both strings carved
+        // from the scratch buffer
+        mpz_ptr whole_part = crypto_scratch_mpz();
+        mpz_ptr fraction_part = crypto_scratch_mpz();
+        size_t whole_len = (size_t)(dot - decimal_str);
+        char* whole_str = (char*)crypto_scratch_bytes(whole_len + 1 + crypto_denom_def(denom)->decimals + 1);
+        if (whole_str == NULL) {
+            crypto_scratch_mpz_release(fraction_part);
+            crypto_scratch_mpz_release(whole_part);
+            crypto_scratch_mpz_release(value);
+            return false;
+        }
+        char* fraction_str = whole_str + whole_len + 1;
+
         // Parse the whole number part
-        char* whole_str = strdup(decimal_str);
-        whole_str[dot - decimal_str] = '\0';
-        mpz_set_str(whole_part, whole_str, 10);
-        // TODO: Pre-calculate the power of 10 for the denom
-        mpz_mul_ui(whole_part, whole_part, power(10, crypto_denoms[denom].decimals));
-        free(whole_str);
+        memcpy(whole_str, decimal_str, whole_len);
+        whole_str[whole_len] = '\0';
+        if (mpz_set_str(whole_part, whole_str, 10) != 0) {
+            mpz_set_ui(whole_part, 0);
+        }
+        mpz_mul(whole_part, whole_part, *crypto_denom_scale(denom));
 
         // Parse the fraction part up to the last expected digit for the denom
-        char* fraction_str = malloc(crypto_denoms[denom].decimals + 1);
         // Pad fraction_str with zeros
-        memset(fraction_str, '0', crypto_denoms[denom].decimals);
+        memset(fraction_str, '0', crypto_denom_def(denom)->decimals);
         // Null-terminate the string
-        fraction_str[crypto_denoms[denom].decimals] = '\0';
+        fraction_str[crypto_denom_def(denom)->decimals] = '\0';
         // Copy the fraction part into the string
         memcpy(fraction_str, dot + 1, 
-            strlen(dot + 1) < crypto_denoms[denom].decimals ? strlen(dot + 1) : crypto_denoms[denom].decimals);
-        mpz_set_str(fraction_part, fraction_str, 10);
-        free(fraction_str);
+            strlen(dot + 1) < crypto_denom_def(denom)->decimals ? strlen(dot + 1) : crypto_denom_def(denom)->decimals);
+        if (mpz_set_str(fraction_part, fraction_str, 10) != 0) {
+            mpz_set_ui(fraction_part, 0);
+        }
 
         // Add the whole and fraction parts
-        mpz_add(val->value, whole_part, fraction_part);
-        mpz_clear(whole_part);
-        mpz_clear(fraction_part);
+        mpz_add(value, whole_part, fraction_part);
+        crypto_scratch_mpz_release(fraction_part);
+        crypto_scratch_mpz_release(whole_part);
     }
 
     // 4. Apply sign
-    mpz_mul_si(val->value, val->value, sign);
+    mpz_mul_si(value, value, sign);
+    crypto_set_mpz(val, value);
+    crypto_scratch_mpz_release(value);
+    return true;
 }
 
-// Convert a crypto_val_t to a decimal string.
-// Note that the decimal string will be in the smallest unit of the crypto type.
-// For example, if the crypto_val_t is 123456789 and the denom is BTC_DENOM_BITCOIN,
-// the decimal string will be "1.23456789".
-// Note that the caller is responsible for freeing the returned string.
-char* crypto_to_decimal_str(crypto_val_t* val, crypto_denom_t denom) {
-    assert(val != NULL);
-    assert(crypto_is_valid_denom(denom));
-    assert(val->crypto_type == crypto_denoms[denom].crypto_type);
-
-    // Determine the sign
-    int sign = mpz_sgn(val->value);
-
-    // Determine the whole part scaled to the denom
-    mpz_t whole_part;
-    mpz_init(whole_part);
-    mpz_t fraction_part;
-    mpz_init(fraction_part);
-    mpz_tdiv_qr_ui(whole_part, fraction_part, val->value, power(10, crypto_denoms[denom].decimals));
-
-    // Convert the whole and fraction parts to strings
-    mpz_abs(whole_part, whole_part);
-    mpz_abs(fraction_part, fraction_part);
-    char* whole_str = mpz_get_str(NULL, 10, whole_part);
-    char* fraction_str = mpz_get_str(NULL, 10, fraction_part);
-
-    // Format the whole and fraction parts
-    char* formatted_str = malloc(strlen(whole_str) + strlen(fraction_str) + (sign == -1 ? 2 : 1));
-    // Add the sign if it's negative; otherwise, just copy the whole_str
-    if (sign == -1) {
-        formatted_str[0] = '-';
-        strcpy(formatted_str + 1, whole_str);
-    } else {
-        strcpy(formatted_str, whole_str);
-    }
-    // If the fraction part is not zero, add the decimal point and pad the fraction part with leading zeros if needed
-    if (mpz_cmp_ui(fraction_part, 0) != 0) {
-        // Reallocate memory for the formatted string to include the decimal point and 
-        // enough zeros to pad the fraction part to the denom
-        formatted_str = realloc(formatted_str, strlen(formatted_str) + crypto_denoms[denom].decimals + 2);
-        // Add the decimal point
-        strcat(formatted_str, ".");
-        // Pad with leading zeros if needed using strcat in a loop
-        for (size_t i = 0; i < crypto_denoms[denom].decimals - strlen(fraction_str); i++) {
-            strcat(formatted_str, "0");
-        }
-        // Add the fraction part
-        strcat(formatted_str, fraction_str);
-    }
-
-    // Free the temporary strings
-    free(whole_str);
-    free(fraction_str);
-    mpz_clear(whole_part);
-    mpz_clear(fraction_part);
-    return formatted_str;
-}
+#if defined(__SIZEOF_INT128__) && GMP_NUMB_BITS == 64
+#define CRYPTO_HAVE_PREINV 1
 
-void crypto_add(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b) {
-    assert(r != NULL);
-    assert(a != NULL);
-    assert(b != NULL);
-    assert(a->crypto_type == b->crypto_type);
-    assert(r->crypto_type == a->crypto_type);
-    mpz_add(r->value, a->value, b->value);
+// Divide the two-limb number u1:u0 by a normalized limb d with its reciprocal v,
+// per Moller and Granlund, "Improved division by invariant integers". Requires u1 < d.
+static inline mp_limb_t crypto_div_2by1(mp_limb_t* rem, mp_limb_t u1, mp_limb_t u0, mp_limb_t d, mp_limb_t v) {
+    unsigned __int128 q = (unsigned __int128)v * u1 + (((unsigned __int128)u1 << 64) | u0);
+    mp_limb_t q1 = (mp_limb_t)(q >> 64) + 1;
+    mp_limb_t q0 = (mp_limb_t)q;
+    mp_limb_t r = u0 - q1 * d;
+    if (r > q0) {
+        q1--;
+        r += d;
+    }
+    if (r >= d) {
+        q1++;
+        r -= d;
+    }
+    *rem = r;
+    return q1;
 }
+#endif
 
-void crypto_sub(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b) {
-    assert(r != NULL);
-    assert(a != NULL);
-    assert(b != NULL);
-    assert(a->crypto_type == b->crypto_type);
-    assert(r->crypto_type == a->crypto_type);
-    mpz_sub(r->value, a->value, b->value);
-}
+// Powers of ten that fit in a single limb, used to fold digit chunks into limbs.
+#if GMP_NUMB_BITS >= 64
+#define CRYPTO_CHUNK_DIGITS 19
+#else
+#define CRYPTO_CHUNK_DIGITS 9
+#endif
 
-void crypto_mul(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
-    assert(r != NULL);
-    assert(a != NULL);
-    assert(b != NULL);
-    assert(r->crypto_type == a->crypto_type);
-    mpz_mul(r->value, a->value, *b);
-}
+static const mp_limb_t crypto_limb_pow10[CRYPTO_CHUNK_DIGITS + 1] = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL,
+    100000000UL, 1000000000UL,
+#if GMP_NUMB_BITS >= 64
+    10000000000UL, 100000000000UL, 1000000000000UL, 10000000000000UL,
+    100000000000000UL, 1000000000000000UL, 10000000000000000UL,
+    100000000000000000UL, 1000000000000000000UL, 10000000000000000000UL
+#endif
+};
 
-void crypto_div_truncate(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
-    assert(r != NULL);
-    assert(a != NULL);
-    assert(b != NULL);
-    assert(r->crypto_type == a->crypto_type);
-    mpz_tdiv_q(r->value, a->value, *b);
+// Length of the prefix of s[0..n) whose bytes all lie in [lo, hi], 16 or 32 bytes at a
+// time where the target has vectors. Never reads past s + n.
+static inline size_t crypto_span_range(const char* s, size_t n, unsigned char lo, unsigned char hi) {
+    size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Bytes in range are those where (b - lo) is unsigned <= hi - lo, i.e. min(t, width) == t
+#if defined(__AVX2__)
+    const __m256i lo32 = _mm256_set1_epi8((char)lo);
+    const __m256i width32 = _mm256_set1_epi8((char)(hi - lo));
+    for (; i + 32 <= n; i += 32) {
+        __m256i t = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(s + i)), lo32);
+        uint32_t in = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(t, width32), t));
+        if (in != UINT32_MAX) {
+            return i + (size_t)__builtin_ctz(~in);
+        }
+    }
+#endif
+    const __m128i lo16 = _mm_set1_epi8((char)lo);
+    const __m128i width16 = _mm_set1_epi8((char)(hi - lo));
+    for (; i + 16 <= n; i += 16) {
+        __m128i t = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(s + i)), lo16);
+        unsigned in = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(t, width16), t));
+        if (in != 0xFFFF) {
+            return i + (size_t)__builtin_ctz(~in);
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t lo16 = vdupq_n_u8(lo);
+    const uint8x16_t width16 = vdupq_n_u8((uint8_t)(hi - lo));
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t out = vcgtq_u8(vsubq_u8(vld1q_u8((const uint8_t*)s + i), lo16), width16);
+        // Narrow to four bits per byte to get a scalar mask of the bytes out of range
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(out), 4)), 0);
+        if (mask != 0) {
+            return i + (size_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+#endif
+    while (i < n && (unsigned char)((unsigned char)s[i] - lo) <= (unsigned char)(hi - lo)) {
+        i++;
+    }
+    return i;
 }
 
-void crypto_div_floor(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
-    assert(r != NULL);
-    assert(a != NULL);
-    assert(b != NULL);
-    assert(r->crypto_type == a->crypto_type);
-    mpz_fdiv_q(r->value, a->value, *b);
+// The eight bytes at p as a little-endian word, so the first character is the low byte
+static inline uint64_t crypto_load_le64(const char* p) {
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    return x;
 }
 
-void crypto_div_ceil(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
-    assert(r != NULL);
-    assert(a != NULL);
-    assert(b != NULL);
-    assert(r->crypto_type == a->crypto_type);
-    mpz_cdiv_q(r->value, a->value, *b);
+// Whether all eight bytes of a crypto_load_le64 word are ASCII digits: each byte has
+// high nibble 3, and adding 6 does not carry into it
+static inline bool crypto_swar_is_digits8(uint64_t x) {
+    return ((x & 0xF0F0F0F0F0F0F0F0ULL) | (((x + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+           0x3333333333333333ULL;
 }
 
-int crypto_cmp(const crypto_val_t* a, const crypto_val_t* b) {
-    assert(a != NULL);
-    assert(b != NULL);
-    assert(a->crypto_type == b->crypto_type);
-    return mpz_cmp(a->value, b->value);
+// The value of eight ASCII digits in a crypto_load_le64 word, combining neighbouring
+// digits, then pairs, then quads with one multiply-add each
+static inline uint32_t crypto_swar_digits8(uint64_t x) {
+    x = ((x & 0x0F0F0F0F0F0F0F0FULL) * (1 + (10 << 8))) >> 8;
+    x = ((x & 0x00FF00FF00FF00FFULL) * (1 + (100 << 16))) >> 16;
+    return (uint32_t)(((x & 0x0000FFFF0000FFFFULL) * (1 + (10000ULL << 32))) >> 32);
 }
 
-int crypto_gt_zero(const crypto_val_t* a) {
-    assert(a != NULL);
-    return mpz_cmp_si(a->value, 0) > 0;
+// Accumulator for the single-pass parser. Digits are gathered into a one-limb
+// chunk and folded into inline limbs; only values beyond the inline capacity spill
+// into an mpz_t.
+typedef struct {
+    mp_limb_t limbs[CRYPTO_INLINE_LIMBS + 1];
+    mp_size_t size;
+    mp_limb_t chunk;
+    int chunk_digits;
+    bool is_big;
+    mpz_ptr big;       // From the scratch pool once is_big is set
+} crypto_digit_acc_t;
+
+static void crypto_digit_acc_flush(crypto_digit_acc_t* acc) {
+    if (acc->chunk_digits == 0) {
+        return;
+    }
+    mp_limb_t scale = crypto_limb_pow10[acc->chunk_digits];
+    if (acc->is_big) {
+        mpz_t t;
+        mpz_mul(acc->big, acc->big, mpz_roinit_n(t, &scale, 1));
+        mpz_add(acc->big, acc->big, mpz_roinit_n(t, &acc->chunk, acc->chunk != 0));
+    } else if (acc->size == 0) {
+        acc->limbs[0] = acc->chunk;
+        acc->size = acc->chunk != 0;
+    } else {
+        mp_limb_t hi = mpn_mul_1(acc->limbs, acc->limbs, acc->size, scale);
+        hi += mpn_add_1(acc->limbs, acc->limbs, acc->size, acc->chunk);
+        if (hi != 0) {
+            acc->limbs[acc->size++] = hi;
+        }
+        if (acc->size > CRYPTO_INLINE_LIMBS) {
+            // Spill into GMP; from here on the value no longer fits inline
+            mpz_t t;
+            acc->big = crypto_scratch_mpz();
+            mpz_set(acc->big, mpz_roinit_n(t, acc->limbs, acc->size));
+            acc->is_big = true;
+        }
+    }
+    acc->chunk = 0;
+    acc->chunk_digits = 0;
 }
 
-int crypto_lt_zero(const crypto_val_t* a) {
-    assert(a != NULL);
-    return mpz_cmp_si(a->value, 0) < 0;
+static inline void crypto_digit_acc_push(crypto_digit_acc_t* acc, unsigned digit) {
+    acc->chunk = acc->chunk * 10 + digit;
+    if (++acc->chunk_digits == CRYPTO_CHUNK_DIGITS) {
+        crypto_digit_acc_flush(acc);
+    }
 }
 
-int crypto_eq_zero(const crypto_val_t* a) {
-    assert(a != NULL);
-    return mpz_cmp_si(a->value, 0) == 0;
+// Append eight digits with the value v. A chunk without room for them is flushed
+// early, which is exact since a flush scales by the digits the chunk holds.
+static inline void crypto_digit_acc_push8(crypto_digit_acc_t* acc, uint32_t v) {
+    if (acc->chunk_digits + 8 > CRYPTO_CHUNK_DIGITS) {
+        crypto_digit_acc_flush(acc);
+    }
+    acc->chunk = acc->chunk * 100000000 + v;
+    acc->chunk_digits += 8;
+    if (acc->chunk_digits == CRYPTO_CHUNK_DIGITS) {
+        crypto_digit_acc_flush(acc);
+    }
 }
 
-// Get the denom for a given symbol.
-// Returns DENOM_COUNT if the symbol is not found.
-crypto_denom_t crypto_get_denom_for_symbol(crypto_type_t type, const char* symbol) {
-    for (int i = 0; i < DENOM_COUNT; i++) {
-        if (crypto_denoms[i].crypto_type == type && strcmp(symbol, crypto_denoms[i].symbol) == 0) {
-            return i;
+// Append n zero digits, i.e. multiply the accumulated value by 10^n.
+static void crypto_digit_acc_shift(crypto_digit_acc_t* acc, int n) {
+    while (n > 0) {
+        int k = CRYPTO_CHUNK_DIGITS - acc->chunk_digits;
+        if (k > n) {
+            k = n;
+        }
+        acc->chunk *= crypto_limb_pow10[k];
+        acc->chunk_digits += k;
+        n -= k;
+        if (acc->chunk_digits == CRYPTO_CHUNK_DIGITS) {
+            crypto_digit_acc_flush(acc);
         }
     }
-    return DENOM_COUNT;
 }
 
-bool crypto_is_valid_decimal(const char* str) {
-    if (!str) return false;
-    
-    // Skip leading whitespace
-    while (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r') {
-        str++;
+static inline bool crypto_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Parser for any denomination and any length of input; see crypto_parse_decimal.
+// Digits are read a word at a time, so all len bytes must be readable.
+static crypto_parse_status_t crypto_parse_decimal_generic(crypto_val_t* val, crypto_denom_t denom, const char* str, size_t len, size_t* error_pos) {
+    const int decimals = crypto_denom_def(denom)->decimals;
+    crypto_parse_status_t status = CRYPTO_PARSE_OK;
+    size_t i = 0;
+
+    // Leading whitespace
+    while (i < len && crypto_is_space(str[i])) {
+        i++;
     }
-    
-    // Check for empty string after whitespace
-    if (*str == '\0') return false;
-    
-    // Check for optional sign
-    if (*str == '+' || *str == '-') {
-        str++;
+    if (i >= len || str[i] == '\0') {
+        status = CRYPTO_PARSE_EMPTY;
+        goto fail;
     }
-    
-    // Must have at least one digit or decimal point
-    if (!isdigit(*str) && *str != '.') return false;
-    
-    bool has_decimal = *str == '.' ? true : false;
-    bool has_digit = isdigit(*str) ? true : false;
-    
-    str++;
-    
-    // Process the rest of the string
-    while (*str != '\0') {
-        if (*str == '.') {
-            if (has_decimal) return false; // More than one decimal point
-            has_decimal = true;
-        } else if (isdigit(*str)) {
-            has_digit = true;
-        } else if (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r') {
-            // Skip trailing whitespace
-            str++;
-            while (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r') {
-                str++;
+
+    // Optional sign
+    bool negative = false;
+    if (str[i] == '-' || str[i] == '+') {
+        negative = str[i] == '-';
+        i++;
+    }
+
+    // Digits, gathering the whole part and up to `decimals` fraction digits as one number
+    crypto_digit_acc_t acc;
+    acc.size = 0;
+    acc.chunk = 0;
+    acc.chunk_digits = 0;
+    acc.is_big = false;
+    bool seen_digit = false;
+    bool seen_dot = false;
+    int fraction_digits = 0;
+    for (; i < len && str[i] != '\0'; i++) {
+        // Eight digits at a time while they all count
+        if (len - i >= 8 && (!seen_dot || decimals - fraction_digits >= 8)) {
+            uint64_t word = crypto_load_le64(str + i);
+            if (crypto_swar_is_digits8(word)) {
+                crypto_digit_acc_push8(&acc, crypto_swar_digits8(word));
+                fraction_digits += seen_dot ? 8 : 0;
+                seen_digit = true;
+                i += 7;
+                continue;
             }
-            // If we hit non-whitespace after trailing whitespace, invalid
-            if (*str != '\0') return false;
+        }
+        char c = str[i];
+        if (c >= '0' && c <= '9') {
+            seen_digit = true;
+            if (!seen_dot) {
+                crypto_digit_acc_push(&acc, (unsigned)(c - '0'));
+            } else if (fraction_digits < decimals) {
+                crypto_digit_acc_push(&acc, (unsigned)(c - '0'));
+                fraction_digits++;
+            } else {
+                // Truncated digits
+                i += crypto_span_range(str + i, len - i, '0', '9') - 1;
+            }
+        } else if (c == '.') {
+            if (seen_dot) {
+                status = CRYPTO_PARSE_MULTIPLE_DOTS;
+                goto fail_acc;
+            }
+            seen_dot = true;
+        } else if (crypto_is_space(c)) {
             break;
         } else {
-            return false; // Invalid character
+            status = CRYPTO_PARSE_INVALID_CHAR;
+            goto fail_acc;
         }
-        str++;
     }
-    
-    return has_digit; // Must have at least one digit
-}
+    size_t digits_end = i;
 
-bool crypto_has_nonzero_fraction(const char* str) {
-    if (!str) return false;
-    
-    // Skip leading whitespace
-    while (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r') {
-        str++;
+    // Trailing whitespace only
+    while (i < len && crypto_is_space(str[i])) {
+        i++;
     }
-    
-    // Skip optional sign
-    if (*str == '+' || *str == '-') {
-        str++;
+    if (i < len && str[i] != '\0') {
+        status = CRYPTO_PARSE_INVALID_CHAR;
+        goto fail_acc;
     }
-    
-    // Find the decimal point
-    const char* decimal_point = strchr(str, '.');
-    if (!decimal_point) {
-        return false; // No decimal point means no fraction
+    if (!seen_digit) {
+        i = digits_end;
+        status = CRYPTO_PARSE_NO_DIGITS;
+        goto fail_acc;
     }
-    
-    // Check if there are any non-zero digits after the decimal point
-    decimal_point++; // Move past the decimal point
-    while (*decimal_point != '\0' && *decimal_point != ' ' && *decimal_point != '\t' && *decimal_point != '\n' && *decimal_point != '\r') {
-        if (*decimal_point != '0') {
-            return true; // Found a non-zero digit in the fraction
+
+    // Scale to the smallest unit and store
+    crypto_digit_acc_shift(&acc, decimals - fraction_digits);
+    crypto_digit_acc_flush(&acc);
+    if (acc.is_big) {
+        if (negative) {
+            mpz_neg(acc.big, acc.big);
         }
-        decimal_point++;
+        crypto_set_mpz(val, acc.big);
+        crypto_scratch_mpz_release(acc.big);
+    } else {
+        crypto_store_limbs(val, acc.limbs, acc.size, negative);
     }
-    
-    return false; // All digits after decimal point were zero
+    return CRYPTO_PARSE_OK;
+
+fail_acc:
+    if (acc.is_big) {
+        crypto_scratch_mpz_release(acc.big);
+    }
+fail:
+    if (error_pos != NULL) {
+        *error_pos = i;
+    }
+    return status;
 }
 
-// Take an assumed valid decimal string, determine the precision past the decimal point,
-// multiple the whole number by 10^precision, add the fraction to the whole number,
-// and return the precision. The result will be passed in as a pointer to mpz_t.
-uint8_t crypto_scale_by_precision(const char* str, mpz_t* result) {
-    assert(str != NULL);
-    assert(result != NULL);
+#ifdef CRYPTO_HAVE_PREINV
+// Parse and format kernels specialized for one decimal count each. With the count a
+// compile-time constant, splitting a value into whole and fraction parts is a multiply
+// by a constant reciprocal and the fraction digits are a fixed-length loop. A kernel
+// only takes the common case, an optional sign with up to 19 whole digits for parsing
+// and a value of at most two limbs for formatting; anything else, including every
+// error, goes to the generic code, so results are identical.
+#define CRYPTO_KERNEL_DECIMALS_MAX 19
+// Longest kernel output: sign, 39 whole digits, the point and 19 fraction digits
+#define CRYPTO_KERNEL_FORMAT_MAX 60
 
-    // Get the whole number part
-    mpz_set_str(*result, str, 10);
+#if defined(__GNUC__)
+#define CRYPTO_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define CRYPTO_ALWAYS_INLINE inline
+#endif
+
+// Parse str as a decimal with the given number of decimals. Returns false, leaving
+// val unchanged, when the input needs the generic parser.
+static CRYPTO_ALWAYS_INLINE bool crypto_parse_fixed(crypto_val_t* val, const char* str, size_t len, const unsigned decimals) {
+    size_t i = 0;
+    while (i < len && crypto_is_space(str[i])) {
+        i++;
+    }
+    bool negative = false;
+    if (i < len && (str[i] == '-' || str[i] == '+')) {
+        negative = str[i] == '-';
+        i++;
+    }
+
+    // Whole digits while the next ones cannot overflow 64 bits
+    size_t start = i;
+    uint64_t whole = 0;
+    while (len - i >= 8 && whole < 100000000000ULL) {
+        uint64_t word = crypto_load_le64(str + i);
+        if (!crypto_swar_is_digits8(word)) {
+            break;
+        }
+        whole = whole * 100000000 + crypto_swar_digits8(word);
+        i += 8;
+    }
+    for (; i < len && (unsigned)(str[i] - '0') < 10; i++) {
+        if (whole >= UINT64_MAX / 10 - 1) {
+            return false;
+        }
+        whole = whole * 10 + (unsigned)(str[i] - '0');
+    }
+    bool seen_digit = i > start;
+
+    // Fraction digits up to the precision; the rest are truncated
+    uint64_t fraction = 0;
+    unsigned fraction_digits = 0;
+    if (i < len && str[i] == '.') {
+        start = ++i;
+        while (decimals - fraction_digits >= 8 && len - i >= 8) {
+            uint64_t word = crypto_load_le64(str + i);
+            if (!crypto_swar_is_digits8(word)) {
+                break;
+            }
+            fraction = fraction * 100000000 + crypto_swar_digits8(word);
+            fraction_digits += 8;
+            i += 8;
+        }
+        for (; fraction_digits < decimals && i < len && (unsigned)(str[i] - '0') < 10; i++) {
+            fraction = fraction * 10 + (unsigned)(str[i] - '0');
+            fraction_digits++;
+        }
+        i += crypto_span_range(str + i, len - i, '0', '9');
+        seen_digit = seen_digit || i > start;
+    }
+    if (!seen_digit) {
+        return false;
+    }
+    while (i < len && crypto_is_space(str[i])) {
+        i++;
+    }
+    if (i < len && str[i] != '\0') {
+        return false;
+    }
+
+    // whole * 10^decimals < 2^64 * 10^19 and the scaled fraction is below 10^decimals
+    unsigned __int128 v = (unsigned __int128)whole * crypto_limb_pow10[decimals] +
+                          fraction * crypto_limb_pow10[decimals - fraction_digits];
+    mp_limb_t limbs[2] = { (mp_limb_t)v, (mp_limb_t)(v >> 64) };
+    crypto_store_limbs(val, limbs, 2, negative);
+    return true;
+}
+
+static const char crypto_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Write the decimal digits of x without leading zeros; returns their count
+static inline size_t crypto_u64_digits(char* out, uint64_t x) {
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    while (x >= 100) {
+        p -= 2;
+        memcpy(p, crypto_digit_pairs + (x % 100) * 2, 2);
+        x /= 100;
+    }
+    if (x >= 10) {
+        p -= 2;
+        memcpy(p, crypto_digit_pairs + x * 2, 2);
+    } else {
+        *--p = (char)('0' + x);
+    }
+    size_t n = (size_t)(tmp + sizeof(tmp) - p);
+    memcpy(out, p, n);
+    return n;
+}
+
+// Write x, which is below 10^n, as exactly n digits
+static CRYPTO_ALWAYS_INLINE void crypto_u64_digits_fixed(char* out, uint64_t x, const unsigned n) {
+    unsigned i = n;
+    while (i >= 2) {
+        i -= 2;
+        memcpy(out + i, crypto_digit_pairs + (x % 100) * 2, 2);
+        x /= 100;
+    }
+    if (i == 1) {
+        out[0] = (char)('0' + x);
+    }
+}
+
+// Normalized power of ten and its reciprocal for crypto_div_2by1; constant when k is
+#define CRYPTO_POW10_NORM(k) (crypto_limb_pow10[k] << __builtin_clzll(crypto_limb_pow10[k]))
+#define CRYPTO_POW10_INV(k) \
+    ((mp_limb_t)((((unsigned __int128)~CRYPTO_POW10_NORM(k) << 64) | ~(mp_limb_t)0) / CRYPTO_POW10_NORM(k)))
+
+// Format the magnitude l1:l0 with the given number of decimals, as crypto_format_to
+// does, into out, which has room for CRYPTO_KERNEL_FORMAT_MAX bytes. Returns the
+// length, or 0 when the whole part needs the generic code.
+static CRYPTO_ALWAYS_INLINE size_t crypto_format_fixed(char* out, mp_limb_t l1, mp_limb_t l0, bool negative, const unsigned decimals) {
+    // Split into whole = w1:w0 and fraction below 10^decimals
+    mp_limb_t w1 = l1, w0 = l0, fraction = 0;
+    if (decimals > 0) {
+        const mp_limb_t unit = crypto_limb_pow10[decimals];
+        if (l1 == 0) {
+            w0 = l0 / unit;
+            fraction = l0 % unit;
+        } else {
+            const unsigned shift = (unsigned)__builtin_clzll(unit);
+            mp_limb_t u2 = shift > 0 ? l1 >> (64 - shift) : 0;
+            mp_limb_t u1 = shift > 0 ? (l1 << shift) | (l0 >> (64 - shift)) : l1;
+            mp_limb_t rem;
+            w1 = crypto_div_2by1(&rem, u2, u1, CRYPTO_POW10_NORM(decimals), CRYPTO_POW10_INV(decimals));
+            w0 = crypto_div_2by1(&rem, rem, l0 << shift, CRYPTO_POW10_NORM(decimals), CRYPTO_POW10_INV(decimals));
+            fraction = rem >> shift;
+        }
+    }
+
+    char* p = out;
+    if (negative) {
+        *p++ = '-';
+    }
+    if (w1 == 0) {
+        p += crypto_u64_digits(p, w0);
+    } else {
+        // Above 2^64: the digits above 10^19, then 19 more
+        if (w1 >= crypto_limb_pow10[19]) {
+            return 0;
+        }
+        mp_limb_t low;
+        mp_limb_t high = crypto_div_2by1(&low, w1, w0, CRYPTO_POW10_NORM(19), CRYPTO_POW10_INV(19));
+        p += crypto_u64_digits(p, high);
+        crypto_u64_digits_fixed(p, low, 19);
+        p += 19;
+    }
+    if (fraction != 0) {
+        *p++ = '.';
+        crypto_u64_digits_fixed(p, fraction, decimals);
+        p += decimals;
+    }
+    return (size_t)(p - out);
+}
+
+typedef bool (*crypto_parse_kernel_fn)(crypto_val_t* val, const char* str, size_t len);
+typedef size_t (*crypto_format_kernel_fn)(char* out, mp_limb_t l1, mp_limb_t l0, bool negative);
+
+// One kernel pair per decimal count from 0 to CRYPTO_KERNEL_DECIMALS_MAX
+#define CRYPTO_KERNEL(d)                                                                        \
+    static bool crypto_parse_d##d(crypto_val_t* val, const char* str, size_t len) {             \
+        return crypto_parse_fixed(val, str, len, d);                                            \
+    }                                                                                           \
+    static size_t crypto_format_d##d(char* out, mp_limb_t l1, mp_limb_t l0, bool negative) {    \
+        return crypto_format_fixed(out, l1, l0, negative, d);                                   \
+    }
+#define CRYPTO_KERNELS(X) \
+    X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) \
+    X(10) X(11) X(12) X(13) X(14) X(15) X(16) X(17) X(18) X(19)
+CRYPTO_KERNELS(CRYPTO_KERNEL)
+
+// Kernels indexed by a denomination's decimals, which every denom with that count shares
+#define CRYPTO_PARSE_KERNEL_ENTRY(d) crypto_parse_d##d,
+#define CRYPTO_FORMAT_KERNEL_ENTRY(d) crypto_format_d##d,
+static const crypto_parse_kernel_fn crypto_parse_kernels[CRYPTO_KERNEL_DECIMALS_MAX + 1] = {
+    CRYPTO_KERNELS(CRYPTO_PARSE_KERNEL_ENTRY)
+};
+static const crypto_format_kernel_fn crypto_format_kernels[CRYPTO_KERNEL_DECIMALS_MAX + 1] = {
+    CRYPTO_KERNELS(CRYPTO_FORMAT_KERNEL_ENTRY)
+};
+#endif
+
+// Validate and parse a decimal string in a single pass, without heap allocation
+// for any value that fits inline.
+// Accepts the same syntax as crypto_is_valid_decimal: optional surrounding
+// whitespace, an optional sign, digits with at most one decimal point and at
+// least one digit. Fraction digits beyond the denomination's precision are
+// truncated. Scanning stops after len bytes or at a NUL, whichever comes first,
+// so pass SIZE_MAX for NUL-terminated strings.
+// On failure val is left unchanged and, if error_pos is not NULL, it receives
+// the byte offset of the offending character (or of the end of input).
+crypto_parse_status_t crypto_parse_decimal(crypto_val_t* val, crypto_denom_t denom, const char* str, size_t len, size_t* error_pos) {
+    assert(val != NULL);
+    assert(crypto_is_valid_denom(denom));
+    assert(str != NULL);
+    assert(val->crypto_type == crypto_denom_def(denom)->crypto_type);
+    // Stop at a NUL up front so that digits can be read a word at a time
+    len = strnlen(str, len);
+#ifdef CRYPTO_HAVE_PREINV
+    unsigned decimals = crypto_denom_def(denom)->decimals;
+    if (decimals <= CRYPTO_KERNEL_DECIMALS_MAX && crypto_parse_kernels[decimals](val, str, len)) {
+        return CRYPTO_PARSE_OK;
+    }
+#endif
+    return crypto_parse_decimal_generic(val, denom, str, len, error_pos);
+}
+
+// Human-readable description of a parse status
+const char* crypto_parse_status_str(crypto_parse_status_t status) {
+    switch (status) {
+        case CRYPTO_PARSE_OK:
+            return "ok";
+        case CRYPTO_PARSE_EMPTY:
+            return "empty value";
+        case CRYPTO_PARSE_NO_DIGITS:
+            return "no digits";
+        case CRYPTO_PARSE_INVALID_CHAR:
+            return "invalid character";
+        case CRYPTO_PARSE_MULTIPLE_DOTS:
+            return "more than one decimal point";
+        case CRYPTO_PARSE_NOMEM:
+            return "out of memory";
+    }
+    return "unknown error";
+}
+
+// Set the value of a crypto_val_t from a decimal string.
+// Note that val will be stored in the smallest unit of the crypto type.
+// For example, if the decimal string is "1.23456789" and the denom is BTC_DENOM_BITCOIN,
+// val will be set to 123456789.
+// Strings rejected by crypto_parse_decimal keep their historical treatment: the whole
+// and fraction parts are read separately and a part that is not a number counts as zero.
+// Returns false, leaving val unchanged, only if memory for that treatment ran out.
+bool crypto_set_from_decimal(crypto_val_t* val, crypto_denom_t denom, const char* decimal_str) {
+    assert(val != NULL);
+    assert(crypto_is_valid_denom(denom));
+    assert(decimal_str != NULL);
+    assert(val->crypto_type == crypto_denom_def(denom)->crypto_type);
+
+    if (crypto_parse_decimal(val, denom, decimal_str, SIZE_MAX, NULL) != CRYPTO_PARSE_OK) {
+        return crypto_set_from_decimal_lenient(val, denom, decimal_str);
+    }
+    return true;
+}
+
+// Longest string crypto_format_to can produce for an inline value in the given denom,
+// not counting the terminating NUL. A buffer of crypto_format_max_len(denom) + 1 bytes
+// always suffices unless the value has been promoted beyond CRYPTO_INLINE_BITS.
+size_t crypto_format_max_len(crypto_denom_t denom) {
+    assert(crypto_is_valid_denom(denom));
+    size_t decimals = crypto_denom_def(denom)->decimals;
+    // Sign, then either "<whole>.<fraction>" or "0.<fraction>"
+    size_t digits = CRYPTO_INLINE_DIGITS > decimals ? CRYPTO_INLINE_DIGITS + 1 : decimals + 2;
+    return 1 + digits;
+}
+
+// Formatter for any denomination and any value; see crypto_format_to.
+static size_t crypto_format_to_generic(char* buf, size_t cap, const crypto_val_t* val, crypto_denom_t denom) {
+    mpz_t view;
+    mpz_srcptr value = crypto_view(val, view);
+    mp_size_t n = mpz_size(value);
+    bool negative = mpz_sgn(value) < 0;
+    size_t decimals = crypto_denom_def(denom)->decimals;
+
+    if (n == 0) {
+        if (cap < 2) {
+            return 1;
+        }
+        buf[0] = '0';
+        buf[1] = '\0';
+        return 1;
+    }
+
+    // mpn_get_str clobbers its input and needs room for one digit more than the result
+    mp_limb_t limb_buf[CRYPTO_INLINE_LIMBS];
+    unsigned char digit_buf[CRYPTO_INLINE_DIGITS + 2];
+    mp_limb_t* limbs = limb_buf;
+    unsigned char* digits = digit_buf;
+    size_t digits_cap = mpz_sizeinbase(value, 10) + 1;
+    if (n > CRYPTO_INLINE_LIMBS) {
+        limbs = (mp_limb_t*)crypto_scratch_bytes(n * sizeof(mp_limb_t) + digits_cap);
+        if (limbs == NULL) {
+            return CRYPTO_FORMAT_NOMEM;
+        }
+        digits = (unsigned char*)(limbs + n);
+    }
+    memcpy(limbs, mpz_limbs_read(value), n * sizeof(mp_limb_t));
+    size_t count = mpn_get_str(digits, 10, limbs, n);
+    const unsigned char* d = digits;
+    while (count > 1 && *d == 0) {
+        d++;
+        count--;
+    }
+
+    // Layout: [-] whole [. fraction], with the fraction padded to the denom's decimals
+    // and omitted entirely when it is zero
+    size_t whole_digits = count > decimals ? count - decimals : 0;
+    bool has_fraction = false;
+    for (size_t i = whole_digits; i < count; i++) {
+        if (d[i] != 0) {
+            has_fraction = true;
+            break;
+        }
+    }
+    size_t len = (negative ? 1 : 0) + (whole_digits > 0 ? whole_digits : 1) + (has_fraction ? 1 + decimals : 0);
+
+    if (len < cap) {
+        char* out = buf;
+        if (negative) {
+            *out++ = '-';
+        }
+        if (whole_digits == 0) {
+            *out++ = '0';
+        }
+        for (size_t i = 0; i < whole_digits; i++) {
+            *out++ = (char)('0' + d[i]);
+        }
+        if (has_fraction) {
+            *out++ = '.';
+            for (size_t i = count; i < decimals; i++) {
+                *out++ = '0';
+            }
+            for (size_t i = whole_digits; i < count; i++) {
+                *out++ = (char)('0' + d[i]);
+            }
+        }
+        *out = '\0';
+    }
+
+    return len;
+}
+
+// Format a crypto_val_t as a decimal string in the given denom, in a single pass.
+// Works like snprintf: returns the length of the formatted string, not counting the
+// terminating NUL. If the return value is >= cap, nothing is written to buf (which may
+// then be NULL) and the caller should retry with a buffer of at least return + 1 bytes.
+// The output matches crypto_to_decimal_str, and no heap memory is used for inline values.
+// A wider value is formatted through per-thread scratch memory; if that cannot grow,
+// nothing is written and CRYPTO_FORMAT_NOMEM is returned.
+size_t crypto_format_to(char* buf, size_t cap, const crypto_val_t* val, crypto_denom_t denom) {
+    assert(val != NULL);
+    assert(crypto_is_valid_denom(denom));
+    assert(val->crypto_type == crypto_denom_def(denom)->crypto_type);
+    assert(buf != NULL || cap == 0);
+#ifdef CRYPTO_HAVE_PREINV
+    unsigned decimals = crypto_denom_def(denom)->decimals;
+    int n = val->size < 0 ? -val->size : val->size;
+    if (!val->is_big && n <= 2 && decimals <= CRYPTO_KERNEL_DECIMALS_MAX) {
+        mp_limb_t l0 = n > 0 ? val->limbs[0] : 0;
+        mp_limb_t l1 = n > 1 ? val->limbs[1] : 0;
+        // Format in place when buf is surely large enough, else through a local buffer
+        char local[CRYPTO_KERNEL_FORMAT_MAX];
+        char* out = cap > CRYPTO_KERNEL_FORMAT_MAX ? buf : local;
+        size_t len = crypto_format_kernels[decimals](out, l1, l0, val->size < 0);
+        if (len > 0) {
+            if (len < cap) {
+                if (out != buf) {
+                    memcpy(buf, out, len);
+                }
+                buf[len] = '\0';
+            }
+            return len;
+        }
+    }
+#endif
+    return crypto_format_to_generic(buf, cap, val, denom);
+}
+
+// Convert a crypto_val_t to a decimal string.
+// Note that the decimal string will be in the smallest unit of the crypto type.
+// For example, if the crypto_val_t is 123456789 and the denom is BTC_DENOM_BITCOIN,
+// the decimal string will be "1.23456789".
+// Note that the caller is responsible for freeing the returned string with crypto_free
+// (plain free() is fine while the default allocator is in use).
+char* crypto_to_decimal_str(crypto_val_t* val, crypto_denom_t denom) {
+    char stack_buf[128];
+    size_t len = crypto_format_to(stack_buf, sizeof(stack_buf), val, denom);
+    if (len == CRYPTO_FORMAT_NOMEM) {
+        return NULL;
+    }
+    char* formatted_str = crypto_malloc(len + 1);
+    if (formatted_str == NULL) {
+        return NULL;
+    }
+    if (len < sizeof(stack_buf)) {
+        memcpy(formatted_str, stack_buf, len + 1);
+    } else {
+        crypto_format_to(formatted_str, len + 1, val, denom);
+    }
+    return formatted_str;
+}
+
+// Binary encoding of an amount in smallest units, designed so that memcmp orders two
+// blobs of the same crypto type by amount. A built-in type is written by id:
+//
+//   byte 0      CRYPTO_BLOB_VERSION
+//   bytes 1-2   crypto type, big-endian
+//
+// A registered type is written by symbol, since its id depends on registration order:
+//
+//   byte 0      CRYPTO_BLOB_VERSION_SYMBOL
+//   byte 1      symbol length, 1 to CRYPTO_SYMBOL_MAX
+//   bytes 2..   the symbol
+//
+// Both continue with
+//
+//   1 byte      0x80 + n for a positive value, 0x80 - n for a negative one, where n is
+//               the number of magnitude bytes (0x80 alone is zero)
+//   n bytes     the magnitude, big-endian without leading zero bytes; every byte is
+//               complemented for negative values so larger magnitudes sort lower
+//
+// Returns the size of the encoding. Like crypto_format_to, nothing is written when
+// that is larger than cap. Returns 0 if the magnitude exceeds CRYPTO_BLOB_MAX_MAGNITUDE bytes.
+size_t crypto_to_blob(unsigned char* buf, size_t cap, const crypto_val_t* val) {
+    assert(val != NULL);
+    assert(crypto_is_valid_type(val->crypto_type));
+    assert(buf != NULL || cap == 0);
+
+    mpz_t view;
+    mpz_srcptr value = crypto_view(val, view);
+    int sign = mpz_sgn(value);
+    size_t n = sign == 0 ? 0 : (mpz_sizeinbase(value, 2) + 7) / 8;
+    if (n > CRYPTO_BLOB_MAX_MAGNITUDE) {
+        return 0;
+    }
+    bool builtin = (unsigned)val->crypto_type < CRYPTO_COUNT;
+    const char* symbol = crypto_type_def(val->crypto_type)->symbol;
+    size_t symbol_len = builtin ? 0 : strlen(symbol);
+    size_t header = builtin ? CRYPTO_BLOB_HEADER_SIZE : 3 + symbol_len;
+    size_t size = header + n;
+    if (size > cap) {
+        return size;
+    }
+
+    if (builtin) {
+        buf[0] = CRYPTO_BLOB_VERSION;
+        buf[1] = (unsigned char)((unsigned)val->crypto_type >> 8);
+        buf[2] = (unsigned char)val->crypto_type;
+    } else {
+        buf[0] = CRYPTO_BLOB_VERSION_SYMBOL;
+        buf[1] = (unsigned char)symbol_len;
+        memcpy(buf + 2, symbol, symbol_len);
+    }
+    buf[header - 1] = (unsigned char)(sign < 0 ? 0x80 - n : 0x80 + n);
+    const mp_limb_t* limbs = mpz_limbs_read(value);
+    unsigned char mask = sign < 0 ? 0xFF : 0x00;
+    for (size_t i = 0; i < n; i++) {
+        // Byte i counted from the least significant end
+        mp_limb_t limb = limbs[i / sizeof(mp_limb_t)];
+        unsigned char byte = (unsigned char)(limb >> (8 * (i % sizeof(mp_limb_t))));
+        buf[size - 1 - i] = byte ^ mask;
+    }
+    return size;
+}
+
+// Size of the type header of the amount encoding at buf, up to and including the
+// sign and length byte, or 0 if buf does not start with one that fits in len
+static size_t crypto_blob_header_len(const unsigned char* buf, size_t len) {
+    if (len >= CRYPTO_BLOB_HEADER_SIZE && buf[0] == CRYPTO_BLOB_VERSION) {
+        return CRYPTO_BLOB_HEADER_SIZE;
+    }
+    if (len >= 3 && buf[0] == CRYPTO_BLOB_VERSION_SYMBOL && buf[1] >= 1 && buf[1] <= CRYPTO_SYMBOL_MAX &&
+        len >= 3 + (size_t)buf[1]) {
+        return 3 + (size_t)buf[1];
+    }
+    return 0;
+}
+
+// Number of magnitude bytes given by the sign and length byte
+static inline size_t crypto_blob_magnitude_len(int header) {
+    return header >= 0x80 ? (size_t)(header - 0x80) : (size_t)(0x80 - header);
+}
+
+// Crypto type of an encoded amount, or CRYPTO_COUNT if buf is not a well-formed
+// blob of this version for a known type. Built-in types must be written by id and
+// registered ones by symbol, so every amount has exactly one encoding.
+crypto_type_t crypto_blob_type(const unsigned char* buf, size_t len) {
+    assert(buf != NULL || len == 0);
+    size_t h = crypto_blob_header_len(buf, len);
+    if (h == 0) {
+        return CRYPTO_COUNT;
+    }
+    int header = buf[h - 1];
+    size_t n = crypto_blob_magnitude_len(header);
+    if (n > CRYPTO_BLOB_MAX_MAGNITUDE || len != h + n) {
+        return CRYPTO_COUNT;
+    }
+    crypto_type_t type;
+    if (buf[0] == CRYPTO_BLOB_VERSION) {
+        type = (crypto_type_t)(((unsigned)buf[1] << 8) | buf[2]);
+        if ((unsigned)type >= CRYPTO_COUNT) {
+            return CRYPTO_COUNT;
+        }
+    } else {
+        type = crypto_get_type_for_symbol_n((const char*)buf + 2, buf[1]);
+        if ((unsigned)type <= CRYPTO_COUNT) {
+            return CRYPTO_COUNT;
+        }
+    }
+    // Leading zero bytes would break the ordering, so they are rejected
+    if (n > 0 && buf[h] == (header < 0x80 ? 0xFF : 0x00)) {
+        return CRYPTO_COUNT;
+    }
+    return type;
+}
+
+// Decode an amount produced by crypto_to_blob into an initialized crypto_val_t.
+// Returns false, leaving val unchanged, if the blob is malformed or holds a
+// different crypto type than val.
+bool crypto_from_blob(crypto_val_t* val, const unsigned char* buf, size_t len) {
+    assert(val != NULL);
+    if (crypto_blob_type(buf, len) != val->crypto_type) {
+        return false;
+    }
+    size_t h = crypto_blob_header_len(buf, len);
+    bool negative = buf[h - 1] < 0x80;
+    size_t n = len - h;
+    unsigned char mask = negative ? 0xFF : 0x00;
+    mp_limb_t limbs[(CRYPTO_BLOB_MAX_MAGNITUDE + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t)];
+    mp_size_t limb_count = (mp_size_t)((n + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t));
+    for (mp_size_t i = 0; i < limb_count; i++) {
+        limbs[i] = 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        mp_limb_t byte = (mp_limb_t)(buf[len - 1 - i] ^ mask);
+        limbs[i / sizeof(mp_limb_t)] |= byte << (8 * (i % sizeof(mp_limb_t)));
+    }
+    crypto_store_limbs(val, limbs, limb_count, negative);
+    return true;
+}
+
+// Initialize an empty partial of the given crypto type
+void crypto_partial_init(crypto_partial_t* p, crypto_type_t type) {
+    assert(p != NULL);
+    p->count = 0;
+    crypto_init(&p->sum, type);
+    crypto_init(&p->min, type);
+    crypto_init(&p->max, type);
+}
+
+void crypto_partial_clear(crypto_partial_t* p) {
+    assert(p != NULL);
+    crypto_clear(&p->sum);
+    crypto_clear(&p->min);
+    crypto_clear(&p->max);
+}
+
+// Add one amount of the partial's crypto type
+void crypto_partial_add(crypto_partial_t* p, const crypto_val_t* val) {
+    assert(p != NULL);
+    assert(val != NULL);
+    assert(val->crypto_type == p->sum.crypto_type);
+    if (p->count == 0 || crypto_cmp(val, &p->min) < 0) {
+        crypto_set(&p->min, val);
+    }
+    if (p->count == 0 || crypto_cmp(val, &p->max) > 0) {
+        crypto_set(&p->max, val);
+    }
+    crypto_add(&p->sum, &p->sum, val);
+    p->count++;
+}
+
+// Merge other, a partial of the same crypto type, into p. other is left unchanged.
+void crypto_partial_merge(crypto_partial_t* p, const crypto_partial_t* other) {
+    assert(p != NULL);
+    assert(other != NULL);
+    assert(other->sum.crypto_type == p->sum.crypto_type);
+    if (other->count == 0) {
+        return;
+    }
+    if (p->count == 0 || crypto_cmp(&other->min, &p->min) < 0) {
+        crypto_set(&p->min, &other->min);
+    }
+    if (p->count == 0 || crypto_cmp(&other->max, &p->max) > 0) {
+        crypto_set(&p->max, &other->max);
+    }
+    crypto_add(&p->sum, &p->sum, &other->sum);
+    p->count += other->count;
+}
+
+// Binary encoding of a partial:
+//
+//   byte 0      CRYPTO_PARTIAL_VERSION
+//   bytes 1-8   count, big-endian
+//   bytes 9..   sum, min and max, each in the crypto_to_blob encoding
+//
+// Returns the size of the encoding; nothing is written when that is larger than cap.
+// Returns 0 if the sum, min or max cannot be encoded.
+size_t crypto_partial_to_blob(unsigned char* buf, size_t cap, const crypto_partial_t* p) {
+    assert(p != NULL);
+    assert(buf != NULL || cap == 0);
+    const crypto_val_t* vals[3] = { &p->sum, &p->min, &p->max };
+    size_t size = CRYPTO_PARTIAL_HEADER_SIZE;
+    for (int i = 0; i < 3; i++) {
+        size_t n = crypto_to_blob(NULL, 0, vals[i]);
+        if (n == 0) {
+            return 0;
+        }
+        size += n;
+    }
+    if (size > cap) {
+        return size;
+    }
+
+    buf[0] = CRYPTO_PARTIAL_VERSION;
+    for (int i = 0; i < 8; i++) {
+        buf[1 + i] = (unsigned char)(p->count >> (8 * (7 - i)));
+    }
+    size_t off = CRYPTO_PARTIAL_HEADER_SIZE;
+    for (int i = 0; i < 3; i++) {
+        off += crypto_to_blob(buf + off, cap - off, vals[i]);
+    }
+    return size;
+}
+
+// Size of the amount encoding at buf + off, or 0 if it would run past len
+static size_t crypto_partial_field_len(const unsigned char* buf, size_t len, size_t off) {
+    size_t h = crypto_blob_header_len(buf + off, len - off);
+    if (h == 0) {
+        return 0;
+    }
+    size_t n = h + crypto_blob_magnitude_len(buf[off + h - 1]);
+    return n <= len - off ? n : 0;
+}
+
+// Crypto type of an encoded partial, or CRYPTO_COUNT if buf does not start like a
+// partial of this version for a known type. crypto_partial_from_blob checks the rest.
+crypto_type_t crypto_partial_blob_type(const unsigned char* buf, size_t len) {
+    assert(buf != NULL || len == 0);
+    if (len < CRYPTO_PARTIAL_HEADER_SIZE || buf[0] != CRYPTO_PARTIAL_VERSION) {
+        return CRYPTO_COUNT;
+    }
+    size_t n = crypto_partial_field_len(buf, len, CRYPTO_PARTIAL_HEADER_SIZE);
+    return n == 0 ? CRYPTO_COUNT : crypto_blob_type(buf + CRYPTO_PARTIAL_HEADER_SIZE, n);
+}
+
+// Decode a partial produced by crypto_partial_to_blob into an initialized partial.
+// Returns false, leaving p unchanged, if the blob is malformed or holds a different
+// crypto type than p.
+bool crypto_partial_from_blob(crypto_partial_t* p, const unsigned char* buf, size_t len) {
+    assert(p != NULL);
+    crypto_type_t type = p->sum.crypto_type;
+    if (crypto_partial_blob_type(buf, len) != type) {
+        return false;
+    }
+    uint64_t count = 0;
+    for (int i = 0; i < 8; i++) {
+        count = (count << 8) | buf[1 + i];
+    }
+
+    crypto_partial_t decoded;
+    crypto_partial_init(&decoded, type);
+    crypto_val_t* vals[3] = { &decoded.sum, &decoded.min, &decoded.max };
+    size_t off = CRYPTO_PARTIAL_HEADER_SIZE;
+    bool ok = true;
+    for (int i = 0; i < 3 && ok; i++) {
+        size_t n = crypto_partial_field_len(buf, len, off);
+        ok = n > 0 && crypto_from_blob(vals[i], buf + off, n);
+        off += n;
+    }
+    // An empty partial has zero bounds; otherwise min cannot exceed max
+    ok = ok && off == len &&
+         (count > 0 ? crypto_cmp(&decoded.min, &decoded.max) <= 0
+                    : crypto_eq_zero(&decoded.sum) && crypto_eq_zero(&decoded.min) && crypto_eq_zero(&decoded.max));
+    if (ok) {
+        crypto_partial_clear(p);
+        *p = decoded;
+        p->count = count;
+    } else {
+        crypto_partial_clear(&decoded);
+    }
+    return ok;
+}
+
+// Add or subtract two values of the same crypto type.
+// Inline operands are combined with mpn primitives on stack limbs; the result is
+// only promoted to GMP when it no longer fits in CRYPTO_INLINE_BITS.
+static void crypto_addsub(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b, bool subtract) {
+    CRYPTO_STAT_PATH(!a->is_big && !b->is_big);
+    if (!a->is_big && !b->is_big) {
+        mp_limb_t tmp[CRYPTO_INLINE_LIMBS + 1];
+        const mp_limb_t* ap = a->limbs;
+        const mp_limb_t* bp = b->limbs;
+        mp_size_t an = a->size < 0 ? -a->size : a->size;
+        mp_size_t bn = b->size < 0 ? -b->size : b->size;
+        bool aneg = a->size < 0;
+        bool bneg = (b->size < 0) != subtract;
+        // Keep the longer operand first, as mpn_add/mpn_sub require
+        if (an < bn) {
+            const mp_limb_t* tp = ap; ap = bp; bp = tp;
+            mp_size_t tn = an; an = bn; bn = tn;
+            bool tneg = aneg; aneg = bneg; bneg = tneg;
+        }
+        mp_size_t rn = an;
+        bool rneg = aneg;
+        if (bn == 0) {
+            if (an > 0) {
+                memcpy(tmp, ap, an * sizeof(mp_limb_t));
+            }
+        } else if (aneg == bneg) {
+            tmp[an] = mpn_add(tmp, ap, an, bp, bn);
+            rn = an + 1;
+        } else {
+            // Opposite signs: subtract the smaller magnitude from the larger one
+            int c = an != bn ? 1 : mpn_cmp(ap, bp, an);
+            if (c == 0) {
+                rn = 0;
+                rneg = false;
+            } else if (c > 0) {
+                mpn_sub(tmp, ap, an, bp, bn);
+            } else {
+                mpn_sub_n(tmp, bp, ap, an);
+                rneg = bneg;
+            }
+        }
+        crypto_store_limbs(r, tmp, rn, rneg);
+        return;
+    }
+
+    mpz_t va, vb;
+    crypto_promote(r);
+    if (subtract) {
+        mpz_sub(r->big, crypto_view(a, va), crypto_view(b, vb));
+    } else {
+        mpz_add(r->big, crypto_view(a, va), crypto_view(b, vb));
+    }
+}
+
+void crypto_add(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(b != NULL);
+    assert(a->crypto_type == b->crypto_type);
+    assert(r->crypto_type == a->crypto_type);
+    crypto_addsub(r, a, b, false);
+}
+
+void crypto_sub(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(b != NULL);
+    assert(a->crypto_type == b->crypto_type);
+    assert(r->crypto_type == a->crypto_type);
+    crypto_addsub(r, a, b, true);
+}
+
+// Multiply a value by a GMP integer; inline operands multiply on stack limbs.
+static void crypto_mul_raw(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
+    mp_size_t bn = mpz_size(*b);
+    CRYPTO_STAT_PATH(!a->is_big && bn <= CRYPTO_INLINE_LIMBS);
+    if (!a->is_big && bn <= CRYPTO_INLINE_LIMBS) {
+        mp_limb_t tmp[2 * CRYPTO_INLINE_LIMBS];
+        mp_size_t an = a->size < 0 ? -a->size : a->size;
+        if (an == 0 || bn == 0) {
+            crypto_store_limbs(r, NULL, 0, false);
+            return;
+        }
+        bool negative = (a->size < 0) != (mpz_sgn(*b) < 0);
+        if (an >= bn) {
+            mpn_mul(tmp, a->limbs, an, mpz_limbs_read(*b), bn);
+        } else {
+            mpn_mul(tmp, mpz_limbs_read(*b), bn, a->limbs, an);
+        }
+        crypto_store_limbs(r, tmp, an + bn, negative);
+        return;
+    }
+
+    mpz_t va;
+    crypto_promote(r);
+    mpz_mul(r->big, crypto_view(a, va), *b);
+}
+
+void crypto_mul(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(b != NULL);
+    assert(r->crypto_type == a->crypto_type);
+    crypto_mul_raw(r, a, b);
+}
+
+// Whether a truncated quotient must move one away from zero. half compares twice the
+// remainder's magnitude with the divisor's (-1, 0 or 1) and odd is the quotient's low bit.
+static bool crypto_round_away(crypto_rounding_t rounding, bool negative, bool exact, int half, bool odd) {
+    if (exact) {
+        return false;
+    }
+    switch (rounding) {
+        case CRYPTO_ROUND_FLOOR:
+            return negative;
+        case CRYPTO_ROUND_CEIL:
+            return !negative;
+        case CRYPTO_ROUND_HALF_UP:
+            return half >= 0;
+        case CRYPTO_ROUND_HALF_EVEN:
+            return half > 0 || (half == 0 && odd);
+        default:
+            return false;
+    }
+}
+
+// Store a truncated quotient magnitude, first rounding it away from zero when
+// crypto_round_away says so. q must have room for qn + 1 limbs.
+static void crypto_store_quotient(crypto_val_t* r, mp_limb_t* q, mp_size_t qn, bool negative, bool exact, int half, crypto_rounding_t rounding) {
+    if (crypto_round_away(rounding, negative, exact, half, qn > 0 && (q[0] & 1))) {
+        if (qn == 0) {
+            q[0] = 1;
+            qn = 1;
+        } else {
+            q[qn] = mpn_add_1(q, q, qn, 1);
+            qn++;
+        }
+    }
+    crypto_store_limbs(r, q, qn, negative);
+}
+
+// Compare twice the n-limb remainder rem with the n-limb divisor magnitude d
+static int crypto_cmp_half(const mp_limb_t* rem, const mp_limb_t* d, mp_size_t n) {
+    if (rem[n - 1] >> (GMP_NUMB_BITS - 1)) {
+        return 1;  // Twice the remainder has an extra limb
+    }
+    mp_limb_t twice[CRYPTO_INLINE_LIMBS];
+    mpn_lshift(twice, rem, n, 1);
+    int c = mpn_cmp(twice, d, n);
+    return (c > 0) - (c < 0);
+}
+
+// Divide through GMP; also raises GMP's division-by-zero exception for a zero divisor
+static void crypto_div_mpz(crypto_val_t* r, const crypto_val_t* a, const mpz_t b, crypto_rounding_t rounding) {
+    mpz_t va;
+    crypto_promote(r);
+    switch (rounding) {
+        case CRYPTO_ROUND_TRUNCATE:
+            mpz_tdiv_q(r->big, crypto_view(a, va), b);
+            break;
+        case CRYPTO_ROUND_FLOOR:
+            mpz_fdiv_q(r->big, crypto_view(a, va), b);
+            break;
+        case CRYPTO_ROUND_CEIL:
+            mpz_cdiv_q(r->big, crypto_view(a, va), b);
+            break;
+        case CRYPTO_ROUND_HALF_UP:
+        case CRYPTO_ROUND_HALF_EVEN: {
+            // The sign is taken first since r may be a
+            mpz_srcptr av = crypto_view(a, va);
+            bool negative = (mpz_sgn(av) < 0) != (mpz_sgn(b) < 0);
+            mpz_ptr rem = crypto_scratch_mpz();
+            mpz_tdiv_qr(r->big, rem, av, b);
+            bool exact = mpz_sgn(rem) == 0;
+            mpz_mul_2exp(rem, rem, 1);
+            int half = mpz_cmpabs(rem, b);
+            if (crypto_round_away(rounding, negative, exact, (half > 0) - (half < 0), mpz_odd_p(r->big))) {
+                if (negative) {
+                    mpz_sub_ui(r->big, r->big, 1);
+                } else {
+                    mpz_add_ui(r->big, r->big, 1);
+                }
+            }
+            crypto_scratch_mpz_release(rem);
+            break;
+        }
+    }
+}
+
+// Divide a value by a GMP integer with the given rounding.
+// Inline dividends with a non-zero divisor that fits inline stay on mpn primitives;
+// a zero divisor goes through GMP so it raises the usual division-by-zero exception.
+static void crypto_div(crypto_val_t* r, const crypto_val_t* a, const mpz_t b, crypto_rounding_t rounding) {
+    mp_size_t bn = mpz_size(b);
+    CRYPTO_STAT_PATH(!a->is_big && bn > 0 && bn <= CRYPTO_INLINE_LIMBS);
+    if (!a->is_big && bn > 0 && bn <= CRYPTO_INLINE_LIMBS) {
+        mp_size_t an = a->size < 0 ? -a->size : a->size;
+        bool negative = (a->size < 0) != (mpz_sgn(b) < 0);
+        mp_limb_t q[CRYPTO_INLINE_LIMBS + 1];
+        mp_limb_t rem[CRYPTO_INLINE_LIMBS];
+        mp_size_t qn;
+        bool exact;
+        if (an < bn) {
+            qn = 0;
+            exact = an == 0;
+        } else {
+            mpn_tdiv_qr(q, rem, 0, a->limbs, an, mpz_limbs_read(b), bn);
+            qn = an - bn + 1;
+            exact = mpn_zero_p(rem, bn);
+        }
+        int half = 0;
+        if (!exact && rounding >= CRYPTO_ROUND_HALF_UP) {
+            if (an < bn) {
+                // The remainder is the dividend itself
+                memset(rem, 0, bn * sizeof(mp_limb_t));
+                memcpy(rem, a->limbs, an * sizeof(mp_limb_t));
+            }
+            half = crypto_cmp_half(rem, mpz_limbs_read(b), bn);
+        }
+        crypto_store_quotient(r, q, qn, negative, exact, half, rounding);
+        return;
+    }
+    crypto_div_mpz(r, a, b, rounding);
+}
+
+void crypto_div_truncate(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(b != NULL);
+    assert(r->crypto_type == a->crypto_type);
+    crypto_div(r, a, *b, CRYPTO_ROUND_TRUNCATE);
+}
+
+void crypto_div_floor(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(b != NULL);
+    assert(r->crypto_type == a->crypto_type);
+    crypto_div(r, a, *b, CRYPTO_ROUND_FLOOR);
+}
+
+void crypto_div_ceil(crypto_val_t* r, const crypto_val_t* a, const mpz_t *b) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(b != NULL);
+    assert(r->crypto_type == a->crypto_type);
+    crypto_div(r, a, *b, CRYPTO_ROUND_CEIL);
+}
+
+// Prepare a divisor for repeated use with crypto_div_by. A zero divisor is accepted
+// here; dividing by it raises GMP's division-by-zero exception.
+void crypto_divisor_init(crypto_divisor_t* d, const mpz_t value) {
+    assert(d != NULL);
+    mpz_init_set(d->value, value);
+    d->negative = mpz_sgn(value) < 0;
+    d->word = false;
+    d->shift = 0;
+    d->norm = 0;
+    d->inv = 0;
+#ifdef CRYPTO_HAVE_PREINV
+    if (mpz_size(value) == 1) {
+        mp_limb_t m = mpz_getlimbn(value, 0);
+        d->shift = (unsigned)__builtin_clzll(m);
+        d->norm = m << d->shift;
+        d->inv = (mp_limb_t)((((unsigned __int128)~d->norm << 64) | ~(mp_limb_t)0) / d->norm);
+        d->word = true;
+    }
+#endif
+}
+
+void crypto_divisor_clear(crypto_divisor_t* d) {
+    assert(d != NULL);
+    mpz_clear(d->value);
+}
+
+// Divide a value by a prepared divisor with the given rounding. For truncate, floor and
+// ceil this gives the same result as crypto_div_truncate, crypto_div_floor or
+// crypto_div_ceil with d's value.
+void crypto_div_by(crypto_val_t* r, const crypto_val_t* a, const crypto_divisor_t* d, crypto_rounding_t rounding) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(d != NULL);
+    assert(r->crypto_type == a->crypto_type);
+#ifdef CRYPTO_HAVE_PREINV
+    if (d->word && !a->is_big) {
+        CRYPTO_STAT_PATH(true);
+        mp_size_t an = a->size < 0 ? -a->size : a->size;
+        bool negative = (a->size < 0) != d->negative;
+        mp_limb_t q[CRYPTO_INLINE_LIMBS + 1];
+        mp_limb_t rem = 0;
+        unsigned shift = d->shift;
+        // Divide the dividend shifted left by shift, one limb at a time from the top
+        if (an > 0 && shift > 0) {
+            rem = a->limbs[an - 1] >> (64 - shift);
+        }
+        for (mp_size_t i = an - 1; i >= 0; i--) {
+            mp_limb_t u0 = a->limbs[i];
+            if (shift > 0) {
+                u0 = (u0 << shift) | (i > 0 ? a->limbs[i - 1] >> (64 - shift) : 0);
+            }
+            q[i] = crypto_div_2by1(&rem, rem, u0, d->norm, d->inv);
+        }
+        // The true remainder is rem >> shift and the divisor norm >> shift
+        mp_limb_t m = d->norm >> shift;
+        rem >>= shift;
+        int half = rem > m - rem ? 1 : rem == m - rem ? 0 : -1;
+        crypto_store_quotient(r, q, an, negative, rem == 0, half, rounding);
+        return;
+    }
+#endif
+    crypto_div(r, a, d->value, rounding);
+}
+
+// r = a * num / den, computed exactly and rounded once. The product is kept at full
+// width, so unlike crypto_mul followed by a crypto_div_* call nothing is lost before
+// the division.
+void crypto_muldiv(crypto_val_t* r, const crypto_val_t* a, const mpz_t* num, const mpz_t* den, crypto_rounding_t rounding) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(num != NULL);
+    assert(den != NULL);
+    assert(r->crypto_type == a->crypto_type);
+    crypto_val_t product;
+    crypto_init(&product, a->crypto_type);
+    crypto_mul_raw(&product, a, num);
+    crypto_div(r, &product, *den, rounding);
+    crypto_clear(&product);
+}
+
+// Compare two values of the same crypto type without checking the arguments.
+static int crypto_cmp_raw(const crypto_val_t* a, const crypto_val_t* b) {
+    CRYPTO_STAT_PATH(!a->is_big && !b->is_big);
+    if (!a->is_big && !b->is_big) {
+        if (a->size != b->size) {
+            return a->size < b->size ? -1 : 1;
+        }
+        if (a->size == 0) {
+            return 0;
+        }
+        int c = mpn_cmp(a->limbs, b->limbs, a->size < 0 ? -a->size : a->size);
+        if (a->size < 0) {
+            c = -c;
+        }
+        return (c > 0) - (c < 0);
+    }
+    mpz_t va, vb;
+    int c = mpz_cmp(crypto_view(a, va), crypto_view(b, vb));
+    return (c > 0) - (c < 0);
+}
+
+// Compare two values of the same crypto type.
+// Returns -1, 0 or 1.
+int crypto_cmp(const crypto_val_t* a, const crypto_val_t* b) {
+    assert(a != NULL);
+    assert(b != NULL);
+    assert(a->crypto_type == b->crypto_type);
+    return crypto_cmp_raw(a, b);
+}
+
+// Sign of a value: -1, 0 or 1
+static int crypto_sgn(const crypto_val_t* a) {
+    if (a->is_big) {
+        return mpz_sgn(a->big);
+    }
+    return (a->size > 0) - (a->size < 0);
+}
+
+int crypto_gt_zero(const crypto_val_t* a) {
+    assert(a != NULL);
+    return crypto_sgn(a) > 0;
+}
+
+int crypto_lt_zero(const crypto_val_t* a) {
+    assert(a != NULL);
+    return crypto_sgn(a) < 0;
+}
+
+int crypto_eq_zero(const crypto_val_t* a) {
+    assert(a != NULL);
+    return crypto_sgn(a) == 0;
+}
+
+// Batch operations over contiguous arrays of n values. The arrays must all hold
+// values of the same crypto type; the arguments are checked once and the loops
+// call the unchecked kernels directly. Element-wise results may alias their
+// inputs (r == a is fine).
+
+// r[i] = a[i] + b[i]
+void crypto_add_n(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b, size_t n) {
+    assert(n == 0 || (r != NULL && a != NULL && b != NULL));
+    assert(n == 0 || (a[0].crypto_type == b[0].crypto_type && r[0].crypto_type == a[0].crypto_type));
+    for (size_t i = 0; i < n; i++) {
+        assert(a[i].crypto_type == a[0].crypto_type);
+        crypto_addsub(&r[i], &a[i], &b[i], false);
+    }
+}
+
+// r[i] = a[i] - b[i]
+void crypto_sub_n(crypto_val_t* r, const crypto_val_t* a, const crypto_val_t* b, size_t n) {
+    assert(n == 0 || (r != NULL && a != NULL && b != NULL));
+    assert(n == 0 || (a[0].crypto_type == b[0].crypto_type && r[0].crypto_type == a[0].crypto_type));
+    for (size_t i = 0; i < n; i++) {
+        assert(a[i].crypto_type == a[0].crypto_type);
+        crypto_addsub(&r[i], &a[i], &b[i], true);
+    }
+}
+
+// r[i] = a[i] * b
+void crypto_mul_n(crypto_val_t* r, const crypto_val_t* a, const mpz_t* b, size_t n) {
+    assert(b != NULL);
+    assert(n == 0 || (r != NULL && a != NULL));
+    assert(n == 0 || r[0].crypto_type == a[0].crypto_type);
+    for (size_t i = 0; i < n; i++) {
+        assert(a[i].crypto_type == a[0].crypto_type);
+        crypto_mul_raw(&r[i], &a[i], b);
+    }
+}
+
+// r = a[0] + ... + a[n - 1]
+// Inline values are added into separate positive and negative limb accumulators
+// one limb wider than the inline bound, which cannot overflow for any size_t n, so
+// nothing is normalized or promoted until the end. Promoted values go through GMP.
+void crypto_sum_n(crypto_val_t* r, const crypto_val_t* a, size_t n) {
+    assert(r != NULL);
+    assert(n == 0 || a != NULL);
+    mp_limb_t pos[CRYPTO_INLINE_LIMBS + 1] = { 0 };
+    mp_limb_t neg[CRYPTO_INLINE_LIMBS + 1] = { 0 };
+    mpz_ptr big = NULL;
+    bool have_big = false;
+    for (size_t i = 0; i < n; i++) {
+        assert(a[i].crypto_type == r->crypto_type);
+        const crypto_val_t* v = &a[i];
+        if (v->is_big) {
+            if (!have_big) {
+                big = crypto_scratch_mpz();
+                mpz_set_ui(big, 0);
+                have_big = true;
+            }
+            mpz_add(big, big, v->big);
+        } else if (v->size > 0) {
+            mpn_add(pos, pos, CRYPTO_INLINE_LIMBS + 1, v->limbs, v->size);
+        } else if (v->size < 0) {
+            mpn_add(neg, neg, CRYPTO_INLINE_LIMBS + 1, v->limbs, -v->size);
+        }
+    }
+
+    mp_limb_t diff[CRYPTO_INLINE_LIMBS + 1];
+    bool negative = mpn_cmp(pos, neg, CRYPTO_INLINE_LIMBS + 1) < 0;
+    if (negative) {
+        mpn_sub_n(diff, neg, pos, CRYPTO_INLINE_LIMBS + 1);
+    } else {
+        mpn_sub_n(diff, pos, neg, CRYPTO_INLINE_LIMBS + 1);
+    }
+    if (!have_big) {
+        crypto_store_limbs(r, diff, CRYPTO_INLINE_LIMBS + 1, negative);
+        return;
+    }
+
+    mpz_t view;
+    mp_size_t dn = CRYPTO_INLINE_LIMBS + 1;
+    while (dn > 0 && diff[dn - 1] == 0) {
+        dn--;
+    }
+    mpz_add(big, big, mpz_roinit_n(view, diff, negative ? -dn : dn));
+    crypto_set_mpz(r, big);
+    crypto_scratch_mpz_release(big);
+}
+
+// Set bit i of mask (bit i % 64 of word i / 64) when the sign of
+// crypto_cmp(&a[i], threshold) equals sign: 1 for greater than, -1 for less than,
+// 0 for equal. mask must hold (n + 63) / 64 words; bits past n are cleared.
+// Returns the number of bits set.
+size_t crypto_cmp_n(uint64_t* mask, const crypto_val_t* a, size_t n, const crypto_val_t* threshold, int sign) {
+    assert(mask != NULL || n == 0);
+    assert(a != NULL || n == 0);
+    assert(threshold != NULL);
+    assert(sign >= -1 && sign <= 1);
+    size_t count = 0;
+    for (size_t w = 0; w < (n + 63) / 64; w++) {
+        size_t end = (w + 1) * 64 < n ? (w + 1) * 64 : n;
+        uint64_t bits = 0;
+        for (size_t i = w * 64; i < end; i++) {
+            assert(a[i].crypto_type == threshold->crypto_type);
+            bits |= (uint64_t)(crypto_cmp_raw(&a[i], threshold) == sign) << (i % 64);
+        }
+        mask[w] = bits;
+        count += (size_t)__builtin_popcountll(bits);
+    }
+    return count;
+}
+
+// Symbol lookups go through two open-addressed hash tables, one keyed on the type
+// symbol and one on (type, denom symbol). Both hash the raw symbol bytes, so UTF-8
+// symbols such as μBTC need no special handling. The tables are sized to a power of
+// two at most half full with every registry slot taken, and store id + 1 (0 marks an
+// empty slot). Built-in entries are inserted once on first use under pthread_once;
+// registered ones are inserted under crypto_registry_lock. Slots are only ever filled,
+// never moved or emptied, so lookups read them with acquire loads and no lock.
+#define CRYPTO_TYPE_HASH_SIZE 8192
+#define CRYPTO_DENOM_HASH_SIZE 32768
+#define CRYPTO_TYPE_ID_LIMIT (CRYPTO_TYPE_FIRST_REGISTERED + CRYPTO_REGISTRY_MAX_TYPES)
+#define CRYPTO_DENOM_ID_LIMIT (CRYPTO_DENOM_FIRST_REGISTERED + CRYPTO_REGISTRY_MAX_DENOMS)
+
+_Static_assert(CRYPTO_TYPE_ID_LIMIT * 2 <= CRYPTO_TYPE_HASH_SIZE, "grow CRYPTO_TYPE_HASH_SIZE");
+_Static_assert(CRYPTO_DENOM_ID_LIMIT * 2 <= CRYPTO_DENOM_HASH_SIZE, "grow CRYPTO_DENOM_HASH_SIZE");
+_Static_assert(CRYPTO_DENOM_ID_LIMIT < UINT16_MAX, "hash slots hold 16-bit ids");
+
+static uint16_t crypto_type_hash[CRYPTO_TYPE_HASH_SIZE];
+static uint16_t crypto_denom_hash[CRYPTO_DENOM_HASH_SIZE];
+static uint8_t crypto_type_symbol_len[CRYPTO_TYPE_ID_LIMIT];
+static uint8_t crypto_denom_symbol_len[CRYPTO_DENOM_ID_LIMIT];
+// The denominations of each type, chained in id order as id + 1 (0 ends the chain)
+static uint16_t crypto_type_first_denom[CRYPTO_TYPE_ID_LIMIT];
+static uint16_t crypto_type_last_denom[CRYPTO_TYPE_ID_LIMIT];
+static uint16_t crypto_denom_next[CRYPTO_DENOM_ID_LIMIT];
+static pthread_once_t crypto_symbol_hash_once = PTHREAD_ONCE_INIT;
+
+// FNV-1a over the symbol bytes, seeded so that denom keys also cover the type.
+static inline uint32_t crypto_symbol_hash(const char* symbol, size_t len, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)symbol[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void crypto_type_hash_insert(crypto_type_t type, const char* symbol, size_t len) {
+    uint32_t slot = crypto_symbol_hash(symbol, len, 0) & (CRYPTO_TYPE_HASH_SIZE - 1);
+    while (crypto_type_hash[slot] != 0) {
+        slot = (slot + 1) & (CRYPTO_TYPE_HASH_SIZE - 1);
+    }
+    crypto_type_symbol_len[type] = (uint8_t)len;
+    __atomic_store_n(&crypto_type_hash[slot], (uint16_t)(type + 1), __ATOMIC_RELEASE);
+}
+
+static void crypto_denom_hash_insert(crypto_denom_t denom, crypto_type_t type, const char* symbol, size_t len) {
+    uint32_t slot = crypto_symbol_hash(symbol, len, (uint32_t)type) & (CRYPTO_DENOM_HASH_SIZE - 1);
+    while (crypto_denom_hash[slot] != 0) {
+        slot = (slot + 1) & (CRYPTO_DENOM_HASH_SIZE - 1);
+    }
+    crypto_denom_symbol_len[denom] = (uint8_t)len;
+    __atomic_store_n(&crypto_denom_hash[slot], (uint16_t)(denom + 1), __ATOMIC_RELEASE);
+
+    uint16_t last = crypto_type_last_denom[type];
+    __atomic_store_n(last == 0 ? &crypto_type_first_denom[type] : &crypto_denom_next[last - 1],
+                     (uint16_t)(denom + 1), __ATOMIC_RELEASE);
+    crypto_type_last_denom[type] = (uint16_t)(denom + 1);
+}
+
+static void crypto_symbol_hash_build(void) {
+    // Insert in index order so that a duplicate symbol resolves to its first entry
+    for (int i = 0; i < CRYPTO_COUNT; i++) {
+        crypto_type_hash_insert(i, crypto_defs[i].symbol, strlen(crypto_defs[i].symbol));
+    }
+    for (int i = 0; i < DENOM_COUNT; i++) {
+        crypto_denom_hash_insert(i, crypto_denoms[i].crypto_type, crypto_denoms[i].symbol,
+                                 strlen(crypto_denoms[i].symbol));
+    }
+}
+
+// Get the denom for a symbol of len bytes, which need not be NUL-terminated.
+// Returns DENOM_COUNT if the symbol is not found.
+crypto_denom_t crypto_get_denom_for_symbol_n(crypto_type_t type, const char* symbol, size_t len) {
+    assert(symbol != NULL);
+    pthread_once(&crypto_symbol_hash_once, crypto_symbol_hash_build);
+    uint32_t slot = crypto_symbol_hash(symbol, len, (uint32_t)type) & (CRYPTO_DENOM_HASH_SIZE - 1);
+    uint16_t entry;
+    while ((entry = __atomic_load_n(&crypto_denom_hash[slot], __ATOMIC_ACQUIRE)) != 0) {
+        crypto_denom_t i = (crypto_denom_t)(entry - 1);
+        const crypto_denom_def_t* def = crypto_denom_def(i);
+        if (def->crypto_type == type && crypto_denom_symbol_len[i] == len &&
+            memcmp(def->symbol, symbol, len) == 0) {
+            return i;
+        }
+        slot = (slot + 1) & (CRYPTO_DENOM_HASH_SIZE - 1);
+    }
+    return DENOM_COUNT;
+}
+
+// First denomination of a type in id order, or DENOM_COUNT if it has none.
+crypto_denom_t crypto_first_denom(crypto_type_t type) {
+    assert(crypto_is_valid_type(type));
+    pthread_once(&crypto_symbol_hash_once, crypto_symbol_hash_build);
+    uint16_t entry = __atomic_load_n(&crypto_type_first_denom[type], __ATOMIC_ACQUIRE);
+    return entry == 0 ? DENOM_COUNT : (crypto_denom_t)(entry - 1);
+}
+
+// Next denomination of the same type after denom, or DENOM_COUNT after the last.
+// Visits only that type's denominations, however many others are registered.
+crypto_denom_t crypto_next_denom(crypto_denom_t denom) {
+    assert(crypto_is_valid_denom(denom));
+    pthread_once(&crypto_symbol_hash_once, crypto_symbol_hash_build);
+    uint16_t entry = __atomic_load_n(&crypto_denom_next[denom], __ATOMIC_ACQUIRE);
+    return entry == 0 ? DENOM_COUNT : (crypto_denom_t)(entry - 1);
+}
+
+// Get the denom for a given symbol.
+// Returns DENOM_COUNT if the symbol is not found.
+crypto_denom_t crypto_get_denom_for_symbol(crypto_type_t type, const char* symbol) {
+    assert(symbol != NULL);
+    return crypto_get_denom_for_symbol_n(type, symbol, strlen(symbol));
+}
+
+bool crypto_is_valid_decimal(const char* str) {
+    if (!str) return false;
+    size_t len = strlen(str);
+    size_t i = 0;
+
+    // Skip leading whitespace
+    while (i < len && crypto_is_space(str[i])) {
+        i++;
+    }
+
+    // Check for optional sign
+    if (i < len && (str[i] == '+' || str[i] == '-')) {
+        i++;
+    }
+
+    // Whole digits, then at most one decimal point and fraction digits
+    size_t digits = crypto_span_range(str + i, len - i, '0', '9');
+    i += digits;
+    if (i < len && str[i] == '.') {
+        i++;
+        size_t fraction_digits = crypto_span_range(str + i, len - i, '0', '9');
+        digits += fraction_digits;
+        i += fraction_digits;
+    }
+    if (digits == 0) return false; // Must have at least one digit
+
+    // Only trailing whitespace may follow
+    while (i < len && crypto_is_space(str[i])) {
+        i++;
+    }
+    return i == len;
+}
+
+bool crypto_has_nonzero_fraction(const char* str) {
+    if (!str) return false;
 
     // Find the decimal point
     const char* decimal_point = strchr(str, '.');
     if (!decimal_point) {
-        return 0; // No decimal point means no precision
+        return false; // No decimal point means no fraction
     }
 
-    // Get the precision
-    uint8_t precision = 0;
-    while (decimal_point[precision + 1] != '\0') {
-        precision++;
+    // Skip the zeros after the decimal point; anything else but the end counts as non-zero
+    decimal_point++; // Move past the decimal point
+    const char* end = decimal_point + strlen(decimal_point);
+    decimal_point += crypto_span_range(decimal_point, (size_t)(end - decimal_point), '0', '0');
+    return decimal_point < end && !crypto_is_space(*decimal_point);
+}
+
+// Take an assumed valid decimal string, determine the precision past the decimal point,
+// multiple the whole number by 10^precision, add the fraction to the whole number,
+// and return the precision. The result will be passed in as a pointer to mpz_t.
+// A fraction that is all zeros counts as no fraction, so "2.00" yields 2 with precision 0.
+uint8_t crypto_scale_by_precision(const char* str, mpz_t* result) {
+    assert(str != NULL);
+    assert(result != NULL);
+
+    // Skip leading whitespace and read the optional sign
+    while (crypto_is_space(*str)) {
+        str++;
+    }
+    bool negative = *str == '-';
+    if (*str == '-' || *str == '+') {
+        str++;
     }
 
-    // Get the fraction part into a mpz_t
-    mpz_t fraction;
-    mpz_init(fraction);
-    mpz_set_str(fraction, decimal_point + 1, 10);
+    // Fold the digits of both parts into the result, nine at a time so that every
+    // chunk fits an unsigned long
+    mpz_set_ui(*result, 0);
+    unsigned long chunk = 0;
+    int chunk_digits = 0;
+    unsigned precision = 0;
+    bool in_fraction = false;
+    bool nonzero_fraction = false;
+    for (; (*str >= '0' && *str <= '9') || (*str == '.' && !in_fraction); str++) {
+        if (*str == '.') {
+            in_fraction = true;
+            continue;
+        }
+        if (in_fraction) {
+            precision++;
+            nonzero_fraction |= *str != '0';
+        }
+        chunk = chunk * 10 + (unsigned long)(*str - '0');
+        if (++chunk_digits == 9) {
+            mpz_mul_ui(*result, *result, 1000000000UL);
+            mpz_add_ui(*result, *result, chunk);
+            chunk = 0;
+            chunk_digits = 0;
+        }
+    }
+    if (chunk_digits > 0) {
+        mpz_mul_ui(*result, *result, (unsigned long)crypto_pow10_u64(chunk_digits));
+        mpz_add_ui(*result, *result, chunk);
+    }
 
     // Only scale the whole number if the fraction is not zero
-    if (mpz_cmp_ui(fraction, 0) != 0) {
-        mpz_t scale;
-        mpz_init(scale);
-        mpz_ui_pow_ui(scale, 10, precision);
-        // Scale the whole number by the precision; assume the precision can be large
-        mpz_mul(*result, *result, scale);
-        // Add the fraction to the whole number
-        mpz_add(*result, *result, fraction);
-        // Clear the fraction
-        mpz_clear(fraction);
-        mpz_clear(scale);
-        // Return the precision
-        return precision;
-    } else {
-        // Clear the fraction
-        mpz_clear(fraction);
-        return 0;
+    if (!nonzero_fraction && precision > 0) {
+        if (precision <= CRYPTO_POW10_MAX) {
+            mpz_divexact(*result, *result, *crypto_pow10(precision));
+        } else {
+            mpz_ptr scale = crypto_scratch_mpz();
+            mpz_ui_pow_ui(scale, 10, precision);
+            mpz_divexact(*result, *result, scale);
+            crypto_scratch_mpz_release(scale);
+        }
+        precision = 0;
     }
+    if (negative) {
+        mpz_neg(*result, *result);
+    }
+    return (uint8_t)precision;
 }
 
-// Get the type for a given symbol.
+// Get the type for a symbol of len bytes, which need not be NUL-terminated.
 // Returns CRYPTO_COUNT if the symbol is not found.
-crypto_type_t crypto_get_type_for_symbol(const char* symbol) {
-    for (int i = 0; i < CRYPTO_COUNT; i++) {
-        if (strcmp(symbol, crypto_defs[i].symbol) == 0) {
+crypto_type_t crypto_get_type_for_symbol_n(const char* symbol, size_t len) {
+    assert(symbol != NULL);
+    pthread_once(&crypto_symbol_hash_once, crypto_symbol_hash_build);
+    uint32_t slot = crypto_symbol_hash(symbol, len, 0) & (CRYPTO_TYPE_HASH_SIZE - 1);
+    uint16_t entry;
+    while ((entry = __atomic_load_n(&crypto_type_hash[slot], __ATOMIC_ACQUIRE)) != 0) {
+        crypto_type_t i = (crypto_type_t)(entry - 1);
+        if (crypto_type_symbol_len[i] == len && memcmp(crypto_type_def(i)->symbol, symbol, len) == 0) {
             return i;
         }
+        slot = (slot + 1) & (CRYPTO_TYPE_HASH_SIZE - 1);
     }
     return CRYPTO_COUNT;
 }
 
+// Get the type for a given symbol.
+// Returns CRYPTO_COUNT if the symbol is not found.
+crypto_type_t crypto_get_type_for_symbol(const char* symbol) {
+    assert(symbol != NULL);
+    return crypto_get_type_for_symbol_n(symbol, strlen(symbol));
+}
+
+// A registered symbol is 1 to CRYPTO_SYMBOL_MAX bytes with no spaces or control
+// characters, so that registry files can separate fields with whitespace
+static bool crypto_registry_symbol_ok(const char* symbol, size_t len) {
+    if (len == 0 || len > CRYPTO_SYMBOL_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)symbol[i];
+        if (c <= ' ' || c == 0x7F) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool crypto_registry_name_ok(const char* name, size_t len) {
+    if (len == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)name[i];
+        if (c < ' ' || c == 0x7F) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Registered strings live as long as the process, which outlasts any allocator
+// installed with crypto_set_allocator, so they come straight from malloc
+static char* crypto_registry_strdup(const char* str, size_t len) {
+    char* copy = malloc(len + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+// Append a denomination whose strings the registry already owns. The caller holds
+// crypto_registry_lock and has checked that there is room.
+static crypto_denom_t crypto_registry_add_denom(crypto_type_t type, const char* symbol, size_t len,
+                                                const char* name, unsigned decimals) {
+    unsigned k = crypto_registry_denom_n;
+    crypto_denom_t denom = (crypto_denom_t)(CRYPTO_DENOM_FIRST_REGISTERED + k);
+    crypto_registry_denoms[k] = (crypto_denom_def_t){
+        .name = name,
+        .symbol = symbol,
+        .crypto_type = type,
+        .decimals = (uint8_t)decimals
+    };
+    // Publish the id before making it reachable by symbol
+    __atomic_store_n(&crypto_registry_denom_n, k + 1, __ATOMIC_RELEASE);
+    crypto_denom_hash_insert(denom, type, symbol, len);
+    return denom;
+}
+
+static crypto_registry_status_t crypto_register_type_n(const char* symbol, size_t len, const char* name,
+                                                       size_t name_len, unsigned decimals, crypto_type_t* type) {
+    if (!crypto_registry_symbol_ok(symbol, len)) {
+        return CRYPTO_REGISTRY_INVALID_SYMBOL;
+    }
+    if (!crypto_registry_name_ok(name, name_len)) {
+        return CRYPTO_REGISTRY_INVALID_NAME;
+    }
+    if (decimals > CRYPTO_POW10_MAX) {
+        return CRYPTO_REGISTRY_INVALID_DECIMALS;
+    }
+    pthread_once(&crypto_symbol_hash_once, crypto_symbol_hash_build);
+    pthread_mutex_lock(&crypto_registry_lock);
+    crypto_registry_status_t status = CRYPTO_REGISTRY_OK;
+    crypto_type_t t = crypto_get_type_for_symbol_n(symbol, len);
+    if (t != CRYPTO_COUNT) {
+        // Registering the same asset again is a no-op, so registry files can be reloaded
+        crypto_denom_t base = crypto_get_denom_for_symbol_n(t, symbol, len);
+        if (base == DENOM_COUNT || crypto_denom_def(base)->decimals != decimals) {
+            status = CRYPTO_REGISTRY_CONFLICT;
+        }
+    } else if (crypto_registry_type_n == CRYPTO_REGISTRY_MAX_TYPES ||
+               crypto_registry_denom_n == CRYPTO_REGISTRY_MAX_DENOMS) {
+        status = CRYPTO_REGISTRY_FULL;
+    } else {
+        char* owned_symbol = crypto_registry_strdup(symbol, len);
+        char* owned_name = crypto_registry_strdup(name, name_len);
+        if (owned_symbol == NULL || owned_name == NULL) {
+            free(owned_symbol);
+            free(owned_name);
+            status = CRYPTO_REGISTRY_NOMEM;
+        } else {
+            unsigned k = crypto_registry_type_n;
+            t = (crypto_type_t)(CRYPTO_TYPE_FIRST_REGISTERED + k);
+            crypto_registry_types[k] = (crypto_def_t){
+                .crypto_type = t,
+                .name = owned_name,
+                .symbol = owned_symbol
+            };
+            __atomic_store_n(&crypto_registry_type_n, k + 1, __ATOMIC_RELEASE);
+            // The base unit shares the type's symbol and name
+            crypto_registry_add_denom(t, owned_symbol, len, owned_name, decimals);
+            crypto_type_hash_insert(t, owned_symbol, len);
+        }
+    }
+    pthread_mutex_unlock(&crypto_registry_lock);
+    if (status == CRYPTO_REGISTRY_OK && type != NULL) {
+        *type = t;
+    }
+    return status;
+}
+
+static crypto_registry_status_t crypto_register_denom_n(crypto_type_t type, const char* symbol, size_t len,
+                                                        const char* name, size_t name_len, unsigned decimals,
+                                                        crypto_denom_t* denom) {
+    if (!crypto_is_valid_type(type)) {
+        return CRYPTO_REGISTRY_UNKNOWN_TYPE;
+    }
+    if (!crypto_registry_symbol_ok(symbol, len)) {
+        return CRYPTO_REGISTRY_INVALID_SYMBOL;
+    }
+    if (!crypto_registry_name_ok(name, name_len)) {
+        return CRYPTO_REGISTRY_INVALID_NAME;
+    }
+    if (decimals > CRYPTO_POW10_MAX) {
+        return CRYPTO_REGISTRY_INVALID_DECIMALS;
+    }
+    pthread_once(&crypto_symbol_hash_once, crypto_symbol_hash_build);
+    pthread_mutex_lock(&crypto_registry_lock);
+    crypto_registry_status_t status = CRYPTO_REGISTRY_OK;
+    crypto_denom_t d = crypto_get_denom_for_symbol_n(type, symbol, len);
+    if (d != DENOM_COUNT) {
+        if (crypto_denom_def(d)->decimals != decimals) {
+            status = CRYPTO_REGISTRY_CONFLICT;
+        }
+    } else if (crypto_registry_denom_n == CRYPTO_REGISTRY_MAX_DENOMS) {
+        status = CRYPTO_REGISTRY_FULL;
+    } else {
+        char* owned_symbol = crypto_registry_strdup(symbol, len);
+        char* owned_name = crypto_registry_strdup(name, name_len);
+        if (owned_symbol == NULL || owned_name == NULL) {
+            free(owned_symbol);
+            free(owned_name);
+            status = CRYPTO_REGISTRY_NOMEM;
+        } else {
+            d = crypto_registry_add_denom(type, owned_symbol, len, owned_name, decimals);
+        }
+    }
+    pthread_mutex_unlock(&crypto_registry_lock);
+    if (status == CRYPTO_REGISTRY_OK && denom != NULL) {
+        *denom = d;
+    }
+    return status;
+}
+
+// Register a crypto type together with its base unit, a denomination with the same
+// symbol and name and the given number of decimals. Registering a symbol that already
+// exists with the same decimals succeeds and yields the existing type. The new type
+// is usable everywhere a built-in one is, from any thread, as soon as this returns.
+crypto_registry_status_t crypto_register_type(const char* symbol, const char* name, unsigned decimals, crypto_type_t* type) {
+    assert(symbol != NULL);
+    assert(name != NULL);
+    return crypto_register_type_n(symbol, strlen(symbol), name, strlen(name), decimals, type);
+}
+
+// Register another denomination of an existing type, built-in or registered.
+crypto_registry_status_t crypto_register_denom(crypto_type_t type, const char* symbol, const char* name, unsigned decimals, crypto_denom_t* denom) {
+    assert(symbol != NULL);
+    assert(name != NULL);
+    return crypto_register_denom_n(type, symbol, strlen(symbol), name, strlen(name), decimals, denom);
+}
+
+// Next whitespace-separated field of a registry line; returns its length (0 at the end)
+static size_t crypto_registry_field(const char** p, const char* end, const char** field) {
+    while (*p < end && (**p == ' ' || **p == '\t')) {
+        (*p)++;
+    }
+    *field = *p;
+    while (*p < end && **p != ' ' && **p != '\t') {
+        (*p)++;
+    }
+    return (size_t)(*p - *field);
+}
+
+static bool crypto_registry_decimals(const char* field, size_t len, unsigned* decimals) {
+    if (len == 0 || len > 3) {
+        return false;
+    }
+    unsigned value = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (field[i] < '0' || field[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (unsigned)(field[i] - '0');
+    }
+    *decimals = value;
+    return true;
+}
+
+// Register every entry of a registry file held in memory. Each line is blank, a
+// comment starting with '#', or one of
+//
+//   asset SYMBOL DECIMALS NAME...        a crypto type and its base unit
+//   denom TYPE SYMBOL DECIMALS NAME...   another denomination of TYPE
+//
+// with fields separated by spaces or tabs; NAME runs to the end of the line. Loading
+// stops at the first line that fails, whose 1-based number is stored in error_line.
+// Entries before it stay registered; as registration is idempotent the file can be
+// fixed and loaded again.
+crypto_registry_status_t crypto_registry_load_buffer(const char* data, size_t len, size_t* error_line) {
+    assert(data != NULL || len == 0);
+    const char* p = data;
+    const char* end = data + len;
+    size_t line = 0;
+    while (p < end) {
+        line++;
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        if (eol == NULL) {
+            eol = end;
+        }
+        const char* stop = eol;
+        if (stop > p && stop[-1] == '\r') {
+            stop--;
+        }
+
+        const char* kind;
+        size_t kind_len = crypto_registry_field(&p, stop, &kind);
+        crypto_registry_status_t status = CRYPTO_REGISTRY_OK;
+        if (kind_len == 0 || kind[0] == '#') {
+            // Blank line or comment
+        } else {
+            bool is_denom = kind_len == 5 && memcmp(kind, "denom", 5) == 0;
+            bool is_asset = kind_len == 5 && memcmp(kind, "asset", 5) == 0;
+            crypto_type_t type = CRYPTO_COUNT;
+            const char* type_symbol = NULL;
+            size_t type_len = is_denom ? crypto_registry_field(&p, stop, &type_symbol) : 0;
+            const char* symbol;
+            size_t symbol_len = crypto_registry_field(&p, stop, &symbol);
+            const char* digits;
+            size_t digits_len = crypto_registry_field(&p, stop, &digits);
+            const char* name;
+            crypto_registry_field(&p, stop, &name);
+            size_t name_len = (size_t)(stop - name);
+            while (name_len > 0 && (name[name_len - 1] == ' ' || name[name_len - 1] == '\t')) {
+                name_len--;
+            }
+            unsigned decimals;
+            if ((!is_denom && !is_asset) || (is_denom && type_len == 0) || symbol_len == 0 ||
+                !crypto_registry_decimals(digits, digits_len, &decimals)) {
+                status = CRYPTO_REGISTRY_SYNTAX;
+            } else if (is_asset) {
+                status = crypto_register_type_n(symbol, symbol_len, name, name_len, decimals, NULL);
+            } else {
+                type = crypto_get_type_for_symbol_n(type_symbol, type_len);
+                status = crypto_register_denom_n(type, symbol, symbol_len, name, name_len, decimals, NULL);
+            }
+        }
+        if (status != CRYPTO_REGISTRY_OK) {
+            if (error_line != NULL) {
+                *error_line = line;
+            }
+            return status;
+        }
+        p = eol + 1;
+    }
+    return CRYPTO_REGISTRY_OK;
+}
+
+// Register every entry of a registry file; see crypto_registry_load_buffer for the
+// format. Returns CRYPTO_REGISTRY_IO_ERROR with errno set, and error_line 0, if the
+// file cannot be read.
+crypto_registry_status_t crypto_registry_load(const char* path, size_t* error_line) {
+    assert(path != NULL);
+    if (error_line != NULL) {
+        *error_line = 0;
+    }
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        return CRYPTO_REGISTRY_IO_ERROR;
+    }
+    char* data = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    crypto_registry_status_t status = CRYPTO_REGISTRY_OK;
+    for (;;) {
+        if (len == cap) {
+            cap = cap ? cap * 2 : 4096;
+            char* grown = crypto_realloc(data, cap);
+            if (grown == NULL) {
+                status = CRYPTO_REGISTRY_NOMEM;
+                break;
+            }
+            data = grown;
+        }
+        size_t n = fread(data + len, 1, cap - len, f);
+        len += n;
+        if (n == 0) {
+            if (ferror(f)) {
+                status = CRYPTO_REGISTRY_IO_ERROR;
+            }
+            break;
+        }
+    }
+    fclose(f);
+    if (status == CRYPTO_REGISTRY_OK) {
+        status = crypto_registry_load_buffer(data, len, error_line);
+    }
+    crypto_free(data);
+    return status;
+}
+
+// Human-readable description of a registry status
+const char* crypto_registry_status_str(crypto_registry_status_t status) {
+    switch (status) {
+        case CRYPTO_REGISTRY_OK:
+            return "ok";
+        case CRYPTO_REGISTRY_INVALID_SYMBOL:
+            return "invalid symbol";
+        case CRYPTO_REGISTRY_INVALID_NAME:
+            return "invalid name";
+        case CRYPTO_REGISTRY_INVALID_DECIMALS:
+            return "too many decimals";
+        case CRYPTO_REGISTRY_UNKNOWN_TYPE:
+            return "unknown crypto type";
+        case CRYPTO_REGISTRY_CONFLICT:
+            return "symbol already registered with other decimals";
+        case CRYPTO_REGISTRY_FULL:
+            return "registry full";
+        case CRYPTO_REGISTRY_NOMEM:
+            return "out of memory";
+        case CRYPTO_REGISTRY_SYNTAX:
+            return "syntax error";
+        case CRYPTO_REGISTRY_IO_ERROR:
+            return "cannot read file";
+    }
+    return "unknown error";
+}
+
 #endif // CRYPTOMATH2_IMPLEMENTATION
 
 #endif // CRYPTOMATH2_H 
\ No newline at end of file
@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+// Usage:
+//
+// #define CRYPTOMATH_IMPLEMENTATION
+// #include "cryptomath_column.h"
+//
+// crypto_column_t balances;
+// crypto_column_init(&balances, CRYPTO_ETHEREUM);
+// crypto_column_parse(&balances, ETH_DENOM_ETHER, "1.5\n2.25\n-0.75\n", 15, NULL);
+//
+// crypto_val_t total;
+// crypto_init(&total, CRYPTO_ETHEREUM);
+// crypto_column_sum(&balances, &total);
+// crypto_column_sort(&balances);
+// crypto_clear(&total);
+// crypto_column_clear(&balances);
+//
+// A column holds many amounts of one crypto type in structure-of-arrays form:
+// limb k of every element is stored contiguously in plane k, next to a plane of
+// signed limb counts, all in one allocation. Limbs above an element's size are
+// kept zero, so the planes can be reduced with straight loops. The rare value
+// wider than CRYPTO_INLINE_BITS is spilled to a separate mpz_t array; its size
+// entry is CRYPTO_COLUMN_SPILLED and plane 0 holds its spill index.
+
+#ifndef CRYPTOMATH_COLUMN_H
+#define CRYPTOMATH_COLUMN_H
+
+#include "cryptomath.h"
+
+// Size entry marking an element stored in the spill region
+#define CRYPTO_COLUMN_SPILLED INT8_MIN
+
+_Static_assert(CRYPTO_INLINE_LIMBS < INT8_MAX, "column sizes are stored as int8_t");
+
+typedef struct {
+    crypto_type_t crypto_type;  // Type of every element
+    size_t count;               // Number of elements
+    size_t capacity;            // Elements the planes can hold before growing
+    mp_limb_t* limbs;           // CRYPTO_INLINE_LIMBS planes of capacity limbs each
+    int8_t* sizes;              // Signed limb count per element, or CRYPTO_COLUMN_SPILLED
+    mpz_t* spill;               // Values wider than CRYPTO_INLINE_BITS
+    size_t spill_count;         // Number of spilled values
+    size_t spill_capacity;      // Spilled values the spill array can hold
+} crypto_column_t;
+
+void crypto_column_init(crypto_column_t* col, crypto_type_t type);
+void crypto_column_clear(crypto_column_t* col);
+bool crypto_column_reserve(crypto_column_t* col, size_t capacity);
+bool crypto_column_append(crypto_column_t* col, const crypto_val_t* val);
+void crypto_column_get(const crypto_column_t* col, size_t i, crypto_val_t* val);
+crypto_parse_status_t crypto_column_parse(crypto_column_t* col, crypto_denom_t denom, const char* buf, size_t len, size_t* error_pos);
+size_t crypto_column_format(const crypto_column_t* col, crypto_denom_t denom, char* buf, size_t cap);
+void crypto_column_sum(const crypto_column_t* col, crypto_val_t* r);
+bool crypto_column_min(const crypto_column_t* col, crypto_val_t* r);
+bool crypto_column_max(const crypto_column_t* col, crypto_val_t* r);
+bool crypto_column_sort(crypto_column_t* col);
+
+// Begin implementation section
+#ifdef CRYPTOMATH_IMPLEMENTATION
+
+#define CRYPTO_COLUMN_LIMB(col, k, i) ((col)->limbs[(size_t)(k) * (col)->capacity + (i)])
+
+// Two-limb accumulator for the plane sums in crypto_column_sum
+#if GMP_NUMB_BITS == 64
+typedef unsigned __int128 crypto_column_acc_t;
+#else
+typedef uint64_t crypto_column_acc_t;
+#endif
+
+void crypto_column_init(crypto_column_t* col, crypto_type_t type) {
+    assert(col != NULL);
+    assert(crypto_is_valid_type(type));
+    memset(col, 0, sizeof(*col));
+    col->crypto_type = type;
+}
+
+void crypto_column_clear(crypto_column_t* col) {
+    assert(col != NULL);
+    for (size_t i = 0; i < col->spill_count; i++) {
+        mpz_clear(col->spill[i]);
+    }
+    crypto_free(col->limbs);
+    crypto_free(col->spill);
+    crypto_column_init(col, col->crypto_type);
+}
+
+// Grow the planes to hold at least capacity elements. The planes and the sizes
+// share one block, so growing moves every plane to its new stride. Returns false,
+// leaving the column unchanged, if memory ran out.
+bool crypto_column_reserve(crypto_column_t* col, size_t capacity) {
+    assert(col != NULL);
+    if (capacity <= col->capacity) {
+        return true;
+    }
+    if (capacity > SIZE_MAX / (CRYPTO_INLINE_LIMBS * sizeof(mp_limb_t) + sizeof(int8_t))) {
+        return false;
+    }
+    size_t bytes = capacity * (CRYPTO_INLINE_LIMBS * sizeof(mp_limb_t) + sizeof(int8_t));
+    mp_limb_t* limbs = crypto_malloc(bytes);
+    if (limbs == NULL) {
+        return false;
+    }
+    int8_t* sizes = (int8_t*)(limbs + CRYPTO_INLINE_LIMBS * capacity);
+    for (size_t k = 0; k < CRYPTO_INLINE_LIMBS; k++) {
+        if (col->count > 0) {
+            memcpy(limbs + k * capacity, col->limbs + k * col->capacity, col->count * sizeof(mp_limb_t));
+        }
+        memset(limbs + k * capacity + col->count, 0, (capacity - col->count) * sizeof(mp_limb_t));
+    }
+    if (col->count > 0) {
+        memcpy(sizes, col->sizes, col->count);
+    }
+    crypto_free(col->limbs);
+    col->limbs = limbs;
+    col->sizes = sizes;
+    col->capacity = capacity;
+    return true;
+}
+
+// Store z at element i, spilling it when it does not fit inline. Returns false,
+// leaving element i unset, if the spill array cannot grow.
+static bool crypto_column_store(crypto_column_t* col, size_t i, mpz_srcptr z) {
+    mp_size_t n = mpz_size(z);
+    if (n <= CRYPTO_INLINE_LIMBS) {
+        const mp_limb_t* p = mpz_limbs_read(z);
+        for (mp_size_t k = 0; k < CRYPTO_INLINE_LIMBS; k++) {
+            CRYPTO_COLUMN_LIMB(col, k, i) = k < n ? p[k] : 0;
+        }
+        col->sizes[i] = (int8_t)(mpz_sgn(z) < 0 ? -n : n);
+        return true;
+    }
+    if (col->spill_count == col->spill_capacity) {
+        size_t spill_capacity = col->spill_capacity ? 2 * col->spill_capacity : 4;
+        mpz_t* spill = crypto_realloc(col->spill, spill_capacity * sizeof(mpz_t));
+        if (spill == NULL) {
+            return false;
+        }
+        col->spill = spill;
+        col->spill_capacity = spill_capacity;
+    }
+    mpz_init_set(col->spill[col->spill_count], z);
+    for (size_t k = 0; k < CRYPTO_INLINE_LIMBS; k++) {
+        CRYPTO_COLUMN_LIMB(col, k, i) = 0;
+    }
+    CRYPTO_COLUMN_LIMB(col, 0, i) = col->spill_count++;
+    col->sizes[i] = CRYPTO_COLUMN_SPILLED;
+    return true;
+}
+
+// Read-only mpz view of element i; inline elements are gathered into limbs
+static mpz_srcptr crypto_column_view(const crypto_column_t* col, size_t i, mp_limb_t* limbs, mpz_ptr view) {
+    int size = col->sizes[i];
+    if (size == CRYPTO_COLUMN_SPILLED) {
+        return col->spill[CRYPTO_COLUMN_LIMB(col, 0, i)];
+    }
+    int n = size < 0 ? -size : size;
+    for (int k = 0; k < n; k++) {
+        limbs[k] = CRYPTO_COLUMN_LIMB(col, k, i);
+    }
+    return mpz_roinit_n(view, limbs, size);
+}
+
+// Append a copy of val. Returns false, leaving the column unchanged, if memory ran out.
+bool crypto_column_append(crypto_column_t* col, const crypto_val_t* val) {
+    assert(col != NULL);
+    assert(val != NULL);
+    assert(val->crypto_type == col->crypto_type);
+    if (col->count == col->capacity && !crypto_column_reserve(col, col->capacity ? 2 * col->capacity : 64)) {
+        return false;
+    }
+    mpz_t view;
+    if (!crypto_column_store(col, col->count, crypto_view(val, view))) {
+        return false;
+    }
+    col->count++;
+    return true;
+}
+
+// Copy element i into val, which must be of the column's crypto type
+void crypto_column_get(const crypto_column_t* col, size_t i, crypto_val_t* val) {
+    assert(col != NULL);
+    assert(val != NULL);
+    assert(i < col->count);
+    assert(val->crypto_type == col->crypto_type);
+    mp_limb_t limbs[CRYPTO_INLINE_LIMBS];
+    mpz_t view;
+    crypto_set_mpz(val, crypto_column_view(col, i, limbs, view));
+}
+
+// Parse newline-separated decimals in denom and append them. Lines holding only
+// whitespace are skipped, so a trailing newline or CRLF line endings are fine.
+// Parsing stops after len bytes or at a NUL. On failure nothing is appended and,
+// if error_pos is not NULL, it receives the offset of the offending byte in buf,
+// or of the line being stored when memory ran out (CRYPTO_PARSE_NOMEM).
+crypto_parse_status_t crypto_column_parse(crypto_column_t* col, crypto_denom_t denom, const char* buf, size_t len, size_t* error_pos) {
+    assert(col != NULL);
+    assert(crypto_is_valid_denom(denom));
+    assert(buf != NULL);
+    assert(crypto_denom_def(denom)->crypto_type == col->crypto_type);
+
+    size_t start_count = col->count;
+    size_t start_spill = col->spill_count;
+    crypto_parse_status_t status = CRYPTO_PARSE_OK;
+    crypto_val_t val;
+    crypto_init(&val, col->crypto_type);
+
+    size_t line = 0;
+    while (line < len && buf[line] != '\0') {
+        size_t end = line;
+        while (end < len && buf[end] != '\0' && buf[end] != '\n') {
+            end++;
+        }
+        size_t pos;
+        status = crypto_parse_decimal(&val, denom, buf + line, end - line, &pos);
+        if (status == CRYPTO_PARSE_OK && !crypto_column_append(col, &val)) {
+            status = CRYPTO_PARSE_NOMEM;
+            pos = 0;
+        }
+        if (status != CRYPTO_PARSE_OK && status != CRYPTO_PARSE_EMPTY) {
+            if (error_pos != NULL) {
+                *error_pos = line + pos;
+            }
+            break;
+        }
+        status = CRYPTO_PARSE_OK;
+        line = end < len && buf[end] == '\n' ? end + 1 : end;
+    }
+    crypto_clear(&val);
+
+    if (status != CRYPTO_PARSE_OK) {
+        // Roll back to the column as it was
+        for (size_t i = start_spill; i < col->spill_count; i++) {
+            mpz_clear(col->spill[i]);
+        }
+        col->spill_count = start_spill;
+        // The planes are still unallocated if nothing was appended
+        if (col->count > start_count) {
+            for (size_t k = 0; k < CRYPTO_INLINE_LIMBS; k++) {
+                memset(&CRYPTO_COLUMN_LIMB(col, k, start_count), 0, (col->count - start_count) * sizeof(mp_limb_t));
+            }
+        }
+        col->count = start_count;
+    }
+    return status;
+}
+
+// Format every element in denom, each followed by a newline, into buf.
+// Returns the length of the full output, excluding the NUL. As with
+// crypto_format_to, the output is complete and NUL-terminated only when the
+// returned length is less than cap; otherwise the contents of buf are unspecified.
+// Returns CRYPTO_FORMAT_NOMEM if an element wider than CRYPTO_INLINE_BITS could
+// not be formatted.
+size_t crypto_column_format(const crypto_column_t* col, crypto_denom_t denom, char* buf, size_t cap) {
+    assert(col != NULL);
+    assert(crypto_is_valid_denom(denom));
+    assert(crypto_denom_def(denom)->crypto_type == col->crypto_type);
+    assert(buf != NULL || cap == 0);
+
+    crypto_val_t val;
+    crypto_init(&val, col->crypto_type);
+    size_t len = 0;
+    for (size_t i = 0; i < col->count; i++) {
+        crypto_column_get(col, i, &val);
+        size_t room = len < cap ? cap - len : 0;
+        size_t n = crypto_format_to(room ? buf + len : NULL, room, &val, denom);
+        if (n == CRYPTO_FORMAT_NOMEM) {
+            len = CRYPTO_FORMAT_NOMEM;
+            break;
+        }
+        len += n;
+        if (len < cap) {
+            buf[len] = '\n';
+        }
+        len++;
+    }
+    if (len < cap) {
+        buf[len] = '\0';
+    }
+    crypto_clear(&val);
+    return len;
+}
+
+// r = sum of every element
+// Only planes below the widest inline element are read. Each is summed on its own
+// into two-limb accumulators, with negative elements picked out by a mask rather
+// than a branch, and the plane sums are combined once at the end.
+void crypto_column_sum(const crypto_column_t* col, crypto_val_t* r) {
+    assert(col != NULL);
+    assert(r != NULL);
+    assert(r->crypto_type == col->crypto_type);
+
+    int planes = 0;
+    for (size_t i = 0; i < col->count; i++) {
+        int size = col->sizes[i] == CRYPTO_COLUMN_SPILLED ? 0 : col->sizes[i];
+        int n = size < 0 ? -size : size;
+        planes = n > planes ? n : planes;
+    }
+
+    crypto_column_acc_t pos[CRYPTO_INLINE_LIMBS] = { 0 };
+    crypto_column_acc_t neg[CRYPTO_INLINE_LIMBS] = { 0 };
+    for (int k = 0; k < planes; k++) {
+        const mp_limb_t* plane = &CRYPTO_COLUMN_LIMB(col, k, 0);
+        const int8_t* sizes = col->sizes;
+        crypto_column_acc_t all = 0, negative = 0;
+        for (size_t i = 0; i < col->count; i++) {
+            mp_limb_t v = sizes[i] == CRYPTO_COLUMN_SPILLED ? 0 : plane[i];
+            all += v;
+            negative += v & ((mp_limb_t)0 - (mp_limb_t)(sizes[i] < 0));
+        }
+        pos[k] = all - negative;
+        neg[k] = negative;
+    }
+
+    // Plane k contributes its two-limb sum at limb offset k
+    mp_limb_t psum[CRYPTO_INLINE_LIMBS + 2] = { 0 };
+    mp_limb_t nsum[CRYPTO_INLINE_LIMBS + 2] = { 0 };
+    for (size_t k = 0; k < CRYPTO_INLINE_LIMBS; k++) {
+        mp_limb_t p[2] = { (mp_limb_t)pos[k], (mp_limb_t)(pos[k] >> GMP_NUMB_BITS) };
+        mp_limb_t n[2] = { (mp_limb_t)neg[k], (mp_limb_t)(neg[k] >> GMP_NUMB_BITS) };
+        mpn_add(psum + k, psum + k, CRYPTO_INLINE_LIMBS + 2 - k, p, 2);
+        mpn_add(nsum + k, nsum + k, CRYPTO_INLINE_LIMBS + 2 - k, n, 2);
+    }
+
+    if (col->spill_count == 0) {
+        mp_limb_t diff[CRYPTO_INLINE_LIMBS + 2];
+        bool negative = mpn_cmp(psum, nsum, CRYPTO_INLINE_LIMBS + 2) < 0;
+        if (negative) {
+            mpn_sub_n(diff, nsum, psum, CRYPTO_INLINE_LIMBS + 2);
+        } else {
+            mpn_sub_n(diff, psum, nsum, CRYPTO_INLINE_LIMBS + 2);
+        }
+        crypto_store_limbs(r, diff, CRYPTO_INLINE_LIMBS + 2, negative);
+        return;
+    }
+
+    mpz_t pview, nview;
+    mpz_ptr total = crypto_scratch_mpz();
+    mpz_sub(total, mpz_roinit_n(pview, psum, CRYPTO_INLINE_LIMBS + 2), mpz_roinit_n(nview, nsum, CRYPTO_INLINE_LIMBS + 2));
+    for (size_t i = 0; i < col->spill_count; i++) {
+        mpz_add(total, total, col->spill[i]);
+    }
+    crypto_set_mpz(r, total);
+    crypto_scratch_mpz_release(total);
+}
+
+// Compare elements i and j of a column
+static int crypto_column_cmp(const crypto_column_t* col, size_t i, size_t j) {
+    int si = col->sizes[i];
+    int sj = col->sizes[j];
+    if (si != CRYPTO_COLUMN_SPILLED && sj != CRYPTO_COLUMN_SPILLED) {
+        if (si != sj) {
+            return si < sj ? -1 : 1;
+        }
+        for (int k = (si < 0 ? -si : si) - 1; k >= 0; k--) {
+            mp_limb_t a = CRYPTO_COLUMN_LIMB(col, k, i);
+            mp_limb_t b = CRYPTO_COLUMN_LIMB(col, k, j);
+            if (a != b) {
+                return (a < b) == (si < 0) ? 1 : -1;
+            }
+        }
+        return 0;
+    }
+    mp_limb_t li[CRYPTO_INLINE_LIMBS], lj[CRYPTO_INLINE_LIMBS];
+    mpz_t vi, vj;
+    int c = mpz_cmp(crypto_column_view(col, i, li, vi), crypto_column_view(col, j, lj, vj));
+    return (c > 0) - (c < 0);
+}
+
+static bool crypto_column_extreme(const crypto_column_t* col, crypto_val_t* r, int direction) {
+    assert(col != NULL);
+    assert(r != NULL);
+    assert(r->crypto_type == col->crypto_type);
+    if (col->count == 0) {
+        return false;
+    }
+    size_t best = 0;
+    for (size_t i = 1; i < col->count; i++) {
+        if (crypto_column_cmp(col, i, best) == direction) {
+            best = i;
+        }
+    }
+    crypto_column_get(col, best, r);
+    return true;
+}
+
+// Smallest element; returns false, leaving r unchanged, when the column is empty
+bool crypto_column_min(const crypto_column_t* col, crypto_val_t* r) {
+    return crypto_column_extreme(col, r, -1);
+}
+
+// Largest element; returns false, leaving r unchanged, when the column is empty
+bool crypto_column_max(const crypto_column_t* col, crypto_val_t* r) {
+    return crypto_column_extreme(col, r, 1);
+}
+
+// Sort ascending. The order is found with a stable merge sort over element
+// indices, then every plane is gathered into a new block in that order. Spilled
+// elements keep their spill index in plane 0, so the spill region is untouched.
+// Returns false, leaving the column unsorted, if memory ran out.
+bool crypto_column_sort(crypto_column_t* col) {
+    assert(col != NULL);
+    size_t n = col->count;
+    if (n < 2) {
+        return true;
+    }
+    size_t* order = crypto_malloc(2 * n * sizeof(size_t));
+    if (order == NULL) {
+        return false;
+    }
+    size_t* tmp = order + n;
+    for (size_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            size_t a = lo, b = mid, out = lo;
+            while (a < mid && b < hi) {
+                tmp[out++] = crypto_column_cmp(col, order[b], order[a]) < 0 ? order[b++] : order[a++];
+            }
+            while (a < mid) {
+                tmp[out++] = order[a++];
+            }
+            while (b < hi) {
+                tmp[out++] = order[b++];
+            }
+        }
+        size_t* swap = order;
+        order = tmp;
+        tmp = swap;
+    }
+    // order and tmp may have swapped; the block starts at whichever is lower
+    size_t* block = order < tmp ? order : tmp;
+
+    crypto_column_t sorted = *col;
+    sorted.limbs = NULL;
+    sorted.sizes = NULL;
+    sorted.capacity = 0;
+    sorted.count = 0;
+    if (!crypto_column_reserve(&sorted, col->capacity)) {
+        crypto_free(block);
+        return false;
+    }
+    for (size_t k = 0; k < CRYPTO_INLINE_LIMBS; k++) {
+        for (size_t i = 0; i < n; i++) {
+            CRYPTO_COLUMN_LIMB(&sorted, k, i) = CRYPTO_COLUMN_LIMB(col, k, order[i]);
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        sorted.sizes[i] = col->sizes[order[i]];
+    }
+    sorted.count = n;
+    crypto_free(col->limbs);
+    *col = sorted;
+    crypto_free(block);
+    return true;
+}
+
+#endif // CRYPTOMATH_IMPLEMENTATION
+
+#endif // CRYPTOMATH_COLUMN_H
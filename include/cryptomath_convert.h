@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+// Usage:
+//
+// #define CRYPTOMATH_IMPLEMENTATION
+// #include "cryptomath_convert.h"
+//
+// crypto_convert_result_t result;
+// if (crypto_convert(&result, input, input_len, '\n', ETH_DENOM_WEI, ETH_DENOM_ETHER, 0)) {
+//     fwrite(result.output, 1, result.output_len, stdout);
+//     for (size_t i = 0; i < result.error_count; i++) {
+//         fprintf(stderr, "record %zu: %s\n", result.errors[i].record,
+//                 crypto_parse_status_str(result.errors[i].status));
+//     }
+// }
+// crypto_convert_result_clear(&result);
+//
+// Bulk conversion of delimiter-separated amounts between two denominations of the
+// same crypto type. The input is split into chunks on record boundaries, chunks are
+// converted on a pool of threads with the single-pass parser and formatter, and the
+// output is reassembled in input order.
+
+#ifndef CRYPTOMATH_CONVERT_H
+#define CRYPTOMATH_CONVERT_H
+
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "cryptomath.h"
+
+// A record that could not be parsed; its output field is left empty
+typedef struct {
+    size_t record;                 // Zero-based index of the record
+    size_t offset;                 // Byte offset of the record in the input
+    size_t error_pos;              // Byte offset of the offending character in the input
+    crypto_parse_status_t status;  // Why the record was rejected
+} crypto_convert_error_t;
+
+typedef struct {
+    char* output;                    // Converted records, NUL-terminated; from crypto_malloc
+    size_t output_len;               // Length of output, excluding the NUL
+    size_t records;                  // Records read, including rejected ones
+    crypto_convert_error_t* errors;  // Rejected records in input order; from crypto_malloc
+    size_t error_count;
+} crypto_convert_result_t;
+
+bool crypto_convert(crypto_convert_result_t* result, const char* input, size_t len, char delim,
+                    crypto_denom_t from, crypto_denom_t to, unsigned threads);
+void crypto_convert_result_clear(crypto_convert_result_t* result);
+
+// Begin implementation section
+#ifdef CRYPTOMATH_IMPLEMENTATION
+
+// Chunks per thread; more than one evens out chunks that convert at different speeds
+#define CRYPTO_CONVERT_CHUNKS_PER_THREAD 4
+// Inputs smaller than this are converted on the calling thread alone
+#define CRYPTO_CONVERT_MIN_PARALLEL (64 * 1024)
+#define CRYPTO_CONVERT_MAX_THREADS 256
+
+typedef struct {
+    const char* start;               // First byte of the chunk
+    size_t len;                      // Chunk length, ending just after a delimiter or at the end of input
+    char* output;
+    size_t output_len;
+    size_t output_cap;
+    size_t records;
+    crypto_convert_error_t* errors;  // record holds the chunk-local index until reassembly
+    size_t error_count;
+    size_t error_cap;
+    bool failed;                     // An allocation failed
+} crypto_convert_chunk_t;
+
+typedef struct {
+    const char* input;
+    char delim;
+    crypto_denom_t from;
+    crypto_denom_t to;
+    crypto_convert_chunk_t* chunks;
+    size_t chunk_count;
+    atomic_size_t next_chunk;
+} crypto_convert_job_t;
+
+static bool crypto_convert_reserve(crypto_convert_chunk_t* chunk, size_t extra) {
+    if (chunk->output_len + extra <= chunk->output_cap) {
+        return true;
+    }
+    size_t cap = chunk->output_cap ? chunk->output_cap : 256;
+    while (cap < chunk->output_len + extra) {
+        cap *= 2;
+    }
+    char* output = crypto_realloc(chunk->output, cap);
+    if (output == NULL) {
+        return false;
+    }
+    chunk->output = output;
+    chunk->output_cap = cap;
+    return true;
+}
+
+static bool crypto_convert_add_error(crypto_convert_chunk_t* chunk, const crypto_convert_error_t* error) {
+    if (chunk->error_count == chunk->error_cap) {
+        size_t cap = chunk->error_cap ? 2 * chunk->error_cap : 16;
+        crypto_convert_error_t* errors = crypto_realloc(chunk->errors, cap * sizeof(*errors));
+        if (errors == NULL) {
+            return false;
+        }
+        chunk->errors = errors;
+        chunk->error_cap = cap;
+    }
+    chunk->errors[chunk->error_count++] = *error;
+    return true;
+}
+
+// Convert every record of a chunk; each output record is followed by the delimiter
+static void crypto_convert_chunk(const crypto_convert_job_t* job, crypto_convert_chunk_t* chunk) {
+    const char* end = chunk->start + chunk->len;
+    size_t max_len = crypto_format_max_len(job->to);
+    crypto_val_t val;
+    crypto_init(&val, crypto_denom_def(job->from)->crypto_type);
+
+    // Reserve for the common case of output about as long as the input
+    if (!crypto_convert_reserve(chunk, chunk->len + max_len + 1)) {
+        chunk->failed = true;
+    }
+    for (const char* record = chunk->start; record < end && !chunk->failed; chunk->records++) {
+        const char* stop = memchr(record, job->delim, (size_t)(end - record));
+        size_t record_len = stop != NULL ? (size_t)(stop - record) : (size_t)(end - record);
+        size_t pos = 0;
+        crypto_parse_status_t status = crypto_parse_decimal(&val, job->from, record, record_len, &pos);
+        if (status == CRYPTO_PARSE_OK) {
+            if (!crypto_convert_reserve(chunk, max_len + 1)) {
+                chunk->failed = true;
+                break;
+            }
+            size_t n = crypto_format_to(chunk->output + chunk->output_len, chunk->output_cap - chunk->output_len, &val, job->to);
+            if (n == CRYPTO_FORMAT_NOMEM) {
+                chunk->failed = true;
+                break;
+            }
+            if (chunk->output_len + n >= chunk->output_cap) {
+                // Wider than any inline value; grow and format again
+                if (!crypto_convert_reserve(chunk, n + 2)) {
+                    chunk->failed = true;
+                    break;
+                }
+                crypto_format_to(chunk->output + chunk->output_len, chunk->output_cap - chunk->output_len, &val, job->to);
+            }
+            chunk->output_len += n;
+        } else {
+            crypto_convert_error_t error = {
+                .record = chunk->records,
+                .offset = (size_t)(record - job->input),
+                .error_pos = (size_t)(record - job->input) + pos,
+                .status = status
+            };
+            if (!crypto_convert_add_error(chunk, &error) || !crypto_convert_reserve(chunk, 1)) {
+                chunk->failed = true;
+                break;
+            }
+        }
+        chunk->output[chunk->output_len++] = job->delim;
+        record += record_len + 1;
+    }
+    crypto_clear(&val);
+}
+
+static void* crypto_convert_worker(void* arg) {
+    crypto_convert_job_t* job = arg;
+    size_t i;
+    while ((i = atomic_fetch_add(&job->next_chunk, 1)) < job->chunk_count) {
+        crypto_convert_chunk(job, &job->chunks[i]);
+    }
+    return NULL;
+}
+
+// Convert every delim-separated record of input from one denomination to another of
+// the same crypto type, using up to threads threads (0 means one per online core).
+// Records that fail to parse produce an empty output field and an entry in
+// result->errors. A delimiter at the very end of input does not start another
+// record, and the output ends with a delimiter exactly when the input does.
+// Returns false, with result cleared, if memory ran out.
+bool crypto_convert(crypto_convert_result_t* result, const char* input, size_t len, char delim,
+                    crypto_denom_t from, crypto_denom_t to, unsigned threads) {
+    assert(result != NULL);
+    assert(input != NULL || len == 0);
+    assert(crypto_is_valid_denom(from));
+    assert(crypto_is_valid_denom(to));
+    assert(crypto_denom_def(from)->crypto_type == crypto_denom_def(to)->crypto_type);
+
+    memset(result, 0, sizeof(*result));
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (unsigned)cores : 1;
+    }
+    if (threads > CRYPTO_CONVERT_MAX_THREADS) {
+        threads = CRYPTO_CONVERT_MAX_THREADS;
+    }
+    if (len < CRYPTO_CONVERT_MIN_PARALLEL) {
+        threads = 1;
+    }
+
+    // Split on record boundaries into chunks of roughly equal size
+    size_t target = threads * CRYPTO_CONVERT_CHUNKS_PER_THREAD;
+    crypto_convert_job_t job = { .input = input, .delim = delim, .from = from, .to = to };
+    job.chunks = crypto_malloc(target * sizeof(*job.chunks));
+    if (job.chunks == NULL) {
+        return false;
+    }
+    size_t chunk_start = 0;
+    while (chunk_start < len) {
+        size_t chunk_end = chunk_start + (len + target - 1) / target;
+        if (chunk_end >= len || job.chunk_count == target - 1) {
+            chunk_end = len;
+        } else {
+            const char* stop = memchr(input + chunk_end, delim, len - chunk_end);
+            chunk_end = stop != NULL ? (size_t)(stop - input) + 1 : len;
+        }
+        memset(&job.chunks[job.chunk_count], 0, sizeof(*job.chunks));
+        job.chunks[job.chunk_count].start = input + chunk_start;
+        job.chunks[job.chunk_count].len = chunk_end - chunk_start;
+        job.chunk_count++;
+        chunk_start = chunk_end;
+    }
+    atomic_init(&job.next_chunk, 0);
+
+    // The calling thread works too, so a thread that fails to start only costs throughput
+    pthread_t ids[CRYPTO_CONVERT_MAX_THREADS];
+    unsigned started = 0;
+    while (started + 1 < threads && started + 1 < job.chunk_count &&
+           pthread_create(&ids[started], NULL, crypto_convert_worker, &job) == 0) {
+        started++;
+    }
+    crypto_convert_worker(&job);
+    for (unsigned t = 0; t < started; t++) {
+        pthread_join(ids[t], NULL);
+    }
+
+    // Reassemble in input order
+    bool ok = true;
+    for (size_t i = 0; i < job.chunk_count; i++) {
+        ok &= !job.chunks[i].failed;
+        result->output_len += job.chunks[i].output_len;
+        result->error_count += job.chunks[i].error_count;
+    }
+    if (ok) {
+        result->output = crypto_malloc(result->output_len + 1);
+        result->errors = result->error_count ? crypto_malloc(result->error_count * sizeof(*result->errors)) : NULL;
+        ok = result->output != NULL && (result->error_count == 0 || result->errors != NULL);
+    }
+    if (ok) {
+        char* out = result->output;
+        crypto_convert_error_t* err = result->errors;
+        for (size_t i = 0; i < job.chunk_count; i++) {
+            crypto_convert_chunk_t* chunk = &job.chunks[i];
+            if (chunk->output_len > 0) {
+                memcpy(out, chunk->output, chunk->output_len);
+                out += chunk->output_len;
+            }
+            for (size_t e = 0; e < chunk->error_count; e++) {
+                *err = chunk->errors[e];
+                err->record += result->records;
+                err++;
+            }
+            result->records += chunk->records;
+        }
+        if (len > 0 && input[len - 1] != delim) {
+            result->output_len--;
+        }
+        result->output[result->output_len] = '\0';
+    }
+    for (size_t i = 0; i < job.chunk_count; i++) {
+        crypto_free(job.chunks[i].output);
+        crypto_free(job.chunks[i].errors);
+    }
+    crypto_free(job.chunks);
+    if (!ok) {
+        crypto_convert_result_clear(result);
+    }
+    return ok;
+}
+
+void crypto_convert_result_clear(crypto_convert_result_t* result) {
+    assert(result != NULL);
+    crypto_free(result->output);
+    crypto_free(result->errors);
+    memset(result, 0, sizeof(*result));
+}
+
+#endif // CRYPTOMATH_IMPLEMENTATION
+
+#endif // CRYPTOMATH_CONVERT_H
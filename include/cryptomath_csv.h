@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+// Usage:
+//
+// #define CRYPTOMATH_IMPLEMENTATION
+// #include "cryptomath_csv.h"
+//
+// // account,asset,amount,unit
+// crypto_csv_spec_t spec = { .delim = ',', .header = true,
+//                            .amount_column = 2, .symbol_column = 1, .denom_column = 3 };
+// crypto_csv_totals_t totals;
+// crypto_csv_stats_t stats;
+// crypto_csv_totals_init(&totals);
+// if (crypto_csv_sum("reconciliation.csv", &spec, &totals, &stats)) {
+//     printf("ETH total: %s\n", ...crypto_format_to(..., &totals.sum[CRYPTO_ETHEREUM], ETH_DENOM_ETHER)...);
+// }
+// crypto_csv_totals_clear(&totals);
+//
+// Streaming reader for CSV/TSV files with an amount column and a crypto type symbol
+// column, plus an optional denomination column. Files are memory-mapped and amounts
+// are parsed in place from the mapped pages; pages behind the cursor are released as
+// the reader moves on, so memory use stays flat however large the file is. Fields may
+// be wrapped in double quotes, and quoted fields may hold delimiters and newlines.
+
+#ifndef CRYPTOMATH_CSV_H
+#define CRYPTOMATH_CSV_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cryptomath_column.h"
+
+typedef struct {
+    char delim;          // Field delimiter, e.g. ',' or '\t'
+    bool header;         // Skip the first row
+    int amount_column;   // Zero-based column of the amount
+    int symbol_column;   // Zero-based column of the crypto type symbol, e.g. "ETH"
+    int denom_column;    // Zero-based column of the denomination symbol, e.g. "GWEI",
+                         // or -1 when amounts are in the type's own unit
+} crypto_csv_spec_t;
+
+typedef struct {
+    size_t rows;                    // Data rows read, excluding the header
+    size_t rejected;                // Rows skipped because a field was missing or invalid
+    size_t first_rejected_row;      // Zero-based data row of the first rejected row
+    size_t first_rejected_offset;   // Byte offset of the first rejected row
+    const char* first_rejected_reason;
+} crypto_csv_stats_t;
+
+// Called for every accepted row; return false to stop reading
+typedef bool (*crypto_csv_row_fn)(void* ctx, crypto_denom_t denom, const crypto_val_t* amount);
+
+// Per-type totals filled by crypto_csv_sum, indexed by crypto_type_index() (built-in
+// types by their enum value); min and max are only set when count > 0. The arrays
+// grow when rows of a type registered after crypto_csv_totals_init arrive.
+typedef struct {
+    size_t types;        // Entries in each array
+    size_t* count;
+    crypto_val_t* sum;
+    crypto_val_t* min;
+    crypto_val_t* max;
+} crypto_csv_totals_t;
+
+bool crypto_csv_read_buffer(const char* data, size_t len, const crypto_csv_spec_t* spec,
+                            crypto_csv_row_fn fn, void* ctx, crypto_csv_stats_t* stats);
+bool crypto_csv_read(const char* path, const crypto_csv_spec_t* spec,
+                     crypto_csv_row_fn fn, void* ctx, crypto_csv_stats_t* stats);
+bool crypto_csv_totals_init(crypto_csv_totals_t* totals);
+void crypto_csv_totals_clear(crypto_csv_totals_t* totals);
+bool crypto_csv_sum(const char* path, const crypto_csv_spec_t* spec, crypto_csv_totals_t* totals, crypto_csv_stats_t* stats);
+bool crypto_csv_to_column(const char* path, const crypto_csv_spec_t* spec, crypto_column_t* col, crypto_csv_stats_t* stats);
+
+// Begin implementation section
+#ifdef CRYPTOMATH_IMPLEMENTATION
+
+// Mapped pages are released in steps of this many bytes behind the cursor
+#define CRYPTO_CSV_RELEASE_BYTES ((size_t)64 << 20)
+
+typedef struct {
+    const char* start;
+    size_t len;
+} crypto_csv_field_t;
+
+// Split the row at p into fields, keeping the first count of them. Quoted fields are
+// returned without their quotes. Returns the start of the next row.
+static const char* crypto_csv_split(const char* p, const char* end, char delim, crypto_csv_field_t* fields, int count, int* found) {
+    int n = 0;
+    for (;;) {
+        crypto_csv_field_t field;
+        const char* stop;
+        if (p < end && *p == '"') {
+            // Quoted: "" is an escaped quote, and delimiters and newlines are literal
+            const char* q = p + 1;
+            for (;;) {
+                q = memchr(q, '"', (size_t)(end - q));
+                if (q == NULL) {
+                    q = end;
+                    break;
+                }
+                if (q + 1 < end && q[1] == '"') {
+                    q += 2;
+                    continue;
+                }
+                break;
+            }
+            field.start = p + 1;
+            field.len = (size_t)(q - field.start);
+            stop = q < end ? q + 1 : end;
+            while (stop < end && *stop != delim && *stop != '\n') {
+                stop++;
+            }
+        } else {
+            stop = p;
+            while (stop < end && *stop != delim && *stop != '\n') {
+                stop++;
+            }
+            field.start = p;
+            field.len = (size_t)(stop - p);
+        }
+        if (n < count) {
+            fields[n] = field;
+        }
+        n++;
+        if (stop >= end) {
+            *found = n;
+            return end;
+        }
+        if (*stop == '\n') {
+            *found = n;
+            return stop + 1;
+        }
+        p = stop + 1;
+        if (n >= count) {
+            // Past the wanted fields: jump to the end of the row unless a quote
+            // could hide a newline
+            const char* nl = memchr(p, '\n', (size_t)(end - p));
+            const char* row_end = nl != NULL ? nl : end;
+            if (memchr(p, '"', (size_t)(row_end - p)) == NULL) {
+                *found = n + 1;
+                return nl != NULL ? nl + 1 : end;
+            }
+        }
+    }
+}
+
+static void crypto_csv_trim(crypto_csv_field_t* field) {
+    while (field->len > 0 && crypto_is_space(field->start[0])) {
+        field->start++;
+        field->len--;
+    }
+    while (field->len > 0 && crypto_is_space(field->start[field->len - 1])) {
+        field->len--;
+    }
+}
+
+static void crypto_csv_reject(crypto_csv_stats_t* stats, size_t offset, const char* reason) {
+    if (stats->rejected++ == 0) {
+        stats->first_rejected_row = stats->rows;
+        stats->first_rejected_offset = offset;
+        stats->first_rejected_reason = reason;
+    }
+}
+
+// Stream the rows of an in-memory CSV buffer, calling fn for every row whose symbol,
+// denomination and amount are valid. Rows that are not are counted in stats and
+// skipped. When release is true the buffer is a private mapping whose pages may be
+// dropped once read.
+static bool crypto_csv_scan(const char* data, size_t len, const crypto_csv_spec_t* spec,
+                            crypto_csv_row_fn fn, void* ctx, crypto_csv_stats_t* stats, bool release) {
+    assert(spec != NULL);
+    assert(fn != NULL);
+    assert(stats != NULL);
+    assert(spec->amount_column >= 0 && spec->symbol_column >= 0 && spec->denom_column >= -1);
+
+    memset(stats, 0, sizeof(*stats));
+    int count = spec->amount_column;
+    if (spec->symbol_column > count) {
+        count = spec->symbol_column;
+    }
+    if (spec->denom_column > count) {
+        count = spec->denom_column;
+    }
+    count++;
+    crypto_csv_field_t fields_buf[16];
+    crypto_csv_field_t* fields = count <= 16 ? fields_buf : crypto_malloc((size_t)count * sizeof(*fields));
+    if (fields == NULL) {
+        return false;
+    }
+
+    // The symbol column rarely changes from one row to the next, so remember the
+    // last lookup and its result
+    const char* last_symbol = NULL;
+    size_t last_symbol_len = 0;
+    const char* last_unit = NULL;
+    size_t last_unit_len = 0;
+    crypto_denom_t last_denom = DENOM_COUNT;
+    crypto_type_t last_type = CRYPTO_COUNT;
+    // Parsed amounts reuse one value, re-typed only when the row's type changes
+    crypto_val_t amount;
+    bool amount_ready = false;
+
+    const char* p = data;
+    const char* end = data + len;
+    size_t released = 0;
+    long page = sysconf(_SC_PAGESIZE);
+    if (spec->header && p < end) {
+        int found;
+        p = crypto_csv_split(p, end, spec->delim, fields, count, &found);
+    }
+    bool keep_going = true;
+    while (p < end && keep_going) {
+        const char* row = p;
+        int found;
+        p = crypto_csv_split(p, end, spec->delim, fields, count, &found);
+        if (found == 1 && fields[0].len == 0) {
+            continue;  // Blank line
+        }
+        if (found < count) {
+            crypto_csv_reject(stats, (size_t)(row - data), "missing column");
+            stats->rows++;
+            continue;
+        }
+
+        crypto_csv_field_t symbol = fields[spec->symbol_column];
+        crypto_csv_field_t unit = spec->denom_column >= 0 ? fields[spec->denom_column] : symbol;
+        crypto_csv_trim(&symbol);
+        crypto_csv_trim(&unit);
+        if (last_symbol == NULL || symbol.len != last_symbol_len || memcmp(symbol.start, last_symbol, symbol.len) != 0 ||
+            unit.len != last_unit_len || memcmp(unit.start, last_unit, unit.len) != 0) {
+            last_symbol = symbol.start;
+            last_symbol_len = symbol.len;
+            last_unit = unit.start;
+            last_unit_len = unit.len;
+            last_type = crypto_get_type_for_symbol_n(symbol.start, symbol.len);
+            last_denom = last_type == CRYPTO_COUNT ? DENOM_COUNT
+                                                   : crypto_get_denom_for_symbol_n(last_type, unit.start, unit.len);
+        }
+        if (last_type == CRYPTO_COUNT) {
+            crypto_csv_reject(stats, (size_t)(row - data), "unknown crypto type");
+        } else if (last_denom == DENOM_COUNT) {
+            crypto_csv_reject(stats, (size_t)(row - data), "unknown denomination");
+        } else {
+            if (!amount_ready || amount.crypto_type != last_type) {
+                if (amount_ready) {
+                    crypto_clear(&amount);
+                }
+                crypto_init(&amount, last_type);
+                amount_ready = true;
+            }
+            crypto_csv_field_t f = fields[spec->amount_column];
+            crypto_parse_status_t status = crypto_parse_decimal(&amount, last_denom, f.start, f.len, NULL);
+            if (status != CRYPTO_PARSE_OK) {
+                crypto_csv_reject(stats, (size_t)(row - data), crypto_parse_status_str(status));
+            } else {
+                keep_going = fn(ctx, last_denom, &amount);
+            }
+        }
+        stats->rows++;
+
+        // Drop pages that are fully behind the current row; the cached symbol may
+        // point into them, so forget it
+        size_t done = (size_t)(row - data);
+        if (release && done - released >= CRYPTO_CSV_RELEASE_BYTES) {
+            size_t upto = done - done % (size_t)page;
+            madvise((void*)(data + released), upto - released, MADV_DONTNEED);
+            released = upto;
+            last_symbol = NULL;
+        }
+    }
+
+    if (amount_ready) {
+        crypto_clear(&amount);
+    }
+    if (fields != fields_buf) {
+        crypto_free(fields);
+    }
+    return true;
+}
+
+// Stream the rows of an in-memory CSV buffer. Returns false only if memory ran out.
+bool crypto_csv_read_buffer(const char* data, size_t len, const crypto_csv_spec_t* spec,
+                            crypto_csv_row_fn fn, void* ctx, crypto_csv_stats_t* stats) {
+    assert(data != NULL || len == 0);
+    return crypto_csv_scan(data, len, spec, fn, ctx, stats, false);
+}
+
+// Stream the rows of a file through a read-only mapping. Returns false with errno set
+// if the file cannot be opened or mapped.
+bool crypto_csv_read(const char* path, const crypto_csv_spec_t* spec,
+                     crypto_csv_row_fn fn, void* ctx, crypto_csv_stats_t* stats) {
+    assert(path != NULL);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return false;
+    }
+    size_t len = (size_t)st.st_size;
+    if (len == 0) {
+        close(fd);
+        return crypto_csv_scan("", 0, spec, fn, ctx, stats, false);
+    }
+    void* data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+        errno = saved;
+        return false;
+    }
+    madvise(data, len, MADV_SEQUENTIAL);
+    bool ok = crypto_csv_scan(data, len, spec, fn, ctx, stats, true);
+    munmap(data, len);
+    return ok;
+}
+
+// Grow every array of totals to cover the first n type indexes. Returns false, leaving
+// totals usable at its old size, if memory ran out.
+static bool crypto_csv_totals_reserve(crypto_csv_totals_t* totals, size_t n) {
+    if (n <= totals->types) {
+        return true;
+    }
+    // Each array is only replaced once it has grown, so a failure part way leaves
+    // every array at least totals->types long
+    size_t* count = crypto_realloc(totals->count, n * sizeof(*count));
+    if (count == NULL) {
+        return false;
+    }
+    totals->count = count;
+    crypto_val_t** arrays[] = { &totals->sum, &totals->min, &totals->max };
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        crypto_val_t* grown = crypto_realloc(*arrays[i], n * sizeof(**arrays[i]));
+        if (grown == NULL) {
+            return false;
+        }
+        *arrays[i] = grown;
+    }
+    for (size_t i = totals->types; i < n; i++) {
+        crypto_type_t t = crypto_type_at(i);
+        totals->count[i] = 0;
+        crypto_init(&totals->sum[i], t);
+        crypto_init(&totals->min[i], t);
+        crypto_init(&totals->max[i], t);
+    }
+    totals->types = n;
+    return true;
+}
+
+// Set up totals for every type known so far. Returns false if memory ran out;
+// crypto_csv_totals_clear must still be called.
+bool crypto_csv_totals_init(crypto_csv_totals_t* totals) {
+    assert(totals != NULL);
+    totals->types = 0;
+    totals->count = NULL;
+    totals->sum = NULL;
+    totals->min = NULL;
+    totals->max = NULL;
+    return crypto_csv_totals_reserve(totals, crypto_type_count());
+}
+
+void crypto_csv_totals_clear(crypto_csv_totals_t* totals) {
+    assert(totals != NULL);
+    for (size_t i = 0; i < totals->types; i++) {
+        crypto_clear(&totals->sum[i]);
+        crypto_clear(&totals->min[i]);
+        crypto_clear(&totals->max[i]);
+    }
+    crypto_free(totals->count);
+    crypto_free(totals->sum);
+    crypto_free(totals->min);
+    crypto_free(totals->max);
+    totals->types = 0;
+    totals->count = NULL;
+    totals->sum = NULL;
+    totals->min = NULL;
+    totals->max = NULL;
+}
+
+typedef struct {
+    crypto_csv_totals_t* totals;
+    bool nomem;
+} crypto_csv_sum_ctx_t;
+
+static bool crypto_csv_sum_row(void* ctx, crypto_denom_t denom, const crypto_val_t* amount) {
+    crypto_csv_sum_ctx_t* sum_ctx = ctx;
+    crypto_csv_totals_t* totals = sum_ctx->totals;
+    size_t t = crypto_type_index(crypto_denom_def(denom)->crypto_type);
+    if (t >= totals->types && !crypto_csv_totals_reserve(totals, crypto_type_count())) {
+        sum_ctx->nomem = true;
+        return false;
+    }
+    crypto_add(&totals->sum[t], &totals->sum[t], amount);
+    if (totals->count[t]++ == 0) {
+        crypto_set(&totals->min[t], amount);
+        crypto_set(&totals->max[t], amount);
+    } else if (crypto_cmp(amount, &totals->min[t]) < 0) {
+        crypto_set(&totals->min[t], amount);
+    } else if (crypto_cmp(amount, &totals->max[t]) > 0) {
+        crypto_set(&totals->max[t], amount);
+    }
+    return true;
+}
+
+// Add the count, sum, min and max of every accepted row of a file to totals, per type.
+// Returns false if the file cannot be read or memory ran out.
+bool crypto_csv_sum(const char* path, const crypto_csv_spec_t* spec, crypto_csv_totals_t* totals, crypto_csv_stats_t* stats) {
+    assert(totals != NULL);
+    crypto_csv_sum_ctx_t ctx = { totals, false };
+    return crypto_csv_read(path, spec, crypto_csv_sum_row, &ctx, stats) && !ctx.nomem;
+}
+
+typedef struct {
+    crypto_column_t* col;
+    bool nomem;
+} crypto_csv_column_ctx_t;
+
+static bool crypto_csv_column_row(void* ctx, crypto_denom_t denom, const crypto_val_t* amount) {
+    crypto_csv_column_ctx_t* column_ctx = ctx;
+    crypto_column_t* col = column_ctx->col;
+    if (crypto_denom_def(denom)->crypto_type == col->crypto_type && !crypto_column_append(col, amount)) {
+        column_ctx->nomem = true;
+        return false;
+    }
+    return true;
+}
+
+// Append the amount of every accepted row of the column's crypto type to col; rows
+// of other types are read but not appended. Returns false if the file cannot be
+// read or memory ran out.
+bool crypto_csv_to_column(const char* path, const crypto_csv_spec_t* spec, crypto_column_t* col, crypto_csv_stats_t* stats) {
+    assert(col != NULL);
+    crypto_csv_column_ctx_t ctx = { col, false };
+    return crypto_csv_read(path, spec, crypto_csv_column_row, &ctx, stats) && !ctx.nomem;
+}
+
+#endif // CRYPTOMATH_IMPLEMENTATION
+
+#endif // CRYPTOMATH_CSV_H
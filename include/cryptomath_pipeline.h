@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+// Usage:
+//
+// #define CRYPTOMATH_IMPLEMENTATION
+// #include "cryptomath_pipeline.h"
+//
+// crypto_pipeline_config_t config = { .workers = 4, .capacity = 64 };
+// crypto_pipeline_t* p = crypto_pipeline_create(&config);
+//
+// crypto_ingest_item_t items[] = {
+//     { .asset = "ETH", .denom = "GWEI", .text = "1500000000" },
+//     { .asset = "BTC", .denom = "BTC", .text = "0.5" },
+// };
+// crypto_ingest_batch_t batch = { .items = items, .count = 2 };
+// if (!crypto_pipeline_try_submit(p, &batch)) {
+//     // Full: stop reading from the network until completions are collected
+// }
+//
+// // When crypto_pipeline_fd(p) polls readable:
+// crypto_ingest_batch_t* done;
+// while ((done = crypto_pipeline_poll(p)) != NULL) {
+//     for (size_t i = 0; i < done->count; i++) {
+//         if (done->items[i].status == CRYPTO_INGEST_OK) {
+//             // done->items[i].value holds the amount in smallest units
+//             crypto_clear(&done->items[i].value);
+//         }
+//     }
+// }
+// crypto_pipeline_destroy(p);
+//
+// An ingest pipeline parses batches of amounts on a pool of worker threads, so that
+// a thread serving a network event loop only hands batches off and collects them.
+// Submitted batches wait in a bounded lock-free queue. A worker resolves each item's
+// symbols and parses its text with crypto_parse_decimal, whose inline values and
+// per-thread scratch need no allocation for amounts that fit the inline limbs.
+// Completed batches are passed to a callback on the worker thread or, without one,
+// queued for crypto_pipeline_poll behind a file descriptor that polls readable.
+//
+// At most capacity batches are in the pipeline at once, counting those completed
+// but not yet collected, so a consumer that falls behind slows its producers down
+// instead of letting memory grow. The caller owns batches, items and their strings,
+// which must stay valid until the batch is completed.
+
+#ifndef CRYPTOMATH_PIPELINE_H
+#define CRYPTOMATH_PIPELINE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "cryptomath.h"
+
+// Outcome of one item
+typedef enum {
+    CRYPTO_INGEST_OK = 0,          // value holds the amount
+    CRYPTO_INGEST_UNKNOWN_TYPE,    // asset is not a registered crypto type symbol
+    CRYPTO_INGEST_UNKNOWN_DENOM,   // denom is not a denomination of the asset
+    CRYPTO_INGEST_INVALID_AMOUNT   // text is not a decimal; see parse_status and error_pos
+} crypto_ingest_status_t;
+
+typedef struct {
+    const char* asset;               // Crypto type symbol, e.g. "ETH"
+    const char* denom;               // Denomination symbol the text is in, e.g. "GWEI"
+    const char* text;                // Decimal amount
+    size_t len;                      // Bytes of text, or 0 when it is NUL-terminated
+    // Set when the batch is completed
+    crypto_ingest_status_t status;
+    crypto_parse_status_t parse_status;  // Why an invalid amount was rejected
+    size_t error_pos;                    // Offset in text where it was rejected
+    crypto_val_t value;              // Initialized, in smallest units, only when status is OK
+} crypto_ingest_item_t;
+
+typedef struct {
+    crypto_ingest_item_t* items;
+    size_t count;
+    void* user_data;                 // Not used by the pipeline
+    size_t rejected;                 // Set when completed: items whose status is not OK
+} crypto_ingest_batch_t;
+
+// Called on a worker thread for every completed batch
+typedef void (*crypto_ingest_done_fn)(crypto_ingest_batch_t* batch, void* ctx);
+
+typedef struct {
+    unsigned workers;                // Worker threads; 0 for one
+    size_t capacity;                 // Batches in the pipeline at once, rounded up to a
+                                     // power of two; 0 for 64
+    crypto_ingest_done_fn on_complete;  // NULL to collect batches with crypto_pipeline_poll
+    void* ctx;                       // Passed to on_complete
+} crypto_pipeline_config_t;
+
+// A bounded multi-producer, multi-consumer queue of batches. Each cell's sequence
+// number says whether it is free for the push at its position or holds the batch
+// for the pop at its position, so pushes and pops only contend on their own index.
+typedef struct {
+    _Atomic size_t seq;
+    crypto_ingest_batch_t* batch;
+} crypto_ring_cell_t;
+
+typedef struct {
+    crypto_ring_cell_t* cells;
+    size_t mask;                     // Cells minus one; cells is a power of two
+    // Producers and consumers each write one index; keep them on separate cache lines
+    char pad0[64];
+    _Atomic size_t head;             // Next position to pop
+    char pad1[64 - sizeof(size_t)];
+    _Atomic size_t tail;             // Next position to push
+    char pad2[64 - sizeof(size_t)];
+} crypto_ring_t;
+
+typedef struct {
+    crypto_ring_t submitted;         // Batches waiting for a worker
+    crypto_ring_t completed;         // Batches waiting for crypto_pipeline_poll
+    size_t capacity;
+    _Atomic size_t outstanding;      // Batches submitted and not yet collected
+    _Atomic size_t unfinished;       // Batches submitted and not yet completed
+    _Atomic unsigned sleeping;       // Workers waiting on work
+    _Atomic unsigned blocked;        // Producers waiting on space
+    bool stopping;                   // Set under lock by crypto_pipeline_destroy
+    pthread_mutex_t lock;            // Only taken to sleep and to wake sleepers
+    pthread_cond_t work;
+    pthread_cond_t space;
+    pthread_cond_t idle;
+    pthread_t* threads;
+    unsigned thread_count;
+    crypto_ingest_done_fn on_complete;
+    void* ctx;
+    int fds[2];                      // Completion pipe when on_complete is NULL, else -1
+} crypto_pipeline_t;
+
+crypto_pipeline_t* crypto_pipeline_create(const crypto_pipeline_config_t* config);
+void crypto_pipeline_destroy(crypto_pipeline_t* p);
+bool crypto_pipeline_try_submit(crypto_pipeline_t* p, crypto_ingest_batch_t* batch);
+void crypto_pipeline_submit(crypto_pipeline_t* p, crypto_ingest_batch_t* batch);
+int crypto_pipeline_fd(const crypto_pipeline_t* p);
+crypto_ingest_batch_t* crypto_pipeline_poll(crypto_pipeline_t* p);
+void crypto_pipeline_flush(crypto_pipeline_t* p);
+void crypto_ingest_batch_run(crypto_ingest_batch_t* batch);
+
+// Begin implementation section
+#ifdef CRYPTOMATH_IMPLEMENTATION
+
+static bool crypto_ring_init(crypto_ring_t* r, size_t cells) {
+    r->cells = crypto_malloc(cells * sizeof(crypto_ring_cell_t));
+    if (r->cells == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < cells; i++) {
+        atomic_init(&r->cells[i].seq, i);
+        r->cells[i].batch = NULL;
+    }
+    r->mask = cells - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return true;
+}
+
+// False if every cell is taken
+static bool crypto_ring_push(crypto_ring_t* r, crypto_ingest_batch_t* batch) {
+    size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    for (;;) {
+        crypto_ring_cell_t* cell = &r->cells[pos & r->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->batch = batch;
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        }
+    }
+}
+
+// NULL if no cell holds a batch
+static crypto_ingest_batch_t* crypto_ring_pop(crypto_ring_t* r) {
+    size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    for (;;) {
+        crypto_ring_cell_t* cell = &r->cells[pos & r->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                crypto_ingest_batch_t* batch = cell->batch;
+                atomic_store_explicit(&cell->seq, pos + r->mask + 1, memory_order_release);
+                return batch;
+            }
+        } else if (dif < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+}
+
+// Pushes a batch the pipeline has already made room for. The cell can still be in the
+// middle of being released by a pop, so wait for that to finish.
+static void crypto_ring_push_reserved(crypto_ring_t* r, crypto_ingest_batch_t* batch) {
+    while (!crypto_ring_push(r, batch)) {
+        sched_yield();
+    }
+}
+
+// Resolves, parses and scales every item of a batch on the calling thread, setting
+// each item's status and the batch's rejected count. Used by the workers, and usable
+// directly for batches too small to be worth a hand-off.
+void crypto_ingest_batch_run(crypto_ingest_batch_t* batch) {
+    assert(batch != NULL);
+    assert(batch->items != NULL || batch->count == 0);
+    // Batches are usually of one asset and unit, so the previous item's symbols are
+    // compared before the registry is searched
+    const char* last_asset = NULL;
+    const char* last_denom = NULL;
+    crypto_type_t type = CRYPTO_COUNT;
+    crypto_denom_t denom = DENOM_COUNT;
+    size_t rejected = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+        crypto_ingest_item_t* item = &batch->items[i];
+        assert(item->asset != NULL && item->denom != NULL && item->text != NULL);
+        item->parse_status = CRYPTO_PARSE_OK;
+        item->error_pos = 0;
+        if (last_asset == NULL || (item->asset != last_asset && strcmp(item->asset, last_asset) != 0)) {
+            type = crypto_get_type_for_symbol(item->asset);
+            last_asset = item->asset;
+            last_denom = NULL;
+        }
+        if (type == CRYPTO_COUNT) {
+            item->status = CRYPTO_INGEST_UNKNOWN_TYPE;
+            rejected++;
+            continue;
+        }
+        if (last_denom == NULL || (item->denom != last_denom && strcmp(item->denom, last_denom) != 0)) {
+            denom = crypto_get_denom_for_symbol(type, item->denom);
+            last_denom = item->denom;
+        }
+        if (denom == DENOM_COUNT) {
+            item->status = CRYPTO_INGEST_UNKNOWN_DENOM;
+            rejected++;
+            continue;
+        }
+        size_t len = item->len ? item->len : strlen(item->text);
+        crypto_init(&item->value, type);
+        item->parse_status = crypto_parse_decimal(&item->value, denom, item->text, len, &item->error_pos);
+        if (item->parse_status != CRYPTO_PARSE_OK) {
+            crypto_clear(&item->value);
+            item->status = CRYPTO_INGEST_INVALID_AMOUNT;
+            rejected++;
+            continue;
+        }
+        item->status = CRYPTO_INGEST_OK;
+        item->error_pos = 0;
+    }
+    batch->rejected = rejected;
+}
+
+// A batch left the pipeline: wake a producer waiting for room
+static void crypto_pipeline_release(crypto_pipeline_t* p) {
+    atomic_fetch_sub(&p->outstanding, 1);
+    if (atomic_load(&p->blocked) > 0) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_signal(&p->space);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+static void crypto_pipeline_complete(crypto_pipeline_t* p, crypto_ingest_batch_t* batch) {
+    if (p->on_complete != NULL) {
+        p->on_complete(batch, p->ctx);
+        crypto_pipeline_release(p);
+    } else {
+        crypto_ring_push_reserved(&p->completed, batch);
+        // A full pipe is already readable, so a lost byte loses no wakeup
+        ssize_t n = write(p->fds[1], "", 1);
+        (void)n;
+    }
+    if (atomic_fetch_sub(&p->unfinished, 1) == 1) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_broadcast(&p->idle);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+static void* crypto_pipeline_worker(void* arg) {
+    crypto_pipeline_t* p = arg;
+    for (;;) {
+        crypto_ingest_batch_t* batch = crypto_ring_pop(&p->submitted);
+        if (batch == NULL) {
+            // Announce the wait before checking again, so that a producer that pushes
+            // after the check sees the announcement and signals under the lock
+            pthread_mutex_lock(&p->lock);
+            atomic_fetch_add(&p->sleeping, 1);
+            atomic_thread_fence(memory_order_seq_cst);
+            while ((batch = crypto_ring_pop(&p->submitted)) == NULL && !p->stopping) {
+                pthread_cond_wait(&p->work, &p->lock);
+            }
+            atomic_fetch_sub(&p->sleeping, 1);
+            pthread_mutex_unlock(&p->lock);
+            if (batch == NULL) {
+                break;
+            }
+        }
+        crypto_ingest_batch_run(batch);
+        crypto_pipeline_complete(p, batch);
+    }
+    return NULL;
+}
+
+static void crypto_pipeline_free(crypto_pipeline_t* p) {
+    for (int i = 0; i < 2; i++) {
+        if (p->fds[i] >= 0) {
+            close(p->fds[i]);
+        }
+    }
+    pthread_cond_destroy(&p->idle);
+    pthread_cond_destroy(&p->space);
+    pthread_cond_destroy(&p->work);
+    pthread_mutex_destroy(&p->lock);
+    crypto_free(p->threads);
+    crypto_free(p->completed.cells);
+    crypto_free(p->submitted.cells);
+    crypto_free(p);
+}
+
+// Stops the workers once every submitted batch is completed
+static void crypto_pipeline_stop(crypto_pipeline_t* p) {
+    pthread_mutex_lock(&p->lock);
+    p->stopping = true;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+    for (unsigned i = 0; i < p->thread_count; i++) {
+        pthread_join(p->threads[i], NULL);
+    }
+    p->thread_count = 0;
+}
+
+// Start a pipeline and its worker threads. Returns NULL if memory, the completion
+// pipe or a thread could not be had.
+crypto_pipeline_t* crypto_pipeline_create(const crypto_pipeline_config_t* config) {
+    assert(config != NULL);
+    size_t capacity = 1;
+    while (capacity < (config->capacity ? config->capacity : 64)) {
+        capacity *= 2;
+    }
+    unsigned workers = config->workers ? config->workers : 1;
+
+    crypto_pipeline_t* p = crypto_malloc(sizeof(*p));
+    if (p == NULL) {
+        return NULL;
+    }
+    memset(p, 0, sizeof(*p));
+    p->fds[0] = p->fds[1] = -1;
+    p->capacity = capacity;
+    p->on_complete = config->on_complete;
+    p->ctx = config->ctx;
+    atomic_init(&p->outstanding, 0);
+    atomic_init(&p->unfinished, 0);
+    atomic_init(&p->sleeping, 0);
+    atomic_init(&p->blocked, 0);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->space, NULL);
+    pthread_cond_init(&p->idle, NULL);
+
+    // Completed batches are counted as outstanding, so neither ring can overflow
+    bool ok = crypto_ring_init(&p->submitted, capacity) &&
+              (p->on_complete != NULL || crypto_ring_init(&p->completed, capacity));
+    if (ok && p->on_complete == NULL) {
+        ok = pipe(p->fds) == 0;
+        for (int i = 0; ok && i < 2; i++) {
+            ok = fcntl(p->fds[i], F_SETFL, fcntl(p->fds[i], F_GETFL) | O_NONBLOCK) == 0 &&
+                 fcntl(p->fds[i], F_SETFD, FD_CLOEXEC) == 0;
+        }
+    }
+    p->threads = ok ? crypto_malloc(workers * sizeof(pthread_t)) : NULL;
+    for (ok = p->threads != NULL; ok && p->thread_count < workers; p->thread_count++) {
+        ok = pthread_create(&p->threads[p->thread_count], NULL, crypto_pipeline_worker, p) == 0;
+        if (!ok) {
+            break;
+        }
+    }
+    if (!ok) {
+        crypto_pipeline_stop(p);
+        crypto_pipeline_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+// Complete every submitted batch, then stop the workers and free the pipeline.
+// Batches completed but not collected with crypto_pipeline_poll are abandoned to
+// the caller, with their items' statuses set.
+void crypto_pipeline_destroy(crypto_pipeline_t* p) {
+    if (p == NULL) {
+        return;
+    }
+    crypto_pipeline_stop(p);
+    crypto_pipeline_free(p);
+}
+
+// Queue a batch for the workers. Returns false without queueing it if capacity
+// batches are already in the pipeline.
+bool crypto_pipeline_try_submit(crypto_pipeline_t* p, crypto_ingest_batch_t* batch) {
+    assert(p != NULL);
+    assert(batch != NULL);
+    if (atomic_fetch_add(&p->outstanding, 1) >= p->capacity) {
+        crypto_pipeline_release(p);
+        return false;
+    }
+    atomic_fetch_add(&p->unfinished, 1);
+    crypto_ring_push_reserved(&p->submitted, batch);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&p->sleeping) > 0) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_signal(&p->work);
+        pthread_mutex_unlock(&p->lock);
+    }
+    return true;
+}
+
+// Queue a batch for the workers, waiting for room. Without on_complete, room is only
+// made by crypto_pipeline_poll, so it must be called from another thread.
+void crypto_pipeline_submit(crypto_pipeline_t* p, crypto_ingest_batch_t* batch) {
+    while (!crypto_pipeline_try_submit(p, batch)) {
+        pthread_mutex_lock(&p->lock);
+        atomic_fetch_add(&p->blocked, 1);
+        if (atomic_load(&p->outstanding) >= p->capacity) {
+            pthread_cond_wait(&p->space, &p->lock);
+        }
+        atomic_fetch_sub(&p->blocked, 1);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+// A descriptor that polls readable while completed batches wait to be collected, or
+// -1 when completions go to on_complete. It is owned by the pipeline.
+int crypto_pipeline_fd(const crypto_pipeline_t* p) {
+    assert(p != NULL);
+    return p->fds[0];
+}
+
+// The next completed batch, or NULL if none is waiting. The descriptor is reset
+// before looking, so call this until it returns NULL each time the descriptor polls
+// readable.
+crypto_ingest_batch_t* crypto_pipeline_poll(crypto_pipeline_t* p) {
+    assert(p != NULL);
+    assert(p->on_complete == NULL);
+    char drain[64];
+    while (read(p->fds[0], drain, sizeof(drain)) > 0) {
+    }
+    crypto_ingest_batch_t* batch = crypto_ring_pop(&p->completed);
+    if (batch != NULL) {
+        crypto_pipeline_release(p);
+    }
+    return batch;
+}
+
+// Wait until every batch submitted so far has been completed
+void crypto_pipeline_flush(crypto_pipeline_t* p) {
+    assert(p != NULL);
+    pthread_mutex_lock(&p->lock);
+    while (atomic_load(&p->unfinished) > 0) {
+        pthread_cond_wait(&p->idle, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+#endif // CRYPTOMATH_IMPLEMENTATION
+
+#endif // CRYPTOMATH_PIPELINE_H
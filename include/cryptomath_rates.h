@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+// Usage:
+//
+// #define CRYPTOMATH_IMPLEMENTATION
+// #include "cryptomath_rates.h"
+//
+// crypto_rate_table_t rates;
+// crypto_rate_table_init(&rates);
+// crypto_rate_table_set(&rates, BTC_DENOM_BITCOIN, ETH_DENOM_ETHER, "15.25");
+//
+// crypto_val_t btc, eth;
+// crypto_init(&btc, CRYPTO_BITCOIN);
+// crypto_init(&eth, CRYPTO_ETHEREUM);
+// crypto_set_from_decimal(&btc, BTC_DENOM_BITCOIN, "0.5");
+// crypto_value_in(&eth, &btc, &rates, CRYPTO_ROUND_HALF_EVEN);  // 7.625 ETH
+// crypto_clear(&btc);
+// crypto_clear(&eth);
+// crypto_rate_table_clear(&rates);
+//
+// A rate table values amounts of one crypto type in another. Each rate is kept as
+// the reduced ratio num/den of smallest units, parsed once when it is set, so that
+// converting an amount is one multiply and one division by a prepared divisor
+// with a single rounding. Rates are looked up by the pair of types, whatever
+// denominations they were quoted in.
+
+#ifndef CRYPTOMATH_RATES_H
+#define CRYPTOMATH_RATES_H
+
+#include "cryptomath.h"
+
+typedef struct {
+    crypto_type_t from;     // Type of the amounts valued
+    crypto_type_t to;       // Type they are valued in
+    mpz_t num;              // Smallest units of to per den smallest units of from
+    crypto_divisor_t den;   // Positive, and coprime with num
+} crypto_rate_t;
+
+typedef struct {
+    crypto_rate_t* rates;   // Sorted by (from, to)
+    size_t count;           // Number of rates
+    size_t capacity;        // Rates the array can hold before growing
+} crypto_rate_table_t;
+
+void crypto_rate_table_init(crypto_rate_table_t* t);
+void crypto_rate_table_clear(crypto_rate_table_t* t);
+bool crypto_rate_table_set(crypto_rate_table_t* t, crypto_denom_t from, crypto_denom_t to, const char* price);
+const crypto_rate_t* crypto_rate_table_find(const crypto_rate_table_t* t, crypto_type_t from, crypto_type_t to);
+void crypto_rate_apply(crypto_val_t* r, const crypto_val_t* a, const crypto_rate_t* rate, crypto_rounding_t rounding);
+bool crypto_value_in(crypto_val_t* r, const crypto_val_t* a, const crypto_rate_table_t* t, crypto_rounding_t rounding);
+
+// Begin implementation section
+#ifdef CRYPTOMATH_IMPLEMENTATION
+
+void crypto_rate_table_init(crypto_rate_table_t* t) {
+    assert(t != NULL);
+    memset(t, 0, sizeof(*t));
+}
+
+void crypto_rate_table_clear(crypto_rate_table_t* t) {
+    assert(t != NULL);
+    for (size_t i = 0; i < t->count; i++) {
+        mpz_clear(t->rates[i].num);
+        crypto_divisor_clear(&t->rates[i].den);
+    }
+    crypto_free(t->rates);
+    crypto_rate_table_init(t);
+}
+
+// Index of the rate for (from, to), or of where it would be inserted
+static size_t crypto_rate_table_lower_bound(const crypto_rate_table_t* t, crypto_type_t from, crypto_type_t to) {
+    size_t lo = 0, hi = t->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const crypto_rate_t* r = &t->rates[mid];
+        if (r->from < from || (r->from == from && r->to < to)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Set the rate at which amounts of from's type are valued in to's type, replacing
+// any rate for the same pair: one from is worth price to. Returns false, leaving
+// the table unchanged, if price is not a valid non-negative decimal, both
+// denominations are of the same type or memory ran out.
+bool crypto_rate_table_set(crypto_rate_table_t* t, crypto_denom_t from, crypto_denom_t to, const char* price) {
+    assert(t != NULL);
+    assert(crypto_is_valid_denom(from));
+    assert(crypto_is_valid_denom(to));
+    assert(price != NULL);
+    const crypto_denom_def_t* from_def = crypto_denom_def(from);
+    const crypto_denom_def_t* to_def = crypto_denom_def(to);
+    if (from_def->crypto_type == to_def->crypto_type || !crypto_is_valid_decimal(price)) {
+        return false;
+    }
+
+    // price = P / 10^k, so one smallest unit of from is worth P * 10^to_decimals /
+    // 10^(from_decimals + k) smallest units of to
+    mpz_t num, den, g;
+    mpz_inits(num, den, g, NULL);
+    unsigned k = crypto_scale_by_precision(price, &num);
+    if (mpz_sgn(num) < 0) {
+        mpz_clears(num, den, g, NULL);
+        return false;
+    }
+    mpz_mul(num, num, *crypto_pow10(to_def->decimals));
+    mpz_ui_pow_ui(den, 10, from_def->decimals + k);
+    mpz_gcd(g, num, den);
+    mpz_divexact(num, num, g);
+    mpz_divexact(den, den, g);
+
+    size_t i = crypto_rate_table_lower_bound(t, from_def->crypto_type, to_def->crypto_type);
+    crypto_rate_t* rate;
+    if (i < t->count && t->rates[i].from == from_def->crypto_type && t->rates[i].to == to_def->crypto_type) {
+        rate = &t->rates[i];
+        mpz_swap(rate->num, num);
+        crypto_divisor_clear(&rate->den);
+    } else {
+        if (t->count == t->capacity) {
+            size_t capacity = t->capacity ? 2 * t->capacity : 8;
+            crypto_rate_t* rates = crypto_realloc(t->rates, capacity * sizeof(crypto_rate_t));
+            if (rates == NULL) {
+                mpz_clears(num, den, g, NULL);
+                return false;
+            }
+            t->rates = rates;
+            t->capacity = capacity;
+        }
+        // The GMP structs only hold pointers to their limbs, so they move with memmove
+        memmove(&t->rates[i + 1], &t->rates[i], (t->count - i) * sizeof(crypto_rate_t));
+        t->count++;
+        rate = &t->rates[i];
+        rate->from = from_def->crypto_type;
+        rate->to = to_def->crypto_type;
+        mpz_init(rate->num);
+        mpz_swap(rate->num, num);
+    }
+    crypto_divisor_init(&rate->den, den);
+    mpz_clears(num, den, g, NULL);
+    return true;
+}
+
+// The rate for valuing from in to, or NULL if none was set
+const crypto_rate_t* crypto_rate_table_find(const crypto_rate_table_t* t, crypto_type_t from, crypto_type_t to) {
+    assert(t != NULL);
+    size_t i = crypto_rate_table_lower_bound(t, from, to);
+    if (i < t->count && t->rates[i].from == from && t->rates[i].to == to) {
+        return &t->rates[i];
+    }
+    return NULL;
+}
+
+// r = a valued at rate, rounded once to r's smallest unit. a must be of the rate's from
+// type and r of its to type.
+void crypto_rate_apply(crypto_val_t* r, const crypto_val_t* a, const crypto_rate_t* rate, crypto_rounding_t rounding) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(rate != NULL);
+    assert(a->crypto_type == rate->from);
+    assert(r->crypto_type == rate->to);
+    // The product is exact, even when it outgrows the inline limbs
+    crypto_val_t product;
+    crypto_init(&product, rate->to);
+    crypto_mul_raw(&product, a, &rate->num);
+    crypto_div_by(r, &product, &rate->den, rounding);
+    crypto_clear(&product);
+}
+
+// r = a valued in r's crypto type. Amounts already of that type are copied; others
+// use the table's rate for the pair. Returns false, leaving r unchanged, if there
+// is no such rate.
+bool crypto_value_in(crypto_val_t* r, const crypto_val_t* a, const crypto_rate_table_t* t, crypto_rounding_t rounding) {
+    assert(r != NULL);
+    assert(a != NULL);
+    assert(t != NULL);
+    if (a->crypto_type == r->crypto_type) {
+        crypto_set(r, a);
+        return true;
+    }
+    const crypto_rate_t* rate = crypto_rate_table_find(t, a->crypto_type, r->crypto_type);
+    if (rate == NULL) {
+        return false;
+    }
+    crypto_rate_apply(r, a, rate, rounding);
+    return true;
+}
+
+#endif // CRYPTOMATH_IMPLEMENTATION
+
+#endif // CRYPTOMATH_RATES_H
@@ -1,5 +1,5 @@
 # Header-only library files
-LIB_HEADERS = $(INCLUDE_DIR)/cryptomath.h
+LIB_HEADERS = $(INCLUDE_DIR)/cryptomath.h $(INCLUDE_DIR)/cryptomath_column.h $(INCLUDE_DIR)/cryptomath_convert.h $(INCLUDE_DIR)/cryptomath_csv.h $(INCLUDE_DIR)/cryptomath_rates.h $(INCLUDE_DIR)/cryptomath_pipeline.h
 
 # Library object files
 LIB_OBJS = $(addprefix $(BUILD_DIR)/, $(notdir $(LIB_HEADERS:.h=.o)))
@@ -0,0 +1,46 @@
+# Release build of the SQLite extension
+# Objects are built into their own directory with RELEASE_CFLAGS, so the test
+# build is left alone. make release-pgo additionally trains the build on the
+# SQL benchmarks and rebuilds it with the recorded profile (GCC).
+RELEASE_BUILD_DIR = $(BUILD_DIR)/release
+RELEASE_SQLITE_EXT = $(RELEASE_BUILD_DIR)/crypto_decimal_extension.$(EXTENSION_SUFFIX)
+RELEASE_SQLITE_OBJS = $(addprefix $(RELEASE_BUILD_DIR)/, $(notdir $(SQLITE_SRCS:.c=.o)))
+
+# Profile-guided optimization: PGO=generate instruments the build, PGO=use applies
+# the profile collected in RELEASE_PGO_DIR
+RELEASE_PGO_DIR = $(abspath $(BUILD_DIR)/pgo)
+RELEASE_PGO_ROWS ?= 1000000
+ifeq ($(PGO),generate)
+	RELEASE_CFLAGS += -fprofile-generate -fprofile-dir=$(RELEASE_PGO_DIR) -fprofile-update=atomic
+endif
+ifeq ($(PGO),use)
+	RELEASE_CFLAGS += -fprofile-use -fprofile-dir=$(RELEASE_PGO_DIR) -fprofile-partial-training -Wno-missing-profile
+endif
+
+.PHONY: release release-pgo clean-release
+
+release: $(RELEASE_SQLITE_EXT)
+
+$(RELEASE_BUILD_DIR):
+	mkdir -p $(RELEASE_BUILD_DIR)
+
+# -flto defers code generation to this link, where the sources are optimized together
+$(RELEASE_SQLITE_EXT): $(RELEASE_SQLITE_OBJS) $(SQLITE_HEADERS) | $(RELEASE_BUILD_DIR)
+	$(CC) -fPIC $(EXTENSION_FLAGS) $(RELEASE_CFLAGS) $(INCLUDE_FLAGS) -o $@ $(RELEASE_SQLITE_OBJS) $(LDFLAGS)
+
+$(RELEASE_SQLITE_OBJS): $(RELEASE_BUILD_DIR)/%.o: $(SRC_DIR)/%.c $(SQLITE_HEADERS) | $(RELEASE_BUILD_DIR)
+	$(CC) -fPIC $(RELEASE_CFLAGS) $(INCLUDE_FLAGS) -c $< -o $@
+
+# Instrument, train on the SQL benchmarks, then rebuild with the profile
+release-pgo: $(BENCH_SQLITE_TARGET)
+	rm -rf $(RELEASE_BUILD_DIR) $(RELEASE_PGO_DIR)
+	$(MAKE) release PGO=generate
+	BENCH_ROWS=$(RELEASE_PGO_ROWS) ./$(BENCH_SQLITE_TARGET) ./$(RELEASE_SQLITE_EXT) > /dev/null
+	rm -rf $(RELEASE_BUILD_DIR)
+	$(MAKE) release PGO=use
+
+# Clean the release build and its profile
+clean-release:
+	rm -rf $(RELEASE_BUILD_DIR) $(RELEASE_PGO_DIR)
+
+-include $(RELEASE_SQLITE_OBJS:.o=.d)
@@ -1,11 +1,11 @@
 # SQLite extension specific settings
 SQLITE_EXT = $(BUILD_DIR)/crypto_decimal_extension.$(EXTENSION_SUFFIX)
-SQLITE_SRCS = $(SRC_DIR)/crypto_decimal_extension.c $(SRC_DIR)/crypto_get_types.c $(SRC_DIR)/crypto_get_denoms.c
+SQLITE_SRCS = $(SRC_DIR)/crypto_decimal_extension.c $(SRC_DIR)/crypto_get_types.c $(SRC_DIR)/crypto_get_denoms.c $(SRC_DIR)/crypto_sum_all.c $(SRC_DIR)/crypto_stats.c $(SRC_DIR)/crypto_balances.c $(SRC_DIR)/crypto_ledger.c
 SQLITE_OBJS = $(addprefix $(BUILD_DIR)/, $(notdir $(SQLITE_SRCS:.c=.o)))
 SQLITE_DEPS = $(SQLITE_OBJS:.o=.d)
 
 # Header dependencies
-SQLITE_HEADERS = $(INCLUDE_DIR)/cryptomath.h $(INCLUDE_DIR)/cypto_get_types.h $(INCLUDE_DIR)/cypto_get_denoms.h
+SQLITE_HEADERS = $(INCLUDE_DIR)/cryptomath.h $(INCLUDE_DIR)/cryptomath_rates.h $(INCLUDE_DIR)/cypto_get_types.h $(INCLUDE_DIR)/cypto_get_denoms.h $(INCLUDE_DIR)/crypto_sum_all.h $(INCLUDE_DIR)/crypto_stats.h $(INCLUDE_DIR)/crypto_balances.h $(INCLUDE_DIR)/crypto_ledger.h
 
 # Distribution files
 DIST_SQLITE_EXT = $(DIST_DIR)/$(DIST_PACKAGE)/lib/$(notdir $(SQLITE_EXT))
@@ -22,9 +22,9 @@ $(SQLITE_OBJS): $(BUILD_DIR)/%.o: $(SRC_DIR)/%.c $(SQLITE_HEADERS) | $(BUILD_DIR
 clean-sqlite:
 	rm -f $(SQLITE_EXT) $(SQLITE_EXT).dSYM $(SQLITE_OBJS) $(SQLITE_DEPS)
 
-# Prepare SQLite extension for distribution
-dist-sqlite: $(SQLITE_EXT) $(SQLITE_HEADERS)
+# Prepare SQLite extension for distribution; the release build is the one shipped
+dist-sqlite: $(RELEASE_SQLITE_EXT) $(SQLITE_HEADERS)
 	mkdir -p $(DIST_DIR)/$(DIST_PACKAGE)/lib
-	cp $(SQLITE_EXT) $(DIST_DIR)/$(DIST_PACKAGE)/lib/
+	cp $(RELEASE_SQLITE_EXT) $(DIST_DIR)/$(DIST_PACKAGE)/lib/
 
 .PHONY: clean-sqlite 
\ No newline at end of file
@@ -0,0 +1,861 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "crypto_balances.h"
+#include "crypto_ledger.h"
+/*
+** Virtual table module: "crypto_balances"
+** Keeps per-(account, asset) totals of a ledger table and presents one row
+** per pair that had at least one amount:
+**   account     (the ledger's account value, of whatever type it has)
+**   asset TEXT  (crypto type symbol, e.g., "ETH")
+**   balance TEXT (sum of the pair's amounts in the asset's base unit)
+**   count INT   (number of amounts summed)
+**
+** The arguments name the ledger table, which must be in the same schema and
+** have an INTEGER PRIMARY KEY AUTOINCREMENT so that rowids are never reused,
+** then its account, asset, denomination and amount columns.
+** Amounts are summed as by crypto_sum_all: rows with a NULL column or an
+** invalid amount are skipped, and an unknown asset or denomination is an error.
+**
+** Totals as of a checkpoint rowid are kept in the shadow table %_totals, and
+** the checkpoint itself in %_state. A read loads those totals and folds in
+** only the ledger rows after the checkpoint, so its cost grows with the number
+** of pairs and the rows added since, not with the ledger. Writing a command to
+** the hidden command column persists totals:
+**   'checkpoint'  folds the rows after the checkpoint into %_totals
+**   'rebuild'     recomputes %_totals from the whole ledger
+**
+** Nothing checkpoints on its own, and until a checkpoint every read sums all
+** the rows added since the last one: run 'checkpoint' after each batch of
+** ledger inserts, or whenever that many rows are acceptable to fold per read.
+**
+** The checkpoint assumes the ledger is append-only. AUTOINCREMENT keeps new
+** rows above it, but nothing notices a row deleted, updated or inserted with
+** an explicit rowid at or below it: run 'rebuild' after any such write.
+**
+** Usage in SQL:
+**   CREATE VIRTUAL TABLE balances USING crypto_balances(ledger, account, asset, unit, amount);
+**   SELECT account, asset, balance FROM balances WHERE account = 'alice';
+**   INSERT INTO balances(command) VALUES ('checkpoint');
+*/
+
+// Forward declarations
+static int cryptoBalancesCreate(sqlite3 *db, void *pAux,
+                                int argc, const char *const*argv,
+                                sqlite3_vtab **ppVtab, char **pzErr);
+static int cryptoBalancesConnect(sqlite3 *db, void *pAux,
+                                 int argc, const char *const*argv,
+                                 sqlite3_vtab **ppVtab, char **pzErr);
+static int cryptoBalancesDisconnect(sqlite3_vtab *pVtab);
+static int cryptoBalancesDestroy(sqlite3_vtab *pVtab);
+static int cryptoBalancesBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo);
+static int cryptoBalancesOpen(sqlite3_vtab *p, sqlite3_vtab_cursor **ppCursor);
+static int cryptoBalancesClose(sqlite3_vtab_cursor *cur);
+static int cryptoBalancesFilter(sqlite3_vtab_cursor *pCursor, int idxNum,
+                                const char *idxStr, int argc, sqlite3_value **argv);
+static int cryptoBalancesNext(sqlite3_vtab_cursor *pCursor);
+static int cryptoBalancesEof(sqlite3_vtab_cursor *pCursor);
+static int cryptoBalancesColumn(sqlite3_vtab_cursor *pCursor,
+                                sqlite3_context *ctx, int i);
+static int cryptoBalancesRowid(sqlite3_vtab_cursor *pCursor, sqlite_int64 *pRowid);
+static int cryptoBalancesUpdate(sqlite3_vtab *pVtab, int argc, sqlite3_value **argv,
+                                sqlite_int64 *pRowid);
+static int cryptoBalancesRename(sqlite3_vtab *pVtab, const char *zNew);
+static int cryptoBalancesShadowName(const char *zName);
+
+#define UNUSED(x) (void)(x)
+
+/* Column numbers; command is the hidden column written to run a command. */
+#define BALANCES_ACCOUNT 0
+#define BALANCES_ASSET   1
+#define BALANCES_BALANCE 2
+#define BALANCES_COUNT   3
+#define BALANCES_COMMAND 4
+
+/* idxNum bit set when xFilter receives the account to read. */
+#define BALANCES_IDX_ACCOUNT 1
+
+/* Module arguments: ledger table, account, asset, denomination and amount columns. */
+#define BALANCES_NARG 5
+
+typedef struct {
+  sqlite3_vtab base;  /* Base class.  Must be first. */
+  sqlite3 *db;        /* Connection the ledger and shadow tables are read on. */
+  char *zDb;          /* Schema holding the table, its shadows and the ledger. */
+  char *zName;        /* Name of this table; the shadow tables are named after it. */
+  char *azArg[BALANCES_NARG];  /* Ledger table and column names, dequoted. */
+} cryptoBalancesVtab;
+
+/* The totals of one (account, asset) pair. */
+typedef struct {
+  sqlite3_value *pAccount;  /* Owned copy of the account value. */
+  crypto_type_t type;       /* Asset. */
+  crypto_val_t sum;         /* Running sum of the pair's amounts. */
+  sqlite3_int64 count;      /* Amounts summed. */
+  unsigned int hash;        /* Hash of the account and asset. */
+} balanceEntry;
+
+/*
+** The pairs seen so far, in the order they were first seen, with an open
+** addressing index over them. aSlot holds entry indexes plus one, zero for an
+** empty slot, and is kept at most half full.
+*/
+typedef struct {
+  balanceEntry *aEntry;
+  int nEntry;
+  int nAlloc;
+  int *aSlot;
+  int nSlot;          /* Zero or a power of two. */
+} balanceMap;
+
+/* The ledger rowid the persisted totals are current to. */
+typedef struct {
+  bool has;             /* False until a checkpoint has read a ledger row. */
+  sqlite3_int64 rowid;  /* Last ledger rowid folded into %_totals. */
+} balancesState;
+
+/* Cursor structure - holds the totals gathered by the last xFilter. */
+typedef struct {
+  sqlite3_vtab_cursor base;  /* Base class. Must be first. */
+  balanceMap map;            /* Totals per pair. */
+  int iEntry;                /* Entry of the current row. */
+} cryptoBalancesCursor;
+
+static void balanceMapClear(balanceMap *pMap){
+  for (int i = 0; i < pMap->nEntry; i++) {
+    sqlite3_value_free(pMap->aEntry[i].pAccount);
+    crypto_clear(&pMap->aEntry[i].sum);
+  }
+  sqlite3_free(pMap->aEntry);
+  sqlite3_free(pMap->aSlot);
+  memset(pMap, 0, sizeof(*pMap));
+}
+
+/* FNV-1a over the account's storage class and value, then the asset. */
+static unsigned int balanceHash(sqlite3_value *pAccount, crypto_type_t type){
+  unsigned int h = 2166136261u;
+  int eType = sqlite3_value_type(pAccount);
+  const unsigned char *z;
+  int n;
+  sqlite3_int64 i64;
+  double r;
+  switch (eType) {
+    case SQLITE_INTEGER:
+      i64 = sqlite3_value_int64(pAccount);
+      z = (const unsigned char*)&i64;
+      n = (int)sizeof(i64);
+      break;
+    case SQLITE_FLOAT:
+      r = sqlite3_value_double(pAccount);
+      z = (const unsigned char*)&r;
+      n = (int)sizeof(r);
+      break;
+    case SQLITE_BLOB:
+      z = sqlite3_value_blob(pAccount);
+      n = sqlite3_value_bytes(pAccount);
+      break;
+    default:
+      z = sqlite3_value_text(pAccount);
+      n = sqlite3_value_bytes(pAccount);
+      break;
+  }
+  h = (h ^ (unsigned int)eType) * 16777619u;
+  for (int i = 0; i < n; i++) {
+    h = (h ^ z[i]) * 16777619u;
+  }
+  return (h ^ (unsigned int)type) * 16777619u;
+}
+
+/* True if two non-NULL account values have the same storage class and value. */
+static bool balanceAccountEq(sqlite3_value *a, sqlite3_value *b){
+  int eType = sqlite3_value_type(a);
+  if (eType != sqlite3_value_type(b)) return false;
+  switch (eType) {
+    case SQLITE_INTEGER:
+      return sqlite3_value_int64(a) == sqlite3_value_int64(b);
+    case SQLITE_FLOAT:
+      return sqlite3_value_double(a) == sqlite3_value_double(b);
+    case SQLITE_BLOB: {
+      int n = sqlite3_value_bytes(a);
+      return n == sqlite3_value_bytes(b)
+          && (n == 0 || memcmp(sqlite3_value_blob(a), sqlite3_value_blob(b), (size_t)n) == 0);
+    }
+    default: {
+      const unsigned char *za = sqlite3_value_text(a);
+      const unsigned char *zb = sqlite3_value_text(b);
+      int n = sqlite3_value_bytes(a);
+      return n == sqlite3_value_bytes(b) && memcmp(za, zb, (size_t)n) == 0;
+    }
+  }
+}
+
+/* Doubles the index and reinserts every entry. */
+static int balanceMapRehash(balanceMap *pMap){
+  int nSlot = pMap->nSlot ? 2 * pMap->nSlot : 64;
+  int *aSlot = sqlite3_malloc64((sqlite3_uint64)nSlot * sizeof(*aSlot));
+  if (!aSlot) return SQLITE_NOMEM;
+  memset(aSlot, 0, (size_t)nSlot * sizeof(*aSlot));
+  for (int i = 0; i < pMap->nEntry; i++) {
+    unsigned int s = pMap->aEntry[i].hash & (unsigned int)(nSlot - 1);
+    while (aSlot[s]) s = (s + 1) & (unsigned int)(nSlot - 1);
+    aSlot[s] = i + 1;
+  }
+  sqlite3_free(pMap->aSlot);
+  pMap->aSlot = aSlot;
+  pMap->nSlot = nSlot;
+  return SQLITE_OK;
+}
+
+/*
+** Finds the entry for (pAccount, type), adding an empty one if there is none.
+** Sets *ppEntry, which stays valid until the next entry is added.
+*/
+static int balanceMapGet(balanceMap *pMap, sqlite3_value *pAccount, crypto_type_t type,
+                         balanceEntry **ppEntry){
+  if (2 * (pMap->nEntry + 1) > pMap->nSlot) {
+    int rc = balanceMapRehash(pMap);
+    if (rc != SQLITE_OK) return rc;
+  }
+  unsigned int h = balanceHash(pAccount, type);
+  unsigned int mask = (unsigned int)(pMap->nSlot - 1);
+  unsigned int s = h & mask;
+  for (; pMap->aSlot[s]; s = (s + 1) & mask) {
+    balanceEntry *e = &pMap->aEntry[pMap->aSlot[s] - 1];
+    if (e->hash == h && e->type == type && balanceAccountEq(e->pAccount, pAccount)) {
+      *ppEntry = e;
+      return SQLITE_OK;
+    }
+  }
+
+  if (pMap->nEntry == pMap->nAlloc) {
+    int nAlloc = pMap->nAlloc ? 2 * pMap->nAlloc : 32;
+    /* The GMP structs only hold pointers to their limbs, so they move with realloc */
+    balanceEntry *aEntry = sqlite3_realloc64(pMap->aEntry, (sqlite3_uint64)nAlloc * sizeof(*aEntry));
+    if (!aEntry) return SQLITE_NOMEM;
+    pMap->aEntry = aEntry;
+    pMap->nAlloc = nAlloc;
+  }
+  sqlite3_value *pCopy = sqlite3_value_dup(pAccount);
+  if (!pCopy) return SQLITE_NOMEM;
+  balanceEntry *e = &pMap->aEntry[pMap->nEntry];
+  e->pAccount = pCopy;
+  e->type = type;
+  crypto_init(&e->sum, type);
+  e->count = 0;
+  e->hash = h;
+  pMap->aSlot[s] = ++pMap->nEntry;
+  *ppEntry = e;
+  return SQLITE_OK;
+}
+
+/* Copies a module argument, removing surrounding whitespace and quotes. */
+static char *balancesDequote(const char *zArg){
+  while (*zArg == ' ' || *zArg == '\t' || *zArg == '\n' || *zArg == '\r') zArg++;
+  int n = (int)strlen(zArg);
+  while (n > 0 && (zArg[n-1] == ' ' || zArg[n-1] == '\t' || zArg[n-1] == '\n' || zArg[n-1] == '\r')) n--;
+  char q = n >= 2 ? zArg[0] : 0;
+  char close = q == '[' ? ']' : q;
+  if ((q == '"' || q == '\'' || q == '`' || q == '[') && zArg[n-1] == close) {
+    char *z = sqlite3_malloc(n);
+    if (!z) return NULL;
+    int j = 0;
+    for (int i = 1; i < n - 1; i++) {
+      z[j++] = zArg[i];
+      if (zArg[i] == close && q != '[' && zArg[i+1] == close) i++;
+    }
+    z[j] = 0;
+    return z;
+  }
+  return sqlite3_mprintf("%.*s", n, zArg);
+}
+
+static int cryptoBalancesDisconnect(sqlite3_vtab *pVtab){
+  cryptoBalancesVtab *pTab = (cryptoBalancesVtab*)pVtab;
+  sqlite3_free(pTab->zDb);
+  sqlite3_free(pTab->zName);
+  for (int i = 0; i < BALANCES_NARG; i++) {
+    sqlite3_free(pTab->azArg[i]);
+  }
+  sqlite3_free(pTab);
+  return SQLITE_OK;
+}
+
+/* Prepares zSql, which is freed; sets the table's error message on failure. */
+static int balancesPrepare(cryptoBalancesVtab *pTab, char *zSql, sqlite3_stmt **ppStmt){
+  *ppStmt = NULL;
+  if (!zSql) return SQLITE_NOMEM;
+  int rc = sqlite3_prepare_v2(pTab->db, zSql, -1, ppStmt, NULL);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK) {
+    sqlite3_free(pTab->base.zErrMsg);
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: %s", sqlite3_errmsg(pTab->db));
+  }
+  return rc;
+}
+
+/* Runs one statement of zSql, which is freed. */
+static int balancesExec(cryptoBalancesVtab *pTab, char *zSql){
+  if (!zSql) return SQLITE_NOMEM;
+  char *zErr = NULL;
+  int rc = sqlite3_exec(pTab->db, zSql, NULL, NULL, &zErr);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK) {
+    sqlite3_free(pTab->base.zErrMsg);
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: %s", zErr ? zErr : sqlite3_errstr(rc));
+  }
+  sqlite3_free(zErr);
+  return rc;
+}
+
+/*
+** Prepares the scan of the ledger rows, of those after ?1 only if afterRowid
+** and of the account ?2 only if byAccount. The columns are qualified so that
+** a missing one is an error, not a string literal.
+*/
+static int balancesPrepareDelta(cryptoBalancesVtab *pTab, bool afterRowid, bool byAccount,
+                                sqlite3_stmt **ppStmt){
+  const char *zLedger = pTab->azArg[0];
+  char *zFilter = byAccount
+      ? sqlite3_mprintf(" AND \"%w\".\"%w\" = ?2", zLedger, pTab->azArg[1])
+      : sqlite3_mprintf("");
+  if (!zFilter) return SQLITE_NOMEM;
+  int rc = balancesPrepare(pTab, sqlite3_mprintf(
+      "SELECT rowid, \"%w\".\"%w\", \"%w\".\"%w\", \"%w\".\"%w\", \"%w\".\"%w\" "
+      "FROM \"%w\".\"%w\" WHERE %s%s",
+      zLedger, pTab->azArg[1], zLedger, pTab->azArg[2], zLedger, pTab->azArg[3], zLedger, pTab->azArg[4],
+      pTab->zDb, zLedger, afterRowid ? "rowid > ?1" : "1", zFilter), ppStmt);
+  sqlite3_free(zFilter);
+  return rc;
+}
+
+/* Reads the checkpoint into *pState. */
+static int balancesReadState(cryptoBalancesVtab *pTab, balancesState *pState){
+  sqlite3_stmt *pStmt;
+  memset(pState, 0, sizeof(*pState));
+  int rc = balancesPrepare(pTab, sqlite3_mprintf(
+      "SELECT checkpoint FROM \"%w\".\"%w_state\"", pTab->zDb, pTab->zName), &pStmt);
+  if (rc != SQLITE_OK) return rc;
+  if (sqlite3_step(pStmt) == SQLITE_ROW) {
+    pState->has = sqlite3_column_type(pStmt, 0) != SQLITE_NULL;
+    pState->rowid = sqlite3_column_int64(pStmt, 0);
+  }
+  rc = sqlite3_finalize(pStmt);
+  if (rc != SQLITE_OK) {
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: %s", sqlite3_errmsg(pTab->db));
+  }
+  return rc;
+}
+
+/*
+** Adds the persisted totals to the map, of one account only if pAccount is
+** not NULL. The totals are read in (account, asset) order.
+*/
+static int balancesLoadTotals(cryptoBalancesVtab *pTab, balanceMap *pMap, sqlite3_value *pAccount){
+  sqlite3_stmt *pStmt;
+  int rc = balancesPrepare(pTab, sqlite3_mprintf(
+      "SELECT account, asset, total, count FROM \"%w\".\"%w_totals\"%s",
+      pTab->zDb, pTab->zName, pAccount ? " WHERE account = ?1" : ""), &pStmt);
+  if (rc != SQLITE_OK) return rc;
+  if (pAccount) sqlite3_bind_value(pStmt, 1, pAccount);
+
+  while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    const unsigned char *zAsset = sqlite3_column_text(pStmt, 1);
+    const unsigned char *zTotal = sqlite3_column_text(pStmt, 2);
+    crypto_type_t type = zAsset
+        ? crypto_get_type_for_symbol_n((const char*)zAsset, (size_t)sqlite3_column_bytes(pStmt, 1))
+        : CRYPTO_COUNT;
+    if (type == CRYPTO_COUNT || !zTotal) {
+      pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: Invalid crypto type '%s' in totals",
+                                           zAsset ? (const char*)zAsset : "");
+      rc = SQLITE_ERROR;
+      break;
+    }
+    crypto_val_t total;
+    crypto_init(&total, type);
+    if (crypto_parse_decimal(&total, crypto_ledger_denom(type), (const char*)zTotal,
+                             (size_t)sqlite3_column_bytes(pStmt, 2), NULL) != CRYPTO_PARSE_OK) {
+      crypto_clear(&total);
+      pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: corrupt total '%s' in totals", zTotal);
+      rc = SQLITE_CORRUPT_VTAB;
+      break;
+    }
+    balanceEntry *e;
+    rc = balanceMapGet(pMap, sqlite3_column_value(pStmt, 0), type, &e);
+    if (rc != SQLITE_OK) {
+      crypto_clear(&total);
+      break;
+    }
+    crypto_add(&e->sum, &e->sum, &total);
+    e->count += sqlite3_column_int64(pStmt, 3);
+    crypto_clear(&total);
+  }
+  if (rc == SQLITE_DONE) {
+    return sqlite3_finalize(pStmt);
+  }
+  if (!pTab->base.zErrMsg) {
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: %s", sqlite3_errmsg(pTab->db));
+  }
+  sqlite3_finalize(pStmt);
+  return rc;
+}
+
+/*
+** Sums the ledger rows after the checkpoint pFrom into the map, of one account
+** only if pAccount is not NULL, and sets *pTo to the checkpoint after them.
+*/
+static int balancesFoldDelta(cryptoBalancesVtab *pTab, balanceMap *pMap, const balancesState *pFrom,
+                             sqlite3_value *pAccount, balancesState *pTo){
+  sqlite3_stmt *pStmt;
+  *pTo = *pFrom;
+  int rc = balancesPrepareDelta(pTab, pFrom->has, pAccount != NULL, &pStmt);
+  if (rc != SQLITE_OK) return rc;
+  if (pFrom->has) sqlite3_bind_int64(pStmt, 1, pFrom->rowid);
+  if (pAccount) sqlite3_bind_value(pStmt, 2, pAccount);
+
+  crypto_ledger_reader_t reader;
+  crypto_ledger_reader_init(&reader);
+  while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    sqlite3_int64 iRowid = sqlite3_column_int64(pStmt, 0);
+    if (!pTo->has || iRowid > pTo->rowid) pTo->rowid = iRowid;
+    pTo->has = true;
+    if (sqlite3_column_type(pStmt, 1) == SQLITE_NULL) continue;
+    crypto_val_t operand;
+    bool parsed;
+    rc = crypto_ledger_read(&reader, pStmt, 2, "crypto_balances", &operand, &parsed, &pTab->base.zErrMsg);
+    if (rc != SQLITE_OK) break;
+    if (!parsed) continue;
+    balanceEntry *e;
+    rc = balanceMapGet(pMap, sqlite3_column_value(pStmt, 1), operand.crypto_type, &e);
+    if (rc != SQLITE_OK) {
+      crypto_clear(&operand);
+      break;
+    }
+    crypto_add(&e->sum, &e->sum, &operand);
+    e->count++;
+    crypto_clear(&operand);
+  }
+  if (rc == SQLITE_DONE) {
+    return sqlite3_finalize(pStmt);
+  }
+  if (!pTab->base.zErrMsg) {
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: %s", sqlite3_errmsg(pTab->db));
+  }
+  sqlite3_finalize(pStmt);
+  return rc;
+}
+
+/*
+** Shared by xCreate and xConnect. The arguments after the module, schema and
+** table names are the ledger table and its four columns.
+*/
+static int balancesInit(sqlite3 *db, int argc, const char *const*argv,
+                        cryptoBalancesVtab **ppTab, char **pzErr){
+  if (argc != 3 + BALANCES_NARG) {
+    *pzErr = sqlite3_mprintf("crypto_balances: expected (table, account, asset, denomination, amount) arguments");
+    return SQLITE_ERROR;
+  }
+  int rc = sqlite3_declare_vtab(db,
+      "CREATE TABLE x(account, asset TEXT, balance TEXT, count INT, command HIDDEN)");
+  if (rc != SQLITE_OK) {
+    return rc;
+  }
+
+  cryptoBalancesVtab *pNew = (cryptoBalancesVtab*)sqlite3_malloc(sizeof(*pNew));
+  if (!pNew) return SQLITE_NOMEM;
+  memset(pNew, 0, sizeof(*pNew));
+  pNew->db = db;
+  pNew->zDb = sqlite3_mprintf("%s", argv[1]);
+  pNew->zName = sqlite3_mprintf("%s", argv[2]);
+  bool ok = pNew->zDb && pNew->zName;
+  for (int i = 0; i < BALANCES_NARG; i++) {
+    pNew->azArg[i] = balancesDequote(argv[3 + i]);
+    ok = ok && pNew->azArg[i] && pNew->azArg[i][0];
+  }
+  if (!ok) {
+    bool empty = pNew->zDb && pNew->zName;
+    for (int i = 0; i < BALANCES_NARG; i++) empty = empty && pNew->azArg[i];
+    cryptoBalancesDisconnect(&pNew->base);
+    if (!empty) return SQLITE_NOMEM;
+    *pzErr = sqlite3_mprintf("crypto_balances: table and column names must not be empty");
+    return SQLITE_ERROR;
+  }
+  *ppTab = pNew;
+  return SQLITE_OK;
+}
+
+/*
+** Refuses a ledger without AUTOINCREMENT on its INTEGER PRIMARY KEY, whose
+** rowids are reused after its last rows are deleted: a new row could then
+** land under the checkpoint and never be read.
+*/
+static int balancesCheckAutoincrement(cryptoBalancesVtab *pTab){
+  sqlite3_stmt *pStmt;
+  int rc = balancesPrepare(pTab, sqlite3_mprintf(
+      "SELECT name FROM pragma_table_info(%Q, %Q) WHERE pk = 1",
+      pTab->azArg[0], pTab->zDb), &pStmt);
+  if (rc != SQLITE_OK) return rc;
+  int autoinc = 0;
+  if (sqlite3_step(pStmt) == SQLITE_ROW
+      && sqlite3_table_column_metadata(pTab->db, pTab->zDb, pTab->azArg[0],
+                                       (const char*)sqlite3_column_text(pStmt, 0),
+                                       NULL, NULL, NULL, NULL, &autoinc) != SQLITE_OK) {
+    autoinc = 0;
+  }
+  sqlite3_finalize(pStmt);
+  if (!autoinc) {
+    pTab->base.zErrMsg = sqlite3_mprintf(
+        "crypto_balances: %s must have an INTEGER PRIMARY KEY AUTOINCREMENT", pTab->azArg[0]);
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Creates the shadow tables, after checking that the ledger has the columns
+** named and never reuses rowids, with no checkpoint yet.
+*/
+static int cryptoBalancesCreate(
+  sqlite3 *db, void *pAux,
+  int argc, const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pzErr
+){
+  UNUSED(pAux);
+  cryptoBalancesVtab *pTab;
+  int rc = balancesInit(db, argc, argv, &pTab, pzErr);
+  if (rc != SQLITE_OK) return rc;
+
+  sqlite3_stmt *pStmt;
+  rc = balancesPrepareDelta(pTab, true, false, &pStmt);
+  sqlite3_finalize(pStmt);
+  if (rc == SQLITE_OK) rc = balancesCheckAutoincrement(pTab);
+  if (rc == SQLITE_OK) {
+    rc = balancesExec(pTab, sqlite3_mprintf(
+        "CREATE TABLE \"%w\".\"%w_totals\"(account NOT NULL, asset TEXT NOT NULL, "
+        "total TEXT NOT NULL, count INTEGER NOT NULL, PRIMARY KEY(account, asset)) WITHOUT ROWID;"
+        "CREATE TABLE \"%w\".\"%w_state\"(checkpoint INTEGER);"
+        "INSERT INTO \"%w\".\"%w_state\" VALUES (NULL);",
+        pTab->zDb, pTab->zName, pTab->zDb, pTab->zName, pTab->zDb, pTab->zName));
+  }
+  if (rc != SQLITE_OK) {
+    *pzErr = pTab->base.zErrMsg;
+    pTab->base.zErrMsg = NULL;
+    cryptoBalancesDisconnect(&pTab->base);
+    return rc;
+  }
+  *ppVtab = &pTab->base;
+  return SQLITE_OK;
+}
+
+static int cryptoBalancesConnect(
+  sqlite3 *db, void *pAux,
+  int argc, const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pzErr
+){
+  UNUSED(pAux);
+  cryptoBalancesVtab *pTab;
+  int rc = balancesInit(db, argc, argv, &pTab, pzErr);
+  if (rc != SQLITE_OK) return rc;
+  *ppVtab = &pTab->base;
+  return SQLITE_OK;
+}
+
+/* Drops the shadow tables along with the table. */
+static int cryptoBalancesDestroy(sqlite3_vtab *pVtab){
+  cryptoBalancesVtab *pTab = (cryptoBalancesVtab*)pVtab;
+  int rc = balancesExec(pTab, sqlite3_mprintf(
+      "DROP TABLE IF EXISTS \"%w\".\"%w_totals\";"
+      "DROP TABLE IF EXISTS \"%w\".\"%w_state\";",
+      pTab->zDb, pTab->zName, pTab->zDb, pTab->zName));
+  if (rc != SQLITE_OK) return rc;
+  return cryptoBalancesDisconnect(pVtab);
+}
+
+/*
+** account = ? reads the totals of one account through the shadow table's
+** primary key. SQLite still checks the constraint, since the ledger
+** column's affinity may compare differently. Anything else reads every pair.
+*/
+static int cryptoBalancesBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo){
+  UNUSED(pVTab);
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *c = &pIdxInfo->aConstraint[i];
+    if (!c->usable || c->iColumn != BALANCES_ACCOUNT || c->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    if (sqlite3_stricmp(sqlite3_vtab_collation(pIdxInfo, i), "BINARY") != 0) continue;
+    pIdxInfo->aConstraintUsage[i].argvIndex = 1;
+    pIdxInfo->idxNum = BALANCES_IDX_ACCOUNT;
+    pIdxInfo->estimatedCost = (double)10;
+    pIdxInfo->estimatedRows = 10;
+    return SQLITE_OK;
+  }
+  pIdxInfo->estimatedCost = (double)10000;
+  pIdxInfo->estimatedRows = 10000;
+  return SQLITE_OK;
+}
+
+static int cryptoBalancesOpen(sqlite3_vtab *p, sqlite3_vtab_cursor **ppCursor){
+  UNUSED(p);
+  cryptoBalancesCursor *pCur = (cryptoBalancesCursor*)sqlite3_malloc(sizeof(*pCur));
+  if (!pCur) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int cryptoBalancesClose(sqlite3_vtab_cursor *cur){
+  cryptoBalancesCursor *pCur = (cryptoBalancesCursor*)cur;
+  balanceMapClear(&pCur->map);
+  sqlite3_free(pCur);
+  return SQLITE_OK;
+}
+
+/*
+** Loads the persisted totals and folds in the ledger rows after the checkpoint.
+*/
+static int cryptoBalancesFilter(sqlite3_vtab_cursor *pCursor, int idxNum,
+                                const char *idxStr, int argc, sqlite3_value **argv){
+  UNUSED(idxStr);
+  cryptoBalancesCursor *pCur = (cryptoBalancesCursor*)pCursor;
+  cryptoBalancesVtab *pTab = (cryptoBalancesVtab*)pCursor->pVtab;
+  balanceMapClear(&pCur->map);
+  pCur->iEntry = 0;
+  sqlite3_free(pTab->base.zErrMsg);
+  pTab->base.zErrMsg = NULL;
+
+  sqlite3_value *pAccount = (idxNum & BALANCES_IDX_ACCOUNT) && argc == 1 ? argv[0] : NULL;
+  if (pAccount && sqlite3_value_type(pAccount) == SQLITE_NULL) {
+    return SQLITE_OK;
+  }
+  balancesState state, last;
+  int rc = balancesReadState(pTab, &state);
+  if (rc == SQLITE_OK) rc = balancesLoadTotals(pTab, &pCur->map, pAccount);
+  if (rc == SQLITE_OK) rc = balancesFoldDelta(pTab, &pCur->map, &state, pAccount, &last);
+  if (rc != SQLITE_OK) {
+    balanceMapClear(&pCur->map);
+  }
+  return rc;
+}
+
+static int cryptoBalancesNext(sqlite3_vtab_cursor *pCursor){
+  cryptoBalancesCursor *pCur = (cryptoBalancesCursor*)pCursor;
+  pCur->iEntry++;
+  return SQLITE_OK;
+}
+
+static int cryptoBalancesEof(sqlite3_vtab_cursor *pCursor){
+  cryptoBalancesCursor *pCur = (cryptoBalancesCursor*)pCursor;
+  return pCur->iEntry >= pCur->map.nEntry;
+}
+
+static int cryptoBalancesColumn(sqlite3_vtab_cursor *pCursor,
+                                sqlite3_context *ctx, int i){
+  cryptoBalancesCursor *pCur = (cryptoBalancesCursor*)pCursor;
+  const balanceEntry *e = &pCur->map.aEntry[pCur->iEntry];
+
+  switch (i) {
+    case BALANCES_ACCOUNT:
+      sqlite3_result_value(ctx, e->pAccount);
+      break;
+    case BALANCES_ASSET:
+      sqlite3_result_text(ctx, crypto_type_def(e->type)->symbol, -1, SQLITE_STATIC);
+      break;
+    case BALANCES_BALANCE: {
+      char buf[128];
+      int n;
+      char *z = crypto_ledger_format(&e->sum, crypto_ledger_denom(e->type), buf, sizeof(buf), &n);
+      if (!z) return SQLITE_NOMEM;
+      sqlite3_result_text(ctx, z, n, SQLITE_TRANSIENT);
+      if (z != buf) crypto_free(z);
+      break;
+    }
+    case BALANCES_COUNT:
+      sqlite3_result_int64(ctx, e->count);
+      break;
+    default:
+      sqlite3_result_null(ctx);
+      break;
+  }
+  return SQLITE_OK;
+}
+
+static int cryptoBalancesRowid(sqlite3_vtab_cursor *pCursor, sqlite_int64 *pRowid){
+  cryptoBalancesCursor *pCur = (cryptoBalancesCursor*)pCursor;
+  *pRowid = (sqlite_int64)pCur->iEntry;
+  return SQLITE_OK;
+}
+
+/*
+** Folds the ledger rows after the checkpoint into the persisted totals, one
+** read and one write of the shadow table per pair they touch, and moves the
+** checkpoint to the last rowid read. If bRebuild, the totals are recomputed
+** from the whole ledger instead.
+*/
+static int balancesCheckpoint(cryptoBalancesVtab *pTab, bool bRebuild){
+  balancesState state, last;
+  balanceMap map;
+  memset(&map, 0, sizeof(map));
+  int rc = balancesReadState(pTab, &state);
+  if (rc == SQLITE_OK && bRebuild) {
+    memset(&state, 0, sizeof(state));
+    rc = balancesExec(pTab, sqlite3_mprintf(
+        "DELETE FROM \"%w\".\"%w_totals\"", pTab->zDb, pTab->zName));
+  }
+  if (rc == SQLITE_OK) rc = balancesFoldDelta(pTab, &map, &state, NULL, &last);
+  if (rc != SQLITE_OK || (!bRebuild && last.has == state.has && last.rowid == state.rowid)) {
+    balanceMapClear(&map);
+    return rc;
+  }
+
+  sqlite3_stmt *pSelect = NULL, *pWrite = NULL;
+  rc = balancesPrepare(pTab, sqlite3_mprintf(
+      "SELECT total, count FROM \"%w\".\"%w_totals\" WHERE account = ?1 AND asset = ?2",
+      pTab->zDb, pTab->zName), &pSelect);
+  if (rc == SQLITE_OK) {
+    rc = balancesPrepare(pTab, sqlite3_mprintf(
+        "INSERT OR REPLACE INTO \"%w\".\"%w_totals\"(account, asset, total, count) VALUES (?1, ?2, ?3, ?4)",
+        pTab->zDb, pTab->zName), &pWrite);
+  }
+  for (int i = 0; rc == SQLITE_OK && i < map.nEntry; i++) {
+    balanceEntry *e = &map.aEntry[i];
+    crypto_denom_t denom = crypto_ledger_denom(e->type);
+    const char *zAsset = crypto_type_def(e->type)->symbol;
+    sqlite3_bind_value(pSelect, 1, e->pAccount);
+    sqlite3_bind_text(pSelect, 2, zAsset, -1, SQLITE_STATIC);
+    if (sqlite3_step(pSelect) == SQLITE_ROW) {
+      const char *zTotal = (const char*)sqlite3_column_text(pSelect, 0);
+      crypto_val_t total;
+      crypto_init(&total, e->type);
+      if (!zTotal || crypto_parse_decimal(&total, denom, zTotal,
+                                          (size_t)sqlite3_column_bytes(pSelect, 0), NULL) != CRYPTO_PARSE_OK) {
+        pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: corrupt total '%s' in totals",
+                                             zTotal ? zTotal : "");
+        rc = SQLITE_CORRUPT_VTAB;
+      } else {
+        crypto_add(&e->sum, &e->sum, &total);
+        e->count += sqlite3_column_int64(pSelect, 1);
+      }
+      crypto_clear(&total);
+    }
+    int rcSelect = sqlite3_reset(pSelect);
+    if (rc == SQLITE_OK) rc = rcSelect;
+    if (rc != SQLITE_OK) break;
+
+    char buf[128];
+    int n;
+    char *z = crypto_ledger_format(&e->sum, denom, buf, sizeof(buf), &n);
+    if (!z) {
+      rc = SQLITE_NOMEM;
+      break;
+    }
+    sqlite3_bind_value(pWrite, 1, e->pAccount);
+    sqlite3_bind_text(pWrite, 2, zAsset, -1, SQLITE_STATIC);
+    sqlite3_bind_text(pWrite, 3, z, n, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(pWrite, 4, e->count);
+    if (z != buf) crypto_free(z);
+    sqlite3_step(pWrite);
+    rc = sqlite3_reset(pWrite);
+  }
+  if (rc != SQLITE_OK && !pTab->base.zErrMsg) {
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: %s", sqlite3_errmsg(pTab->db));
+  }
+  sqlite3_finalize(pSelect);
+  sqlite3_finalize(pWrite);
+  balanceMapClear(&map);
+
+  if (rc == SQLITE_OK) {
+    char *zRowid = last.has ? sqlite3_mprintf("%lld", last.rowid) : sqlite3_mprintf("NULL");
+    rc = zRowid ? balancesExec(pTab, sqlite3_mprintf(
+        "UPDATE \"%w\".\"%w_state\" SET checkpoint = %s",
+        pTab->zDb, pTab->zName, zRowid)) : SQLITE_NOMEM;
+    sqlite3_free(zRowid);
+  }
+  return rc;
+}
+
+/*
+** The table's rows are derived from the ledger, so the only write accepted is
+** an INSERT of a command into the hidden command column.
+*/
+static int cryptoBalancesUpdate(sqlite3_vtab *pVtab, int argc, sqlite3_value **argv,
+                                sqlite_int64 *pRowid){
+  UNUSED(pRowid);
+  cryptoBalancesVtab *pTab = (cryptoBalancesVtab*)pVtab;
+  sqlite3_free(pTab->base.zErrMsg);
+  pTab->base.zErrMsg = NULL;
+  const char *zCommand = argc == 2 + BALANCES_COMMAND + 1 && sqlite3_value_type(argv[0]) == SQLITE_NULL
+      ? (const char*)sqlite3_value_text(argv[2 + BALANCES_COMMAND])
+      : NULL;
+  if (!zCommand) {
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: %s is derived from %s; write to the ledger instead",
+                                         pTab->zName, pTab->azArg[0]);
+    return SQLITE_ERROR;
+  }
+  if (sqlite3_stricmp(zCommand, "checkpoint") == 0) {
+    return balancesCheckpoint(pTab, false);
+  }
+  if (sqlite3_stricmp(zCommand, "rebuild") == 0) {
+    return balancesCheckpoint(pTab, true);
+  }
+  pTab->base.zErrMsg = sqlite3_mprintf("crypto_balances: unknown command '%s'", zCommand);
+  return SQLITE_ERROR;
+}
+
+/* Renames the shadow tables with the table. */
+static int cryptoBalancesRename(sqlite3_vtab *pVtab, const char *zNew){
+  cryptoBalancesVtab *pTab = (cryptoBalancesVtab*)pVtab;
+  char *zName = sqlite3_mprintf("%s", zNew);
+  if (!zName) return SQLITE_NOMEM;
+  int rc = balancesExec(pTab, sqlite3_mprintf(
+      "ALTER TABLE \"%w\".\"%w_totals\" RENAME TO \"%w_totals\";"
+      "ALTER TABLE \"%w\".\"%w_state\" RENAME TO \"%w_state\";",
+      pTab->zDb, pTab->zName, zNew, pTab->zDb, pTab->zName, zNew));
+  if (rc != SQLITE_OK) {
+    sqlite3_free(zName);
+    return rc;
+  }
+  sqlite3_free(pTab->zName);
+  pTab->zName = zName;
+  return SQLITE_OK;
+}
+
+/* The suffixes of the shadow tables, so that SQLite can protect them. */
+static int cryptoBalancesShadowName(const char *zName){
+  return sqlite3_stricmp(zName, "totals") == 0 || sqlite3_stricmp(zName, "state") == 0;
+}
+
+// The module definition for the virtual table.
+sqlite3_module cryptoBalancesModule = {
+  3,                         /* iVersion      */
+  cryptoBalancesCreate,      /* xCreate       */
+  cryptoBalancesConnect,     /* xConnect      */
+  cryptoBalancesBestIndex,   /* xBestIndex    */
+  cryptoBalancesDisconnect,  /* xDisconnect   */
+  cryptoBalancesDestroy,     /* xDestroy      */
+  cryptoBalancesOpen,        /* xOpen         */
+  cryptoBalancesClose,       /* xClose        */
+  cryptoBalancesFilter,      /* xFilter       */
+  cryptoBalancesNext,        /* xNext         */
+  cryptoBalancesEof,         /* xEof          */
+  cryptoBalancesColumn,      /* xColumn       */
+  cryptoBalancesRowid,       /* xRowid        */
+  cryptoBalancesUpdate,      /* xUpdate       */
+  0,                         /* xBegin        */
+  0,                         /* xSync         */
+  0,                         /* xCommit       */
+  0,                         /* xRollback     */
+  0,                         /* xFindFunction */
+  cryptoBalancesRename,      /* xRename       */
+  0,                         /* xSavepoint    */
+  0,                         /* xRelease      */
+  0,                         /* xRollbackTo   */
+  cryptoBalancesShadowName,  /* xShadowName   */
+  0                          /* xIntegrity    */
+};
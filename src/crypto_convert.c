@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+/*
+  Convert a column of amounts between denominations of one crypto type.
+
+    crypto_convert [-t threads] [-d delimiter] [-q] TYPE FROM TO [FILE]
+
+  Reads FILE (or stdin), writes the converted records to stdout in input order
+  and reports every record that could not be parsed on stderr. Exits with 0 when
+  every record converted, 1 when some were rejected and 2 on usage or I/O errors.
+
+  Example:
+    crypto_convert ETH WEI ETH amounts_wei.txt > amounts_eth.txt
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CRYPTOMATH_IMPLEMENTATION
+#include "cryptomath_convert.h"
+
+static void usage(const char *prog){
+  fprintf(stderr,
+          "usage: %s [-t threads] [-d delimiter] [-q] TYPE FROM TO [FILE]\n"
+          "  -t threads    worker threads (default: one per core)\n"
+          "  -d delimiter  record delimiter, a single character or \\t (default: newline)\n"
+          "  -q            do not report rejected records\n",
+          prog);
+}
+
+/* Read all of f into a malloc'd buffer */
+static char *read_all(FILE *f, size_t *len){
+  size_t cap = 1 << 20;
+  size_t n = 0;
+  char *buf = malloc(cap);
+  if (buf == NULL) return NULL;
+  for (;;) {
+    size_t got = fread(buf + n, 1, cap - n, f);
+    n += got;
+    if (n < cap) {
+      if (ferror(f)) {
+        free(buf);
+        return NULL;
+      }
+      break;
+    }
+    char *grown = realloc(buf, cap * 2);
+    if (grown == NULL) {
+      free(buf);
+      return NULL;
+    }
+    buf = grown;
+    cap *= 2;
+  }
+  *len = n;
+  return buf;
+}
+
+int main(int argc, char **argv){
+  unsigned threads = 0;
+  char delim = '\n';
+  int quiet = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:d:q")) != -1) {
+    switch (opt) {
+      case 't':
+        threads = (unsigned)strtoul(optarg, NULL, 10);
+        break;
+      case 'd':
+        if (strcmp(optarg, "\\t") == 0) {
+          delim = '\t';
+        } else if (strlen(optarg) == 1) {
+          delim = optarg[0];
+        } else {
+          usage(argv[0]);
+          return 2;
+        }
+        break;
+      case 'q':
+        quiet = 1;
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+  if (argc - optind < 3 || argc - optind > 4) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  crypto_type_t type = crypto_get_type_for_symbol(argv[optind]);
+  if (type == CRYPTO_COUNT) {
+    fprintf(stderr, "%s: unknown crypto type '%s'\n", argv[0], argv[optind]);
+    return 2;
+  }
+  crypto_denom_t from = crypto_get_denom_for_symbol(type, argv[optind + 1]);
+  crypto_denom_t to = crypto_get_denom_for_symbol(type, argv[optind + 2]);
+  if (from == DENOM_COUNT || to == DENOM_COUNT) {
+    fprintf(stderr, "%s: unknown denomination '%s' for %s\n", argv[0],
+            from == DENOM_COUNT ? argv[optind + 1] : argv[optind + 2], argv[optind]);
+    return 2;
+  }
+
+  FILE *in = stdin;
+  const char *name = "stdin";
+  if (argc - optind == 4) {
+    name = argv[optind + 3];
+    in = fopen(name, "rb");
+    if (in == NULL) {
+      fprintf(stderr, "%s: %s: %s\n", argv[0], name, strerror(errno));
+      return 2;
+    }
+  }
+  size_t len = 0;
+  char *input = read_all(in, &len);
+  if (in != stdin) fclose(in);
+  if (input == NULL) {
+    fprintf(stderr, "%s: could not read %s\n", argv[0], name);
+    return 2;
+  }
+
+  crypto_convert_result_t result;
+  if (!crypto_convert(&result, input, len, delim, from, to, threads)) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+    free(input);
+    return 2;
+  }
+  int rc = fwrite(result.output, 1, result.output_len, stdout) == result.output_len ? 0 : 2;
+  if (fflush(stdout) != 0) rc = 2;
+  if (!quiet) {
+    for (size_t i = 0; i < result.error_count; i++) {
+      const crypto_convert_error_t *e = &result.errors[i];
+      fprintf(stderr, "%s: record %zu at byte %zu: %s at byte %zu\n", name, e->record + 1,
+              e->offset, crypto_parse_status_str(e->status), e->error_pos);
+    }
+  }
+  if (rc == 0 && result.error_count > 0) rc = 1;
+  crypto_convert_result_clear(&result);
+  free(input);
+  return rc;
+}
@@ -20,14 +20,23 @@
 SQLITE_EXTENSION_INIT1
 #include "cypto_get_types.h"
 #include "cypto_get_denoms.h"
+#include "crypto_sum_all.h"
+#include "crypto_stats.h"
+#include "crypto_balances.h"
 #include <gmp.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#ifdef CRYPTO_STATS
+/* Count which path the library's arithmetic takes */
+#define CRYPTO_STAT_PATH(fast) \
+    CRYPTO_STATS_ADD((fast) ? CRYPTO_STATS_FAST_PATH : CRYPTO_STATS_GMP_FALLBACK, 1)
+#endif
 #define CRYPTOMATH_IMPLEMENTATION
 #include "cryptomath.h"
+#include "cryptomath_rates.h"
 
 typedef enum {
     ARITHMETIC_ADD,
@@ -38,6 +47,16 @@ typedef enum {
     ARITHMETIC_DIV_CEIL
 } crypto_arithmetic_op_t;
 
+/*
+** Every function is a pure function of its arguments, so SQLite may factor
+** calls out of loops, fold literal calls, and use them in expression indexes,
+** generated columns and CHECK constraints, including from untrusted schemas.
+** Registered assets keep that: arguments and blobs name them by symbol, never
+** by their registration-order id, so a result depends only on the symbol and the
+** decimals it was registered with, and those cannot change within a process.
+*/
+#define CRYPTO_FUNC_FLAGS (SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS)
+
 static const char *crypto_arithmetic_op_str[] = {
     "crypto_add",
     "crypto_sub",
@@ -67,6 +86,311 @@ static void result_error_fmt(
   sqlite3_result_error(ctx, buf, -1);
 }
 
+/*
+ * Return a crypto value to the SQL caller as TEXT in the given denom.
+ * The value is formatted straight into a buffer from sqlite3_malloc64() that is
+ * handed over to SQLite, so the result is not copied again. Out of memory, the
+ * result is SQLITE_NOMEM instead.
+ */
+static void result_crypto_text(
+  sqlite3_context    *ctx,    /* The SQLite function context */
+  const crypto_val_t *val,    /* Value to return */
+  crypto_denom_t      denom   /* Denomination to format the value in */
+){
+  size_t cap = crypto_format_max_len(denom) + 1;
+  char *buf = sqlite3_malloc64(cap);
+  if (!buf) {
+    sqlite3_result_error_nomem(ctx);
+    return;
+  }
+  size_t len = crypto_format_to(buf, cap, val, denom);
+  if (len == CRYPTO_FORMAT_NOMEM) {
+    sqlite3_free(buf);
+    sqlite3_result_error_nomem(ctx);
+    return;
+  }
+  if (len >= cap) {
+    /* Only values promoted beyond the inline limbs can be this long */
+    cap = len + 1;
+    char *bigger = sqlite3_realloc64(buf, cap);
+    if (!bigger) {
+      sqlite3_free(buf);
+      sqlite3_result_error_nomem(ctx);
+      return;
+    }
+    buf = bigger;
+    crypto_format_to(buf, cap, val, denom);
+  }
+  sqlite3_result_text64(ctx, buf, len, sqlite3_free, SQLITE_UTF8);
+}
+
+/*
+ * Return a crypto value to the SQL caller as a BLOB in the crypto_to_blob
+ * encoding. The result is SQLITE_TOOBIG instead if the value is too large to
+ * encode, and SQLITE_NOMEM out of memory.
+ */
+static void result_crypto_blob(
+  sqlite3_context    *ctx,    /* The SQLite function context */
+  const crypto_val_t *val     /* Value to return */
+){
+  unsigned char buf[CRYPTO_BLOB_INLINE_MAX];
+  size_t len = crypto_to_blob(buf, sizeof(buf), val);
+  if (len == 0) {
+    sqlite3_result_error_toobig(ctx);
+    return;
+  }
+  if (len <= sizeof(buf)) {
+    sqlite3_result_blob64(ctx, buf, len, SQLITE_TRANSIENT);
+    return;
+  }
+  /* Only values promoted beyond the inline limbs take this path */
+  unsigned char *big = sqlite3_malloc64(len);
+  if (!big) {
+    sqlite3_result_error_nomem(ctx);
+    return;
+  }
+  crypto_to_blob(big, len, val);
+  sqlite3_result_blob64(ctx, big, len, sqlite3_free);
+}
+
+/*
+ * Return a crypto value as TEXT in the given denom, or as a BLOB when the
+ * operands came in as BLOBs.
+ */
+static void result_crypto_value(
+  sqlite3_context    *ctx,    /* The SQLite function context */
+  const crypto_val_t *val,    /* Value to return */
+  crypto_denom_t      denom,  /* Denomination for TEXT results */
+  bool                as_blob /* Return the crypto_to_blob encoding */
+){
+  if (as_blob) {
+    result_crypto_blob(ctx, val);
+  } else {
+    result_crypto_text(ctx, val, denom);
+  }
+}
+
+/* True if an amount argument is in the binary crypto_to_blob encoding */
+static bool is_blob_operand(sqlite3_value *arg){
+  return sqlite3_value_type(arg) == SQLITE_BLOB;
+}
+
+/*
+ * Fetch an amount argument. BLOBs are returned as-is: asking SQLite for the
+ * text of a BLOB would make sqlite3_value_type() report it as TEXT afterwards.
+ */
+static const unsigned char *operand_arg(sqlite3_value *arg){
+  if (is_blob_operand(arg)) {
+    return (const unsigned char *)sqlite3_value_blob(arg);
+  }
+  return sqlite3_value_text(arg);
+}
+
+/*
+** Decimal operands parsed recently on this thread, so that a cell used by
+** several functions of one row, or a literal repeated on every row, is
+** parsed once. The table is direct-mapped on a hash of the text and the
+** denom, and an entry only answers for the exact bytes it was parsed from;
+** only successful parses of inline values are kept.
+**
+** The memo is thread-local rather than per connection or per statement. A
+** parse depends only on the text and the denom, and a denom's decimals cannot
+** change once it is registered in the process, so an entry is just as valid in
+** another statement or connection. Looking the memo up in connection client
+** data would mean a search by name on every call, about what a hit saves, and
+** functions never run concurrently on one thread, so the table needs no lock.
+*/
+#define OPERAND_MEMO_SIZE     64   /* Entries; a power of two */
+#define OPERAND_MEMO_TEXT_MAX 48   /* Longer operands are parsed every time */
+
+typedef struct operand_memo_t {
+  crypto_denom_t  denom;                            /* Denom the text was parsed in */
+  int             n;                                /* Length of text; 0 for an empty slot */
+  int             size;                             /* Signed limb count of the value */
+  mp_limb_t       limbs[CRYPTO_INLINE_LIMBS];       /* Inline magnitude of the value */
+  char            text[OPERAND_MEMO_TEXT_MAX];      /* The operand the value was parsed from */
+} operand_memo_t;
+
+static _Thread_local operand_memo_t operand_memo[OPERAND_MEMO_SIZE];
+
+/*
+** Slot of an operand: a multiplicative hash of its first and last eight
+** bytes, length and denom. Entries compare the full text, so a weak spread
+** only costs hits; it has to be cheaper than the parse a miss is about to do.
+*/
+static unsigned operand_memo_slot(const char *str, size_t len, crypto_denom_t denom){
+  uint64_t head = 0, tail = 0;
+  if (len >= 8) {
+    memcpy(&head, str, 8);
+    memcpy(&tail, str + len - 8, 8);
+  } else {
+    memcpy(&head, str, len);
+  }
+  uint64_t h = (head ^ (tail << 29 | tail >> 35) ^ ((uint64_t)denom << 40 | len)) * 0x9E3779B97F4A7C15ull;
+  return (unsigned)(h >> 58) & (OPERAND_MEMO_SIZE - 1);
+}
+
+/*
+** Parse a decimal operand like crypto_parse_decimal(), answering from the
+** memo when the same text was last parsed in the same denom.
+*/
+static crypto_parse_status_t parse_decimal_memo(
+  crypto_val_t   *val,     /* Receives the parsed value; inline and of denom's type */
+  crypto_denom_t  denom,   /* Denomination the operand is expressed in */
+  const char     *str,     /* Text of the operand */
+  size_t          len,     /* Length of str in bytes */
+  size_t         *pos      /* Receives the error offset; may be NULL */
+){
+  if (len == 0 || len > OPERAND_MEMO_TEXT_MAX || val->is_big) {
+    return crypto_parse_decimal(val, denom, str, len, pos);
+  }
+  operand_memo_t *m = &operand_memo[operand_memo_slot(str, len, denom)];
+  if (m->n == (int)len && m->denom == denom && memcmp(m->text, str, len) == 0) {
+    CRYPTO_STATS_ADD(CRYPTO_STATS_MEMO_HITS, 1);
+    val->size = m->size;
+    memcpy(val->limbs, m->limbs, sizeof(val->limbs));
+    return CRYPTO_PARSE_OK;
+  }
+  CRYPTO_STATS_ADD(CRYPTO_STATS_MEMO_MISSES, 1);
+  crypto_parse_status_t status = crypto_parse_decimal(val, denom, str, len, pos);
+  if (status == CRYPTO_PARSE_OK && !val->is_big) {
+    m->denom = denom;
+    m->n = (int)len;
+    m->size = val->size;
+    memcpy(m->limbs, val->limbs, sizeof(m->limbs));
+    memcpy(m->text, str, len);
+  }
+  return status;
+}
+
+/*
+ * Validate and parse an operand in one pass. TEXT operands are decimals in
+ * denom; BLOB operands are crypto_to_blob encodings, which carry smallest units
+ * and must be of the same crypto type as val.
+ * On failure a positioned error is reported back to the SQL caller.
+ */
+static bool parse_operand(
+  sqlite3_context *ctx,    /* The SQLite function context */
+  sqlite3_value   *arg,    /* The operand; its text must already have been fetched */
+  crypto_denom_t   denom,  /* Denomination the operand is expressed in */
+  crypto_val_t    *val,    /* Receives the parsed value */
+  const char      *fn,     /* Function name for error messages */
+  const char      *which   /* "first" or "second" */
+){
+  if (is_blob_operand(arg)) {
+    if (!crypto_from_blob(val, sqlite3_value_blob(arg), (size_t)sqlite3_value_bytes(arg))) {
+      CRYPTO_STATS_ADD(CRYPTO_STATS_PARSE_FAILURES, 1);
+      result_error_fmt(ctx, "%s: Invalid crypto blob for %s operand", fn, which);
+      return false;
+    }
+    return true;
+  }
+  const char *str = (const char*)sqlite3_value_text(arg);
+  size_t pos = 0;
+  crypto_parse_status_t status = parse_decimal_memo(val, denom, str, (size_t)sqlite3_value_bytes(arg), &pos);
+  if (status != CRYPTO_PARSE_OK) {
+    CRYPTO_STATS_ADD(CRYPTO_STATS_PARSE_FAILURES, 1);
+    result_error_fmt(ctx, "%s: Invalid decimal format for %s operand (%s at offset %d)",
+                     fn, which, crypto_parse_status_str(status), (int)pos);
+    return false;
+  }
+  return true;
+}
+
+/*
+** Resolved symbol remembered for one argument of a statement via
+** sqlite3_set_auxdata(). SQLite discards auxdata when a scalar argument is
+** not constant, but aggregate steps keep it across rows, so the symbol bytes
+** are kept too and every hit is checked against the current row.
+*/
+typedef struct symbol_cache_t {
+  crypto_type_t   type;       /* Resolved type, or the type a denom was resolved under */
+  crypto_denom_t  denom;      /* Resolved denom; DENOM_COUNT for a type argument */
+  int             n;          /* Length of symbol in bytes */
+  char            symbol[];   /* The symbol the entry was resolved from */
+} symbol_cache_t;
+
+static const symbol_cache_t *symbol_cache_get(
+  sqlite3_context *ctx,    /* The SQLite function context */
+  int              i,      /* Index of the argument */
+  const char      *str,    /* Text of the argument */
+  int              n       /* Length of str in bytes */
+){
+  const symbol_cache_t *c = (const symbol_cache_t *)sqlite3_get_auxdata(ctx, i);
+  if (c && c->n == n && memcmp(c->symbol, str, n) == 0) {
+    CRYPTO_STATS_ADD(CRYPTO_STATS_AUXDATA_HITS, 1);
+    return c;
+  }
+  CRYPTO_STATS_ADD(CRYPTO_STATS_AUXDATA_MISSES, 1);
+  return NULL;
+}
+
+static void symbol_cache_set(
+  sqlite3_context *ctx,    /* The SQLite function context */
+  int              i,      /* Index of the argument */
+  const char      *str,    /* Text of the argument */
+  int              n,      /* Length of str in bytes */
+  crypto_type_t    type,   /* Resolved type */
+  crypto_denom_t   denom   /* Resolved denom, or DENOM_COUNT */
+){
+  symbol_cache_t *c = sqlite3_malloc64(sizeof(*c) + (sqlite3_uint64)n);
+  if (!c) {
+    return;  /* Caching is an optimisation only */
+  }
+  c->type = type;
+  c->denom = denom;
+  c->n = n;
+  memcpy(c->symbol, str, n);
+  /* SQLite frees c right away if it cannot keep it, so c is not used afterwards */
+  sqlite3_set_auxdata(ctx, i, c, sqlite3_free);
+}
+
+/*
+** Resolve argument i as a crypto type symbol, reusing the statement's cached
+** result when the argument has not changed. Returns CRYPTO_COUNT if unknown.
+*/
+static crypto_type_t resolve_type_arg(
+  sqlite3_context *ctx,    /* The SQLite function context */
+  sqlite3_value  **argv,   /* Function arguments */
+  int              i       /* Index of the type argument */
+){
+  const char *str = (const char *)sqlite3_value_text(argv[i]);
+  int n = sqlite3_value_bytes(argv[i]);
+  const symbol_cache_t *c = symbol_cache_get(ctx, i, str, n);
+  if (c) {
+    return c->type;
+  }
+  crypto_type_t type = crypto_get_type_for_symbol_n(str, (size_t)n);
+  if (type != CRYPTO_COUNT) {
+    symbol_cache_set(ctx, i, str, n, type, DENOM_COUNT);
+  }
+  return type;
+}
+
+/*
+** Resolve argument i as a denom symbol of the given type, reusing the
+** statement's cached result when neither has changed. Returns DENOM_COUNT if
+** unknown.
+*/
+static crypto_denom_t resolve_denom_arg(
+  sqlite3_context *ctx,    /* The SQLite function context */
+  sqlite3_value  **argv,   /* Function arguments */
+  int              i,      /* Index of the denom argument */
+  crypto_type_t    type    /* Type the denom belongs to */
+){
+  const char *str = (const char *)sqlite3_value_text(argv[i]);
+  int n = sqlite3_value_bytes(argv[i]);
+  const symbol_cache_t *c = symbol_cache_get(ctx, i, str, n);
+  if (c && c->type == type) {
+    return c->denom;
+  }
+  crypto_denom_t denom = crypto_get_denom_for_symbol_n(type, str, (size_t)n);
+  if (denom != DENOM_COUNT) {
+    symbol_cache_set(ctx, i, str, n, type, denom);
+  }
+  return denom;
+}
+
 //-----------------------------
 // crypto_addsub_sqlite
 //
@@ -88,22 +412,22 @@ static void crypto_addsub_sqlite(
     // Get text from args
     const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
     const unsigned char *denom_str = sqlite3_value_text(argv[1]);
-    const unsigned char *op_1_str = sqlite3_value_text(argv[2]);
-    const unsigned char *op_2_str = sqlite3_value_text(argv[3]);
+    const unsigned char *op_1_str = operand_arg(argv[2]);
+    const unsigned char *op_2_str = operand_arg(argv[3]);
     if (!crypto_type_str || !denom_str || !op_1_str || !op_2_str) {
         result_error_fmt(context, "%s: Invalid arguments", crypto_arithmetic_op_str[op]);
         return;
     }
 
     // Get crypto_type for the first arg
-    crypto_type_t crypto_type = crypto_get_type_for_symbol((const char*)crypto_type_str);
+    crypto_type_t crypto_type = resolve_type_arg(context, argv, 0);
     if (crypto_type == CRYPTO_COUNT) {
         result_error_fmt(context, "%s: Invalid crypto type", crypto_arithmetic_op_str[op]);
         return;
     }
 
     // Get the denom for the first arg
-    crypto_denom_t denom = crypto_get_denom_for_symbol(crypto_type, (const char*)denom_str);
+    crypto_denom_t denom = resolve_denom_arg(context, argv, 1, crypto_type);
     if (denom == DENOM_COUNT) {
         result_error_fmt(context, "%s: Invalid denomination", crypto_arithmetic_op_str[op]);
         return;
@@ -114,27 +438,14 @@ static void crypto_addsub_sqlite(
     crypto_init(&op_1, crypto_type);
     crypto_init(&op_2, crypto_type);
 
-    // Validate the first operand
-    if (!crypto_is_valid_decimal((const char*)op_1_str)) {
-        crypto_clear(&op_1); 
-        crypto_clear(&op_2);
-        result_error_fmt(context, "%s: Invalid decimal format for first operand", crypto_arithmetic_op_str[op]);
-        return;
-    }
-    // Parse the first operand into crypto_val_t
-    crypto_set_from_decimal(&op_1, denom, (const char*)op_1_str);
-
-    // Validate the second operand
-    if (!crypto_is_valid_decimal((const char*)op_2_str)) {
+    // Validate and parse both operands
+    if (!parse_operand(context, argv[2], denom, &op_1, crypto_arithmetic_op_str[op], "first")
+        || !parse_operand(context, argv[3], denom, &op_2, crypto_arithmetic_op_str[op], "second")) {
         crypto_clear(&op_1); 
         crypto_clear(&op_2);
-        result_error_fmt(context, "%s: Invalid decimal format for second operand", crypto_arithmetic_op_str[op]);
         return;
     }
 
-    // Parse the second operand into crypto_val_t
-    crypto_set_from_decimal(&op_2, denom, (const char*)op_2_str);
-
     // Perform the arithmetic operation
     switch (op) {
         case ARITHMETIC_ADD:
@@ -152,18 +463,48 @@ static void crypto_addsub_sqlite(
 
     crypto_clear(&op_2);
 
-    // Convert result to decimal string
-    char *resultStr = crypto_to_decimal_str(&op_1, denom);
+    // Return the result to SQLite as decimal text
+    result_crypto_value(context, &op_1, denom, is_blob_operand(argv[2]) || is_blob_operand(argv[3]));
     crypto_clear(&op_1);
+}
 
-    if (!resultStr) {
-        result_error_fmt(context, "%s: Could not convert result to string", crypto_arithmetic_op_str[op]);
-        return;
-    }
+/*
+** A muldiv scalar parsed into an integer and the power of ten it was scaled
+** by, kept as auxdata on the scalar argument. The divisor of the operation,
+** 10^precision for multiplication and the scalar itself for division, is
+** prepared once so each row's division can use its precomputed reciprocal.
+*/
+typedef struct muldiv_scalar_t {
+  mpz_t scalar;               /* The scalar with its decimal point removed */
+  mpz_t rescale;              /* 10^precision of the scalar */
+  crypto_divisor_t divisor;   /* rescale for ARITHMETIC_MUL, scalar otherwise */
+} muldiv_scalar_t;
+
+static void muldiv_scalar_free(void *p){
+  muldiv_scalar_t *sc = (muldiv_scalar_t *)p;
+  mpz_clear(sc->scalar);
+  mpz_clear(sc->rescale);
+  crypto_divisor_clear(&sc->divisor);
+  sqlite3_free(sc);
+}
 
-    // Return to SQLite
-    sqlite3_result_text(context, resultStr, -1, SQLITE_TRANSIENT);
-    free(resultStr);
+/* Parse an already validated scalar for op. Returns NULL on OOM. */
+static muldiv_scalar_t *muldiv_scalar_new(const char *str, crypto_arithmetic_op_t op){
+  muldiv_scalar_t *sc = sqlite3_malloc(sizeof(*sc));
+  if (!sc) {
+    return NULL;
+  }
+  mpz_init(sc->scalar);
+  mpz_init(sc->rescale);
+  uint8_t precision = crypto_scale_by_precision(str, &sc->scalar);
+  /* 10^precision comes from the shared table; only absurdly long scalars compute it */
+  if (precision <= CRYPTO_POW10_MAX) {
+    mpz_set(sc->rescale, *crypto_pow10(precision));
+  } else {
+    mpz_ui_pow_ui(sc->rescale, 10, precision);
+  }
+  crypto_divisor_init(&sc->divisor, op == ARITHMETIC_MUL ? sc->rescale : sc->scalar);
+  return sc;
 }
 
 //-----------------------------
@@ -188,7 +529,7 @@ static void crypto_muldiv_sqlite(
     // Get text from args
     const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
     const unsigned char *denom_str = sqlite3_value_text(argv[1]);
-    const unsigned char *op_1_str = sqlite3_value_text(argv[2]);
+    const unsigned char *op_1_str = operand_arg(argv[2]);
     const unsigned char *op_2_str = sqlite3_value_text(argv[3]);
     if (!crypto_type_str || !denom_str || !op_1_str || !op_2_str) {
         result_error_fmt(context, "%s: Invalid arguments", crypto_arithmetic_op_str[op]);
@@ -196,14 +537,14 @@ static void crypto_muldiv_sqlite(
     }
 
     // Get crypto_type for the first arg
-    crypto_type_t crypto_type = crypto_get_type_for_symbol((const char*)crypto_type_str);
+    crypto_type_t crypto_type = resolve_type_arg(context, argv, 0);
     if (crypto_type == CRYPTO_COUNT) {
         result_error_fmt(context, "%s: Invalid crypto type", crypto_arithmetic_op_str[op]);
         return;
     }
 
     // Get the denom for the first arg
-    crypto_denom_t denom = crypto_get_denom_for_symbol(crypto_type, (const char*)denom_str);
+    crypto_denom_t denom = resolve_denom_arg(context, argv, 1, crypto_type);
     if (denom == DENOM_COUNT) {
         result_error_fmt(context, "%s: Invalid denomination", crypto_arithmetic_op_str[op]);
         return;
@@ -213,78 +554,245 @@ static void crypto_muldiv_sqlite(
     crypto_val_t op_1;
     crypto_init(&op_1, crypto_type);
 
-    // Validate the first operand
-    if (!crypto_is_valid_decimal((const char*)op_1_str)) {
+    // Validate and parse the first operand
+    if (!parse_operand(context, argv[2], denom, &op_1, crypto_arithmetic_op_str[op], "first")) {
         crypto_clear(&op_1); 
-        result_error_fmt(context, "%s: Invalid decimal format for first operand", crypto_arithmetic_op_str[op]);
         return;
     }
-    // Parse the first operand into crypto_val_t
-    crypto_set_from_decimal(&op_1, denom, (const char*)op_1_str);
 
-    // Validate the second operand
-    if (!crypto_is_valid_decimal((const char*)op_2_str)) {
-        crypto_clear(&op_1); 
-        result_error_fmt(context, "%s: Invalid decimal format for second operand", crypto_arithmetic_op_str[op]);
-        return;
+    // The scalar is almost always a literal, so its parsed form is kept for the
+    // statement; SQLite drops it automatically when the argument is not constant
+    muldiv_scalar_t *sc = (muldiv_scalar_t *)sqlite3_get_auxdata(context, 3);
+    bool sc_is_new = false;
+    CRYPTO_STATS_ADD(sc ? CRYPTO_STATS_AUXDATA_HITS : CRYPTO_STATS_AUXDATA_MISSES, 1);
+    if (!sc) {
+        // Validate the second operand
+        if (!crypto_is_valid_decimal((const char*)op_2_str)) {
+            crypto_clear(&op_1); 
+            result_error_fmt(context, "%s: Invalid decimal format for second operand", crypto_arithmetic_op_str[op]);
+            return;
+        }
+        sc = muldiv_scalar_new((const char*)op_2_str, op);
+        if (!sc) {
+            crypto_clear(&op_1);
+            sqlite3_result_error_nomem(context);
+            return;
+        }
+        sc_is_new = true;
     }
 
-    // Scale the second operand by its precision
-    mpz_t scalar;
-    mpz_init(scalar);
-    uint8_t precision = crypto_scale_by_precision((const char*)op_2_str, &scalar);
-
     // If dividing and scalar is 0, return an error
     if ((op == ARITHMETIC_DIV_TRUNC || op == ARITHMETIC_DIV_FLOOR || op == ARITHMETIC_DIV_CEIL) 
-        && mpz_cmp_ui(scalar, 0) == 0) {
+        && mpz_cmp_ui(sc->scalar, 0) == 0) {
         crypto_clear(&op_1);
-        mpz_clear(scalar);
+        if (sc_is_new) {
+            muldiv_scalar_free(sc);
+        }
         result_error_fmt(context, "%s: Division by zero", crypto_arithmetic_op_str[op]);
         return;
     }
 
-    mpz_t rescale;
-    mpz_init(rescale);
-    mpz_ui_pow_ui(rescale, 10, precision);
     // Perform the arithmetic operation
     switch (op) {
         case ARITHMETIC_MUL:
-            crypto_mul(&op_1, &op_1, &scalar);
-            mpz_tdiv_q(op_1.value, op_1.value, rescale);
+            crypto_mul(&op_1, &op_1, &sc->scalar);
+            crypto_div_by(&op_1, &op_1, &sc->divisor, CRYPTO_ROUND_TRUNCATE);
             break;
         case ARITHMETIC_DIV_TRUNC:
-            mpz_mul(op_1.value, op_1.value, rescale);
-            crypto_div_truncate(&op_1, &op_1, &scalar);
+            crypto_mul(&op_1, &op_1, &sc->rescale);
+            crypto_div_by(&op_1, &op_1, &sc->divisor, CRYPTO_ROUND_TRUNCATE);
             break;
         case ARITHMETIC_DIV_FLOOR:
-            mpz_mul(op_1.value, op_1.value, rescale);
-            crypto_div_floor(&op_1, &op_1, &scalar);
+            crypto_mul(&op_1, &op_1, &sc->rescale);
+            crypto_div_by(&op_1, &op_1, &sc->divisor, CRYPTO_ROUND_FLOOR);
             break;
         case ARITHMETIC_DIV_CEIL:
-            mpz_mul(op_1.value, op_1.value, rescale);
-            crypto_div_ceil(&op_1, &op_1, &scalar);
+            crypto_mul(&op_1, &op_1, &sc->rescale);
+            crypto_div_by(&op_1, &op_1, &sc->divisor, CRYPTO_ROUND_CEIL);
             break;
         default:
             crypto_clear(&op_1);
-            mpz_clear(scalar);
-            mpz_clear(rescale);
+            if (sc_is_new) {
+                muldiv_scalar_free(sc);
+            }
             result_error_fmt(context, "%s: Invalid arithmetic operation", crypto_arithmetic_op_str[op]);
             return;
     }
-    mpz_clear(scalar);
-    mpz_clear(rescale);
-    // Convert result to decimal string
-    char *resultStr = crypto_to_decimal_str(&op_1, denom);
+    if (sc_is_new) {
+        // SQLite may free sc right away, so it is handed over only after its last use
+        sqlite3_set_auxdata(context, 3, sc, muldiv_scalar_free);
+    }
+
+    // Return the result to SQLite as decimal text
+    result_crypto_value(context, &op_1, denom, is_blob_operand(argv[2]));
     crypto_clear(&op_1);
+}
+
+/*
+** The integer factors of a crypto_muldiv ratio num/den, kept as auxdata on
+** the den argument. With num = N/10^p and den = D/10^q the ratio is
+** (N*10^q)/(D*10^p), so every row costs one multiply and one division by a
+** prepared divisor. The num text is kept too and checked on every row, since
+** the auxdata only follows the den argument.
+*/
+typedef struct muldiv_ratio_t {
+  char *num;                  /* Text of the num argument */
+  int num_len;
+  mpz_t factor;               /* N * 10^q */
+  crypto_divisor_t divisor;   /* D * 10^p */
+} muldiv_ratio_t;
+
+static void muldiv_ratio_free(void *p){
+  muldiv_ratio_t *ratio = (muldiv_ratio_t *)p;
+  sqlite3_free(ratio->num);
+  mpz_clear(ratio->factor);
+  crypto_divisor_clear(&ratio->divisor);
+  sqlite3_free(ratio);
+}
+
+/* Build the ratio of two already validated decimals. Returns NULL on OOM. */
+static muldiv_ratio_t *muldiv_ratio_new(const char *num, int num_len, const char *den){
+  muldiv_ratio_t *ratio = sqlite3_malloc(sizeof(*ratio));
+  char *num_copy = sqlite3_malloc(num_len + 1);
+  if (!ratio || !num_copy) {
+    sqlite3_free(ratio);
+    sqlite3_free(num_copy);
+    return NULL;
+  }
+  memcpy(num_copy, num, (size_t)num_len + 1);
+  ratio->num = num_copy;
+  ratio->num_len = num_len;
+  muldiv_scalar_t *n = muldiv_scalar_new(num, ARITHMETIC_MUL);
+  muldiv_scalar_t *d = muldiv_scalar_new(den, ARITHMETIC_MUL);
+  if (!n || !d) {
+    if (n) muldiv_scalar_free(n);
+    if (d) muldiv_scalar_free(d);
+    sqlite3_free(num_copy);
+    sqlite3_free(ratio);
+    return NULL;
+  }
+  mpz_init(ratio->factor);
+  mpz_mul(ratio->factor, n->scalar, d->rescale);
+  mpz_mul(n->rescale, n->rescale, d->scalar);
+  crypto_divisor_init(&ratio->divisor, n->rescale);
+  muldiv_scalar_free(n);
+  muldiv_scalar_free(d);
+  return ratio;
+}
+
+/* Map a rounding mode name to crypto_rounding_t. Returns false if unknown. */
+static bool parse_rounding(const char *name, crypto_rounding_t *rounding){
+  static const struct { const char *name; crypto_rounding_t rounding; } modes[] = {
+    { "trunc", CRYPTO_ROUND_TRUNCATE },
+    { "floor", CRYPTO_ROUND_FLOOR },
+    { "ceil", CRYPTO_ROUND_CEIL },
+    { "half_up", CRYPTO_ROUND_HALF_UP },
+    { "half_even", CRYPTO_ROUND_HALF_EVEN }
+  };
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+    if (sqlite3_stricmp(name, modes[i].name) == 0) {
+      *rounding = modes[i].rounding;
+      return true;
+    }
+  }
+  return false;
+}
+
+//-----------------------------
+// crypto_fused_muldiv_sqlite
+//
+// crypto_muldiv(crypto, denomination, amount, num, den, rounding): amount * num / den
+// with an exact intermediate and a single rounding to the denomination's precision.
+// rounding is one of 'trunc', 'floor', 'ceil', 'half_up' or 'half_even'.
+static void crypto_fused_muldiv_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    // Expect 6 args
+    if (argc != 6) {
+        result_error_fmt(context, "crypto_muldiv: requires six arguments (crypto, denomination, amount, num, den, rounding)");
+        return;
+    }
+
+    const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
+    const unsigned char *denom_str = sqlite3_value_text(argv[1]);
+    const unsigned char *amount_str = operand_arg(argv[2]);
+    const unsigned char *num_str = sqlite3_value_text(argv[3]);
+    const unsigned char *den_str = sqlite3_value_text(argv[4]);
+    const unsigned char *rounding_str = sqlite3_value_text(argv[5]);
+    if (!crypto_type_str || !denom_str || !amount_str || !num_str || !den_str || !rounding_str) {
+        result_error_fmt(context, "crypto_muldiv: Invalid arguments");
+        return;
+    }
+
+    crypto_type_t crypto_type = resolve_type_arg(context, argv, 0);
+    if (crypto_type == CRYPTO_COUNT) {
+        result_error_fmt(context, "crypto_muldiv: Invalid crypto type");
+        return;
+    }
+    crypto_denom_t denom = resolve_denom_arg(context, argv, 1, crypto_type);
+    if (denom == DENOM_COUNT) {
+        result_error_fmt(context, "crypto_muldiv: Invalid denomination");
+        return;
+    }
+    crypto_rounding_t rounding;
+    if (!parse_rounding((const char*)rounding_str, &rounding)) {
+        result_error_fmt(context, "crypto_muldiv: Invalid rounding mode '%s'", rounding_str);
+        return;
+    }
+
+    // Reuse the statement's ratio while num and den are unchanged
+    int num_len = sqlite3_value_bytes(argv[3]);
+    muldiv_ratio_t *ratio = (muldiv_ratio_t *)sqlite3_get_auxdata(context, 4);
+    bool ratio_is_new = false;
+    if (!ratio || ratio->num_len != num_len || memcmp(ratio->num, num_str, (size_t)num_len) != 0) {
+        CRYPTO_STATS_ADD(CRYPTO_STATS_AUXDATA_MISSES, 1);
+        if (!crypto_is_valid_decimal((const char*)num_str)) {
+            result_error_fmt(context, "crypto_muldiv: Invalid decimal format for num");
+            return;
+        }
+        if (!crypto_is_valid_decimal((const char*)den_str)) {
+            result_error_fmt(context, "crypto_muldiv: Invalid decimal format for den");
+            return;
+        }
+        ratio = muldiv_ratio_new((const char*)num_str, num_len, (const char*)den_str);
+        if (!ratio) {
+            sqlite3_result_error_nomem(context);
+            return;
+        }
+        ratio_is_new = true;
+    } else {
+        CRYPTO_STATS_ADD(CRYPTO_STATS_AUXDATA_HITS, 1);
+    }
+    if (mpz_sgn(ratio->divisor.value) == 0) {
+        if (ratio_is_new) {
+            muldiv_ratio_free(ratio);
+        }
+        result_error_fmt(context, "crypto_muldiv: Division by zero");
+        return;
+    }
 
-    if (!resultStr) {
-        result_error_fmt(context, "%s: Could not convert result to string", crypto_arithmetic_op_str[op]);
+    crypto_val_t amount;
+    crypto_init(&amount, crypto_type);
+    if (!parse_operand(context, argv[2], denom, &amount, "crypto_muldiv", "amount")) {
+        crypto_clear(&amount);
+        if (ratio_is_new) {
+            muldiv_ratio_free(ratio);
+        }
         return;
     }
 
-    // Return to SQLite
-    sqlite3_result_text(context, resultStr, -1, SQLITE_TRANSIENT);
-    free(resultStr);
+    // The product is exact, even when it outgrows the inline limbs
+    crypto_mul(&amount, &amount, &ratio->factor);
+    crypto_div_by(&amount, &amount, &ratio->divisor, rounding);
+    if (ratio_is_new) {
+        // SQLite may free ratio right away, so it is handed over only after its last use
+        sqlite3_set_auxdata(context, 4, ratio, muldiv_ratio_free);
+    }
+
+    result_crypto_value(context, &amount, denom, is_blob_operand(argv[2]));
+    crypto_clear(&amount);
 }
 
 //-----------------------------
@@ -306,112 +814,155 @@ static void crypto_scale_sqlite(
     const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
     const unsigned char *from_denom_str = sqlite3_value_text(argv[1]);
     const unsigned char *to_denom_str = sqlite3_value_text(argv[2]);
-    const unsigned char *operand_str = sqlite3_value_text(argv[3]);
+    const unsigned char *operand_str = operand_arg(argv[3]);
     if (!crypto_type_str || !from_denom_str || !to_denom_str || !operand_str) {
         sqlite3_result_null(context);
         return;
     }
 
     // Get crypto_type
-    crypto_type_t crypto_type = crypto_get_type_for_symbol((const char*)crypto_type_str);
+    crypto_type_t crypto_type = resolve_type_arg(context, argv, 0);
     if (crypto_type == CRYPTO_COUNT) {
         sqlite3_result_error(context, "crypto_scale: Invalid crypto type", -1);
         return;
     }
 
     // Get the denom for the first arg
-    crypto_denom_t from_denom = crypto_get_denom_for_symbol(crypto_type, (const char*)from_denom_str);
+    crypto_denom_t from_denom = resolve_denom_arg(context, argv, 1, crypto_type);
     if (from_denom == DENOM_COUNT) {
         sqlite3_result_error(context, "crypto_scale: Invalid from denomination", -1);
         return;
     }
 
     // Get the denom for the second arg
-    crypto_denom_t to_denom = crypto_get_denom_for_symbol(crypto_type, (const char*)to_denom_str);
+    crypto_denom_t to_denom = resolve_denom_arg(context, argv, 2, crypto_type);
     if (to_denom == DENOM_COUNT) {
         sqlite3_result_error(context, "crypto_scale: Invalid to denomination", -1);
         return;
     }
 
-    // Parse the third operand into crypto_val_t
+    // Parse the third operand into crypto_val_t; a BLOB already carries smallest units
     crypto_val_t a;
     crypto_init(&a, crypto_type);
-    crypto_set_from_decimal(&a, from_denom, (const char*)operand_str);
-
-    // Convert result to decimal string
-    char *resultStr = crypto_to_decimal_str(&a, to_denom);
-    crypto_clear(&a);
-
-    if (!resultStr) {
-        sqlite3_result_error(context, "crypto_scale: Could not convert result to string", -1);
-        return;
+    if (is_blob_operand(argv[3])) {
+        if (!crypto_from_blob(&a, sqlite3_value_blob(argv[3]), (size_t)sqlite3_value_bytes(argv[3]))) {
+            crypto_clear(&a);
+            sqlite3_result_error(context, "crypto_scale: Invalid crypto blob", -1);
+            return;
+        }
+    } else if (parse_decimal_memo(&a, from_denom, (const char*)operand_str,
+                                  (size_t)sqlite3_value_bytes(argv[3]), NULL) != CRYPTO_PARSE_OK) {
+        /* Not a valid decimal: keep the lenient conversion crypto_scale always had */
+        if (!crypto_set_from_decimal(&a, from_denom, (const char*)operand_str)) {
+            crypto_clear(&a);
+            sqlite3_result_error_nomem(context);
+            return;
+        }
     }
 
-    // Return to SQLite
-    sqlite3_result_text(context, resultStr, -1, SQLITE_TRANSIENT);
-    free(resultStr);
+    // Return the result to SQLite as decimal text
+    result_crypto_text(context, &a, to_denom);
+    crypto_clear(&a);
 }
 
 // ----------------------------------------------------------------------
-// Aggregation context for crypto_sum
+// Shared argument handling for the aggregate and window functions
 //
-// This is used to sum up a series of crypto-decimal values.
-// It is used to implement the crypto_sum function.
-//
-// Example:
-//   SELECT crypto_sum(denom, operand) FROM table;
-
-typedef struct {
-    crypto_val_t sum;            // running sum
-    crypto_denom_t final_denom;  // final denomination
-    int initialized;             // 0 if not yet initialized with any value
-} crypto_sum_ctx_t;
-
-// Step function: called for each row
-static void crypto_sum_step(
+// All of them take (crypto, operand_denomination, final_denomination, operand).
+// SQLite passes the same arguments to xInverse as it passed to xStep for a row,
+// so both resolve rows through agg_parse_row and skip exactly the same rows.
+
+// Resolve the symbols of one row and parse its operand.
+// Returns 1 if the row carries a value (operand must then be cleared by the caller),
+// 0 if the row is skipped (NULL arguments or an invalid operand) and -1 if an error
+// has been reported.
+static int agg_parse_row(
     sqlite3_context *context,
     int argc,
-    sqlite3_value **argv
+    sqlite3_value **argv,
+    const char *fn,
+    crypto_denom_t *final_denom,
+    crypto_val_t *operand
 ){
     // Expect 4 args
     if (argc != 4) {
-        sqlite3_result_error(context, "crypto_sum requires 4 arguments (crypto, operand_denomination, final_denomination, operand)", -1);
-        return;
+        result_error_fmt(context, "%s requires 4 arguments (crypto, operand_denomination, final_denomination, operand)", fn);
+        return -1;
     }
 
     // Parse the command arguments
     const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
     const unsigned char *operand_denom_str = sqlite3_value_text(argv[1]);
     const unsigned char *final_denom_str = sqlite3_value_text(argv[2]);
-    const unsigned char *operand_str = sqlite3_value_text(argv[3]);
-    if (!crypto_type_str || !operand_denom_str || !final_denom_str) {
-        sqlite3_result_null(context);
-        return;
-    }
-
-    if (!operand_str || !crypto_is_valid_decimal((const char*)operand_str)) {
-        // treat as 0
-        return;
+    const unsigned char *operand_str = operand_arg(argv[3]);
+    if (!crypto_type_str || !operand_denom_str || !final_denom_str || !operand_str) {
+        // treat as NULL
+        return 0;
     }
 
     // Get crypto_type for the final denom
-    crypto_type_t crypto_type = crypto_get_type_for_symbol((const char*)crypto_type_str);
+    crypto_type_t crypto_type = resolve_type_arg(context, argv, 0);
     if (crypto_type == CRYPTO_COUNT) {
-        sqlite3_result_error(context, "crypto_sum: Invalid crypto type", -1);
-        return;
+        result_error_fmt(context, "%s: Invalid crypto type", fn);
+        return -1;
     }
 
     // Get the final denom
-    crypto_denom_t final_denom = crypto_get_denom_for_symbol(crypto_type, (const char*)final_denom_str);
-    if (final_denom == DENOM_COUNT) {
-        sqlite3_result_error(context, "crypto_sum: Invalid final denomination", -1);
-        return;
+    *final_denom = resolve_denom_arg(context, argv, 2, crypto_type);
+    if (*final_denom == DENOM_COUNT) {
+        result_error_fmt(context, "%s: Invalid final denomination", fn);
+        return -1;
     }
 
     // Get the operand denom
-    crypto_denom_t operand_denom = crypto_get_denom_for_symbol(crypto_type, (const char*)operand_denom_str);
+    crypto_denom_t operand_denom = resolve_denom_arg(context, argv, 1, crypto_type);
     if (operand_denom == DENOM_COUNT) {
-        sqlite3_result_error(context, "crypto_sum: Invalid operand denomination", -1);
+        result_error_fmt(context, "%s: Invalid operand denomination", fn);
+        return -1;
+    }
+
+    // Parse the operand into crypto_val_t; invalid decimals and blobs are treated as NULL
+    crypto_init(operand, crypto_type);
+    bool parsed = is_blob_operand(argv[3])
+        ? crypto_from_blob(operand, sqlite3_value_blob(argv[3]), (size_t)sqlite3_value_bytes(argv[3]))
+        : parse_decimal_memo(operand, operand_denom, (const char*)operand_str,
+                             (size_t)sqlite3_value_bytes(argv[3]), NULL) == CRYPTO_PARSE_OK;
+    if (!parsed) {
+        CRYPTO_STATS_ADD(CRYPTO_STATS_PARSE_FAILURES, 1);
+        crypto_clear(operand);
+        return 0;
+    }
+    return 1;
+}
+
+// ----------------------------------------------------------------------
+// Aggregation context for crypto_sum
+//
+// This is used to sum up a series of crypto-decimal values.
+// It is used to implement the crypto_sum aggregate and window function.
+// Rows leaving a window frame are subtracted again, so sliding frames cost O(1) per row.
+//
+// Example:
+//   SELECT crypto_sum(denom, operand) FROM table;
+//   SELECT crypto_sum(crypto, denom, denom, operand) OVER (ORDER BY ts ROWS 999 PRECEDING) FROM table;
+
+typedef struct {
+    crypto_val_t sum;            // running sum
+    crypto_denom_t final_denom;  // final denomination
+    int initialized;             // 0 if not yet initialized with any value
+    sqlite3_int64 count;         // number of values currently summed
+} crypto_sum_ctx_t;
+
+// Add (step) or subtract (inverse) one row
+static void crypto_sum_update(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv,
+    bool inverse
+){
+    crypto_denom_t final_denom;
+    crypto_val_t operand;
+    if (agg_parse_row(context, argc, argv, "crypto_sum", &final_denom, &operand) <= 0) {
         return;
     }
 
@@ -419,6 +970,7 @@ static void crypto_sum_step(
     crypto_sum_ctx_t *p = (crypto_sum_ctx_t *)sqlite3_aggregate_context(context, sizeof(*p));
     if (!p) {
         // Out of memory
+        crypto_clear(&operand);
         sqlite3_result_error_nomem(context);
         return;
     }
@@ -426,281 +978,452 @@ static void crypto_sum_step(
     // If first time, initialize crypto_val_t
     // Note: crypto_init() will initialize the value to 0
     if (!p->initialized) {
-        crypto_init(&p->sum, crypto_type);
+        crypto_init(&p->sum, operand.crypto_type);
         p->final_denom = final_denom;
         p->initialized = 1;
     }
 
-    // Parse the operand into crypto_val_t
-    crypto_val_t operand;
-    crypto_init(&operand, crypto_type);
-    crypto_set_from_decimal(&operand, operand_denom, (const char*)operand_str);
-
-    // Add to sum
-    crypto_add(&p->sum, &operand, &p->sum);
+    if (inverse) {
+        crypto_sub(&p->sum, &p->sum, &operand);
+        p->count--;
+    } else {
+        crypto_add(&p->sum, &operand, &p->sum);
+        p->count++;
+    }
     crypto_clear(&operand);
 }
 
-// Final function: called after all rows processed
-static void crypto_sum_final(sqlite3_context *context) {
+// Step function: called for each row
+static void crypto_sum_step(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    crypto_sum_update(context, argc, argv, false);
+}
+
+// Inverse function: called for each row leaving the window frame
+static void crypto_sum_inverse(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    crypto_sum_update(context, argc, argv, true);
+}
+
+// Value function: the sum of the current window frame
+static void crypto_sum_value(sqlite3_context *context) {
     crypto_sum_ctx_t *p = (crypto_sum_ctx_t *)sqlite3_aggregate_context(context, 0);
 
-    // If no rows were processed or aggregator not created, result = NULL
-    if (!p || !p->initialized) {
+    // If no rows are in the frame or aggregator not created, result = NULL
+    if (!p || !p->initialized || p->count == 0) {
         sqlite3_result_null(context);
         return;
     }
 
-    // Convert p->sum to decimal string
-    char *result_str = crypto_to_decimal_str(&p->sum, p->final_denom);
-    // Clear aggregator memory
-    crypto_clear(&p->sum);
-    p->initialized = 0;
+    // Return p->sum as decimal TEXT
+    result_crypto_text(context, &p->sum, p->final_denom);
+}
 
-    if (!result_str) {
-        sqlite3_result_error(context, "crypto_sum:Memory error converting sum to string", -1);
-        return;
-    }
+// Final function: called after all rows processed
+static void crypto_sum_final(sqlite3_context *context) {
+    crypto_sum_value(context);
 
-    // Return as TEXT
-    sqlite3_result_text(context, result_str, -1, SQLITE_TRANSIENT);
-    free(result_str);
+    // Clear aggregator memory
+    crypto_sum_ctx_t *p = (crypto_sum_ctx_t *)sqlite3_aggregate_context(context, 0);
+    if (p && p->initialized) {
+        crypto_clear(&p->sum);
+        p->initialized = 0;
+    }
 }
 
 // ----------------------------------------------------------------------
-// Aggregation context for crypto_max
+// Aggregation context for crypto_max and crypto_min
+//
+// This is used to find the maximum or minimum value in a series of crypto-decimal
+// values. It is used to implement the crypto_max and crypto_min aggregate and window
+// functions.
 //
-// This is used to find the maximum value in a series of crypto-decimal values.
-// It is used to implement the crypto_max function.
+// Candidates are kept in a monotonic deque: each new value first drops every older
+// candidate it beats, so the front is always the extremum of the current frame and a
+// row leaving the frame only ever removes the front. Sliding frames cost amortized
+// O(1) per row. Each value that has not been beaten by a later one stays in the deque,
+// which is O(log n) candidates for unordered input but every row for input that
+// steadily moves away from the extremum.
 //
 // Example:
 //   SELECT crypto_max(denom, operand) FROM table;
+//   SELECT crypto_min(crypto, denom, denom, operand) OVER (ORDER BY ts ROWS 999 PRECEDING) FROM table;
+
+typedef struct {
+    const char *name;            // function name for error messages
+    int direction;               // 1 keeps the maximum, -1 the minimum
+} crypto_minmax_def_t;
+
+static const crypto_minmax_def_t crypto_max_def = { "crypto_max", 1 };
+static const crypto_minmax_def_t crypto_min_def = { "crypto_min", -1 };
+
+typedef struct {
+    crypto_val_t value;          // candidate value
+    sqlite3_int64 seq;           // sequence number of the row it came from
+} crypto_minmax_entry_t;
 
 typedef struct {
-    crypto_val_t max;            // current maximum value
+    crypto_minmax_entry_t *deque;  // ring buffer of candidates, extremum first
+    sqlite3_int64 cap;           // capacity of deque; always a power of two
+    sqlite3_int64 head;          // index of the front candidate
+    sqlite3_int64 len;           // number of candidates
+    sqlite3_int64 next_in;       // sequence number of the next row stepped in
+    sqlite3_int64 next_out;      // sequence number of the next row to leave the frame
     crypto_denom_t final_denom;  // final denomination
     int initialized;             // 0 if not yet initialized with any value
-} crypto_max_ctx_t;
+} crypto_minmax_ctx_t;
+
+#define MINMAX_AT(p, i) ((p)->deque[((p)->head + (i)) & ((p)->cap - 1)])
+
+// Make room for one more candidate. Returns false on OOM.
+static bool crypto_minmax_reserve(crypto_minmax_ctx_t *p) {
+    if (p->len < p->cap) {
+        return true;
+    }
+    sqlite3_int64 cap = p->cap ? p->cap * 2 : 8;
+    crypto_minmax_entry_t *deque = sqlite3_malloc64(cap * sizeof(*deque));
+    if (!deque) {
+        return false;
+    }
+    // Moving candidates by value is fine: a promoted value only carries its limb pointer
+    for (sqlite3_int64 i = 0; i < p->len; i++) {
+        deque[i] = MINMAX_AT(p, i);
+    }
+    sqlite3_free(p->deque);
+    p->deque = deque;
+    p->cap = cap;
+    p->head = 0;
+    return true;
+}
 
 // Step function: called for each row
-static void crypto_max_step(
+static void crypto_minmax_step(
     sqlite3_context *context,
     int argc,
     sqlite3_value **argv
 ){
-    // Expect 4 args
-    if (argc != 4) {
-        sqlite3_result_error(context, "crypto_max requires 4 arguments (crypto, operand_denomination, final_denomination, operand)", -1);
+    const crypto_minmax_def_t *def = (const crypto_minmax_def_t *)sqlite3_user_data(context);
+    crypto_denom_t final_denom;
+    crypto_val_t operand;
+    if (agg_parse_row(context, argc, argv, def->name, &final_denom, &operand) <= 0) {
         return;
     }
 
-    // Parse the command arguments
-    const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
-    const unsigned char *operand_denom_str = sqlite3_value_text(argv[1]);
-    const unsigned char *final_denom_str = sqlite3_value_text(argv[2]);
-    const unsigned char *operand_str = sqlite3_value_text(argv[3]);
-    if (!crypto_type_str || !operand_denom_str || !final_denom_str) {
-        sqlite3_result_null(context);
+    // Access aggregator context
+    crypto_minmax_ctx_t *p = (crypto_minmax_ctx_t *)sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p) {
+        // Out of memory
+        crypto_clear(&operand);
+        sqlite3_result_error_nomem(context);
         return;
     }
 
-    if (!operand_str || !crypto_is_valid_decimal((const char*)operand_str)) {
-        // treat as NULL
-        return;
+    // If first time, remember the final denom
+    if (!p->initialized) {
+        p->final_denom = final_denom;
+        p->initialized = 1;
     }
 
-    // Get crypto_type for the final denom
-    crypto_type_t crypto_type = crypto_get_type_for_symbol((const char*)crypto_type_str);
-    if (crypto_type == CRYPTO_COUNT) {
-        sqlite3_result_error(context, "crypto_max: Invalid crypto type", -1);
-        return;
+    // Drop the candidates that the new value beats or ties; they leave the frame first
+    while (p->len > 0 && crypto_cmp(&MINMAX_AT(p, p->len - 1).value, &operand) * def->direction <= 0) {
+        crypto_clear(&MINMAX_AT(p, p->len - 1).value);
+        p->len--;
     }
 
-    // Get the final denom
-    crypto_denom_t final_denom = crypto_get_denom_for_symbol(crypto_type, (const char*)final_denom_str);
-    if (final_denom == DENOM_COUNT) {
-        sqlite3_result_error(context, "crypto_max: Invalid final denomination", -1);
+    if (!crypto_minmax_reserve(p)) {
+        crypto_clear(&operand);
+        sqlite3_result_error_nomem(context);
         return;
     }
+    // The deque takes over operand
+    MINMAX_AT(p, p->len).value = operand;
+    MINMAX_AT(p, p->len).seq = p->next_in++;
+    p->len++;
+}
 
-    // Get the operand denom
-    crypto_denom_t operand_denom = crypto_get_denom_for_symbol(crypto_type, (const char*)operand_denom_str);
-    if (operand_denom == DENOM_COUNT) {
-        sqlite3_result_error(context, "crypto_max: Invalid operand denomination", -1);
+// Inverse function: called for each row leaving the window frame, oldest first
+static void crypto_minmax_inverse(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    const crypto_minmax_def_t *def = (const crypto_minmax_def_t *)sqlite3_user_data(context);
+    crypto_denom_t final_denom;
+    crypto_val_t operand;
+    if (agg_parse_row(context, argc, argv, def->name, &final_denom, &operand) <= 0) {
         return;
     }
+    crypto_clear(&operand);
 
-    // Access aggregator context
-    crypto_max_ctx_t *p = (crypto_max_ctx_t *)sqlite3_aggregate_context(context, sizeof(*p));
+    crypto_minmax_ctx_t *p = (crypto_minmax_ctx_t *)sqlite3_aggregate_context(context, 0);
     if (!p) {
-        // Out of memory
-        sqlite3_result_error_nomem(context);
         return;
     }
 
-    // Parse the operand into crypto_val_t
-    crypto_val_t operand;
-    crypto_init(&operand, crypto_type);
-    crypto_set_from_decimal(&operand, operand_denom, (const char*)operand_str);
-
-    // If first time, initialize max with first value
-    if (!p->initialized) {
-        crypto_init(&p->max, crypto_type);
-        crypto_set(&p->max, &operand);
-        p->final_denom = final_denom;
-        p->initialized = 1;
-    } else {
-        // Compare with current max and update if larger
-        if (crypto_cmp(&operand, &p->max) > 0) {
-            crypto_set(&p->max, &operand);
-        }
+    // Only the front can belong to the oldest row; otherwise it was already beaten
+    sqlite3_int64 seq = p->next_out++;
+    if (p->len > 0 && MINMAX_AT(p, 0).seq == seq) {
+        crypto_clear(&MINMAX_AT(p, 0).value);
+        p->head = (p->head + 1) & (p->cap - 1);
+        p->len--;
     }
-
-    crypto_clear(&operand);
 }
 
-// Final function: called after all rows processed
-static void crypto_max_final(sqlite3_context *context) {
-    crypto_max_ctx_t *p = (crypto_max_ctx_t *)sqlite3_aggregate_context(context, 0);
+// Value function: the extremum of the current window frame
+static void crypto_minmax_value(sqlite3_context *context) {
+    crypto_minmax_ctx_t *p = (crypto_minmax_ctx_t *)sqlite3_aggregate_context(context, 0);
 
-    // If no rows were processed or aggregator not created, result = NULL
-    if (!p || !p->initialized) {
+    // If no rows are in the frame or aggregator not created, result = NULL
+    if (!p || !p->initialized || p->len == 0) {
         sqlite3_result_null(context);
         return;
     }
 
-    // Convert p->max to decimal string
-    char *result_str = crypto_to_decimal_str(&p->max, p->final_denom);
-    // Clear aggregator memory
-    crypto_clear(&p->max);
-    p->initialized = 0;
+    // Return the front candidate as decimal TEXT
+    result_crypto_text(context, &MINMAX_AT(p, 0).value, p->final_denom);
+}
 
-    if (!result_str) {
-        sqlite3_result_error(context, "crypto_max: Memory error converting max to string", -1);
-        return;
-    }
+// Final function: called after all rows processed
+static void crypto_minmax_final(sqlite3_context *context) {
+    crypto_minmax_value(context);
 
-    // Return as TEXT
-    sqlite3_result_text(context, result_str, -1, SQLITE_TRANSIENT);
-    free(result_str);
+    // Clear aggregator memory
+    crypto_minmax_ctx_t *p = (crypto_minmax_ctx_t *)sqlite3_aggregate_context(context, 0);
+    if (p) {
+        for (sqlite3_int64 i = 0; i < p->len; i++) {
+            crypto_clear(&MINMAX_AT(p, i).value);
+        }
+        sqlite3_free(p->deque);
+        p->deque = NULL;
+        p->len = 0;
+        p->initialized = 0;
+    }
 }
 
 // ----------------------------------------------------------------------
-// Aggregation context for crypto_min
+// Mergeable partial sums: crypto_sum_partial and crypto_sum_merge
 //
-// This is used to find the minimum value in a series of crypto-decimal values.
-// It is used to implement the crypto_min function.
+// crypto_sum_partial summarizes amounts as a crypto_partial_t BLOB (count, exact sum,
+// min and max, in smallest units). crypto_sum_merge combines such BLOBs, e.g. partials
+// computed over the shards of a ledger in other databases or processes, into the
+// partial of all of them; crypto_partial_sum/min/max/count read a partial back.
 //
 // Example:
-//   SELECT crypto_min(denom, operand) FROM table;
+//   SELECT crypto_sum_partial('ETH', 'ETH', amount) FROM shard;
+//   SELECT crypto_partial_sum(crypto_sum_merge(partial), 'ETH') FROM partials;
 
 typedef struct {
-    crypto_val_t min;            // current minimum value
-    crypto_denom_t final_denom;  // final denomination
-    int initialized;             // 0 if not yet initialized with any value
-} crypto_min_ctx_t;
+    crypto_partial_t partial;    // running partial
+    int initialized;             // 0 until the first non-NULL row
+} crypto_partial_ctx_t;
 
-// Step function: called for each row
-static void crypto_min_step(
+// Access the aggregate context, initializing its partial for type on first use.
+// Reports an error and returns NULL on OOM or if type differs from earlier rows.
+static crypto_partial_ctx_t *crypto_partial_ctx(
     sqlite3_context *context,
-    int argc,
-    sqlite3_value **argv
+    crypto_type_t type,
+    const char *fn
 ){
-    // Expect 4 args
-    if (argc != 4) {
-        sqlite3_result_error(context, "crypto_min requires 4 arguments (crypto, operand_denomination, final_denomination, operand)", -1);
-        return;
+    crypto_partial_ctx_t *p = (crypto_partial_ctx_t *)sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p) {
+        sqlite3_result_error_nomem(context);
+        return NULL;
+    }
+    if (!p->initialized) {
+        crypto_partial_init(&p->partial, type);
+        p->initialized = 1;
+    } else if (p->partial.sum.crypto_type != type) {
+        result_error_fmt(context, "%s: Cannot combine different crypto types", fn);
+        return NULL;
     }
+    return p;
+}
 
-    // Parse the command arguments
-    const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
-    const unsigned char *operand_denom_str = sqlite3_value_text(argv[1]);
-    const unsigned char *final_denom_str = sqlite3_value_text(argv[2]);
-    const unsigned char *operand_str = sqlite3_value_text(argv[3]);
-    if (!crypto_type_str || !operand_denom_str || !final_denom_str) {
-        sqlite3_result_null(context);
+// Step function of crypto_sum_partial(crypto, denomination, operand)
+static void crypto_sum_partial_step(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    // Expect 3 args
+    if (argc != 3) {
+        sqlite3_result_error(context, "crypto_sum_partial requires 3 arguments (crypto, denomination, operand)", -1);
         return;
     }
 
-    if (!operand_str || !crypto_is_valid_decimal((const char*)operand_str)) {
+    const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
+    const unsigned char *denom_str = sqlite3_value_text(argv[1]);
+    const unsigned char *operand_str = operand_arg(argv[2]);
+    if (!crypto_type_str || !denom_str || !operand_str) {
         // treat as NULL
         return;
     }
 
-    // Get crypto_type for the final denom
-    crypto_type_t crypto_type = crypto_get_type_for_symbol((const char*)crypto_type_str);
+    crypto_type_t crypto_type = resolve_type_arg(context, argv, 0);
     if (crypto_type == CRYPTO_COUNT) {
-        sqlite3_result_error(context, "crypto_min: Invalid crypto type", -1);
+        sqlite3_result_error(context, "crypto_sum_partial: Invalid crypto type", -1);
+        return;
+    }
+    crypto_denom_t denom = resolve_denom_arg(context, argv, 1, crypto_type);
+    if (denom == DENOM_COUNT) {
+        sqlite3_result_error(context, "crypto_sum_partial: Invalid denomination", -1);
         return;
     }
 
-    // Get the final denom
-    crypto_denom_t final_denom = crypto_get_denom_for_symbol(crypto_type, (const char*)final_denom_str);
-    if (final_denom == DENOM_COUNT) {
-        sqlite3_result_error(context, "crypto_min: Invalid final denomination", -1);
+    // Invalid decimals and blobs are treated as NULL, as in crypto_sum
+    crypto_val_t operand;
+    crypto_init(&operand, crypto_type);
+    bool parsed = is_blob_operand(argv[2])
+        ? crypto_from_blob(&operand, sqlite3_value_blob(argv[2]), (size_t)sqlite3_value_bytes(argv[2]))
+        : parse_decimal_memo(&operand, denom, (const char*)operand_str,
+                             (size_t)sqlite3_value_bytes(argv[2]), NULL) == CRYPTO_PARSE_OK;
+    if (!parsed) {
+        CRYPTO_STATS_ADD(CRYPTO_STATS_PARSE_FAILURES, 1);
+        crypto_clear(&operand);
         return;
     }
 
-    // Get the operand denom
-    crypto_denom_t operand_denom = crypto_get_denom_for_symbol(crypto_type, (const char*)operand_denom_str);
-    if (operand_denom == DENOM_COUNT) {
-        sqlite3_result_error(context, "crypto_min: Invalid operand denomination", -1);
+    crypto_partial_ctx_t *p = crypto_partial_ctx(context, crypto_type, "crypto_sum_partial");
+    if (p) {
+        crypto_partial_add(&p->partial, &operand);
+    }
+    crypto_clear(&operand);
+}
+
+// Step function of crypto_sum_merge(partial)
+static void crypto_sum_merge_step(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    if (argc != 1) {
+        sqlite3_result_error(context, "crypto_sum_merge requires 1 argument (partial)", -1);
+        return;
+    }
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
         return;
     }
 
-    // Access aggregator context
-    crypto_min_ctx_t *p = (crypto_min_ctx_t *)sqlite3_aggregate_context(context, sizeof(*p));
-    if (!p) {
-        // Out of memory
-        sqlite3_result_error_nomem(context);
+    const unsigned char *blob = sqlite3_value_blob(argv[0]);
+    size_t len = (size_t)sqlite3_value_bytes(argv[0]);
+    crypto_type_t crypto_type = sqlite3_value_type(argv[0]) == SQLITE_BLOB
+        ? crypto_partial_blob_type(blob, len) : CRYPTO_COUNT;
+    if (crypto_type == CRYPTO_COUNT) {
+        sqlite3_result_error(context, "crypto_sum_merge: Invalid partial", -1);
         return;
     }
 
-    // Parse the operand into crypto_val_t
-    crypto_val_t operand;
-    crypto_init(&operand, crypto_type);
-    crypto_set_from_decimal(&operand, operand_denom, (const char*)operand_str);
+    crypto_partial_t other;
+    crypto_partial_init(&other, crypto_type);
+    if (!crypto_partial_from_blob(&other, blob, len)) {
+        crypto_partial_clear(&other);
+        sqlite3_result_error(context, "crypto_sum_merge: Invalid partial", -1);
+        return;
+    }
 
-    // If first time, initialize min with first value
-    if (!p->initialized) {
-        crypto_init(&p->min, crypto_type);
-        crypto_set(&p->min, &operand);
-        p->final_denom = final_denom;
-        p->initialized = 1;
+    crypto_partial_ctx_t *p = crypto_partial_ctx(context, crypto_type, "crypto_sum_merge");
+    if (p) {
+        crypto_partial_merge(&p->partial, &other);
+    }
+    crypto_partial_clear(&other);
+}
+
+// Final function of both: the partial as a BLOB, or NULL if every row was NULL
+static void crypto_partial_final(sqlite3_context *context) {
+    crypto_partial_ctx_t *p = (crypto_partial_ctx_t *)sqlite3_aggregate_context(context, 0);
+    if (!p || !p->initialized) {
+        sqlite3_result_null(context);
+        return;
+    }
+
+    unsigned char buf[CRYPTO_PARTIAL_INLINE_MAX];
+    size_t len = crypto_partial_to_blob(buf, sizeof(buf), &p->partial);
+    if (len == 0) {
+        sqlite3_result_error(context, "crypto_sum_partial: Sum too large to encode", -1);
+    } else if (len <= sizeof(buf)) {
+        sqlite3_result_blob64(context, buf, len, SQLITE_TRANSIENT);
     } else {
-        // Compare with current min and update if smaller
-        if (crypto_cmp(&operand, &p->min) < 0) {
-            crypto_set(&p->min, &operand);
+        /* Only partials holding promoted values take this path */
+        unsigned char *big = sqlite3_malloc64(len);
+        if (big) {
+            crypto_partial_to_blob(big, len, &p->partial);
+            sqlite3_result_blob64(context, big, len, sqlite3_free);
+        } else {
+            sqlite3_result_error_nomem(context);
         }
     }
-
-    crypto_clear(&operand);
+    crypto_partial_clear(&p->partial);
+    p->initialized = 0;
 }
 
-// Final function: called after all rows processed
-static void crypto_min_final(sqlite3_context *context) {
-    crypto_min_ctx_t *p = (crypto_min_ctx_t *)sqlite3_aggregate_context(context, 0);
+// Fields read back from a partial by crypto_partial_sum/min/max/count
+typedef enum {
+    PARTIAL_FIELD_SUM,
+    PARTIAL_FIELD_MIN,
+    PARTIAL_FIELD_MAX,
+    PARTIAL_FIELD_COUNT
+} crypto_partial_field_t;
+
+static const char *crypto_partial_field_str[] = {
+    "crypto_partial_sum",
+    "crypto_partial_min",
+    "crypto_partial_max",
+    "crypto_partial_count"
+};
 
-    // If no rows were processed or aggregator not created, result = NULL
-    if (!p || !p->initialized) {
+//-----------------------------
+// crypto_partial_field_sqlite
+//
+// Read one field of a partial: crypto_partial_sum/min/max(partial, denomination) return
+// TEXT in the denomination of the partial's crypto type (NULL min/max when it is
+// empty), and crypto_partial_count(partial) returns an INTEGER.
+static void crypto_partial_field_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    crypto_partial_field_t field = (crypto_partial_field_t)(intptr_t)sqlite3_user_data(context);
+    const char *fn = crypto_partial_field_str[field];
+    if (argc != (field == PARTIAL_FIELD_COUNT ? 1 : 2)) {
+        result_error_fmt(context, "%s: Wrong number of arguments", fn);
+        return;
+    }
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
         sqlite3_result_null(context);
         return;
     }
 
-    // Convert p->min to decimal string
-    char *result_str = crypto_to_decimal_str(&p->min, p->final_denom);
-    // Clear aggregator memory
-    crypto_clear(&p->min);
-    p->initialized = 0;
+    const unsigned char *blob = sqlite3_value_blob(argv[0]);
+    size_t len = (size_t)sqlite3_value_bytes(argv[0]);
+    crypto_type_t crypto_type = sqlite3_value_type(argv[0]) == SQLITE_BLOB
+        ? crypto_partial_blob_type(blob, len) : CRYPTO_COUNT;
+    crypto_partial_t partial;
+    if (crypto_type == CRYPTO_COUNT) {
+        result_error_fmt(context, "%s: Invalid partial", fn);
+        return;
+    }
+    crypto_partial_init(&partial, crypto_type);
+    if (!crypto_partial_from_blob(&partial, blob, len)) {
+        crypto_partial_clear(&partial);
+        result_error_fmt(context, "%s: Invalid partial", fn);
+        return;
+    }
+
+    if (field == PARTIAL_FIELD_COUNT) {
+        sqlite3_result_int64(context, (sqlite3_int64)partial.count);
+        crypto_partial_clear(&partial);
+        return;
+    }
 
-    if (!result_str) {
-        sqlite3_result_error(context, "crypto_min: Memory error converting min to string", -1);
+    crypto_denom_t denom = DENOM_COUNT;
+    const unsigned char *denom_str = sqlite3_value_text(argv[1]);
+    if (denom_str) {
+        denom = resolve_denom_arg(context, argv, 1, crypto_type);
+    }
+    if (denom == DENOM_COUNT) {
+        crypto_partial_clear(&partial);
+        result_error_fmt(context, "%s: Invalid denomination", fn);
         return;
     }
 
-    // Return as TEXT
-    sqlite3_result_text(context, result_str, -1, SQLITE_TRANSIENT);
-    free(result_str);
+    const crypto_val_t *val = field == PARTIAL_FIELD_SUM ? &partial.sum
+                            : field == PARTIAL_FIELD_MIN ? &partial.min : &partial.max;
+    if (field != PARTIAL_FIELD_SUM && partial.count == 0) {
+        sqlite3_result_null(context);
+    } else {
+        result_crypto_text(context, val, denom);
+    }
+    crypto_partial_clear(&partial);
 }
 
 //-----------------------------
@@ -722,22 +1445,22 @@ static void crypto_cmp_sqlite(
     // Get text from args
     const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
     const unsigned char *denom_str = sqlite3_value_text(argv[1]);
-    const unsigned char *op_1_str = sqlite3_value_text(argv[2]);
-    const unsigned char *op_2_str = sqlite3_value_text(argv[3]);
+    const unsigned char *op_1_str = operand_arg(argv[2]);
+    const unsigned char *op_2_str = operand_arg(argv[3]);
     if (!crypto_type_str || !denom_str || !op_1_str || !op_2_str) {
         result_error_fmt(context, "crypto_cmp: Invalid arguments");
         return;
     }
 
     // Get crypto_type for the first arg
-    crypto_type_t crypto_type = crypto_get_type_for_symbol((const char*)crypto_type_str);
+    crypto_type_t crypto_type = resolve_type_arg(context, argv, 0);
     if (crypto_type == CRYPTO_COUNT) {
         result_error_fmt(context, "crypto_cmp: Invalid crypto type");
         return;
     }
 
     // Get the denom for the first arg
-    crypto_denom_t denom = crypto_get_denom_for_symbol(crypto_type, (const char*)denom_str);
+    crypto_denom_t denom = resolve_denom_arg(context, argv, 1, crypto_type);
     if (denom == DENOM_COUNT) {
         result_error_fmt(context, "crypto_cmp: Invalid denomination");
         return;
@@ -748,27 +1471,14 @@ static void crypto_cmp_sqlite(
     crypto_init(&op_1, crypto_type);
     crypto_init(&op_2, crypto_type);
 
-    // Validate the first operand
-    if (!crypto_is_valid_decimal((const char*)op_1_str)) {
-        crypto_clear(&op_1); 
-        crypto_clear(&op_2);
-        result_error_fmt(context, "crypto_cmp: Invalid decimal format for first operand");
-        return;
-    }
-    // Parse the first operand into crypto_val_t
-    crypto_set_from_decimal(&op_1, denom, (const char*)op_1_str);
-
-    // Validate the second operand
-    if (!crypto_is_valid_decimal((const char*)op_2_str)) {
+    // Validate and parse both operands
+    if (!parse_operand(context, argv[2], denom, &op_1, "crypto_cmp", "first")
+        || !parse_operand(context, argv[3], denom, &op_2, "crypto_cmp", "second")) {
         crypto_clear(&op_1); 
         crypto_clear(&op_2);
-        result_error_fmt(context, "crypto_cmp: Invalid decimal format for second operand");
         return;
     }
 
-    // Parse the second operand into crypto_val_t
-    crypto_set_from_decimal(&op_2, denom, (const char*)op_2_str);
-
     // Perform the comparison
     int cmp_result = crypto_cmp(&op_1, &op_2);
 
@@ -780,6 +1490,353 @@ static void crypto_cmp_sqlite(
     sqlite3_result_int(context, cmp_result);
 }
 
+//-----------------------------
+// crypto_blob_sqlite
+//
+// A SQLite function that converts an amount between decimal TEXT and the binary
+// crypto_to_blob encoding. Registered as crypto_to_blob (returns a BLOB) and
+// crypto_from_blob (returns TEXT in the given denomination); either accepts
+// TEXT or BLOB input.
+static void crypto_blob_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    bool to_blob = sqlite3_user_data(context) != NULL;
+    const char *fn = to_blob ? "crypto_to_blob" : "crypto_from_blob";
+
+    // Expect 3 args
+    if (argc != 3) {
+        result_error_fmt(context, "%s requires three arguments (crypto, denomination, operand)", fn);
+        return;
+    }
+
+    // Get text from args
+    const unsigned char *crypto_type_str = sqlite3_value_text(argv[0]);
+    const unsigned char *denom_str = sqlite3_value_text(argv[1]);
+    const unsigned char *operand_str = operand_arg(argv[2]);
+    if (!crypto_type_str || !denom_str || !operand_str) {
+        sqlite3_result_null(context);
+        return;
+    }
+
+    // Get crypto_type for the first arg
+    crypto_type_t crypto_type = resolve_type_arg(context, argv, 0);
+    if (crypto_type == CRYPTO_COUNT) {
+        result_error_fmt(context, "%s: Invalid crypto type", fn);
+        return;
+    }
+
+    // Get the denom for the second arg
+    crypto_denom_t denom = resolve_denom_arg(context, argv, 1, crypto_type);
+    if (denom == DENOM_COUNT) {
+        result_error_fmt(context, "%s: Invalid denomination", fn);
+        return;
+    }
+
+    crypto_val_t a;
+    crypto_init(&a, crypto_type);
+    if (!parse_operand(context, argv[2], denom, &a, fn, "first")) {
+        crypto_clear(&a);
+        return;
+    }
+
+    result_crypto_value(context, &a, denom, to_blob);
+    crypto_clear(&a);
+}
+
+//-----------------------------
+// crypto_register_sqlite
+//
+// A SQLite function that adds an asset to the process-wide registry. Registered as
+// crypto_register_type(symbol, name, decimals), which adds a crypto type and its
+// base unit, and crypto_register_denom(crypto, symbol, name, decimals), which adds
+// another denomination of an existing type. Either can be applied to every row of
+// a table to load it. Returns 1; registering an identical entry again is a no-op,
+// and registering a symbol with different decimals fails. Registrations are not
+// saved in the database, so every process using a schema that names an asset must
+// register it with the same decimals.
+static void crypto_register_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    bool is_denom = sqlite3_user_data(context) != NULL;
+    const char *fn = is_denom ? "crypto_register_denom" : "crypto_register_type";
+    int first = is_denom ? 1 : 0;
+
+    // Expect 3 or 4 args
+    if (argc != first + 3) {
+        if (is_denom) {
+            result_error_fmt(context, "%s requires four arguments (crypto, symbol, name, decimals)", fn);
+        } else {
+            result_error_fmt(context, "%s requires three arguments (symbol, name, decimals)", fn);
+        }
+        return;
+    }
+
+    const char *symbol = (const char*)sqlite3_value_text(argv[first]);
+    const char *name = (const char*)sqlite3_value_text(argv[first + 1]);
+    if (!symbol || !name || sqlite3_value_type(argv[first + 2]) != SQLITE_INTEGER) {
+        result_error_fmt(context, "%s: symbol and name must be text and decimals an integer", fn);
+        return;
+    }
+    sqlite3_int64 decimals = sqlite3_value_int64(argv[first + 2]);
+    if (decimals < 0 || decimals > CRYPTO_POW10_MAX) {
+        result_error_fmt(context, "%s: decimals must be between 0 and %d", fn, CRYPTO_POW10_MAX);
+        return;
+    }
+
+    crypto_registry_status_t status;
+    if (is_denom) {
+        const char *type_str = (const char*)sqlite3_value_text(argv[0]);
+        crypto_type_t type = type_str ? crypto_get_type_for_symbol(type_str) : CRYPTO_COUNT;
+        status = crypto_register_denom(type, symbol, name, (unsigned)decimals, NULL);
+    } else {
+        status = crypto_register_type(symbol, name, (unsigned)decimals, NULL);
+    }
+    if (status != CRYPTO_REGISTRY_OK) {
+        result_error_fmt(context, "%s: Cannot register '%s' (%s)", fn, symbol, crypto_registry_status_str(status));
+        return;
+    }
+    sqlite3_result_int(context, 1);
+}
+
+//-----------------------------
+// crypto_load_assets_sqlite
+//
+// A SQLite function that loads a registry file (see crypto_registry_load) into the
+// process-wide registry. Returns 1, or reports the failing line.
+static void crypto_load_assets_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    (void)argc;
+    const char *path = (const char*)sqlite3_value_text(argv[0]);
+    if (!path) {
+        sqlite3_result_null(context);
+        return;
+    }
+    size_t line = 0;
+    crypto_registry_status_t status = crypto_registry_load(path, &line);
+    if (status == CRYPTO_REGISTRY_IO_ERROR) {
+        result_error_fmt(context, "crypto_load_assets: Cannot read '%s'", path);
+        return;
+    }
+    if (status != CRYPTO_REGISTRY_OK) {
+        result_error_fmt(context, "crypto_load_assets: %s at line %d of '%s'",
+                         crypto_registry_status_str(status), (int)line, path);
+        return;
+    }
+    sqlite3_result_int(context, 1);
+}
+
+/*
+** Rates for crypto_value_in, one table per connection. crypto_set_rate and
+** crypto_clear_rates change it and crypto_value_in reads it; all three get it
+** as their user data, and crypto_value_in/6, registered first, frees it with
+** the connection. Rates are parsed once, when they are set, so valuing a row costs
+** a lookup, a multiply and a division by a prepared divisor.
+*/
+static void crypto_rates_free(void *p){
+  crypto_rate_table_clear((crypto_rate_table_t *)p);
+  sqlite3_free(p);
+}
+
+//-----------------------------
+// crypto_set_rate_sqlite
+//
+// crypto_set_rate(from_crypto, from_denom, to_crypto, to_denom, price): one
+// from_denom is worth price to_denom from now on in this connection, replacing any
+// rate between the two types. Apply it to every row of a price table to load it.
+// Returns 1.
+static void crypto_set_rate_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    (void)argc;
+    crypto_rate_table_t *rates = (crypto_rate_table_t *)sqlite3_user_data(context);
+    const unsigned char *price = sqlite3_value_text(argv[4]);
+    if (!sqlite3_value_text(argv[0]) || !sqlite3_value_text(argv[1]) ||
+        !sqlite3_value_text(argv[2]) || !sqlite3_value_text(argv[3]) || !price) {
+        result_error_fmt(context, "crypto_set_rate: Invalid arguments");
+        return;
+    }
+
+    crypto_type_t from_type = resolve_type_arg(context, argv, 0);
+    crypto_type_t to_type = resolve_type_arg(context, argv, 2);
+    if (from_type == CRYPTO_COUNT || to_type == CRYPTO_COUNT) {
+        result_error_fmt(context, "crypto_set_rate: Invalid crypto type");
+        return;
+    }
+    crypto_denom_t from = resolve_denom_arg(context, argv, 1, from_type);
+    crypto_denom_t to = resolve_denom_arg(context, argv, 3, to_type);
+    if (from == DENOM_COUNT || to == DENOM_COUNT) {
+        result_error_fmt(context, "crypto_set_rate: Invalid denomination");
+        return;
+    }
+    if (from_type == to_type) {
+        result_error_fmt(context, "crypto_set_rate: Rates are between two different crypto types");
+        return;
+    }
+    if (!crypto_rate_table_set(rates, from, to, (const char*)price)) {
+        // A valid non-negative price only fails when the table cannot grow
+        if (crypto_is_valid_decimal((const char*)price) && !strchr((const char*)price, '-')) {
+            sqlite3_result_error_nomem(context);
+        } else {
+            result_error_fmt(context, "crypto_set_rate: Invalid price '%s'", price);
+        }
+        return;
+    }
+    sqlite3_result_int(context, 1);
+}
+
+//-----------------------------
+// crypto_clear_rates_sqlite
+//
+// crypto_clear_rates(): forget every rate set in this connection. Returns how many
+// there were.
+static void crypto_clear_rates_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    (void)argc;
+    (void)argv;
+    crypto_rate_table_t *rates = (crypto_rate_table_t *)sqlite3_user_data(context);
+    sqlite3_int64 count = (sqlite3_int64)rates->count;
+    crypto_rate_table_clear(rates);
+    sqlite3_result_int64(context, count);
+}
+
+//-----------------------------
+// crypto_value_in_sqlite
+//
+// crypto_value_in(to_crypto, to_denom, from_crypto, from_denom, amount[, rounding]):
+// amount, in from_denom, valued in to_denom at the rate set with crypto_set_rate
+// and rounded once to to_crypto's smallest unit. rounding is one of 'trunc' (the
+// default), 'floor', 'ceil', 'half_up' or 'half_even'. Amounts already of
+// to_crypto are only rescaled. BLOB amounts give a BLOB result.
+static void crypto_value_in_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    crypto_rate_table_t *rates = (crypto_rate_table_t *)sqlite3_user_data(context);
+    const unsigned char *amount_str = operand_arg(argv[4]);
+    if (!sqlite3_value_text(argv[0]) || !sqlite3_value_text(argv[1]) ||
+        !sqlite3_value_text(argv[2]) || !sqlite3_value_text(argv[3]) || !amount_str) {
+        result_error_fmt(context, "crypto_value_in: Invalid arguments");
+        return;
+    }
+    crypto_rounding_t rounding = CRYPTO_ROUND_TRUNCATE;
+    if (argc == 6) {
+        const unsigned char *rounding_str = sqlite3_value_text(argv[5]);
+        if (!rounding_str || !parse_rounding((const char*)rounding_str, &rounding)) {
+            result_error_fmt(context, "crypto_value_in: Invalid rounding mode '%s'",
+                             rounding_str ? (const char*)rounding_str : "NULL");
+            return;
+        }
+    }
+
+    crypto_type_t to_type = resolve_type_arg(context, argv, 0);
+    crypto_type_t from_type = resolve_type_arg(context, argv, 2);
+    if (to_type == CRYPTO_COUNT || from_type == CRYPTO_COUNT) {
+        result_error_fmt(context, "crypto_value_in: Invalid crypto type");
+        return;
+    }
+    crypto_denom_t to = resolve_denom_arg(context, argv, 1, to_type);
+    crypto_denom_t from = resolve_denom_arg(context, argv, 3, from_type);
+    if (to == DENOM_COUNT || from == DENOM_COUNT) {
+        result_error_fmt(context, "crypto_value_in: Invalid denomination");
+        return;
+    }
+    const crypto_rate_t *rate = NULL;
+    if (from_type != to_type) {
+        rate = crypto_rate_table_find(rates, from_type, to_type);
+        if (!rate) {
+            result_error_fmt(context, "crypto_value_in: No rate from %s to %s",
+                             crypto_type_def(from_type)->symbol, crypto_type_def(to_type)->symbol);
+            return;
+        }
+    }
+
+    crypto_val_t amount, value;
+    crypto_init(&amount, from_type);
+    if (!parse_operand(context, argv[4], from, &amount, "crypto_value_in", "amount")) {
+        crypto_clear(&amount);
+        return;
+    }
+    if (rate) {
+        crypto_init(&value, to_type);
+        crypto_rate_apply(&value, &amount, rate, rounding);
+        result_crypto_value(context, &value, to, is_blob_operand(argv[4]));
+        crypto_clear(&value);
+    } else {
+        result_crypto_value(context, &amount, to, is_blob_operand(argv[4]));
+    }
+    crypto_clear(&amount);
+}
+
+/*
+** The library's own heap allocations go through SQLite so they show up in
+** sqlite3_memory_used() and honour soft heap limits. GMP keeps its own
+** allocator: its hooks are process-wide and other GMP users share them.
+*/
+static void *crypto_sqlite_malloc(size_t n){
+  CRYPTO_STATS_ADD(CRYPTO_STATS_ALLOCS, 1);
+  CRYPTO_STATS_ADD(CRYPTO_STATS_ALLOC_BYTES, n);
+  return sqlite3_malloc64((sqlite3_uint64)n);
+}
+
+static void *crypto_sqlite_realloc(void *p, size_t n){
+  CRYPTO_STATS_ADD(CRYPTO_STATS_ALLOCS, 1);
+  CRYPTO_STATS_ADD(CRYPTO_STATS_ALLOC_BYTES, n);
+  return sqlite3_realloc64(p, (sqlite3_uint64)n);
+}
+
+/*
+** Instrumented entry points, one per registered SQL function. Without
+** CRYPTO_STATS these expand to nothing and the plain implementations are
+** registered.
+*/
+CRYPTO_STATS_WRAP(crypto_addsub_sqlite, CRYPTO_STATS_FN_ADD)
+CRYPTO_STATS_WRAP(crypto_addsub_sqlite, CRYPTO_STATS_FN_SUB)
+CRYPTO_STATS_WRAP(crypto_muldiv_sqlite, CRYPTO_STATS_FN_MUL)
+CRYPTO_STATS_WRAP(crypto_muldiv_sqlite, CRYPTO_STATS_FN_DIV_TRUNC)
+CRYPTO_STATS_WRAP(crypto_muldiv_sqlite, CRYPTO_STATS_FN_DIV_FLOOR)
+CRYPTO_STATS_WRAP(crypto_muldiv_sqlite, CRYPTO_STATS_FN_DIV_CEIL)
+CRYPTO_STATS_WRAP(crypto_fused_muldiv_sqlite, CRYPTO_STATS_FN_MULDIV)
+CRYPTO_STATS_WRAP(crypto_scale_sqlite, CRYPTO_STATS_FN_SCALE)
+CRYPTO_STATS_WRAP(crypto_cmp_sqlite, CRYPTO_STATS_FN_CMP)
+CRYPTO_STATS_WRAP(crypto_blob_sqlite, CRYPTO_STATS_FN_TO_BLOB)
+CRYPTO_STATS_WRAP(crypto_blob_sqlite, CRYPTO_STATS_FN_FROM_BLOB)
+CRYPTO_STATS_WRAP(crypto_sum_step, CRYPTO_STATS_FN_SUM)
+CRYPTO_STATS_WRAP(crypto_minmax_step, CRYPTO_STATS_FN_MAX)
+CRYPTO_STATS_WRAP(crypto_minmax_step, CRYPTO_STATS_FN_MIN)
+
+//-----------------------------
+// crypto_stats_reset_sqlite
+//
+// Zero the crypto_stats counters. Returns 1, or 0 when the extension was built
+// without CRYPTO_STATS and there is nothing to reset.
+static void crypto_stats_reset_sqlite(
+    sqlite3_context *context,
+    int argc,
+    sqlite3_value **argv
+){
+    (void)argc;
+    (void)argv;
+    crypto_stats_reset();
+#ifdef CRYPTO_STATS
+    sqlite3_result_int(context, 1);
+#else
+    sqlite3_result_int(context, 0);
+#endif
+}
+
 //-----------------------------
 // Entry point for the extension
 #ifdef _WIN32
@@ -791,66 +1848,72 @@ int sqlite3_cryptodecimalextension_init(
     const sqlite3_api_routines *pApi
 ){
     SQLITE_EXTENSION_INIT2(pApi);
+    crypto_set_allocator(crypto_sqlite_malloc, crypto_sqlite_realloc, sqlite3_free);
     // Create or register the function crypto_add
     void *pOp = (void*)(intptr_t)ARITHMETIC_ADD;
-    if (sqlite3_create_function(db, "crypto_add", 4, SQLITE_UTF8, pOp,
-                                crypto_addsub_sqlite, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_create_function(db, "crypto_add", 4, CRYPTO_FUNC_FLAGS, pOp,
+                                CRYPTO_STATS_FUNC(crypto_addsub_sqlite, CRYPTO_STATS_FN_ADD), NULL, NULL) != SQLITE_OK) {
         *pzErrMsg = sqlite3_mprintf("Error registering crypto_add function");
         return SQLITE_ERROR;
     }
     // Create or register the function crypto_sub
     pOp = (void*)(intptr_t)ARITHMETIC_SUB;
-    if (sqlite3_create_function(db, "crypto_sub", 4, SQLITE_UTF8, pOp,
-                                crypto_addsub_sqlite, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_create_function(db, "crypto_sub", 4, CRYPTO_FUNC_FLAGS, pOp,
+                                CRYPTO_STATS_FUNC(crypto_addsub_sqlite, CRYPTO_STATS_FN_SUB), NULL, NULL) != SQLITE_OK) {
         *pzErrMsg = sqlite3_mprintf("Error registering crypto_sub function");
         return SQLITE_ERROR;
     }
     // Create or register the function crypto_mul
     pOp = (void*)(intptr_t)ARITHMETIC_MUL;
-    if (sqlite3_create_function(db, "crypto_mul", 4, SQLITE_UTF8, pOp,
-                                crypto_muldiv_sqlite, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_create_function(db, "crypto_mul", 4, CRYPTO_FUNC_FLAGS, pOp,
+                                CRYPTO_STATS_FUNC(crypto_muldiv_sqlite, CRYPTO_STATS_FN_MUL), NULL, NULL) != SQLITE_OK) {
         *pzErrMsg = sqlite3_mprintf("Error registering crypto_mul function");
         return SQLITE_ERROR;
     }
     // Create or register the function crypto_div_trunc
     pOp = (void*)(intptr_t)ARITHMETIC_DIV_TRUNC;
-    if (sqlite3_create_function(db, "crypto_div_trunc", 4, SQLITE_UTF8, pOp,
-                                crypto_muldiv_sqlite, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_create_function(db, "crypto_div_trunc", 4, CRYPTO_FUNC_FLAGS, pOp,
+                                CRYPTO_STATS_FUNC(crypto_muldiv_sqlite, CRYPTO_STATS_FN_DIV_TRUNC), NULL, NULL) != SQLITE_OK) {
         *pzErrMsg = sqlite3_mprintf("Error registering crypto_div_trunc function");
         return SQLITE_ERROR;
     }
     // Create or register the function crypto_div_floor
     pOp = (void*)(intptr_t)ARITHMETIC_DIV_FLOOR;
-    if (sqlite3_create_function(db, "crypto_div_floor", 4, SQLITE_UTF8, pOp,
-                                crypto_muldiv_sqlite, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_create_function(db, "crypto_div_floor", 4, CRYPTO_FUNC_FLAGS, pOp,
+                                CRYPTO_STATS_FUNC(crypto_muldiv_sqlite, CRYPTO_STATS_FN_DIV_FLOOR), NULL, NULL) != SQLITE_OK) {
         *pzErrMsg = sqlite3_mprintf("Error registering crypto_div_floor function");
         return SQLITE_ERROR;
     }
     // Create or register the function crypto_div_ceil
     pOp = (void*)(intptr_t)ARITHMETIC_DIV_CEIL;
-    if (sqlite3_create_function(db, "crypto_div_ceil", 4, SQLITE_UTF8, pOp,
-                                crypto_muldiv_sqlite, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_create_function(db, "crypto_div_ceil", 4, CRYPTO_FUNC_FLAGS, pOp,
+                                CRYPTO_STATS_FUNC(crypto_muldiv_sqlite, CRYPTO_STATS_FN_DIV_CEIL), NULL, NULL) != SQLITE_OK) {
         *pzErrMsg = sqlite3_mprintf("Error registering crypto_div_ceil function");
         return SQLITE_ERROR;
     }
+    // Create or register the function crypto_muldiv
+    if (sqlite3_create_function(db, "crypto_muldiv", 6, CRYPTO_FUNC_FLAGS, NULL,
+                                CRYPTO_STATS_FUNC(crypto_fused_muldiv_sqlite, CRYPTO_STATS_FN_MULDIV), NULL, NULL) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_muldiv function");
+        return SQLITE_ERROR;
+    }
     // Create or register the function crypto_scale
-    if (sqlite3_create_function(db, "crypto_scale", 4, SQLITE_UTF8, NULL,
-                                crypto_scale_sqlite, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_create_function(db, "crypto_scale", 4, CRYPTO_FUNC_FLAGS, NULL,
+                                CRYPTO_STATS_FUNC(crypto_scale_sqlite, CRYPTO_STATS_FN_SCALE), NULL, NULL) != SQLITE_OK) {
         *pzErrMsg = sqlite3_mprintf("Error registering crypto_scale function");
         return SQLITE_ERROR;
     }
-    // create aggregate function: crypto_sum
-    // The last parameter to sqlite3_create_function_v2 is a destructor for the app data, if needed.
-    // We'll pass NULL here.
-    int rc = sqlite3_create_function_v2(
+    // Register the aggregate and window function crypto_sum
+    int rc = sqlite3_create_window_function(
         db,
         "crypto_sum",         // function name
         4,                 // number of arguments
-        SQLITE_UTF8,       // preferred text encoding
+        CRYPTO_FUNC_FLAGS, // preferred text encoding and function flags
         NULL,              // application data
-        NULL,              // xFunc (scalar)
-        crypto_sum_step,      // xStep (aggregate step)
+        CRYPTO_STATS_FUNC(crypto_sum_step, CRYPTO_STATS_FN_SUM), // xStep (aggregate step)
         crypto_sum_final,     // xFinal (aggregate final)
+        crypto_sum_value,     // xValue (current window value)
+        crypto_sum_inverse,   // xInverse (row leaving the window)
         NULL               // xDestroy
     );
 
@@ -859,16 +1922,17 @@ int sqlite3_cryptodecimalextension_init(
         return SQLITE_ERROR;
     }
 
-    // Register crypto_max aggregate function
-    rc = sqlite3_create_function_v2(
+    // Register the aggregate and window function crypto_max
+    rc = sqlite3_create_window_function(
         db,
         "crypto_max",         // function name
         4,                 // number of arguments
-        SQLITE_UTF8,       // preferred text encoding
-        NULL,              // application data
-        NULL,              // xFunc (scalar)
-        crypto_max_step,      // xStep (aggregate step)
-        crypto_max_final,     // xFinal (aggregate final)
+        CRYPTO_FUNC_FLAGS, // preferred text encoding and function flags
+        (void*)&crypto_max_def, // application data
+        CRYPTO_STATS_FUNC(crypto_minmax_step, CRYPTO_STATS_FN_MAX), // xStep (aggregate step)
+        crypto_minmax_final,  // xFinal (aggregate final)
+        crypto_minmax_value,  // xValue (current window value)
+        crypto_minmax_inverse, // xInverse (row leaving the window)
         NULL               // xDestroy
     );
 
@@ -877,16 +1941,17 @@ int sqlite3_cryptodecimalextension_init(
         return SQLITE_ERROR;
     }
 
-    // Register crypto_min aggregate function
-    rc = sqlite3_create_function_v2(
+    // Register the aggregate and window function crypto_min
+    rc = sqlite3_create_window_function(
         db,
         "crypto_min",         // function name
         4,                 // number of arguments
-        SQLITE_UTF8,       // preferred text encoding
-        NULL,              // application data
-        NULL,              // xFunc (scalar)
-        crypto_min_step,      // xStep (aggregate step)
-        crypto_min_final,     // xFinal (aggregate final)
+        CRYPTO_FUNC_FLAGS, // preferred text encoding and function flags
+        (void*)&crypto_min_def, // application data
+        CRYPTO_STATS_FUNC(crypto_minmax_step, CRYPTO_STATS_FN_MIN), // xStep (aggregate step)
+        crypto_minmax_final,  // xFinal (aggregate final)
+        crypto_minmax_value,  // xValue (current window value)
+        crypto_minmax_inverse, // xInverse (row leaving the window)
         NULL               // xDestroy
     );
 
@@ -895,6 +1960,30 @@ int sqlite3_cryptodecimalextension_init(
         return SQLITE_ERROR;
     }
 
+    // Register the mergeable partial aggregates crypto_sum_partial and crypto_sum_merge
+    rc = sqlite3_create_function(db, "crypto_sum_partial", 3, CRYPTO_FUNC_FLAGS, NULL,
+                                 NULL, crypto_sum_partial_step, crypto_partial_final);
+    if (rc != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_sum_partial function");
+        return SQLITE_ERROR;
+    }
+    rc = sqlite3_create_function(db, "crypto_sum_merge", 1, CRYPTO_FUNC_FLAGS, NULL,
+                                 NULL, crypto_sum_merge_step, crypto_partial_final);
+    if (rc != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_sum_merge function");
+        return SQLITE_ERROR;
+    }
+
+    // Register the readers of a partial
+    for (int field = PARTIAL_FIELD_SUM; field <= PARTIAL_FIELD_COUNT; field++) {
+        if (sqlite3_create_function(db, crypto_partial_field_str[field], field == PARTIAL_FIELD_COUNT ? 1 : 2,
+                                    CRYPTO_FUNC_FLAGS, (void*)(intptr_t)field,
+                                    crypto_partial_field_sqlite, NULL, NULL) != SQLITE_OK) {
+            *pzErrMsg = sqlite3_mprintf("Error registering %s function", crypto_partial_field_str[field]);
+            return SQLITE_ERROR;
+        }
+    }
+
     // Register "crypto_types" virtual table.
     rc = sqlite3_create_module(db, "crypto_types", &cryptoTypesModule, 0);
     if (rc == SQLITE_OK) {
@@ -931,12 +2020,102 @@ int sqlite3_cryptodecimalextension_init(
         return SQLITE_ERROR;
     }
 
+    // Register the eponymous-only table-valued function crypto_sum_all
+    if (sqlite3_create_module(db, "crypto_sum_all", &cryptoSumAllModule, 0) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_sum_all table-valued function");
+        return SQLITE_ERROR;
+    }
+
+    // Register the crypto_balances module; its tables are created with CREATE VIRTUAL TABLE
+    if (sqlite3_create_module(db, "crypto_balances", &cryptoBalancesModule, 0) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_balances virtual table module");
+        return SQLITE_ERROR;
+    }
+
+    // Register "crypto_stats" virtual table; it is empty unless built with CRYPTO_STATS
+    rc = sqlite3_create_module(db, "crypto_stats", &cryptoStatsModule, 0);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db,
+            "CREATE VIRTUAL TABLE temp.crypto_stats USING crypto_stats",
+            NULL, NULL, NULL
+        );
+    }
+
+    if (rc != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_stats virtual table");
+        return SQLITE_ERROR;
+    }
+
+    // Create or register the function crypto_stats_reset; it has side effects,
+    // so it is neither deterministic nor innocuous
+    if (sqlite3_create_function(db, "crypto_stats_reset", 0, SQLITE_UTF8 | SQLITE_DIRECTONLY, NULL,
+                                crypto_stats_reset_sqlite, NULL, NULL) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_stats_reset function");
+        return SQLITE_ERROR;
+    }
+
+    // Create or register the registry functions; they change process-wide state and
+    // read files, so they may only be called directly
+    if (sqlite3_create_function(db, "crypto_register_type", 3, SQLITE_UTF8 | SQLITE_DIRECTONLY, NULL,
+                                crypto_register_sqlite, NULL, NULL) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_register_type function");
+        return SQLITE_ERROR;
+    }
+    if (sqlite3_create_function(db, "crypto_register_denom", 4, SQLITE_UTF8 | SQLITE_DIRECTONLY, (void*)1,
+                                crypto_register_sqlite, NULL, NULL) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_register_denom function");
+        return SQLITE_ERROR;
+    }
+    if (sqlite3_create_function(db, "crypto_load_assets", 1, SQLITE_UTF8 | SQLITE_DIRECTONLY, NULL,
+                                crypto_load_assets_sqlite, NULL, NULL) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_load_assets function");
+        return SQLITE_ERROR;
+    }
+
+    // Create or register the valuation functions, which share this connection's rate
+    // table. Setting and clearing rates changes state, so those may only be called
+    // directly; valuations depend on the rates set, so they are not deterministic.
+    crypto_rate_table_t *rates = sqlite3_malloc(sizeof(*rates));
+    if (!rates) {
+        return SQLITE_NOMEM;
+    }
+    crypto_rate_table_init(rates);
+    // Register the function that owns the table first: SQLite calls the destructor
+    // itself if this fails, and nothing else holds the table yet. Once it is
+    // registered the table lives until the connection closes, whatever follows.
+    if (sqlite3_create_function_v2(db, "crypto_value_in", 6, SQLITE_UTF8 | SQLITE_INNOCUOUS, rates,
+                                   crypto_value_in_sqlite, NULL, NULL, crypto_rates_free) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_value_in function");
+        return SQLITE_ERROR;
+    }
+    if (sqlite3_create_function(db, "crypto_value_in", 5, SQLITE_UTF8 | SQLITE_INNOCUOUS, rates,
+                                crypto_value_in_sqlite, NULL, NULL) != SQLITE_OK ||
+        sqlite3_create_function(db, "crypto_set_rate", 5, SQLITE_UTF8 | SQLITE_DIRECTONLY, rates,
+                                crypto_set_rate_sqlite, NULL, NULL) != SQLITE_OK ||
+        sqlite3_create_function(db, "crypto_clear_rates", 0, SQLITE_UTF8 | SQLITE_DIRECTONLY, rates,
+                                crypto_clear_rates_sqlite, NULL, NULL) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering the rate functions");
+        return SQLITE_ERROR;
+    }
+
     // Create or register the function crypto_cmp
-    if (sqlite3_create_function(db, "crypto_cmp", 4, SQLITE_UTF8, NULL,
-                                crypto_cmp_sqlite, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_create_function(db, "crypto_cmp", 4, CRYPTO_FUNC_FLAGS, NULL,
+                                CRYPTO_STATS_FUNC(crypto_cmp_sqlite, CRYPTO_STATS_FN_CMP), NULL, NULL) != SQLITE_OK) {
         *pzErrMsg = sqlite3_mprintf("Error registering crypto_cmp function");
         return SQLITE_ERROR;
     }
 
+    // Create or register the BLOB conversion functions
+    if (sqlite3_create_function(db, "crypto_to_blob", 3, CRYPTO_FUNC_FLAGS, (void*)1,
+                                CRYPTO_STATS_FUNC(crypto_blob_sqlite, CRYPTO_STATS_FN_TO_BLOB), NULL, NULL) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_to_blob function");
+        return SQLITE_ERROR;
+    }
+    if (sqlite3_create_function(db, "crypto_from_blob", 3, CRYPTO_FUNC_FLAGS, NULL,
+                                CRYPTO_STATS_FUNC(crypto_blob_sqlite, CRYPTO_STATS_FN_FROM_BLOB), NULL, NULL) != SQLITE_OK) {
+        *pzErrMsg = sqlite3_mprintf("Error registering crypto_from_blob function");
+        return SQLITE_ERROR;
+    }
+
     return SQLITE_OK;
 }
@@ -19,6 +19,10 @@
 **
 ** Usage in SQL:
 **   SELECT symbol, name, crypto_symbol, decimals FROM crypto_denoms();
+**
+** Equality constraints on symbol and crypto_symbol go through the library's
+** symbol index: both together are a single lookup, crypto_symbol alone walks
+** that type's denominations, and symbol alone probes each type once.
 */
 
 // Forward declarations
@@ -45,10 +49,23 @@ typedef struct {
   /* You could store additional fields for state here. */
 } cryptoDenomsVtab;
 
-/* Cursor structure - tracks our current row index. */
+/* Column numbers, in schema order. */
+#define DENOMS_SYMBOL 0
+#define DENOMS_CRYPTO_SYMBOL 2
+
+/* idxNum bits: which constraint values xFilter receives, crypto_symbol first. */
+#define DENOMS_IDX_SYMBOL 1
+#define DENOMS_IDX_TYPE   2
+
+/* Cursor structure - tracks the current denomination. */
 typedef struct {
   sqlite3_vtab_cursor base;  /* Base class. Must be first. */
-  int rowid;                 /* Current row index. */
+  int idxNum;                /* Plan chosen by xBestIndex. */
+  crypto_denom_t denom;      /* Current row; DENOM_COUNT at EOF. */
+  size_t end;                /* Full scan: one past the last denom index. */
+  size_t iType;              /* Symbol only: index of the type just probed. */
+  char *zSymbol;             /* Symbol only: the symbol being probed for. */
+  int nSymbol;               /* Length of zSymbol in bytes. */
 } cryptoDenomsCursor;
 
 /*
@@ -99,15 +116,58 @@ static int cryptoDenomsDisconnect(sqlite3_vtab *pVtab){
 }
 
 /*
-** The query planner calls this to figure out the best way to query
-** your virtual table. If you have no indexes, you can often just
-** return OK. For demonstration, we’ll set some arbitrary cost.
+** The query planner calls this to figure out the best way to query the
+** table. Costs count the rows visited: one for a (crypto_symbol, symbol)
+** lookup, a type's denominations for crypto_symbol alone, one probe per type
+** for symbol alone, and every denomination for a scan.
 */
 static int cryptoDenomsBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo){
   UNUSED(pVTab);
-  UNUSED(pIdxInfo);
-  pIdxInfo->estimatedCost = (double)1;
-  pIdxInfo->estimatedRows = DENOM_COUNT; /* We know there are DENOM_COUNT crypto denoms */
+  int iSymbol = -1;
+  int iType = -1;
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *c = &pIdxInfo->aConstraint[i];
+    if (!c->usable || c->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    /* The index compares bytes, so only the default collation can use it */
+    if (sqlite3_stricmp(sqlite3_vtab_collation(pIdxInfo, i), "BINARY") != 0) continue;
+    if (c->iColumn == DENOMS_SYMBOL && iSymbol < 0) iSymbol = i;
+    if (c->iColumn == DENOMS_CRYPTO_SYMBOL && iType < 0) iType = i;
+  }
+
+  double nDenom = (double)crypto_denom_count(); /* Built-in and registered denoms */
+  double nType = (double)crypto_type_count();
+  int nArg = 0;
+  pIdxInfo->idxNum = 0;
+  if (iType >= 0) {
+    pIdxInfo->aConstraintUsage[iType].argvIndex = ++nArg;
+    pIdxInfo->aConstraintUsage[iType].omit = 1;
+    pIdxInfo->idxNum |= DENOMS_IDX_TYPE;
+  }
+  if (iSymbol >= 0) {
+    pIdxInfo->aConstraintUsage[iSymbol].argvIndex = ++nArg;
+    pIdxInfo->aConstraintUsage[iSymbol].omit = 1;
+    pIdxInfo->idxNum |= DENOMS_IDX_SYMBOL;
+  }
+
+  switch (pIdxInfo->idxNum) {
+    case DENOMS_IDX_TYPE | DENOMS_IDX_SYMBOL:
+      pIdxInfo->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+      pIdxInfo->estimatedCost = (double)1;
+      pIdxInfo->estimatedRows = 1;
+      break;
+    case DENOMS_IDX_TYPE:
+      pIdxInfo->estimatedCost = nDenom / nType + 1;
+      pIdxInfo->estimatedRows = (sqlite3_int64)(nDenom / nType + 1);
+      break;
+    case DENOMS_IDX_SYMBOL:
+      pIdxInfo->estimatedCost = nType;
+      pIdxInfo->estimatedRows = 2;
+      break;
+    default:
+      pIdxInfo->estimatedCost = nDenom;
+      pIdxInfo->estimatedRows = (sqlite3_int64)nDenom;
+      break;
+  }
   return SQLITE_OK;
 }
 
@@ -125,53 +185,133 @@ static int cryptoDenomsOpen(sqlite3_vtab *p, sqlite3_vtab_cursor **ppCursor){
 /* Closes a cursor. */
 static int cryptoDenomsClose(sqlite3_vtab_cursor *cur){
   cryptoDenomsCursor *pCur = (cryptoDenomsCursor*)cur;
+  sqlite3_free(pCur->zSymbol);
   sqlite3_free(pCur);
   return SQLITE_OK;
 }
 
+/*
+** The text an equality constraint compares a symbol column with, or NULL
+** when it can match no symbol: a NULL or a BLOB never equals a TEXT value.
+*/
+static const char *denomsConstraintText(sqlite3_value *pVal, int *pn){
+  int eType = sqlite3_value_type(pVal);
+  if (eType == SQLITE_NULL || eType == SQLITE_BLOB) return NULL;
+  const char *z = (const char*)sqlite3_value_text(pVal);
+  *pn = sqlite3_value_bytes(pVal);
+  return z;
+}
+
+/*
+** Symbol-only plan: moves to the denomination named zSymbol of the first type
+** at or after pCur->iType that has one.
+*/
+static void denomsProbeTypes(cryptoDenomsCursor *pCur){
+  size_t nType = crypto_type_count();
+  pCur->denom = DENOM_COUNT;
+  for (; pCur->iType < nType; pCur->iType++) {
+    pCur->denom = crypto_get_denom_for_symbol_n(crypto_type_at(pCur->iType),
+                                                pCur->zSymbol, (size_t)pCur->nSymbol);
+    if (pCur->denom != DENOM_COUNT) return;
+  }
+}
+
 /* Resets the cursor to the first row of results. */
 static int cryptoDenomsFilter(sqlite3_vtab_cursor *pCursor, int idxNum,
                              const char *idxStr, int argc, sqlite3_value **argv){
-  UNUSED(idxNum);
   UNUSED(idxStr);
-  UNUSED(argc);
-  UNUSED(argv);
   cryptoDenomsCursor *pCur = (cryptoDenomsCursor*)pCursor;
-  pCur->rowid = 0;
+  int iArg = 0;
+  sqlite3_free(pCur->zSymbol);
+  pCur->zSymbol = NULL;
+  pCur->idxNum = idxNum;
+  pCur->denom = DENOM_COUNT;
+
+  crypto_type_t type = CRYPTO_COUNT;
+  if ((idxNum & DENOMS_IDX_TYPE) && iArg < argc) {
+    int n = 0;
+    const char *z = denomsConstraintText(argv[iArg++], &n);
+    type = z ? crypto_get_type_for_symbol_n(z, (size_t)n) : CRYPTO_COUNT;
+    if (type == CRYPTO_COUNT) return SQLITE_OK;
+  }
+  const char *zSymbol = NULL;
+  int nSymbol = 0;
+  if ((idxNum & DENOMS_IDX_SYMBOL) && iArg < argc) {
+    zSymbol = denomsConstraintText(argv[iArg++], &nSymbol);
+    if (!zSymbol) return SQLITE_OK;
+  }
+
+  switch (idxNum) {
+    case DENOMS_IDX_TYPE | DENOMS_IDX_SYMBOL:
+      pCur->denom = crypto_get_denom_for_symbol_n(type, zSymbol, (size_t)nSymbol);
+      break;
+    case DENOMS_IDX_TYPE:
+      pCur->denom = crypto_first_denom(type);
+      break;
+    case DENOMS_IDX_SYMBOL:
+      pCur->zSymbol = sqlite3_malloc(nSymbol > 0 ? nSymbol : 1);
+      if (!pCur->zSymbol) return SQLITE_NOMEM;
+      memcpy(pCur->zSymbol, zSymbol, (size_t)nSymbol);
+      pCur->nSymbol = nSymbol;
+      pCur->iType = 0;
+      denomsProbeTypes(pCur);
+      break;
+    default:
+      /* Rows are dense denom indexes: the built-in denoms, then the registered ones. */
+      pCur->end = crypto_denom_count();
+      pCur->denom = crypto_denom_at(0);
+      break;
+  }
   return SQLITE_OK;
 }
 
 /* Advances the cursor to the next row. */
 static int cryptoDenomsNext(sqlite3_vtab_cursor *pCursor){
   cryptoDenomsCursor *pCur = (cryptoDenomsCursor*)pCursor;
-  pCur->rowid++;
+  switch (pCur->idxNum) {
+    case DENOMS_IDX_TYPE | DENOMS_IDX_SYMBOL:
+      pCur->denom = DENOM_COUNT;
+      break;
+    case DENOMS_IDX_TYPE:
+      pCur->denom = crypto_next_denom(pCur->denom);
+      break;
+    case DENOMS_IDX_SYMBOL:
+      pCur->iType++;
+      denomsProbeTypes(pCur);
+      break;
+    default: {
+      size_t next = crypto_denom_index(pCur->denom) + 1;
+      pCur->denom = next < pCur->end ? crypto_denom_at(next) : DENOM_COUNT;
+      break;
+    }
+  }
   return SQLITE_OK;
 }
 
 /* Returns true (1) if we are at the end of our data. */
 static int cryptoDenomsEof(sqlite3_vtab_cursor *pCursor){
   cryptoDenomsCursor *pCur = (cryptoDenomsCursor*)pCursor;
-  /* We know there are DENOM_COUNT crypto denoms. */
-  return (pCur->rowid >= DENOM_COUNT);
+  return pCur->denom == DENOM_COUNT;
 }
 
 /* Returns the column data for the current row/column. */
 static int cryptoDenomsColumn(sqlite3_vtab_cursor *pCursor,
                              sqlite3_context *ctx, int i){
   cryptoDenomsCursor *pCur = (cryptoDenomsCursor*)pCursor;
+  const crypto_denom_def_t *def = crypto_denom_def(pCur->denom);
 
   switch (i) {
     case 0: /* symbol */
-      sqlite3_result_text(ctx, crypto_denoms[pCur->rowid].symbol, -1, SQLITE_STATIC);
+      sqlite3_result_text(ctx, def->symbol, -1, SQLITE_STATIC);
       break;
     case 1: /* name */
-      sqlite3_result_text(ctx, crypto_denoms[pCur->rowid].name, -1, SQLITE_STATIC);
+      sqlite3_result_text(ctx, def->name, -1, SQLITE_STATIC);
       break;
     case 2: /* crypto_symbol */
-      sqlite3_result_text(ctx, crypto_defs[crypto_denoms[pCur->rowid].crypto_type].symbol, -1, SQLITE_STATIC);
+      sqlite3_result_text(ctx, crypto_type_def(def->crypto_type)->symbol, -1, SQLITE_STATIC);
       break;
     case 3: /* decimals */
-      sqlite3_result_int(ctx, crypto_denoms[pCur->rowid].decimals);
+      sqlite3_result_int(ctx, def->decimals);
       break;
     default:
       /* Should never happen with our declared schema. */
@@ -182,10 +322,10 @@ static int cryptoDenomsColumn(sqlite3_vtab_cursor *pCursor,
   return SQLITE_OK;
 }
 
-/* Returns the current rowid value (just our internal 'rowid'). */
+/* Returns the current rowid: the dense index of the denomination. */
 static int cryptoDenomsRowid(sqlite3_vtab_cursor *pCursor, sqlite_int64 *pRowid){
   cryptoDenomsCursor *pCur = (cryptoDenomsCursor*)pCursor;
-  *pRowid = (sqlite_int64)pCur->rowid;
+  *pRowid = (sqlite_int64)crypto_denom_index(pCur->denom);
   return SQLITE_OK;
 }
 
@@ -17,6 +17,9 @@
 **
 ** Usage in SQL:
 **   SELECT symbol, name FROM crypto_types();
+**
+** An equality constraint on symbol is answered with one lookup in the
+** library's symbol index instead of a scan.
 */
 
 // Forward declarations
@@ -43,10 +46,17 @@ typedef struct {
   /* You could store additional fields for state here. */
 } cryptoTypesVtab;
 
+/* Column numbers, in schema order. */
+#define TYPES_SYMBOL 0
+
+/* idxNum bit set when xFilter receives the symbol to look up. */
+#define TYPES_IDX_SYMBOL 1
+
 /* Cursor structure - tracks our current row index. */
 typedef struct {
   sqlite3_vtab_cursor base;  /* Base class. Must be first. */
-  int rowid;                 /* Current row index. */
+  int rowid;                 /* Current row index (dense type index). */
+  int end;                   /* One past the last row to return. */
 } cryptoTypesCursor;
 
 /*
@@ -97,15 +107,28 @@ static int cryptoTypesDisconnect(sqlite3_vtab *pVtab){
 }
 
 /*
-** The query planner calls this to figure out the best way to query
-** your virtual table. If you have no indexes, you can often just
-** return OK. For demonstration, we’ll set some arbitrary cost.
+** The query planner calls this to figure out the best way to query the
+** table. symbol = ? is a hash lookup returning at most one row; anything
+** else is a scan of every type, which SQLite then filters.
 */
 static int cryptoTypesBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo){
   UNUSED(pVTab);
-  UNUSED(pIdxInfo);
-  pIdxInfo->estimatedCost = (double)1;
-  pIdxInfo->estimatedRows = CRYPTO_COUNT; /* We know there are CRYPTO_COUNT crypto types */
+  double nRow = (double)crypto_type_count(); /* Built-in and registered types */
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *c = &pIdxInfo->aConstraint[i];
+    if (!c->usable || c->iColumn != TYPES_SYMBOL || c->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    /* The index compares bytes, so only the default collation can use it */
+    if (sqlite3_stricmp(sqlite3_vtab_collation(pIdxInfo, i), "BINARY") != 0) continue;
+    pIdxInfo->aConstraintUsage[i].argvIndex = 1;
+    pIdxInfo->aConstraintUsage[i].omit = 1;
+    pIdxInfo->idxNum = TYPES_IDX_SYMBOL;
+    pIdxInfo->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+    pIdxInfo->estimatedCost = (double)1;
+    pIdxInfo->estimatedRows = 1;
+    return SQLITE_OK;
+  }
+  pIdxInfo->estimatedCost = nRow;
+  pIdxInfo->estimatedRows = (sqlite3_int64)nRow;
   return SQLITE_OK;
 }
 
@@ -130,12 +153,22 @@ static int cryptoTypesClose(sqlite3_vtab_cursor *cur){
 /* Resets the cursor to the first row of results. */
 static int cryptoTypesFilter(sqlite3_vtab_cursor *pCursor, int idxNum,
                              const char *idxStr, int argc, sqlite3_value **argv){
-  UNUSED(idxNum);
   UNUSED(idxStr);
-  UNUSED(argc);
-  UNUSED(argv);
   cryptoTypesCursor *pCur = (cryptoTypesCursor*)pCursor;
   pCur->rowid = 0;
+  pCur->end = (int)crypto_type_count();
+  if ((idxNum & TYPES_IDX_SYMBOL) && argc == 1) {
+    /* A NULL or BLOB never equals a TEXT symbol */
+    int eType = sqlite3_value_type(argv[0]);
+    const char *z = eType == SQLITE_NULL || eType == SQLITE_BLOB ? NULL : (const char*)sqlite3_value_text(argv[0]);
+    crypto_type_t type = z ? crypto_get_type_for_symbol_n(z, (size_t)sqlite3_value_bytes(argv[0])) : CRYPTO_COUNT;
+    if (type == CRYPTO_COUNT) {
+      pCur->end = 0;
+    } else {
+      pCur->rowid = (int)crypto_type_index(type);
+      pCur->end = pCur->rowid + 1;
+    }
+  }
   return SQLITE_OK;
 }
 
@@ -149,21 +182,22 @@ static int cryptoTypesNext(sqlite3_vtab_cursor *pCursor){
 /* Returns true (1) if we are at the end of our data. */
 static int cryptoTypesEof(sqlite3_vtab_cursor *pCursor){
   cryptoTypesCursor *pCur = (cryptoTypesCursor*)pCursor;
-  /* We know there are CRYPTO_COUNT crypto types. */
-  return (pCur->rowid >= CRYPTO_COUNT);
+  /* Rows are dense type indexes: the built-in types, then the registered ones. */
+  return (pCur->rowid >= pCur->end);
 }
 
 /* Returns the column data for the current row/column. */
 static int cryptoTypesColumn(sqlite3_vtab_cursor *pCursor,
                              sqlite3_context *ctx, int i){
   cryptoTypesCursor *pCur = (cryptoTypesCursor*)pCursor;
+  const crypto_def_t *def = crypto_type_def(crypto_type_at((size_t)pCur->rowid));
 
   switch (i) {
     case 0: /* symbol */
-      sqlite3_result_text(ctx, crypto_defs[pCur->rowid].symbol, -1, SQLITE_STATIC);
+      sqlite3_result_text(ctx, def->symbol, -1, SQLITE_STATIC);
       break;
     case 1: /* name */
-      sqlite3_result_text(ctx, crypto_defs[pCur->rowid].name, -1, SQLITE_STATIC);
+      sqlite3_result_text(ctx, def->name, -1, SQLITE_STATIC);
       break;
     default:
       /* Should never happen with our declared schema. */
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "crypto_ledger.h"
+/*
+** Ledger rows for the table-valued functions: resolving a row's asset and
+** denomination symbols, parsing its amount, and formatting the totals.
+*/
+
+void crypto_ledger_reader_init(crypto_ledger_reader_t *reader){
+  reader->asset.len = -1;
+  reader->unit.len = -1;
+}
+
+static bool ledgerSymbolHit(const crypto_ledger_symbol_t *s, crypto_type_t type, const unsigned char *z, int n){
+  return s->len == n && s->type == type && memcmp(s->bytes, z, (size_t)n) == 0;
+}
+
+static void ledgerSymbolSet(crypto_ledger_symbol_t *s, crypto_type_t type, const unsigned char *z, int n, int resolved){
+  if (n > CRYPTO_LEDGER_SYMBOL_MAX) {
+    s->len = -1;
+    return;
+  }
+  memcpy(s->bytes, z, (size_t)n);
+  s->len = n;
+  s->type = type;
+  s->resolved = resolved;
+}
+
+int crypto_ledger_read(crypto_ledger_reader_t *reader, sqlite3_stmt *pStmt, int iCol,
+                       const char *zFunc, crypto_val_t *val, bool *pParsed, char **pzErr){
+  *pParsed = false;
+  const unsigned char *zAsset = sqlite3_column_text(pStmt, iCol);
+  const unsigned char *zDenom = sqlite3_column_text(pStmt, iCol + 1);
+  int isBlob = sqlite3_column_type(pStmt, iCol + 2) == SQLITE_BLOB;
+  const void *pAmount = isBlob ? sqlite3_column_blob(pStmt, iCol + 2)
+                               : (const void*)sqlite3_column_text(pStmt, iCol + 2);
+  if (!zAsset || !zDenom || !pAmount) return SQLITE_OK;
+  int nAsset = sqlite3_column_bytes(pStmt, iCol);
+  int nDenom = sqlite3_column_bytes(pStmt, iCol + 1);
+  int nAmount = sqlite3_column_bytes(pStmt, iCol + 2);
+
+  crypto_type_t type;
+  if (ledgerSymbolHit(&reader->asset, CRYPTO_COUNT, zAsset, nAsset)) {
+    type = reader->asset.resolved;
+  } else {
+    type = crypto_get_type_for_symbol_n((const char*)zAsset, (size_t)nAsset);
+    ledgerSymbolSet(&reader->asset, CRYPTO_COUNT, zAsset, nAsset, type);
+  }
+  if (type == CRYPTO_COUNT) {
+    *pzErr = sqlite3_mprintf("%s: Invalid crypto type '%s'", zFunc, zAsset);
+    return SQLITE_ERROR;
+  }
+  crypto_denom_t denom;
+  if (ledgerSymbolHit(&reader->unit, type, zDenom, nDenom)) {
+    denom = reader->unit.resolved;
+  } else {
+    denom = crypto_get_denom_for_symbol_n(type, (const char*)zDenom, (size_t)nDenom);
+    ledgerSymbolSet(&reader->unit, type, zDenom, nDenom, denom);
+  }
+  if (denom == DENOM_COUNT) {
+    *pzErr = sqlite3_mprintf("%s: Invalid denomination '%s' for %s", zFunc, zDenom, zAsset);
+    return SQLITE_ERROR;
+  }
+
+  /* Invalid decimals and blobs of another type are skipped, as in crypto_sum */
+  crypto_init(val, type);
+  bool parsed = isBlob
+      ? crypto_from_blob(val, pAmount, (size_t)nAmount)
+      : crypto_parse_decimal(val, denom, pAmount, (size_t)nAmount, NULL) == CRYPTO_PARSE_OK;
+  if (!parsed) {
+    crypto_clear(val);
+    return SQLITE_OK;
+  }
+  *pParsed = true;
+  return SQLITE_OK;
+}
+
+crypto_denom_t crypto_ledger_denom(crypto_type_t type){
+  return crypto_get_denom_for_symbol(type, crypto_type_def(type)->symbol);
+}
+
+char *crypto_ledger_format(const crypto_val_t *val, crypto_denom_t denom,
+                           char *buf, size_t cap, int *pn){
+  size_t n = crypto_format_to(buf, cap, val, denom);
+  if (n == CRYPTO_FORMAT_NOMEM) return NULL;
+  if (n < cap) {
+    *pn = (int)n;
+    return buf;
+  }
+  /* A promoted sum wider than the inline bound */
+  char *z = crypto_to_decimal_str((crypto_val_t*)val, denom);
+  if (z) *pn = (int)strlen(z);
+  return z;
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include "crypto_stats.h"
+/*
+** Eponymous virtual table module: "crypto_stats"
+** Presents the extension's instrumentation counters as two columns:
+**   name TEXT   (e.g., "auxdata_hits", "crypto_add.calls", "crypto_add.ns")
+**   value INT   (count, bytes or nanoseconds since load or the last reset)
+**
+** The counters are only compiled in when the extension is built with
+** CRYPTO_STATS defined (make CRYPTO_STATS=1); otherwise the table is empty.
+** Per-function nanoseconds are estimated from a sample of the calls.
+**
+** Usage in SQL:
+**   SELECT name, value FROM crypto_stats() WHERE value > 0;
+**   SELECT crypto_stats_reset();
+*/
+
+// Forward declarations
+static int cryptoStatsConnect(sqlite3 *db, void *pAux,
+                              int argc, const char *const*argv,
+                              sqlite3_vtab **ppVtab, char **pzErr);
+static int cryptoStatsDisconnect(sqlite3_vtab *pVtab);
+static int cryptoStatsBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo);
+static int cryptoStatsOpen(sqlite3_vtab *p, sqlite3_vtab_cursor **ppCursor);
+static int cryptoStatsClose(sqlite3_vtab_cursor *cur);
+static int cryptoStatsFilter(sqlite3_vtab_cursor *pCursor, int idxNum,
+                             const char *idxStr, int argc, sqlite3_value **argv);
+static int cryptoStatsNext(sqlite3_vtab_cursor *pCursor);
+static int cryptoStatsEof(sqlite3_vtab_cursor *pCursor);
+static int cryptoStatsColumn(sqlite3_vtab_cursor *pCursor,
+                             sqlite3_context *ctx, int i);
+static int cryptoStatsRowid(sqlite3_vtab_cursor *pCursor, sqlite_int64 *pRowid);
+
+#define UNUSED(x) (void)(x)
+
+static const char *const crypto_stats_counter_names[CRYPTO_STATS_COUNTER_COUNT] = {
+  [CRYPTO_STATS_PARSE_FAILURES] = "parse_failures",
+  [CRYPTO_STATS_ALLOCS] = "allocs",
+  [CRYPTO_STATS_ALLOC_BYTES] = "alloc_bytes",
+  [CRYPTO_STATS_AUXDATA_HITS] = "auxdata_hits",
+  [CRYPTO_STATS_AUXDATA_MISSES] = "auxdata_misses",
+  [CRYPTO_STATS_MEMO_HITS] = "memo_hits",
+  [CRYPTO_STATS_MEMO_MISSES] = "memo_misses",
+  [CRYPTO_STATS_FAST_PATH] = "fast_path",
+  [CRYPTO_STATS_GMP_FALLBACK] = "gmp_fallback"
+};
+
+static const char *const crypto_stats_fn_names[CRYPTO_STATS_FN_COUNT] = {
+  [CRYPTO_STATS_FN_ADD] = "crypto_add",
+  [CRYPTO_STATS_FN_SUB] = "crypto_sub",
+  [CRYPTO_STATS_FN_MUL] = "crypto_mul",
+  [CRYPTO_STATS_FN_DIV_TRUNC] = "crypto_div_trunc",
+  [CRYPTO_STATS_FN_DIV_FLOOR] = "crypto_div_floor",
+  [CRYPTO_STATS_FN_DIV_CEIL] = "crypto_div_ceil",
+  [CRYPTO_STATS_FN_MULDIV] = "crypto_muldiv",
+  [CRYPTO_STATS_FN_SCALE] = "crypto_scale",
+  [CRYPTO_STATS_FN_CMP] = "crypto_cmp",
+  [CRYPTO_STATS_FN_TO_BLOB] = "crypto_to_blob",
+  [CRYPTO_STATS_FN_FROM_BLOB] = "crypto_from_blob",
+  [CRYPTO_STATS_FN_SUM] = "crypto_sum",
+  [CRYPTO_STATS_FN_MAX] = "crypto_max",
+  [CRYPTO_STATS_FN_MIN] = "crypto_min"
+};
+
+#ifdef CRYPTO_STATS
+
+_Atomic uint64_t crypto_stats_counters[CRYPTO_STATS_COUNTER_COUNT];
+_Atomic uint64_t crypto_stats_calls[CRYPTO_STATS_FN_COUNT];
+_Atomic uint64_t crypto_stats_ns[CRYPTO_STATS_FN_COUNT];
+
+/* Rows: the plain counters, then a calls and an ns row per function */
+#define CRYPTO_STATS_ROWS (CRYPTO_STATS_COUNTER_COUNT + 2 * CRYPTO_STATS_FN_COUNT)
+
+static uint64_t crypto_stats_now_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Count a call; returns its start time when it is sampled and 0 otherwise */
+uint64_t crypto_stats_begin(crypto_stats_fn_t fn){
+  uint64_t n = atomic_fetch_add_explicit(&crypto_stats_calls[fn], 1, memory_order_relaxed);
+  if ((n & ((1u << CRYPTO_STATS_SAMPLE_SHIFT) - 1)) != 0) return 0;
+  return crypto_stats_now_ns();
+}
+
+void crypto_stats_end(crypto_stats_fn_t fn, uint64_t start){
+  if (start == 0) return;
+  uint64_t elapsed = crypto_stats_now_ns() - start;
+  atomic_fetch_add_explicit(&crypto_stats_ns[fn], elapsed << CRYPTO_STATS_SAMPLE_SHIFT, memory_order_relaxed);
+}
+
+void crypto_stats_reset(void){
+  for (int i = 0; i < CRYPTO_STATS_COUNTER_COUNT; i++) {
+    atomic_store_explicit(&crypto_stats_counters[i], 0, memory_order_relaxed);
+  }
+  for (int i = 0; i < CRYPTO_STATS_FN_COUNT; i++) {
+    atomic_store_explicit(&crypto_stats_calls[i], 0, memory_order_relaxed);
+    atomic_store_explicit(&crypto_stats_ns[i], 0, memory_order_relaxed);
+  }
+}
+
+#else
+
+#define CRYPTO_STATS_ROWS 0
+
+void crypto_stats_reset(void){
+}
+
+#endif /* CRYPTO_STATS */
+
+typedef struct {
+  sqlite3_vtab base;  /* Base class.  Must be first. */
+} cryptoStatsVtab;
+
+/* Cursor structure - tracks our current row index. */
+typedef struct {
+  sqlite3_vtab_cursor base;  /* Base class. Must be first. */
+  int rowid;                 /* Current row index. */
+} cryptoStatsCursor;
+
+static int cryptoStatsConnect(
+  sqlite3 *db, void *pAux,
+  int argc, const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pzErr
+){
+  UNUSED(pAux);
+  UNUSED(argc);
+  UNUSED(argv);
+  UNUSED(pzErr);
+  int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(name TEXT, value INT)");
+  if (rc != SQLITE_OK) {
+    return rc;
+  }
+
+  cryptoStatsVtab *pNew = (cryptoStatsVtab*)sqlite3_malloc(sizeof(*pNew));
+  if (!pNew) return SQLITE_NOMEM;
+  memset(pNew, 0, sizeof(*pNew));
+  *ppVtab = (sqlite3_vtab*)pNew;
+  return SQLITE_OK;
+}
+
+static int cryptoStatsDisconnect(sqlite3_vtab *pVtab){
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int cryptoStatsBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo){
+  UNUSED(pVTab);
+  pIdxInfo->estimatedCost = (double)1;
+  pIdxInfo->estimatedRows = CRYPTO_STATS_ROWS;
+  return SQLITE_OK;
+}
+
+static int cryptoStatsOpen(sqlite3_vtab *p, sqlite3_vtab_cursor **ppCursor){
+  UNUSED(p);
+  cryptoStatsCursor *pCur = (cryptoStatsCursor*)sqlite3_malloc(sizeof(*pCur));
+  if (!pCur) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int cryptoStatsClose(sqlite3_vtab_cursor *cur){
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int cryptoStatsFilter(sqlite3_vtab_cursor *pCursor, int idxNum,
+                             const char *idxStr, int argc, sqlite3_value **argv){
+  UNUSED(idxNum);
+  UNUSED(idxStr);
+  UNUSED(argc);
+  UNUSED(argv);
+  cryptoStatsCursor *pCur = (cryptoStatsCursor*)pCursor;
+  pCur->rowid = 0;
+  return SQLITE_OK;
+}
+
+static int cryptoStatsNext(sqlite3_vtab_cursor *pCursor){
+  cryptoStatsCursor *pCur = (cryptoStatsCursor*)pCursor;
+  pCur->rowid++;
+  return SQLITE_OK;
+}
+
+static int cryptoStatsEof(sqlite3_vtab_cursor *pCursor){
+  cryptoStatsCursor *pCur = (cryptoStatsCursor*)pCursor;
+  return (pCur->rowid >= CRYPTO_STATS_ROWS);
+}
+
+static int cryptoStatsColumn(sqlite3_vtab_cursor *pCursor,
+                             sqlite3_context *ctx, int i){
+#ifdef CRYPTO_STATS
+  cryptoStatsCursor *pCur = (cryptoStatsCursor*)pCursor;
+  int row = pCur->rowid;
+  if (row < CRYPTO_STATS_COUNTER_COUNT) {
+    if (i == 0) {
+      sqlite3_result_text(ctx, crypto_stats_counter_names[row], -1, SQLITE_STATIC);
+    } else {
+      sqlite3_result_int64(ctx, (sqlite3_int64)atomic_load_explicit(&crypto_stats_counters[row], memory_order_relaxed));
+    }
+    return SQLITE_OK;
+  }
+  row -= CRYPTO_STATS_COUNTER_COUNT;
+  int fn = row / 2;
+  bool ns = row % 2;
+  if (i == 0) {
+    char *name = sqlite3_mprintf("%s.%s", crypto_stats_fn_names[fn], ns ? "ns" : "calls");
+    if (!name) return SQLITE_NOMEM;
+    sqlite3_result_text(ctx, name, -1, sqlite3_free);
+  } else {
+    _Atomic uint64_t *counter = ns ? &crypto_stats_ns[fn] : &crypto_stats_calls[fn];
+    sqlite3_result_int64(ctx, (sqlite3_int64)atomic_load_explicit(counter, memory_order_relaxed));
+  }
+#else
+  UNUSED(pCursor);
+  UNUSED(i);
+  UNUSED(crypto_stats_counter_names);
+  UNUSED(crypto_stats_fn_names);
+  sqlite3_result_null(ctx);
+#endif
+  return SQLITE_OK;
+}
+
+static int cryptoStatsRowid(sqlite3_vtab_cursor *pCursor, sqlite_int64 *pRowid){
+  cryptoStatsCursor *pCur = (cryptoStatsCursor*)pCursor;
+  *pRowid = (sqlite_int64)pCur->rowid;
+  return SQLITE_OK;
+}
+
+// The module definition for our virtual table.
+sqlite3_module cryptoStatsModule = {
+  0,                         /* iVersion      */
+  cryptoStatsConnect,        /* xCreate       */
+  cryptoStatsConnect,        /* xConnect      */
+  cryptoStatsBestIndex,      /* xBestIndex    */
+  cryptoStatsDisconnect,     /* xDisconnect   */
+  cryptoStatsDisconnect,     /* xDestroy      */
+  cryptoStatsOpen,           /* xOpen         */
+  cryptoStatsClose,          /* xClose        */
+  cryptoStatsFilter,         /* xFilter       */
+  cryptoStatsNext,           /* xNext         */
+  cryptoStatsEof,            /* xEof          */
+  cryptoStatsColumn,         /* xColumn       */
+  cryptoStatsRowid,          /* xRowid        */
+  0,                         /* xUpdate       */
+  0,                         /* xBegin        */
+  0,                         /* xSync         */
+  0,                         /* xCommit       */
+  0,                         /* xRollback     */
+  0,                         /* xFindFunction */
+  0,                         /* xRename       */
+  0,                         /* xSavepoint    */
+  0,                         /* xRelease      */
+  0,                         /* xRollbackTo   */
+  0,                         /* xShadowName   */
+  0                          /* xIntegrity    */
+};
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2025 Charles Benedict, Jr.
+ * See LICENSE.md for licensing information.
+ * This copyright notice must be retained in its entirety.
+ * The LICENSE.md file must be retained and must be included with any distribution of this file.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "crypto_sum_all.h"
+#include "crypto_ledger.h"
+/*
+** Eponymous table-valued function: "crypto_sum_all"
+** Sums a mixed-asset query in a single pass, with one accumulator per crypto
+** type, and presents one row per asset that had at least one value:
+**   asset TEXT  (crypto type symbol, e.g., "ETH")
+**   denom TEXT  (the asset's base unit, e.g., "ETH")
+**   total TEXT  (sum of the asset's amounts in denom)
+**   count INT   (number of amounts summed)
+**
+** The argument is a query whose first three columns are the asset symbol, the
+** denomination symbol and the amount (decimal TEXT or crypto BLOB). As with
+** crypto_sum, rows with a NULL column or an invalid amount are skipped, and an
+** unknown asset or denomination is an error. No sorting or grouping is done.
+** The query must be read-only, and the function may only be used directly in
+** top-level SQL, not from views or triggers.
+**
+** Usage in SQL:
+**   SELECT asset, total FROM crypto_sum_all('SELECT asset, unit, amount FROM ledger');
+*/
+
+// Forward declarations
+static int cryptoSumAllConnect(sqlite3 *db, void *pAux,
+                              int argc, const char *const*argv,
+                              sqlite3_vtab **ppVtab, char **pzErr);
+static int cryptoSumAllDisconnect(sqlite3_vtab *pVtab);
+static int cryptoSumAllBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo);
+static int cryptoSumAllOpen(sqlite3_vtab *p, sqlite3_vtab_cursor **ppCursor);
+static int cryptoSumAllClose(sqlite3_vtab_cursor *cur);
+static int cryptoSumAllFilter(sqlite3_vtab_cursor *pCursor, int idxNum,
+                             const char *idxStr, int argc, sqlite3_value **argv);
+static int cryptoSumAllNext(sqlite3_vtab_cursor *pCursor);
+static int cryptoSumAllEof(sqlite3_vtab_cursor *pCursor);
+static int cryptoSumAllColumn(sqlite3_vtab_cursor *pCursor,
+                             sqlite3_context *ctx, int i);
+static int cryptoSumAllRowid(sqlite3_vtab_cursor *pCursor, sqlite_int64 *pRowid);
+
+#define UNUSED(x) (void)(x)
+
+/* Column numbers; query is the hidden argument column. */
+#define SUM_ALL_ASSET 0
+#define SUM_ALL_DENOM 1
+#define SUM_ALL_TOTAL 2
+#define SUM_ALL_COUNT 3
+#define SUM_ALL_QUERY 4
+
+typedef struct {
+  sqlite3_vtab base;  /* Base class.  Must be first. */
+  sqlite3 *db;        /* Connection the argument query runs on. */
+} cryptoSumAllVtab;
+
+/* Cursor structure - holds the per-type totals of the last query. */
+typedef struct {
+  sqlite3_vtab_cursor base;          /* Base class. Must be first. */
+  crypto_val_t *sums;                /* Running sum per crypto_type_index(). */
+  sqlite3_int64 *counts;             /* Values summed per crypto_type_index(). */
+  size_t nType;                      /* Entries in sums and counts. */
+  size_t iType;                      /* Type index of the current row. */
+} cryptoSumAllCursor;
+
+static int cryptoSumAllConnect(
+  sqlite3 *db, void *pAux,
+  int argc, const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pzErr
+){
+  UNUSED(pAux);
+  UNUSED(argc);
+  UNUSED(argv);
+  UNUSED(pzErr);
+  int rc = sqlite3_declare_vtab(db,
+      "CREATE TABLE x(asset TEXT, denom TEXT, total TEXT, count INT, query HIDDEN)");
+  if (rc != SQLITE_OK) {
+    return rc;
+  }
+  /* The argument is arbitrary SQL, so keep it out of views and triggers. */
+  rc = sqlite3_vtab_config(db, SQLITE_VTAB_DIRECTONLY);
+  if (rc != SQLITE_OK) {
+    return rc;
+  }
+
+  cryptoSumAllVtab *pNew = (cryptoSumAllVtab*)sqlite3_malloc(sizeof(*pNew));
+  if (!pNew) return SQLITE_NOMEM;
+  memset(pNew, 0, sizeof(*pNew));
+  pNew->db = db;
+  *ppVtab = (sqlite3_vtab*)pNew;
+  return SQLITE_OK;
+}
+
+static int cryptoSumAllDisconnect(sqlite3_vtab *pVtab){
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+/*
+** The query argument is required: it arrives as an equality constraint on the
+** hidden column and is passed to xFilter as argv[0].
+*/
+static int cryptoSumAllBestIndex(sqlite3_vtab *pVTab, sqlite3_index_info *pIdxInfo){
+  UNUSED(pVTab);
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    const struct sqlite3_index_constraint *c = &pIdxInfo->aConstraint[i];
+    if (c->iColumn != SUM_ALL_QUERY || c->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    if (!c->usable) return SQLITE_CONSTRAINT;
+    pIdxInfo->aConstraintUsage[i].argvIndex = 1;
+    pIdxInfo->aConstraintUsage[i].omit = 1;
+    pIdxInfo->idxNum = 1;
+    pIdxInfo->estimatedCost = (double)1;
+    pIdxInfo->estimatedRows = (sqlite3_int64)crypto_type_count();
+    return SQLITE_OK;
+  }
+  /* No query: make this plan unattractive so xFilter can report the error. */
+  pIdxInfo->idxNum = 0;
+  pIdxInfo->estimatedCost = (double)1e99;
+  return SQLITE_OK;
+}
+
+static int cryptoSumAllOpen(sqlite3_vtab *p, sqlite3_vtab_cursor **ppCursor){
+  UNUSED(p);
+  cryptoSumAllCursor *pCur = (cryptoSumAllCursor*)sqlite3_malloc(sizeof(*pCur));
+  if (!pCur) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static void cryptoSumAllReset(cryptoSumAllCursor *pCur){
+  for (size_t t = 0; t < pCur->nType; t++) {
+    crypto_clear(&pCur->sums[t]);
+    crypto_init(&pCur->sums[t], crypto_type_at(t));
+    pCur->counts[t] = 0;
+  }
+  pCur->iType = pCur->nType;
+}
+
+/*
+** Grows the totals to cover the first n type indexes, so that types registered
+** while a query runs can be summed too.
+*/
+static int cryptoSumAllReserve(cryptoSumAllCursor *pCur, size_t n){
+  if (n <= pCur->nType) return SQLITE_OK;
+  sqlite3_int64 *aCount = sqlite3_realloc64(pCur->counts, n * sizeof(*aCount));
+  if (!aCount) return SQLITE_NOMEM;
+  pCur->counts = aCount;
+  crypto_val_t *aSum = sqlite3_realloc64(pCur->sums, n * sizeof(*aSum));
+  if (!aSum) return SQLITE_NOMEM;
+  pCur->sums = aSum;
+  for (size_t t = pCur->nType; t < n; t++) {
+    crypto_init(&pCur->sums[t], crypto_type_at(t));
+    pCur->counts[t] = 0;
+  }
+  pCur->nType = n;
+  return SQLITE_OK;
+}
+
+static int cryptoSumAllClose(sqlite3_vtab_cursor *cur){
+  cryptoSumAllCursor *pCur = (cryptoSumAllCursor*)cur;
+  for (size_t t = 0; t < pCur->nType; t++) {
+    crypto_clear(&pCur->sums[t]);
+  }
+  sqlite3_free(pCur->sums);
+  sqlite3_free(pCur->counts);
+  sqlite3_free(pCur);
+  return SQLITE_OK;
+}
+
+/* Moves the cursor to the first type at or after pCur->iType with values. */
+static void cryptoSumAllSkipEmpty(cryptoSumAllCursor *pCur){
+  while (pCur->iType < pCur->nType && pCur->counts[pCur->iType] == 0) {
+    pCur->iType++;
+  }
+}
+
+/* Runs the argument query and sums every row into the cursor. */
+static int cryptoSumAllFilter(sqlite3_vtab_cursor *pCursor, int idxNum,
+                             const char *idxStr, int argc, sqlite3_value **argv){
+  UNUSED(idxStr);
+  cryptoSumAllCursor *pCur = (cryptoSumAllCursor*)pCursor;
+  cryptoSumAllVtab *pTab = (cryptoSumAllVtab*)pCursor->pVtab;
+  cryptoSumAllReset(pCur);
+  sqlite3_free(pTab->base.zErrMsg);
+  pTab->base.zErrMsg = NULL;
+  if (cryptoSumAllReserve(pCur, crypto_type_count()) != SQLITE_OK) {
+    return SQLITE_NOMEM;
+  }
+
+  const char *zSql = idxNum == 1 && argc == 1 ? (const char*)sqlite3_value_text(argv[0]) : NULL;
+  if (!zSql) {
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_sum_all requires a query argument");
+    return SQLITE_ERROR;
+  }
+  sqlite3_stmt *pStmt = NULL;
+  int rc = sqlite3_prepare_v2(pTab->db, zSql, -1, &pStmt, NULL);
+  if (rc != SQLITE_OK) {
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_sum_all: %s", sqlite3_errmsg(pTab->db));
+    return rc;
+  }
+  if (!sqlite3_stmt_readonly(pStmt)) {
+    sqlite3_finalize(pStmt);
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_sum_all: query must not write to the database");
+    return SQLITE_ERROR;
+  }
+  if (sqlite3_column_count(pStmt) < 3) {
+    sqlite3_finalize(pStmt);
+    pTab->base.zErrMsg = sqlite3_mprintf("crypto_sum_all: query must return asset, denomination and amount columns");
+    return SQLITE_ERROR;
+  }
+
+  crypto_ledger_reader_t reader;
+  crypto_ledger_reader_init(&reader);
+  while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    crypto_val_t operand;
+    bool parsed;
+    rc = crypto_ledger_read(&reader, pStmt, 0, "crypto_sum_all", &operand, &parsed, &pTab->base.zErrMsg);
+    if (rc != SQLITE_OK) break;
+    if (!parsed) continue;
+    size_t t = crypto_type_index(operand.crypto_type);
+    if (t >= pCur->nType) {
+      rc = cryptoSumAllReserve(pCur, crypto_type_count());
+      if (rc != SQLITE_OK) {
+        crypto_clear(&operand);
+        break;
+      }
+    }
+    crypto_add(&pCur->sums[t], &pCur->sums[t], &operand);
+    pCur->counts[t]++;
+    crypto_clear(&operand);
+  }
+  if (rc == SQLITE_DONE) {
+    rc = sqlite3_finalize(pStmt);
+  } else {
+    if (!pTab->base.zErrMsg) {
+      pTab->base.zErrMsg = sqlite3_mprintf("crypto_sum_all: %s", sqlite3_errmsg(pTab->db));
+    }
+    sqlite3_finalize(pStmt);
+  }
+  if (rc != SQLITE_OK) return rc;
+
+  pCur->iType = 0;
+  cryptoSumAllSkipEmpty(pCur);
+  return SQLITE_OK;
+}
+
+static int cryptoSumAllNext(sqlite3_vtab_cursor *pCursor){
+  cryptoSumAllCursor *pCur = (cryptoSumAllCursor*)pCursor;
+  pCur->iType++;
+  cryptoSumAllSkipEmpty(pCur);
+  return SQLITE_OK;
+}
+
+static int cryptoSumAllEof(sqlite3_vtab_cursor *pCursor){
+  cryptoSumAllCursor *pCur = (cryptoSumAllCursor*)pCursor;
+  return pCur->iType >= pCur->nType;
+}
+
+static int cryptoSumAllColumn(sqlite3_vtab_cursor *pCursor,
+                             sqlite3_context *ctx, int i){
+  cryptoSumAllCursor *pCur = (cryptoSumAllCursor*)pCursor;
+  crypto_type_t type = crypto_type_at(pCur->iType);
+  crypto_denom_t denom = crypto_ledger_denom(type);
+
+  switch (i) {
+    case SUM_ALL_ASSET:
+      sqlite3_result_text(ctx, crypto_type_def(type)->symbol, -1, SQLITE_STATIC);
+      break;
+    case SUM_ALL_DENOM:
+      sqlite3_result_text(ctx, crypto_denom_def(denom)->symbol, -1, SQLITE_STATIC);
+      break;
+    case SUM_ALL_TOTAL: {
+      char buf[128];
+      int n;
+      char *z = crypto_ledger_format(&pCur->sums[pCur->iType], denom, buf, sizeof(buf), &n);
+      if (!z) return SQLITE_NOMEM;
+      sqlite3_result_text(ctx, z, n, SQLITE_TRANSIENT);
+      if (z != buf) crypto_free(z);
+      break;
+    }
+    case SUM_ALL_COUNT:
+      sqlite3_result_int64(ctx, pCur->counts[pCur->iType]);
+      break;
+    default:
+      sqlite3_result_null(ctx);
+      break;
+  }
+  return SQLITE_OK;
+}
+
+static int cryptoSumAllRowid(sqlite3_vtab_cursor *pCursor, sqlite_int64 *pRowid){
+  cryptoSumAllCursor *pCur = (cryptoSumAllCursor*)pCursor;
+  *pRowid = (sqlite_int64)pCur->iType;
+  return SQLITE_OK;
+}
+
+// The module definition for the table-valued function.
+sqlite3_module cryptoSumAllModule = {
+  0,                         /* iVersion      */
+  0,                         /* xCreate       */
+  cryptoSumAllConnect,       /* xConnect      */
+  cryptoSumAllBestIndex,     /* xBestIndex    */
+  cryptoSumAllDisconnect,    /* xDisconnect   */
+  0,                         /* xDestroy      */
+  cryptoSumAllOpen,          /* xOpen         */
+  cryptoSumAllClose,         /* xClose        */
+  cryptoSumAllFilter,        /* xFilter       */
+  cryptoSumAllNext,          /* xNext         */
+  cryptoSumAllEof,           /* xEof          */
+  cryptoSumAllColumn,        /* xColumn       */
+  cryptoSumAllRowid,         /* xRowid        */
+  0,                         /* xUpdate       */
+  0,                         /* xBegin        */
+  0,                         /* xSync         */
+  0,                         /* xCommit       */
+  0,                         /* xRollback     */
+  0,                         /* xFindFunction */
+  0,                         /* xRename       */
+  0,                         /* xSavepoint    */
+  0,                         /* xRelease      */
+  0,                         /* xRollbackTo   */
+  0,                         /* xShadowName   */
+  0                          /* xIntegrity    */
+};
@@ -8,85 +8,76 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <setjmp.h>
+#include <errno.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <sqlite3.h>
+#include <pthread.h>
+#include <poll.h>
 
 #define CRYPTOMATH_IMPLEMENTATION
 #include "cryptomath.h"
+#include "cryptomath_column.h"
+#include "cryptomath_convert.h"
+#include "cryptomath_csv.h"
+#include "cryptomath_rates.h"
+#include "cryptomath_pipeline.h"
 
 // Test result tracking
 static int total_tests = 0;
 static int passed_tests = 0;
 static int failed_tests = 0;
 
-// Global jump buffer for longjmp
-static jmp_buf jumpBuffer;
-
-// Custom SIGABRT handler that jumps back to our test
-static void sigabrt_handler(int signo) {
-    (void)signo;  // unused parameter
-    longjmp(jumpBuffer, 1);
-}
-
-// Custom SIGFPE handler that jumps back to our test
-static void sigfpe_handler(int signo) {
-    (void)signo;  // unused parameter
-    longjmp(jumpBuffer, 1);
+// The signal that ended the child pid, or 0 if it exited or could not be started
+static int child_signal(pid_t pid) {
+    int status;
+    if (pid < 0) {
+        return 0;
+    }
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return 0;
+        }
+    }
+    return WIFSIGNALED(status) ? WTERMSIG(status) : 0;
 }
 
-// The macro sets up the signal handler, calls setjmp,
-// executes your statement, and checks whether we jumped
-// due to an assertion (SIGABRT).
-#define SHOULD_ASSERT(STMT)                                          \
+// Run STMT in a forked child and count a pass if the child is killed by SIG.
+// Nothing the statement does can reach this process's state, so the check holds
+// at any optimization level; jumping out of a signal handler instead left locals
+// and half-updated library state indeterminate once the compiler optimized.
+#define SHOULD_SIGNAL(STMT, SIG, WHAT)                               \
     do {                                                             \
         total_tests++;                                               \
-        /* Install custom signal handler for SIGABRT */              \
-        signal(SIGABRT, sigabrt_handler);                            \
-                                                                     \
-        /* setjmp returns 0 initially, and 1 if we longjmp from the handler */ \
-        if (setjmp(jumpBuffer) == 0) {                               \
-            /* Execute the statement (which should trigger assert) */\
+        /* Flush so buffered output is not written twice */          \
+        fflush(stdout);                                              \
+        fflush(stderr);                                              \
+        pid_t pid = fork();                                          \
+        if (pid == 0) {                                              \
+            /* No core file for a death that is expected */          \
+            struct rlimit no_core = { 0, 0 };                        \
+            setrlimit(RLIMIT_CORE, &no_core);                        \
+            signal(SIG, SIG_DFL);                                    \
             (void)(STMT);                                            \
-            /* If we get here, no abort/assert occurred */           \
-            printf("FAIL: Assertion not triggered by '%s'\n", #STMT);\
-            failed_tests++;                                          \
-        } else {                                                     \
-            /* We arrived via longjmp => an assert called abort */   \
-            printf("PASS: Assertion triggered by '%s'\n", #STMT);    \
-            passed_tests++;                                          \
+            _exit(0);                                                \
         }                                                            \
-                                                                     \
-        /* Optionally restore default SIGABRT handler for safety */  \
-        signal(SIGABRT, SIG_DFL);                                    \
-    } while (0)
-
-// The macro sets up the signal handler, calls setjmp,
-// executes your statement, and checks whether we jumped
-// due to an exception (SIGFPE).
-#define SHOULD_FPE(STMT)                                             \
-    do {                                                             \
-        total_tests++;                                               \
-        /* Install custom signal handler for SIGFPE */               \
-        signal(SIGFPE, sigfpe_handler);                              \
-                                                                     \
-        /* setjmp returns 0 initially, and 1 if we longjmp from the handler */ \
-        if (setjmp(jumpBuffer) == 0) {                               \
-            /* Execute the statement (which should trigger exception) */\
-            (void)(STMT);                                            \
-            /* If we get here, no abort/assert occurred */           \
-            printf("FAIL: Exception not triggered by '%s'\n", #STMT);\
-            failed_tests++;                                          \
-        } else {                                                     \
-            /* We arrived via longjmp => an exception called abort */   \
-            printf("PASS: Exception triggered by '%s'\n", #STMT);    \
+        if (child_signal(pid) == SIG) {                              \
+            printf("PASS: " WHAT " triggered by '%s'\n", #STMT);     \
             passed_tests++;                                          \
+        } else {                                                     \
+            printf("FAIL: " WHAT " not triggered by '%s'\n", #STMT); \
+            failed_tests++;                                          \
         }                                                            \
-                                                                     \
-        /* Optionally restore default SIGFPE handler for safety */   \
-        signal(SIGFPE, SIG_DFL);                                     \
     } while (0)
 
+// STMT must fail an assertion (SIGABRT)
+#define SHOULD_ASSERT(STMT) SHOULD_SIGNAL(STMT, SIGABRT, "Assertion")
+
+// STMT must raise an arithmetic exception (SIGFPE), as GMP does on division by zero
+#define SHOULD_FPE(STMT) SHOULD_SIGNAL(STMT, SIGFPE, "Exception")
+
 // Helper macro for testing valid decimal strings
 #define TEST_VALID_DECIMAL(str) do { \
     total_tests++; \
@@ -111,7 +102,8 @@ static void sigfpe_handler(int signo) {
 
 void verify_string_parsing(crypto_val_t* val, const char* expected_val_as_str) {
     total_tests++;
-    char* str = mpz_get_str(NULL, 10, val->value);
+    mpz_t view;
+    char* str = mpz_get_str(NULL, 10, crypto_view(val, view));
     if (!str) {
         printf("ERROR: Failed to convert result to string\n");
         failed_tests++;
@@ -171,9 +163,10 @@ void verify_zero_comparison(const crypto_val_t* a, int comparison, int expected_
             return;
     }
     total_tests++;
+    mpz_t view;
     printf("%s %s %s %s: %s\n",
             expected_result == 1 ? "" : "NOT",
-            mpz_get_str(NULL, 10, a->value),
+            mpz_get_str(NULL, 10, crypto_view(a, view)),
             a->crypto_type == CRYPTO_BITCOIN ? "SAT" : "Unknown",
             comparison == 0 ? "== 0" : (comparison > 0 ? "> 0" : "< 0"),
             cmp_result == expected_result ? "✓ PASSED" : "✗ FAILED");
@@ -459,6 +452,24 @@ void test_multiplication_division() {
     mpz_set_ui(scalar, 2);
     crypto_mul(&btc1, &btc1, &scalar);
     verify_decimal_string(&btc1, BTC_DENOM_BITCOIN, "4");
+
+    // Test 7: Scalars keep their whole part when they have a fraction
+    const struct { const char* str; const char* scaled; uint8_t precision; } scalars[] = {
+        { "1.5", "15", 1 }, { "-12.25", "-1225", 2 }, { " +3.0 ", "3", 0 }, { "0.001", "1", 3 },
+        { "12345678901234567890.5", "123456789012345678905", 1 }, { "7", "7", 0 }
+    };
+    for (size_t i = 0; i < sizeof(scalars) / sizeof(scalars[0]); i++) {
+        uint8_t precision = crypto_scale_by_precision(scalars[i].str, &scalar);
+        char* scaled = mpz_get_str(NULL, 10, scalar);
+        total_tests++;
+        if (precision != scalars[i].precision || strcmp(scaled, scalars[i].scaled) != 0) {
+            printf("FAIL: Scaling '%s' gave %s with precision %u\n", scalars[i].str, scaled, precision);
+            failed_tests++;
+        } else {
+            passed_tests++;
+        }
+        free(scaled);
+    }
         
     // Cleanup
     crypto_clear(&btc1);
@@ -466,6 +477,1666 @@ void test_multiplication_division() {
     mpz_clear(scalar);
 }
 
+// Reference quotient for the round-to-nearest modes, computed on magnitudes
+static void reference_div_nearest(mpz_t q, const mpz_t a, const mpz_t d, crypto_rounding_t rounding) {
+    mpz_t aq, ad, r;
+    mpz_inits(aq, ad, r, NULL);
+    mpz_abs(aq, a);
+    mpz_abs(ad, d);
+    mpz_tdiv_qr(q, r, aq, ad);
+    mpz_mul_2exp(r, r, 1);
+    int c = mpz_cmp(r, ad);
+    if (c > 0 || (c == 0 && (rounding == CRYPTO_ROUND_HALF_UP || mpz_odd_p(q)))) {
+        mpz_add_ui(q, q, 1);
+    }
+    if ((mpz_sgn(a) < 0) != (mpz_sgn(d) < 0)) {
+        mpz_neg(q, q);
+    }
+    mpz_clears(aq, ad, r, NULL);
+}
+
+void test_prepared_divisor() {
+    printf("\n=== Testing Prepared Divisors ===\n");
+
+    // Test 1: Every rounding matches GMP for word-sized, multi-limb and negative
+    // divisors over inline dividends of every width and both signs
+    const char* divisors[] = {
+        "1", "3", "10", "1000", "-7", "10000000000000000000", "9223372036854775809",
+        "18446744073709551615", "-18446744073709551557", "18446744073709551616", "-340282366920938463463374607431768211297"
+    };
+    crypto_val_t a, r, big;
+    crypto_init(&a, CRYPTO_ETHEREUM);
+    crypto_init(&r, CRYPTO_ETHEREUM);
+    crypto_init(&big, CRYPTO_ETHEREUM);
+    mpz_t value, dividend, expected, got, one, ten_pow;
+    mpz_inits(value, dividend, expected, got, ten_pow, NULL);
+    mpz_init_set_ui(one, 1);
+    uint64_t seed = 88172645463325252ULL;
+    int mismatches = 0;
+    for (size_t d = 0; d < sizeof(divisors) / sizeof(divisors[0]); d++) {
+        mpz_set_str(value, divisors[d], 10);
+        crypto_divisor_t divisor;
+        crypto_divisor_init(&divisor, value);
+        for (int i = 0; i < 400; i++) {
+            // Dividends of 0 to 4 limbs; the top limb is sometimes small
+            mpz_set_ui(dividend, 0);
+            for (int limb = 0; limb < i % 5; limb++) {
+                seed ^= seed << 13;
+                seed ^= seed >> 7;
+                seed ^= seed << 17;
+                mpz_mul_2exp(dividend, dividend, 64);
+                mpz_add_ui(dividend, dividend, i % 3 == 0 && limb == 0 ? seed % 1000 : seed);
+            }
+            if (i % 2) {
+                mpz_neg(dividend, dividend);
+            }
+            crypto_set_mpz(&a, dividend);
+            for (int mode = CRYPTO_ROUND_TRUNCATE; mode <= CRYPTO_ROUND_HALF_EVEN; mode++) {
+                if (mode == CRYPTO_ROUND_TRUNCATE) {
+                    mpz_tdiv_q(expected, dividend, value);
+                } else if (mode == CRYPTO_ROUND_FLOOR) {
+                    mpz_fdiv_q(expected, dividend, value);
+                } else if (mode == CRYPTO_ROUND_CEIL) {
+                    mpz_cdiv_q(expected, dividend, value);
+                } else {
+                    reference_div_nearest(expected, dividend, value, (crypto_rounding_t)mode);
+                }
+                // Prepared, inline mpn and GMP paths must all agree
+                crypto_div_by(&r, &a, &divisor, (crypto_rounding_t)mode);
+                crypto_get_mpz(got, &r);
+                mismatches += mpz_cmp(got, expected) != 0;
+                crypto_muldiv(&r, &a, &one, &value, (crypto_rounding_t)mode);
+                crypto_get_mpz(got, &r);
+                mismatches += mpz_cmp(got, expected) != 0;
+                mpz_mul_2exp(ten_pow, dividend, 300);
+                crypto_set_mpz(&big, ten_pow);
+                mpz_mul_2exp(ten_pow, value, 300);
+                crypto_muldiv(&r, &big, &one, &ten_pow, (crypto_rounding_t)mode);
+                crypto_get_mpz(got, &r);
+                mismatches += mpz_cmp(got, expected) != 0;
+            }
+        }
+        crypto_divisor_clear(&divisor);
+    }
+    total_tests++;
+    if (mismatches == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: %d prepared divisions differ from GMP\n", mismatches);
+        failed_tests++;
+    }
+
+    // Test 2: Promoted dividends fall back to GMP
+    mpz_ui_pow_ui(dividend, 10, 90);
+    mpz_neg(dividend, dividend);
+    crypto_set_mpz(&a, dividend);
+    mpz_set_ui(value, 7);
+    crypto_divisor_t seven;
+    crypto_divisor_init(&seven, value);
+    crypto_div_by(&r, &a, &seven, CRYPTO_ROUND_FLOOR);
+    crypto_get_mpz(got, &r);
+    mpz_fdiv_q(expected, dividend, value);
+    total_tests++;
+    if (mpz_cmp(got, expected) == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Prepared division of a promoted value differs from GMP\n");
+        failed_tests++;
+    }
+    crypto_divisor_clear(&seven);
+
+    // Test 3: Dividing by a prepared zero raises the division-by-zero exception
+    mpz_set_ui(value, 0);
+    crypto_divisor_t zero;
+    crypto_divisor_init(&zero, value);
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "5");
+    SHOULD_FPE(crypto_div_by(&r, &a, &zero, CRYPTO_ROUND_TRUNCATE));
+    crypto_divisor_clear(&zero);
+
+    // Test 4: A fused multiply-divide rounds once: 5 wei * num / den
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "5");
+    const struct { int num; int den; crypto_rounding_t rounding; const char* expected; } fused[] = {
+        { 7, 2, CRYPTO_ROUND_HALF_UP, "18" },     // 17.5
+        { 7, 2, CRYPTO_ROUND_HALF_EVEN, "18" },
+        { 5, 2, CRYPTO_ROUND_HALF_EVEN, "12" },   // 12.5
+        { 5, 2, CRYPTO_ROUND_HALF_UP, "13" },
+        { -5, 2, CRYPTO_ROUND_HALF_UP, "-13" },
+        { -5, 2, CRYPTO_ROUND_HALF_EVEN, "-12" },
+        { 2, 3, CRYPTO_ROUND_HALF_EVEN, "3" },    // 3.33
+        { -2, 3, CRYPTO_ROUND_FLOOR, "-4" },
+        { 2, -3, CRYPTO_ROUND_CEIL, "-3" },
+    };
+    for (size_t i = 0; i < sizeof(fused) / sizeof(fused[0]); i++) {
+        mpz_set_si(value, fused[i].num);
+        mpz_set_si(dividend, fused[i].den);
+        crypto_muldiv(&r, &a, &value, &dividend, fused[i].rounding);
+        verify_decimal_string(&r, ETH_DENOM_WEI, fused[i].expected);
+    }
+
+    mpz_clears(value, dividend, expected, got, one, ten_pow, NULL);
+    crypto_clear(&a);
+    crypto_clear(&r);
+    crypto_clear(&big);
+}
+
+void verify_inline(const crypto_val_t* val, bool expected_inline, const char* desc) {
+    total_tests++;
+    if (val->is_big == expected_inline) {
+        printf("FAIL: %s should be %s\n", desc, expected_inline ? "inline" : "promoted");
+        failed_tests++;
+    } else {
+        passed_tests++;
+    }
+}
+
+void test_inline_representation() {
+    printf("\n=== Testing Inline Representation ===\n");
+
+    crypto_val_t a, b, result;
+    crypto_init(&a, CRYPTO_ETHEREUM);
+    crypto_init(&b, CRYPTO_ETHEREUM);
+    crypto_init(&result, CRYPTO_ETHEREUM);
+
+    // Test 1: 2^256 - 1 wei (EVM uint256 max) stays inline
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "115792089237316195423570985008687907853269984665640564039457584007913129639935");
+    verify_inline(&a, true, "uint256 max");
+    verify_decimal_string(&a, ETH_DENOM_ETHER, "115792089237316195423570985008687907853269984665640564039457.584007913129639935");
+
+    // Test 2: Adding 1 wei overflows the inline limbs and promotes
+    crypto_set_from_decimal(&b, ETH_DENOM_WEI, "1");
+    crypto_add(&result, &a, &b);
+    verify_inline(&result, false, "uint256 max + 1");
+    verify_string_parsing(&result, "115792089237316195423570985008687907853269984665640564039457584007913129639936");
+
+    // Test 3: Mixed promoted and inline operands
+    crypto_sub(&result, &result, &b);
+    verify_string_parsing(&result, "115792089237316195423570985008687907853269984665640564039457584007913129639935");
+    verify_comparison(&result, &a, "2^256-1 (promoted)", "2^256-1 (inline)", 0);
+    verify_comparison(&b, &result, "1 WEI", "2^256-1 (promoted)", -1);
+
+    // Test 4: Negative overflow
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "-115792089237316195423570985008687907853269984665640564039457584007913129639935");
+    crypto_sub(&a, &a, &b);
+    verify_inline(&a, false, "-(2^256)");
+    verify_string_parsing(&a, "-115792089237316195423570985008687907853269984665640564039457584007913129639936");
+    crypto_clear(&a);
+    crypto_init(&a, CRYPTO_ETHEREUM);
+
+    // Test 5: Carries and borrows across limbs
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "18446744073709551615");
+    crypto_add(&a, &a, &b);
+    verify_inline(&a, true, "2^64");
+    verify_string_parsing(&a, "18446744073709551616");
+    crypto_sub(&a, &a, &b);
+    verify_string_parsing(&a, "18446744073709551615");
+    crypto_set_from_decimal(&b, ETH_DENOM_WEI, "18446744073709551616");
+    crypto_sub(&a, &a, &b);
+    verify_string_parsing(&a, "-1");
+    verify_comparison(&a, &b, "-1 WEI", "2^64 WEI", -1);
+
+    // Test 6: Multiplication overflow promotes
+    mpz_t scalar;
+    mpz_init(scalar);
+    mpz_ui_pow_ui(scalar, 2, 255);
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "2");
+    crypto_mul(&result, &a, &scalar);
+    verify_string_parsing(&result, "115792089237316195423570985008687907853269984665640564039457584007913129639936");
+
+    // Test 7: Division rounding on inline values
+    mpz_set_si(scalar, 2);
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "-7");
+    crypto_div_truncate(&b, &a, &scalar);
+    verify_string_parsing(&b, "-3");
+    crypto_div_floor(&b, &a, &scalar);
+    verify_string_parsing(&b, "-4");
+    crypto_div_ceil(&b, &a, &scalar);
+    verify_string_parsing(&b, "-3");
+    mpz_set_si(scalar, -2);
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "7");
+    crypto_div_floor(&b, &a, &scalar);
+    verify_string_parsing(&b, "-4");
+    crypto_div_ceil(&b, &a, &scalar);
+    verify_string_parsing(&b, "-3");
+    mpz_set_si(scalar, 3);
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "1");
+    crypto_div_ceil(&b, &a, &scalar);
+    verify_string_parsing(&b, "1");
+    crypto_div_floor(&b, &a, &scalar);
+    verify_string_parsing(&b, "0");
+
+    // Test 8: Promoted values divide back down correctly
+    mpz_ui_pow_ui(scalar, 2, 300);
+    crypto_set_from_decimal(&a, ETH_DENOM_WEI, "3");
+    crypto_mul(&result, &a, &scalar);
+    crypto_div_truncate(&result, &result, &scalar);
+    verify_string_parsing(&result, "3");
+
+    mpz_clear(scalar);
+    crypto_clear(&a);
+    crypto_clear(&b);
+    crypto_clear(&result);
+}
+
+// Helper macro for testing crypto_parse_decimal failures
+#define TEST_PARSE_ERROR(str, expected_status, expected_pos) do { \
+    crypto_val_t v; \
+    size_t pos = 0; \
+    crypto_init(&v, CRYPTO_BITCOIN); \
+    crypto_parse_status_t status = crypto_parse_decimal(&v, BTC_DENOM_BITCOIN, str, SIZE_MAX, &pos); \
+    total_tests++; \
+    if (status != expected_status || pos != (size_t)(expected_pos)) { \
+        printf("FAIL: '%s' expected %s at %d, got %s at %d\n", str, \
+               crypto_parse_status_str(expected_status), (int)(expected_pos), \
+               crypto_parse_status_str(status), (int)pos); \
+        failed_tests++; \
+    } else { \
+        passed_tests++; \
+    } \
+    crypto_clear(&v); \
+} while(0)
+
+void test_single_pass_parsing() {
+    printf("\n=== Testing Single-Pass Parsing ===\n");
+
+    crypto_val_t amount;
+    crypto_init(&amount, CRYPTO_ETHEREUM);
+
+    // Test 1: Valid inputs parse to the smallest unit
+    total_tests++;
+    if (crypto_parse_decimal(&amount, ETH_DENOM_ETHER, " -1.5\t", SIZE_MAX, NULL) != CRYPTO_PARSE_OK) {
+        printf("FAIL: ' -1.5' was rejected\n");
+        failed_tests++;
+    } else {
+        passed_tests++;
+    }
+    verify_string_parsing(&amount, "-1500000000000000000");
+
+    crypto_parse_decimal(&amount, ETH_DENOM_ETHER, "+.000000000000000001999", SIZE_MAX, NULL);
+    verify_string_parsing(&amount, "1");
+
+    crypto_parse_decimal(&amount, ETH_DENOM_GWEI, "12.", SIZE_MAX, NULL);
+    verify_string_parsing(&amount, "12000000000");
+
+    // Test 2: Explicit length stops scanning without a terminator
+    crypto_parse_decimal(&amount, ETH_DENOM_WEI, "12345,678", 5, NULL);
+    verify_string_parsing(&amount, "12345");
+
+    // A NUL before len ends the input; the word-at-a-time scan must not read past it
+    char* short_str = malloc(2);
+    memcpy(short_str, "1", 2);
+    crypto_parse_decimal(&amount, ETH_DENOM_WEI, short_str, 64, NULL);
+    verify_string_parsing(&amount, "1");
+    crypto_parse_decimal(&amount, ETH_DENOM_ETHER, short_str, 64, NULL);
+    verify_string_parsing(&amount, "1000000000000000000");
+    free(short_str);
+
+    // Test 3: Values longer than a limb chunk and beyond the inline limbs
+    crypto_parse_decimal(&amount, ETH_DENOM_ETHER, "12345678901234567890123456789.123456789012345678", SIZE_MAX, NULL);
+    verify_string_parsing(&amount, "12345678901234567890123456789123456789012345678");
+    verify_inline(&amount, true, "47 digit value");
+    crypto_parse_decimal(&amount, ETH_DENOM_ETHER,
+        "1234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890", SIZE_MAX, NULL);
+    verify_string_parsing(&amount,
+        "1234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890000000000000000000");
+    verify_inline(&amount, false, "118 digit value");
+    crypto_clear(&amount);
+    crypto_init(&amount, CRYPTO_ETHEREUM);
+
+    // Test 4: Failures leave the value unchanged
+    crypto_parse_decimal(&amount, ETH_DENOM_WEI, "42", SIZE_MAX, NULL);
+    crypto_parse_decimal(&amount, ETH_DENOM_WEI, "4x2", SIZE_MAX, NULL);
+    verify_string_parsing(&amount, "42");
+
+    // Test 5: Position-specific errors
+    TEST_PARSE_ERROR("", CRYPTO_PARSE_EMPTY, 0);
+    TEST_PARSE_ERROR("   ", CRYPTO_PARSE_EMPTY, 3);
+    TEST_PARSE_ERROR("+", CRYPTO_PARSE_NO_DIGITS, 1);
+    TEST_PARSE_ERROR(" -. ", CRYPTO_PARSE_NO_DIGITS, 3);
+    TEST_PARSE_ERROR("12a", CRYPTO_PARSE_INVALID_CHAR, 2);
+    TEST_PARSE_ERROR("1.2.3", CRYPTO_PARSE_MULTIPLE_DOTS, 3);
+    TEST_PARSE_ERROR("123 456", CRYPTO_PARSE_INVALID_CHAR, 4);
+    TEST_PARSE_ERROR("--1", CRYPTO_PARSE_INVALID_CHAR, 1);
+
+    crypto_clear(&amount);
+}
+
+// Check crypto_format_to against an expected string: the reported length, an exactly
+// sized buffer, a buffer one byte short (which must be left untouched), and the max_len bound.
+void verify_format_to(const crypto_val_t* val, crypto_denom_t denom, const char* expected) {
+    size_t expected_len = strlen(expected);
+    char buf[512];
+    total_tests++;
+    size_t len = crypto_format_to(NULL, 0, val, denom);
+    if (len != expected_len) {
+        printf("FAIL: Expected length %zu for %s, got %zu\n", expected_len, expected, len);
+        failed_tests++;
+        return;
+    }
+    memset(buf, 'x', sizeof(buf));
+    crypto_format_to(buf, expected_len, val, denom);
+    if (buf[0] != 'x') {
+        printf("FAIL: Short buffer was written for %s\n", expected);
+        failed_tests++;
+        return;
+    }
+    crypto_format_to(buf, expected_len + 1, val, denom);
+    if (strcmp(buf, expected) != 0) {
+        printf("FAIL: Expected %s, got %s\n", expected, buf);
+        failed_tests++;
+        return;
+    }
+    if (!val->is_big && len > crypto_format_max_len(denom)) {
+        printf("FAIL: %s is longer than crypto_format_max_len\n", expected);
+        failed_tests++;
+        return;
+    }
+    passed_tests++;
+}
+
+void test_format_to() {
+    printf("\n=== Testing Formatting Into Caller Buffers ===\n");
+
+    crypto_val_t amount;
+    crypto_init(&amount, CRYPTO_ETHEREUM);
+
+    // Test 1: Zero, whole values and padded fractions
+    verify_format_to(&amount, ETH_DENOM_ETHER, "0");
+    crypto_set_from_decimal(&amount, ETH_DENOM_WEI, "1000000000000000000");
+    verify_format_to(&amount, ETH_DENOM_ETHER, "1");
+    crypto_set_from_decimal(&amount, ETH_DENOM_WEI, "1500");
+    verify_format_to(&amount, ETH_DENOM_ETHER, "0.000000000000001500");
+    verify_format_to(&amount, ETH_DENOM_WEI, "1500");
+    crypto_set_from_decimal(&amount, ETH_DENOM_WEI, "-500000000000000000");
+    verify_format_to(&amount, ETH_DENOM_ETHER, "-0.500000000000000000");
+    crypto_set_from_decimal(&amount, ETH_DENOM_WEI, "-123456789012345678901");
+    verify_format_to(&amount, ETH_DENOM_GWEI, "-123456789012.345678901");
+
+    // Test 2: The inline extremes fit in crypto_format_max_len
+    crypto_set_from_decimal(&amount, ETH_DENOM_WEI,
+        "-115792089237316195423570985008687907853269984665640564039457584007913129639935");
+    verify_inline(&amount, true, "Negative uint256 max");
+    verify_format_to(&amount, ETH_DENOM_WEI,
+        "-115792089237316195423570985008687907853269984665640564039457584007913129639935");
+    verify_format_to(&amount, ETH_DENOM_ETHER,
+        "-115792089237316195423570985008687907853269984665640564039457.584007913129639935");
+
+    // Test 3: Promoted values report the length they need
+    crypto_set_from_decimal(&amount, ETH_DENOM_ETHER,
+        "1234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890.25");
+    verify_inline(&amount, false, "Promoted format value");
+    verify_format_to(&amount, ETH_DENOM_ETHER,
+        "1234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890.250000000000000000");
+    verify_decimal_string(&amount, ETH_DENOM_ETHER,
+        "1234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890.250000000000000000");
+
+    crypto_clear(&amount);
+}
+
+void test_pow10_table() {
+    printf("\n=== Testing Power-of-Ten Table ===\n");
+
+    // Test 1: Every table entry matches GMP
+    mpz_t expected;
+    mpz_init(expected);
+    unsigned mismatches = 0;
+    for (unsigned k = 0; k <= CRYPTO_POW10_MAX; k++) {
+        mpz_ui_pow_ui(expected, 10, k);
+        if (mpz_cmp(*crypto_pow10(k), expected) != 0) {
+            printf("FAIL: crypto_pow10(%u) is wrong\n", k);
+            mismatches++;
+        }
+        if (k <= CRYPTO_POW10_U64_MAX && mpz_cmp_ui(expected, crypto_pow10_u64(k)) != 0) {
+            printf("FAIL: crypto_pow10_u64(%u) is wrong\n", k);
+            mismatches++;
+        }
+    }
+    total_tests++;
+    if (mismatches == 0) {
+        passed_tests++;
+    } else {
+        failed_tests++;
+    }
+    mpz_clear(expected);
+
+    // Test 2: Per-denom scales
+    total_tests++;
+    if (crypto_denom_scale_u64(ETH_DENOM_ETHER) == 1000000000000000000ULL &&
+        crypto_denom_scale_u64(BTC_DENOM_SATOSHI) == 1 &&
+        mpz_cmp_ui(*crypto_denom_scale(BTC_DENOM_BITCOIN), 100000000) == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected denom scale\n");
+        failed_tests++;
+    }
+
+    // Test 3: Out of range exponents
+    SHOULD_ASSERT(crypto_pow10(CRYPTO_POW10_MAX + 1));
+    SHOULD_ASSERT(crypto_pow10_u64(CRYPTO_POW10_U64_MAX + 1));
+}
+
+void test_symbol_lookup() {
+    printf("\n=== Testing Symbol Lookup ===\n");
+
+    // Test 1: Every defined symbol resolves to its own entry
+    unsigned mismatches = 0;
+    for (int i = 0; i < CRYPTO_COUNT; i++) {
+        if (crypto_get_type_for_symbol(crypto_defs[i].symbol) != (crypto_type_t)i) {
+            printf("FAIL: Type symbol %s did not resolve\n", crypto_defs[i].symbol);
+            mismatches++;
+        }
+    }
+    for (int i = 0; i < DENOM_COUNT; i++) {
+        if (crypto_get_denom_for_symbol(crypto_denoms[i].crypto_type, crypto_denoms[i].symbol) != (crypto_denom_t)i) {
+            printf("FAIL: Denom symbol %s did not resolve\n", crypto_denoms[i].symbol);
+            mismatches++;
+        }
+    }
+    total_tests++;
+    if (mismatches == 0) {
+        passed_tests++;
+    } else {
+        failed_tests++;
+    }
+
+    // Test 2: UTF-8 symbols, length-delimited lookups and misses
+    total_tests++;
+    if (crypto_get_denom_for_symbol(CRYPTO_BITCOIN, "\xce\xbc" "BTC") == BTC_DENOM_MICROBIT &&
+        crypto_get_type_for_symbol_n("BTCX", 3) == CRYPTO_BITCOIN &&
+        crypto_get_denom_for_symbol_n(CRYPTO_ETHEREUM, "GWEIWEI", 4) == ETH_DENOM_GWEI &&
+        crypto_get_type_for_symbol("btc") == CRYPTO_COUNT &&
+        crypto_get_type_for_symbol("") == CRYPTO_COUNT &&
+        crypto_get_denom_for_symbol(CRYPTO_BITCOIN, "GWEI") == DENOM_COUNT &&
+        crypto_get_denom_for_symbol_n(CRYPTO_BITCOIN, "BTC", 2) == DENOM_COUNT) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected symbol lookup result\n");
+        failed_tests++;
+    }
+}
+
+void test_asset_registry() {
+    printf("\n=== Testing Asset Registry ===\n");
+
+    // Test 1: A registered type gets an id after the sentinel and a base unit
+    size_t types_before = crypto_type_count();
+    crypto_type_t usde = CRYPTO_COUNT;
+    crypto_denom_t usde_wei = DENOM_COUNT;
+    total_tests++;
+    if (crypto_register_type("USDE", "Ethena USDe", 18, &usde) == CRYPTO_REGISTRY_OK &&
+        usde >= CRYPTO_TYPE_FIRST_REGISTERED && crypto_is_valid_type(usde) &&
+        !crypto_is_valid_type(CRYPTO_COUNT) &&
+        crypto_type_count() == types_before + 1 &&
+        crypto_get_type_for_symbol("USDE") == usde &&
+        strcmp(crypto_type_def(usde)->name, "Ethena USDe") == 0 &&
+        crypto_denom_def(crypto_get_denom_for_symbol(usde, "USDE"))->decimals == 18 &&
+        crypto_register_denom(usde, "WEI", "Wei", 0, &usde_wei) == CRYPTO_REGISTRY_OK &&
+        crypto_get_denom_for_symbol(usde, "WEI") == usde_wei &&
+        crypto_get_denom_for_symbol(CRYPTO_ETHEREUM, "WEI") == ETH_DENOM_WEI) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Registering a type and denomination\n");
+        failed_tests++;
+    }
+
+    // Test 2: Registered denominations parse, format and encode like built-in ones;
+    // blobs name a registered type by symbol, never by its registration-order id
+    crypto_val_t a, b;
+    crypto_init(&a, usde);
+    crypto_init(&b, usde);
+    unsigned char blob[CRYPTO_BLOB_INLINE_MAX];
+    char buf[64];
+    crypto_parse_status_t status = crypto_parse_decimal(&a, crypto_get_denom_for_symbol(usde, "USDE"), "1.5", 3, NULL);
+    size_t blob_len = crypto_to_blob(blob, sizeof(blob), &a);
+    unsigned char by_id[] = { CRYPTO_BLOB_VERSION, (unsigned char)((unsigned)usde >> 8), (unsigned char)usde, 0x80 };
+    crypto_partial_t partial, decoded;
+    crypto_partial_init(&partial, usde);
+    crypto_partial_init(&decoded, usde);
+    crypto_partial_add(&partial, &a);
+    unsigned char partial_blob[CRYPTO_PARTIAL_INLINE_MAX];
+    size_t partial_len = crypto_partial_to_blob(partial_blob, sizeof(partial_blob), &partial);
+    bool partial_ok = crypto_partial_from_blob(&decoded, partial_blob, partial_len) && decoded.count == 1 &&
+                      crypto_cmp(&decoded.sum, &a) == 0;
+    crypto_partial_clear(&partial);
+    crypto_partial_clear(&decoded);
+    total_tests++;
+    if (status == CRYPTO_PARSE_OK &&
+        crypto_format_to(buf, sizeof(buf), &a, usde_wei) > 0 && strcmp(buf, "1500000000000000000") == 0 &&
+        crypto_blob_type(blob, blob_len) == usde && crypto_from_blob(&b, blob, blob_len) && crypto_cmp(&a, &b) == 0 &&
+        blob[0] == CRYPTO_BLOB_VERSION_SYMBOL && blob[1] == 4 && memcmp(blob + 2, "USDE", 4) == 0 &&
+        crypto_blob_type(by_id, sizeof(by_id)) == CRYPTO_COUNT && partial_ok) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Registered amount round trip, got %s\n", buf);
+        failed_tests++;
+    }
+    crypto_clear(&a);
+    crypto_clear(&b);
+
+    // Test 3: Identical registrations are no-ops; conflicts and bad input are rejected
+    crypto_type_t again = CRYPTO_COUNT, btc = CRYPTO_COUNT;
+    total_tests++;
+    if (crypto_register_type("USDE", "Ethena USDe", 18, &again) == CRYPTO_REGISTRY_OK && again == usde &&
+        crypto_register_type("BTC", "Bitcoin", 8, &btc) == CRYPTO_REGISTRY_OK && btc == CRYPTO_BITCOIN &&
+        crypto_register_type("USDE", "Ethena USDe", 6, NULL) == CRYPTO_REGISTRY_CONFLICT &&
+        crypto_register_denom(CRYPTO_BITCOIN, "SAT", "Satoshi", 2, NULL) == CRYPTO_REGISTRY_CONFLICT &&
+        crypto_register_type("A B", "Spaced", 2, NULL) == CRYPTO_REGISTRY_INVALID_SYMBOL &&
+        crypto_register_type("", "Empty", 2, NULL) == CRYPTO_REGISTRY_INVALID_SYMBOL &&
+        crypto_register_type("NONAME", "", 2, NULL) == CRYPTO_REGISTRY_INVALID_NAME &&
+        crypto_register_type("BIG", "Big", CRYPTO_POW10_MAX + 1, NULL) == CRYPTO_REGISTRY_INVALID_DECIMALS &&
+        crypto_register_denom(CRYPTO_COUNT, "X", "X", 0, NULL) == CRYPTO_REGISTRY_UNKNOWN_TYPE &&
+        crypto_type_count() == types_before + 1) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected registry status\n");
+        failed_tests++;
+    }
+
+    // Test 4: Registry files, stopping at the first bad line
+    const char* registry =
+        "# symbol decimals name\n"
+        "asset WSTETH 18 Wrapped liquid staked Ether\n"
+        "\n"
+        "denom\tWSTETH\tGWEI\t9\tGwei  \r\n"
+        "asset PYUSD 6 PayPal USD";
+    const char* broken = "asset FOO 6 Foo\nasset BAR six Bar\nasset BAZ 6 Baz\n";
+    size_t line = 0;
+    crypto_type_t wsteth = CRYPTO_COUNT;
+    total_tests++;
+    if (crypto_registry_load_buffer(registry, strlen(registry), &line) == CRYPTO_REGISTRY_OK &&
+        (wsteth = crypto_get_type_for_symbol("WSTETH")) != CRYPTO_COUNT &&
+        strcmp(crypto_type_def(wsteth)->name, "Wrapped liquid staked Ether") == 0 &&
+        strcmp(crypto_denom_def(crypto_get_denom_for_symbol(wsteth, "GWEI"))->name, "Gwei") == 0 &&
+        crypto_get_type_for_symbol("PYUSD") != CRYPTO_COUNT &&
+        crypto_registry_load_buffer(broken, strlen(broken), &line) == CRYPTO_REGISTRY_SYNTAX && line == 2 &&
+        crypto_get_type_for_symbol("FOO") != CRYPTO_COUNT && crypto_get_type_for_symbol("BAZ") == CRYPTO_COUNT &&
+        crypto_registry_load("/nonexistent/assets.txt", &line) == CRYPTO_REGISTRY_IO_ERROR && errno == ENOENT) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected registry file result (line %zu)\n", line);
+        failed_tests++;
+    }
+
+    // Test 5: Dense indexes cover built-in and registered ids without gaps
+    unsigned mismatches = 0;
+    for (size_t i = 0; i < crypto_type_count(); i++) {
+        crypto_type_t t = crypto_type_at(i);
+        if (!crypto_is_valid_type(t) || crypto_type_index(t) != i ||
+            crypto_get_type_for_symbol(crypto_type_def(t)->symbol) != t) {
+            mismatches++;
+        }
+    }
+    for (size_t i = 0; i < crypto_denom_count(); i++) {
+        crypto_denom_t d = crypto_denom_at(i);
+        if (!crypto_is_valid_denom(d) || crypto_denom_index(d) != i) {
+            mismatches++;
+        }
+    }
+    total_tests++;
+    if (mismatches == 0 && crypto_type_at(CRYPTO_COUNT) == CRYPTO_TYPE_FIRST_REGISTERED) {
+        passed_tests++;
+    } else {
+        printf("FAIL: %u dense index mismatches\n", mismatches);
+        failed_tests++;
+    }
+
+    // Test 6: CSV totals grow for types registered after they were set up
+    char path[] = "/tmp/cryptomath_registry_XXXXXX";
+    int fd = mkstemp(path);
+    const char* csv = "3,USDE\n4,LATE\n5,LATE\n";
+    bool written = fd >= 0 && write(fd, csv, strlen(csv)) == (ssize_t)strlen(csv);
+    if (fd >= 0) {
+        close(fd);
+    }
+    crypto_csv_spec_t spec = { .delim = ',', .amount_column = 0, .symbol_column = 1, .denom_column = -1 };
+    crypto_csv_totals_t totals;
+    crypto_csv_stats_t stats;
+    crypto_type_t late = CRYPTO_COUNT;
+    bool ready = crypto_csv_totals_init(&totals);
+    total_tests++;
+    if (written && ready && crypto_register_type("LATE", "Registered late", 2, &late) == CRYPTO_REGISTRY_OK &&
+        crypto_csv_sum(path, &spec, &totals, &stats) && stats.rejected == 0 &&
+        totals.count[crypto_type_index(usde)] == 1 && totals.count[crypto_type_index(late)] == 2 &&
+        crypto_format_to(buf, sizeof(buf), &totals.sum[crypto_type_index(late)],
+                         crypto_get_denom_for_symbol(late, "LATE")) > 0 && strcmp(buf, "9") == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: CSV totals of a late registered type\n");
+        failed_tests++;
+    }
+    crypto_csv_totals_clear(&totals);
+    unlink(path);
+
+    // Test 7: Per-type chains list a type's denominations in id order, registered ones last
+    crypto_denom_t eth_kwei = DENOM_COUNT;
+    crypto_register_denom(CRYPTO_ETHEREUM, "KWEI", "Kwei", 3, &eth_kwei);
+    crypto_denom_t expected[] = { ETH_DENOM_ETHER, ETH_DENOM_GWEI, ETH_DENOM_WEI, eth_kwei };
+    size_t n = 0;
+    bool ordered = true;
+    for (crypto_denom_t d = crypto_first_denom(CRYPTO_ETHEREUM); d != DENOM_COUNT; d = crypto_next_denom(d)) {
+        ordered = ordered && n < sizeof(expected) / sizeof(expected[0]) && d == expected[n];
+        n++;
+    }
+    total_tests++;
+    if (ordered && n == sizeof(expected) / sizeof(expected[0]) &&
+        crypto_first_denom(usde) == crypto_get_denom_for_symbol(usde, "USDE") &&
+        crypto_next_denom(crypto_first_denom(usde)) == usde_wei &&
+        crypto_next_denom(usde_wei) == DENOM_COUNT) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Denomination chain of a type (%zu entries)\n", n);
+        failed_tests++;
+    }
+
+    // Test 8: A registered denom too fine for a native scale only has the mpz one
+    crypto_denom_t usde_quecto = DENOM_COUNT;
+    total_tests++;
+    if (crypto_register_denom(usde, "QUECTO", "Quecto USDe", 30, &usde_quecto) == CRYPTO_REGISTRY_OK &&
+        crypto_denom_scale_u64(usde_quecto) == 0 &&
+        crypto_denom_scale_u64(usde_wei) == 1 &&
+        mpz_cmp(*crypto_denom_scale(usde_quecto), *crypto_pow10(30)) == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Scale of a denom with more than %d decimals\n", CRYPTO_POW10_U64_MAX);
+        failed_tests++;
+    }
+}
+
+void test_decimals_kernels() {
+    printf("\n=== Testing Per-Decimals Parse and Format Kernels ===\n");
+
+    // One denomination for every decimal count the kernels cover, on a registered type
+    crypto_type_t type = CRYPTO_COUNT;
+    crypto_denom_t denoms[20];
+    bool registered = crypto_register_type("KERNEL", "Kernel Test", 19, &type) == CRYPTO_REGISTRY_OK;
+    for (unsigned d = 0; registered && d < 20; d++) {
+        char symbol[8];
+        snprintf(symbol, sizeof(symbol), "D%u", d);
+        registered = crypto_register_denom(type, symbol, symbol, d, &denoms[d]) == CRYPTO_REGISTRY_OK;
+    }
+    total_tests++;
+    if (registered) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Registering kernel test denominations\n");
+        failed_tests++;
+        return;
+    }
+
+    // Test 1: Parsing matches the generic parser, including statuses and error positions
+    const char* inputs[] = {
+        "0", "-0", "+7", "  42  ", "\t-1.5\n", "0.1", ".5", "5.", "-.25", "1.0000000000000000000000001",
+        "18446744073709551615", "18446744073709551616", "1844674407370955160.9", "-99999999999999999999.99",
+        "123456789.123456789123456789", "00000000000000000000000001", "", " ", "-", ".", "1.2.3", "12a",
+        "1 2", "--1", "1e5", "0x10",
+    };
+    int parse_mismatches = 0;
+    for (unsigned d = 0; d < 20; d++) {
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+            crypto_val_t fast, slow;
+            crypto_init(&fast, type);
+            crypto_init(&slow, type);
+            size_t fast_pos = SIZE_MAX, slow_pos = SIZE_MAX;
+            size_t len = strlen(inputs[i]);
+            crypto_parse_status_t fast_status = crypto_parse_decimal(&fast, denoms[d], inputs[i], SIZE_MAX, &fast_pos);
+            crypto_parse_status_t slow_status = crypto_parse_decimal_generic(&slow, denoms[d], inputs[i], len, &slow_pos);
+            if (fast_status != slow_status || fast_pos != slow_pos || crypto_cmp(&fast, &slow) != 0) {
+                printf("FAIL: Kernel parse of \"%s\" with %u decimals\n", inputs[i], d);
+                parse_mismatches++;
+            }
+            crypto_clear(&fast);
+            crypto_clear(&slow);
+        }
+    }
+    total_tests++;
+    if (parse_mismatches == 0) {
+        passed_tests++;
+    } else {
+        failed_tests++;
+    }
+
+    // Test 2: Formatting matches the generic formatter around the limb and 10^19 boundaries
+    const char* values[] = {
+        "0", "1", "-1", "9", "10", "999999999999999999", "1000000000000000000", "9999999999999999999",
+        "10000000000000000000", "18446744073709551615", "18446744073709551616", "-18446744073709551617",
+        "184467440737095516150000000000000000000", "340282366920938463463374607431768211455",
+        "-340282366920938463463374607431768211455", "340282366920938463463374607431768211456",
+        "123456789012345678901234567890", "100000000000000000000000000000000000000",
+    };
+    int format_mismatches = 0;
+    crypto_val_t v;
+    crypto_init(&v, type);
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        crypto_set_from_decimal(&v, denoms[0], values[i]);
+        for (unsigned d = 0; d < 20; d++) {
+            char fast[128], slow[128], tight[128];
+            size_t fast_len = crypto_format_to(fast, sizeof(fast), &v, denoms[d]);
+            size_t slow_len = crypto_format_to_generic(slow, sizeof(slow), &v, denoms[d]);
+            // Too small a buffer still reports the full length and leaves it untouched
+            memset(tight, 'x', sizeof(tight));
+            size_t tight_len = crypto_format_to(tight, slow_len, &v, denoms[d]);
+            if (fast_len != slow_len || strcmp(fast, slow) != 0 || tight_len != slow_len || tight[0] != 'x') {
+                printf("FAIL: Kernel format of %s with %u decimals, got %s want %s\n", values[i], d, fast, slow);
+                format_mismatches++;
+            }
+        }
+    }
+    crypto_clear(&v);
+    total_tests++;
+    if (format_mismatches == 0) {
+        passed_tests++;
+    } else {
+        failed_tests++;
+    }
+}
+
+void test_vector_scanning() {
+    printf("\n=== Testing Vectorized Digit Scanning ===\n");
+
+    // Test 1: Spans stop at the first byte out of range at every offset and length,
+    // including bytes just outside the range and above 0x7F
+    const unsigned char stoppers[] = { '/', ':', 'a', ' ', '\0', 0x80, 0xB0, 0xFF };
+    char buf[80];
+    int span_mismatches = 0;
+    for (size_t n = 0; n <= sizeof(buf); n++) {
+        for (size_t stop = 0; stop <= n; stop++) {
+            for (size_t k = 0; k < sizeof(stoppers); k++) {
+                for (size_t j = 0; j < n; j++) {
+                    buf[j] = (char)('0' + (j * 7) % 10);
+                }
+                if (stop < n) {
+                    buf[stop] = (char)stoppers[k];
+                }
+                size_t digits = crypto_span_range(buf, n, '0', '9');
+                memset(buf, '0', n);
+                if (stop < n) {
+                    buf[stop] = (char)stoppers[k];
+                }
+                size_t zeros = crypto_span_range(buf, n, '0', '0');
+                if (digits != stop || zeros != stop) {
+                    span_mismatches++;
+                }
+            }
+        }
+    }
+    total_tests++;
+    if (span_mismatches == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: %d digit spans ended at the wrong byte\n", span_mismatches);
+        failed_tests++;
+    }
+
+    // Test 2: Eight-digit words are recognized exactly and convert to their value
+    int word_mismatches = 0;
+    char word[9] = "31415926";
+    for (int pos = 0; pos < 8; pos++) {
+        for (int c = 0; c < 256; c++) {
+            memcpy(word, "31415926", 8);
+            word[pos] = (char)c;
+            bool digits = c >= '0' && c <= '9';
+            uint64_t x = crypto_load_le64(word);
+            if (crypto_swar_is_digits8(x) != digits ||
+                (digits && crypto_swar_digits8(x) != strtoul(word, NULL, 10))) {
+                word_mismatches++;
+            }
+        }
+    }
+    uint64_t nines = crypto_load_le64("99999999");
+    total_tests++;
+    if (word_mismatches == 0 && crypto_swar_digits8(nines) == 99999999 &&
+        crypto_swar_digits8(crypto_load_le64("00000000")) == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: %d eight-digit words misread\n", word_mismatches);
+        failed_tests++;
+    }
+
+    // Test 3: Validation and fraction checks on amounts longer than a vector
+    const char* max_wei = "115792089237316195423570985008687907853269984665640564039457584007913129639935";
+    char valid[128], zeros[64];
+    snprintf(valid, sizeof(valid), " -%.60s.%s ", max_wei, max_wei + 60);
+    snprintf(zeros, sizeof(zeros), "1.%s", "000000000000000000000000000000000000000000000000");
+    char bad[128];
+    snprintf(bad, sizeof(bad), "%.40sx%s", max_wei, max_wei + 40);
+    char late[128];
+    snprintf(late, sizeof(late), "%s7", zeros);
+    char spaced[128];
+    snprintf(spaced, sizeof(spaced), "%s 7", zeros);
+    total_tests++;
+    if (crypto_is_valid_decimal(max_wei) && crypto_is_valid_decimal(valid) && !crypto_is_valid_decimal(bad) &&
+        !crypto_is_valid_decimal(spaced) && !crypto_has_nonzero_fraction(zeros) &&
+        crypto_has_nonzero_fraction(late) && !crypto_has_nonzero_fraction(spaced)) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Long decimal validation\n");
+        failed_tests++;
+    }
+
+    // Test 4: Word-at-a-time parsing agrees with GMP for every split of a 78-digit amount
+    int parse_mismatches = 0;
+    crypto_val_t parsed, expected;
+    crypto_init(&parsed, CRYPTO_ETHEREUM);
+    crypto_init(&expected, CRYPTO_ETHEREUM);
+    mpz_t reference;
+    mpz_init(reference);
+    for (int dot = 0; dot <= 78; dot++) {
+        char amount[96], wei[128];
+        snprintf(amount, sizeof(amount), "%.*s.%s", dot, max_wei, max_wei + dot);
+        // The same amount in wei: fraction digits beyond 18 dropped, short ones padded
+        int fraction = 78 - dot < 18 ? 78 - dot : 18;
+        snprintf(wei, sizeof(wei), "0%.*s%.*s%.*s", dot, max_wei, fraction, max_wei + dot, 18 - fraction,
+                 "000000000000000000");
+        mpz_set_str(reference, wei, 10);
+        crypto_set_mpz(&expected, reference);
+        if (crypto_parse_decimal(&parsed, ETH_DENOM_ETHER, amount, strlen(amount), NULL) != CRYPTO_PARSE_OK ||
+            crypto_cmp(&parsed, &expected) != 0) {
+            printf("FAIL: Parsing %s\n", amount);
+            parse_mismatches++;
+        }
+    }
+    mpz_clear(reference);
+    crypto_clear(&parsed);
+    crypto_clear(&expected);
+    total_tests++;
+    if (parse_mismatches == 0) {
+        passed_tests++;
+    } else {
+        failed_tests++;
+    }
+}
+
+void test_blob_encoding() {
+    printf("\n=== Testing Binary Encoding ===\n");
+
+    // Ascending amounts, including limb boundaries and a promoted value
+    const char* sorted[] = {
+        "-1000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000",
+        "-115792089237316195423570985008687907853269984665640564039457584007913129639935",
+        "-18446744073709551616", "-18446744073709551615", "-256", "-255", "-1", "0", "1", "255",
+        "256", "18446744073709551615", "18446744073709551616",
+        "115792089237316195423570985008687907853269984665640564039457584007913129639935",
+        "1000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    };
+    const int count = sizeof(sorted) / sizeof(sorted[0]);
+    unsigned char blobs[15][CRYPTO_BLOB_HEADER_SIZE + CRYPTO_BLOB_MAX_MAGNITUDE];
+    size_t sizes[15];
+
+    crypto_val_t amount, decoded;
+    crypto_init(&amount, CRYPTO_ETHEREUM);
+    crypto_init(&decoded, CRYPTO_ETHEREUM);
+
+    // Test 1: Every value round-trips
+    for (int i = 0; i < count; i++) {
+        crypto_set_from_decimal(&amount, ETH_DENOM_WEI, sorted[i]);
+        sizes[i] = crypto_to_blob(blobs[i], sizeof(blobs[i]), &amount);
+        total_tests++;
+        if (sizes[i] == 0 || !crypto_from_blob(&decoded, blobs[i], sizes[i]) || crypto_cmp(&amount, &decoded) != 0) {
+            printf("FAIL: %s did not round-trip\n", sorted[i]);
+            failed_tests++;
+        } else {
+            passed_tests++;
+        }
+    }
+
+    // Test 2: memcmp order matches numeric order
+    unsigned misordered = 0;
+    for (int i = 1; i < count; i++) {
+        size_t n = sizes[i - 1] < sizes[i] ? sizes[i - 1] : sizes[i];
+        int c = memcmp(blobs[i - 1], blobs[i], n);
+        if (c > 0 || (c == 0 && sizes[i - 1] >= sizes[i])) {
+            printf("FAIL: %s does not sort before %s\n", sorted[i - 1], sorted[i]);
+            misordered++;
+        }
+    }
+    total_tests++;
+    if (misordered == 0) {
+        passed_tests++;
+    } else {
+        failed_tests++;
+    }
+
+    // Test 3: Sizes, short buffers and the inline bound
+    unsigned char buf[CRYPTO_BLOB_INLINE_MAX];
+    memset(buf, 0xAA, sizeof(buf));
+    crypto_set_from_decimal(&amount, ETH_DENOM_WEI, "256");
+    total_tests++;
+    if (sizes[7] == CRYPTO_BLOB_HEADER_SIZE && crypto_to_blob(buf, 5, &amount) == 6 && buf[0] == 0xAA &&
+        sizes[13] == CRYPTO_BLOB_HEADER_SIZE + CRYPTO_INLINE_BITS / 8 && crypto_to_blob(NULL, 0, &amount) == 6) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected blob sizes\n");
+        failed_tests++;
+    }
+
+    // Test 4: Malformed blobs and other crypto types are rejected
+    crypto_to_blob(buf, sizeof(buf), &amount);
+    unsigned char bad_version[] = { 2, 0, CRYPTO_ETHEREUM, 0x81, 1 };
+    unsigned char leading_zero[] = { 1, 0, CRYPTO_ETHEREUM, 0x82, 0, 1 };
+    unsigned char short_blob[] = { 1, 0, CRYPTO_ETHEREUM, 0x82, 1 };
+    unsigned char bad_type[] = { 1, 0xFF, 0xFF, 0x81, 1 };
+    // A header of 0x00 means 128 magnitude bytes, one more than the encoder writes
+    unsigned char too_long[CRYPTO_BLOB_HEADER_SIZE + CRYPTO_BLOB_MAX_MAGNITUDE + 1] = { 1, 0, CRYPTO_ETHEREUM, 0x00, 0xFE };
+    crypto_val_t btc;
+    crypto_init(&btc, CRYPTO_BITCOIN);
+    total_tests++;
+    if (crypto_blob_type(buf, 6) == CRYPTO_ETHEREUM &&
+        !crypto_from_blob(&decoded, bad_version, sizeof(bad_version)) &&
+        !crypto_from_blob(&decoded, leading_zero, sizeof(leading_zero)) &&
+        !crypto_from_blob(&decoded, short_blob, sizeof(short_blob)) &&
+        crypto_blob_type(bad_type, sizeof(bad_type)) == CRYPTO_COUNT &&
+        crypto_blob_type(too_long, sizeof(too_long)) == CRYPTO_COUNT &&
+        !crypto_from_blob(&btc, buf, 6)) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Malformed blob was accepted\n");
+        failed_tests++;
+    }
+
+    crypto_clear(&btc);
+    crypto_clear(&amount);
+    crypto_clear(&decoded);
+}
+
+void test_partial_sums() {
+    printf("\n=== Testing Mergeable Partial Sums ===\n");
+
+    // Test 1: Shards merged in any order equal the partial of all amounts
+    const char* amounts[] = { "1.5", "-2.25", "1000000", "0.000000000000000001", "-7", "3" };
+    enum { SHARDS = 3, AMOUNTS = sizeof(amounts) / sizeof(amounts[0]) };
+    crypto_partial_t all, shards[SHARDS], merged, reversed;
+    crypto_partial_init(&all, CRYPTO_ETHEREUM);
+    crypto_partial_init(&merged, CRYPTO_ETHEREUM);
+    crypto_partial_init(&reversed, CRYPTO_ETHEREUM);
+    for (int i = 0; i < SHARDS; i++) {
+        crypto_partial_init(&shards[i], CRYPTO_ETHEREUM);
+    }
+    crypto_val_t v;
+    crypto_init(&v, CRYPTO_ETHEREUM);
+    for (int i = 0; i < AMOUNTS; i++) {
+        crypto_set_from_decimal(&v, ETH_DENOM_ETHER, amounts[i]);
+        crypto_partial_add(&all, &v);
+        crypto_partial_add(&shards[i % (SHARDS - 1)], &v);  // The last shard stays empty
+    }
+    for (int i = 0; i < SHARDS; i++) {
+        crypto_partial_merge(&merged, &shards[i]);
+        crypto_partial_merge(&reversed, &shards[SHARDS - 1 - i]);
+    }
+    char sum[64], min[64], max[64];
+    crypto_format_to(sum, sizeof(sum), &merged.sum, ETH_DENOM_ETHER);
+    crypto_format_to(min, sizeof(min), &merged.min, ETH_DENOM_ETHER);
+    crypto_format_to(max, sizeof(max), &merged.max, ETH_DENOM_ETHER);
+    total_tests++;
+    if (merged.count == AMOUNTS && reversed.count == AMOUNTS &&
+        crypto_cmp(&merged.sum, &all.sum) == 0 && crypto_cmp(&reversed.sum, &all.sum) == 0 &&
+        crypto_cmp(&reversed.min, &all.min) == 0 && crypto_cmp(&reversed.max, &all.max) == 0 &&
+        strcmp(sum, "999995.250000000000000001") == 0 && strcmp(min, "-7") == 0 && strcmp(max, "1000000") == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Merged partial sum=%s min=%s max=%s count=%llu\n", sum, min, max,
+               (unsigned long long)merged.count);
+        failed_tests++;
+    }
+
+    // Test 2: Encoding round trip, including an empty partial and a promoted sum
+    unsigned char buf[CRYPTO_PARTIAL_INLINE_MAX];
+    size_t len = crypto_partial_to_blob(buf, sizeof(buf), &merged);
+    crypto_partial_t decoded, empty;
+    crypto_partial_init(&decoded, CRYPTO_ETHEREUM);
+    crypto_partial_init(&empty, CRYPTO_BITCOIN);
+    bool round_trip = len > 0 && len <= sizeof(buf) &&
+        crypto_partial_blob_type(buf, len) == CRYPTO_ETHEREUM &&
+        crypto_partial_from_blob(&decoded, buf, len) && decoded.count == merged.count &&
+        crypto_cmp(&decoded.sum, &merged.sum) == 0 && crypto_cmp(&decoded.min, &merged.min) == 0 &&
+        crypto_cmp(&decoded.max, &merged.max) == 0;
+    size_t empty_len = crypto_partial_to_blob(buf, sizeof(buf), &empty);
+    round_trip = round_trip && empty_len == CRYPTO_PARTIAL_HEADER_SIZE + 3 * CRYPTO_BLOB_HEADER_SIZE &&
+        crypto_partial_from_blob(&empty, buf, empty_len) && empty.count == 0;
+    crypto_set_from_decimal(&v, ETH_DENOM_WEI,
+        "100000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000");
+    crypto_partial_add(&decoded, &v);
+    crypto_partial_add(&decoded, &v);
+    unsigned char* big = malloc(crypto_partial_to_blob(NULL, 0, &decoded));
+    size_t big_len = crypto_partial_to_blob(NULL, 0, &decoded);
+    crypto_partial_t big_decoded;
+    crypto_partial_init(&big_decoded, CRYPTO_ETHEREUM);
+    round_trip = round_trip && big != NULL && decoded.sum.is_big &&
+        crypto_partial_to_blob(big, big_len, &decoded) == big_len &&
+        crypto_partial_from_blob(&big_decoded, big, big_len) &&
+        big_decoded.sum.is_big && crypto_cmp(&big_decoded.sum, &decoded.sum) == 0 && big_decoded.count == AMOUNTS + 2;
+    total_tests++;
+    if (round_trip) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Partial encoding round trip\n");
+        failed_tests++;
+    }
+    free(big);
+
+    // Test 3: Malformed partials and other crypto types are rejected, leaving the target alone
+    len = crypto_partial_to_blob(buf, sizeof(buf), &merged);
+    crypto_partial_t btc;
+    crypto_partial_init(&btc, CRYPTO_BITCOIN);
+    unsigned char amount_blob[CRYPTO_BLOB_INLINE_MAX];
+    size_t amount_len = crypto_to_blob(amount_blob, sizeof(amount_blob), &merged.sum);
+    bool rejected = !crypto_partial_from_blob(&btc, buf, len) &&
+        !crypto_partial_from_blob(&decoded, buf, len - 1) &&
+        crypto_partial_blob_type(amount_blob, amount_len) == CRYPTO_COUNT &&
+        crypto_partial_blob_type(buf, CRYPTO_PARTIAL_HEADER_SIZE) == CRYPTO_COUNT;
+    buf[len] = 0;
+    rejected = rejected && !crypto_partial_from_blob(&decoded, buf, len + 1);
+    // Swap min and max: both fields hold the same type, so only the bounds check catches it
+    crypto_partial_t swapped;
+    crypto_partial_init(&swapped, CRYPTO_ETHEREUM);
+    swapped.count = 2;
+    crypto_set(&swapped.min, &merged.max);
+    crypto_set(&swapped.max, &merged.min);
+    len = crypto_partial_to_blob(buf, sizeof(buf), &swapped);
+    rejected = rejected && !crypto_partial_from_blob(&decoded, buf, len) && decoded.count == AMOUNTS + 2;
+    total_tests++;
+    if (rejected) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Malformed partial was accepted\n");
+        failed_tests++;
+    }
+
+    crypto_partial_clear(&swapped);
+    crypto_partial_clear(&btc);
+    crypto_partial_clear(&big_decoded);
+    crypto_partial_clear(&empty);
+    crypto_partial_clear(&decoded);
+    for (int i = 0; i < SHARDS; i++) {
+        crypto_partial_clear(&shards[i]);
+    }
+    crypto_partial_clear(&reversed);
+    crypto_partial_clear(&merged);
+    crypto_partial_clear(&all);
+    crypto_clear(&v);
+}
+
+static void* failing_malloc(size_t n) {
+    (void)n;
+    return NULL;
+}
+
+static void* failing_realloc(void* p, size_t n) {
+    (void)p;
+    (void)n;
+    return NULL;
+}
+
+void test_rate_table() {
+    printf("\n=== Testing Rate Tables ===\n");
+
+    // Test 1: Rates are kept as reduced smallest-unit ratios, whatever denominations they are quoted in
+    crypto_rate_table_t rates;
+    crypto_rate_table_init(&rates);
+    total_tests++;
+    if (crypto_rate_table_set(&rates, BTC_DENOM_BITCOIN, ETH_DENOM_ETHER, "15.25") &&
+        crypto_rate_table_set(&rates, DOT_DENOM_DOT, BTC_DENOM_SATOSHI, "12345") &&
+        crypto_rate_table_set(&rates, ETH_DENOM_GWEI, BTC_DENOM_SATOSHI, "0.00006557") &&
+        rates.count == 3 &&
+        crypto_rate_table_find(&rates, CRYPTO_BITCOIN, CRYPTO_ETHEREUM) != NULL &&
+        crypto_rate_table_find(&rates, CRYPTO_ETHEREUM, CRYPTO_BITCOIN) != NULL &&
+        crypto_rate_table_find(&rates, CRYPTO_ETHEREUM, CRYPTO_POLKADOT) == NULL &&
+        mpz_cmp_ui(crypto_rate_table_find(&rates, CRYPTO_BITCOIN, CRYPTO_ETHEREUM)->num, 152500000000ULL) == 0 &&
+        mpz_cmp_ui(crypto_rate_table_find(&rates, CRYPTO_BITCOIN, CRYPTO_ETHEREUM)->den.value, 1) == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Setting and finding rates\n");
+        failed_tests++;
+    }
+
+    // Test 2: Valuation rounds once, in the requested direction
+    crypto_val_t btc, eth, sat;
+    crypto_init(&btc, CRYPTO_BITCOIN);
+    crypto_init(&eth, CRYPTO_ETHEREUM);
+    crypto_init(&sat, CRYPTO_BITCOIN);
+    char value[64], down[64], up[64], nearest[64];
+    crypto_set_from_decimal(&btc, BTC_DENOM_BITCOIN, "0.5");
+    bool valued = crypto_value_in(&eth, &btc, &rates, CRYPTO_ROUND_TRUNCATE);
+    crypto_format_to(value, sizeof(value), &eth, ETH_DENOM_ETHER);
+    // 1.5 ETH is 98355 satoshi; 1 wei is 0.00000000006557 satoshi
+    crypto_set_from_decimal(&eth, ETH_DENOM_WEI, "-1");
+    valued = valued && crypto_value_in(&sat, &eth, &rates, CRYPTO_ROUND_FLOOR);
+    crypto_format_to(down, sizeof(down), &sat, BTC_DENOM_SATOSHI);
+    crypto_set_from_decimal(&eth, ETH_DENOM_ETHER, "1.5");
+    valued = valued && crypto_value_in(&sat, &eth, &rates, CRYPTO_ROUND_CEIL);
+    crypto_format_to(up, sizeof(up), &sat, BTC_DENOM_SATOSHI);
+    crypto_set_from_decimal(&eth, ETH_DENOM_GWEI, "7625");
+    valued = valued && crypto_value_in(&sat, &eth, &rates, CRYPTO_ROUND_HALF_EVEN);
+    crypto_format_to(nearest, sizeof(nearest), &sat, BTC_DENOM_SATOSHI);
+    total_tests++;
+    if (valued && strcmp(value, "7.625000000000000000") == 0 && strcmp(down, "-1") == 0 &&
+        strcmp(up, "98355") == 0 && strcmp(nearest, "0") == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Valuation got %s, %s, %s and %s\n", value, down, up, nearest);
+        failed_tests++;
+    }
+
+    // Test 3: Replacing a rate, same-type copies, missing rates and invalid prices
+    crypto_val_t dot;
+    crypto_init(&dot, CRYPTO_POLKADOT);
+    crypto_set_from_decimal(&eth, ETH_DENOM_ETHER, "2");
+    crypto_set_from_decimal(&btc, BTC_DENOM_BITCOIN, "3");
+    crypto_set(&sat, &btc);
+    bool replaced = crypto_rate_table_set(&rates, BTC_DENOM_SATOSHI, ETH_DENOM_GWEI, "200") && rates.count == 3 &&
+                    crypto_value_in(&eth, &btc, &rates, CRYPTO_ROUND_TRUNCATE);
+    crypto_format_to(value, sizeof(value), &eth, ETH_DENOM_ETHER);
+    total_tests++;
+    if (replaced && strcmp(value, "60") == 0 &&
+        crypto_value_in(&sat, &btc, &rates, CRYPTO_ROUND_TRUNCATE) && crypto_cmp(&sat, &btc) == 0 &&
+        !crypto_value_in(&dot, &eth, &rates, CRYPTO_ROUND_TRUNCATE) && crypto_eq_zero(&dot) &&
+        !crypto_rate_table_set(&rates, BTC_DENOM_BITCOIN, ETH_DENOM_ETHER, "-1") &&
+        !crypto_rate_table_set(&rates, BTC_DENOM_BITCOIN, ETH_DENOM_ETHER, "1.2.3") &&
+        !crypto_rate_table_set(&rates, BTC_DENOM_BITCOIN, BTC_DENOM_SATOSHI, "100000000") &&
+        rates.count == 3) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Replaced rate valuation got %s\n", value);
+        failed_tests++;
+    }
+    crypto_clear(&btc);
+    crypto_clear(&eth);
+    crypto_clear(&sat);
+    crypto_clear(&dot);
+    crypto_rate_table_clear(&rates);
+
+    // Test 4: Out of memory growing the table is reported and leaves it as it was
+    crypto_rate_table_init(&rates);
+    crypto_set_allocator(failing_malloc, failing_realloc, free);
+    bool refused = !crypto_rate_table_set(&rates, BTC_DENOM_BITCOIN, ETH_DENOM_ETHER, "15.25");
+    crypto_set_allocator(NULL, NULL, NULL);
+    total_tests++;
+    if (refused && rates.count == 0 && rates.rates == NULL &&
+        crypto_rate_table_set(&rates, BTC_DENOM_BITCOIN, ETH_DENOM_ETHER, "15.25") && rates.count == 1) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Out of memory in a rate table was not reported\n");
+        failed_tests++;
+    }
+    crypto_rate_table_clear(&rates);
+}
+
+// Tallies completed batches for the callback pipeline test
+typedef struct {
+    _Atomic size_t batches;
+    _Atomic size_t rejected;
+    _Atomic size_t mismatches;
+} ingest_tally_t;
+
+static void tally_ingest_batch(crypto_ingest_batch_t* batch, void* ctx) {
+    ingest_tally_t* tally = ctx;
+    crypto_val_t expected;
+    crypto_init(&expected, CRYPTO_ETHEREUM);
+    crypto_set_from_decimal(&expected, ETH_DENOM_GWEI, "250000000");
+    for (size_t i = 0; i < batch->count; i++) {
+        if (batch->items[i].status == CRYPTO_INGEST_OK) {
+            atomic_fetch_add(&tally->mismatches, crypto_cmp(&batch->items[i].value, &expected) != 0);
+            crypto_clear(&batch->items[i].value);
+        }
+    }
+    crypto_clear(&expected);
+    atomic_fetch_add(&tally->rejected, batch->rejected);
+    atomic_fetch_add(&tally->batches, 1);
+}
+
+void test_ingest_pipeline() {
+    printf("\n=== Testing Ingest Pipeline ===\n");
+
+    // Test 1: Per-item statuses, with lengths and symbol changes within a batch
+    crypto_ingest_item_t items[] = {
+        { .asset = "ETH", .denom = "GWEI", .text = "1500000000" },
+        { .asset = "ETH", .denom = "ETH", .text = "2.5xyz", .len = 3 },
+        { .asset = "BTC", .denom = "SAT", .text = "42" },
+        { .asset = "XYZ", .denom = "XYZ", .text = "1" },
+        { .asset = "BTC", .denom = "GWEI", .text = "1" },
+        { .asset = "BTC", .denom = "BTC", .text = "1.2.3" },
+    };
+    crypto_ingest_batch_t batch = { .items = items, .count = 6 };
+    crypto_ingest_batch_run(&batch);
+    char a[64] = "", b[64] = "", c[64] = "";
+    if (items[0].status == CRYPTO_INGEST_OK) crypto_format_to(a, sizeof(a), &items[0].value, ETH_DENOM_ETHER);
+    if (items[1].status == CRYPTO_INGEST_OK) crypto_format_to(b, sizeof(b), &items[1].value, ETH_DENOM_ETHER);
+    if (items[2].status == CRYPTO_INGEST_OK) crypto_format_to(c, sizeof(c), &items[2].value, BTC_DENOM_BITCOIN);
+    total_tests++;
+    if (batch.rejected == 3 && strcmp(a, "1.500000000000000000") == 0 && strcmp(b, "2.500000000000000000") == 0 &&
+        strcmp(c, "0.00000042") == 0 && items[3].status == CRYPTO_INGEST_UNKNOWN_TYPE &&
+        items[4].status == CRYPTO_INGEST_UNKNOWN_DENOM && items[5].status == CRYPTO_INGEST_INVALID_AMOUNT &&
+        items[5].parse_status == CRYPTO_PARSE_MULTIPLE_DOTS && items[5].error_pos == 3) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Ingest batch got %zu rejected, %s, %s, %s\n", batch.rejected, a, b, c);
+        failed_tests++;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (items[i].status == CRYPTO_INGEST_OK) crypto_clear(&items[i].value);
+    }
+
+    // Test 2: Completed batches count against the capacity until polled
+    enum { BATCHES = 5, ITEMS = 64 };
+    static crypto_ingest_item_t polled[BATCHES][ITEMS];
+    static char texts[BATCHES][ITEMS][24];
+    crypto_ingest_batch_t batches[BATCHES];
+    for (int k = 0; k < BATCHES; k++) {
+        for (int i = 0; i < ITEMS; i++) {
+            snprintf(texts[k][i], sizeof(texts[k][i]), "%d.%d", k, i);
+            polled[k][i] = (crypto_ingest_item_t){ .asset = "ETH", .denom = "ETH", .text = texts[k][i] };
+        }
+        batches[k] = (crypto_ingest_batch_t){ .items = polled[k], .count = ITEMS, .user_data = (void*)(intptr_t)k };
+    }
+    crypto_pipeline_t* p = crypto_pipeline_create(&(crypto_pipeline_config_t){ .workers = 2, .capacity = 3 });
+    bool accepted = p != NULL;
+    for (int k = 0; accepted && k < 4; k++) {
+        accepted = crypto_pipeline_try_submit(p, &batches[k]);
+    }
+    bool refused = accepted && !crypto_pipeline_try_submit(p, &batches[4]);
+    int collected = 0, mismatches = 0;
+    for (int round = 0; accepted && round < 2; round++) {
+        crypto_pipeline_flush(p);
+        struct pollfd pfd = { .fd = crypto_pipeline_fd(p), .events = POLLIN };
+        if (poll(&pfd, 1, 5000) != 1) {
+            break;
+        }
+        crypto_ingest_batch_t* done;
+        while ((done = crypto_pipeline_poll(p)) != NULL) {
+            int k = (int)(intptr_t)done->user_data;
+            crypto_val_t want;
+            crypto_init(&want, CRYPTO_ETHEREUM);
+            for (int i = 0; i < ITEMS; i++) {
+                crypto_set_from_decimal(&want, ETH_DENOM_ETHER, texts[k][i]);
+                bool ok = done->items[i].status == CRYPTO_INGEST_OK;
+                mismatches += !ok || crypto_cmp(&done->items[i].value, &want) != 0;
+                if (ok) {
+                    crypto_clear(&done->items[i].value);
+                }
+            }
+            crypto_clear(&want);
+            mismatches += done->rejected != 0;
+            collected++;
+        }
+        if (round == 0) {
+            accepted = crypto_pipeline_try_submit(p, &batches[4]);
+        }
+    }
+    total_tests++;
+    if (accepted && refused && collected == BATCHES && mismatches == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Polled pipeline collected %d batches with %d mismatches\n", collected, mismatches);
+        failed_tests++;
+    }
+    crypto_pipeline_destroy(p);
+
+    // Test 3: Blocking submission into a small queue feeding a callback
+    enum { CALLBACK_BATCHES = 32, CALLBACK_ITEMS = 100 };
+    static crypto_ingest_item_t fed[CALLBACK_BATCHES][CALLBACK_ITEMS];
+    static crypto_ingest_batch_t fed_batches[CALLBACK_BATCHES];
+    ingest_tally_t tally;
+    atomic_init(&tally.batches, 0);
+    atomic_init(&tally.rejected, 0);
+    atomic_init(&tally.mismatches, 0);
+    p = crypto_pipeline_create(&(crypto_pipeline_config_t){
+        .workers = 4, .capacity = 2, .on_complete = tally_ingest_batch, .ctx = &tally });
+    for (int k = 0; p != NULL && k < CALLBACK_BATCHES; k++) {
+        for (int i = 0; i < CALLBACK_ITEMS; i++) {
+            fed[k][i] = (crypto_ingest_item_t){ .asset = "ETH", .denom = "ETH", .text = i == k ? "bad" : "0.25" };
+        }
+        fed_batches[k] = (crypto_ingest_batch_t){ .items = fed[k], .count = CALLBACK_ITEMS };
+        crypto_pipeline_submit(p, &fed_batches[k]);
+    }
+    if (p != NULL) {
+        crypto_pipeline_flush(p);
+    }
+    total_tests++;
+    if (p != NULL && crypto_pipeline_fd(p) == -1 && atomic_load(&tally.batches) == CALLBACK_BATCHES &&
+        atomic_load(&tally.rejected) == CALLBACK_BATCHES && atomic_load(&tally.mismatches) == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Callback pipeline completed %zu batches\n", atomic_load(&tally.batches));
+        failed_tests++;
+    }
+    crypto_pipeline_destroy(p);
+}
+
+void test_batch_operations() {
+    printf("\n=== Testing Batch Operations ===\n");
+
+    enum { N = 130 };
+    static crypto_val_t a[N], b[N], r[N];
+    for (int i = 0; i < N; i++) {
+        char str[32];
+        crypto_init(&a[i], CRYPTO_ETHEREUM);
+        crypto_init(&b[i], CRYPTO_ETHEREUM);
+        crypto_init(&r[i], CRYPTO_ETHEREUM);
+        snprintf(str, sizeof(str), "%d.5", i - 65);
+        crypto_set_from_decimal(&a[i], ETH_DENOM_ETHER, str);
+        crypto_set_from_decimal(&b[i], ETH_DENOM_ETHER, "0.25");
+    }
+
+    // Test 1: Element-wise add, sub and mul match the scalar calls
+    mpz_t three;
+    mpz_init_set_ui(three, 3);
+    crypto_val_t expected;
+    crypto_init(&expected, CRYPTO_ETHEREUM);
+    unsigned mismatches = 0;
+    crypto_add_n(r, a, b, N);
+    for (int i = 0; i < N; i++) {
+        crypto_add(&expected, &a[i], &b[i]);
+        mismatches += crypto_cmp(&expected, &r[i]) != 0;
+    }
+    crypto_sub_n(r, a, b, N);
+    for (int i = 0; i < N; i++) {
+        crypto_sub(&expected, &a[i], &b[i]);
+        mismatches += crypto_cmp(&expected, &r[i]) != 0;
+    }
+    crypto_mul_n(r, a, &three, N);
+    for (int i = 0; i < N; i++) {
+        crypto_mul(&expected, &a[i], &three);
+        mismatches += crypto_cmp(&expected, &r[i]) != 0;
+    }
+    total_tests++;
+    if (mismatches == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: %u batch results differ from the scalar calls\n", mismatches);
+        failed_tests++;
+    }
+
+    // Test 2: Sums of mixed signs, in place, and with a promoted element
+    crypto_val_t sum;
+    crypto_init(&sum, CRYPTO_ETHEREUM);
+    crypto_sum_n(&sum, a, N);
+    verify_decimal_string(&sum, ETH_DENOM_ETHER, "-65");
+    crypto_sum_n(&sum, a, 0);
+    verify_decimal_string(&sum, ETH_DENOM_ETHER, "0");
+    crypto_set_from_decimal(&b[N - 1], ETH_DENOM_WEI, "1000000000000000000000000000000000000000000000000000000000000000000000000000000");
+    crypto_sum_n(&b[0], b, N);
+    verify_decimal_string(&b[0], ETH_DENOM_WEI, "1000000000000000000000000000000000000000000000000000000000032250000000000000000");
+
+    // Test 3: Threshold masks and counts, including a partial last word
+    uint64_t mask[(N + 63) / 64];
+    crypto_val_t zero;
+    crypto_init(&zero, CRYPTO_ETHEREUM);
+    size_t above = crypto_cmp_n(mask, a, N, &zero, 1);
+    size_t below = crypto_cmp_n(mask, a, N, &zero, -1);
+    total_tests++;
+    if (above == 65 && below == 65 && mask[0] == UINT64_MAX && (mask[1] & 1) == 1 && mask[1] >> 1 == 0 && mask[2] == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected cmp_n results (%zu above, %zu below)\n", above, below);
+        failed_tests++;
+    }
+
+    mpz_clear(three);
+    crypto_clear(&expected);
+    crypto_clear(&sum);
+    crypto_clear(&zero);
+    for (int i = 0; i < N; i++) {
+        crypto_clear(&a[i]);
+        crypto_clear(&b[i]);
+        crypto_clear(&r[i]);
+    }
+}
+
+void test_column() {
+    printf("\n=== Testing Amount Columns ===\n");
+
+    crypto_column_t col;
+    crypto_column_init(&col, CRYPTO_ETHEREUM);
+    crypto_val_t val;
+    crypto_init(&val, CRYPTO_ETHEREUM);
+
+    // Test 1: Bulk parse skips blank lines and accepts CRLF
+    const char* text = "1.5\r\n-2.25\n\n  0.000000000000000001\n3\n";
+    total_tests++;
+    if (crypto_column_parse(&col, ETH_DENOM_ETHER, text, strlen(text), NULL) == CRYPTO_PARSE_OK && col.count == 4) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Expected 4 parsed values, got %zu\n", col.count);
+        failed_tests++;
+    }
+
+    // Test 2: A bad line appends nothing and reports its offset
+    const char* bad = "7\n1.2.3\n";
+    size_t error_pos = 0;
+    total_tests++;
+    if (crypto_column_parse(&col, ETH_DENOM_ETHER, bad, strlen(bad), &error_pos) == CRYPTO_PARSE_MULTIPLE_DOTS &&
+        error_pos == 5 && col.count == 4) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Bad line was not rolled back (count %zu, position %zu)\n", col.count, error_pos);
+        failed_tests++;
+    }
+
+    // Test 3: Growth past the first reservation, a spilled value and reductions
+    crypto_set_from_decimal(&val, ETH_DENOM_WEI, "-1");
+    for (int i = 0; i < 100; i++) {
+        crypto_column_append(&col, &val);
+    }
+    crypto_set_from_decimal(&val, ETH_DENOM_WEI, "1000000000000000000000000000000000000000000000000000000000000000000000000000000");
+    crypto_column_append(&col, &val);
+    crypto_column_sum(&col, &val);
+    verify_decimal_string(&val, ETH_DENOM_WEI, "1000000000000000000000000000000000000000000000000000000000002249999999999999901");
+    crypto_column_min(&col, &val);
+    verify_decimal_string(&val, ETH_DENOM_ETHER, "-2.250000000000000000");
+    crypto_column_max(&col, &val);
+    verify_decimal_string(&val, ETH_DENOM_WEI, "1000000000000000000000000000000000000000000000000000000000000000000000000000000");
+
+    // Test 4: Sort, then format back to text
+    crypto_column_t small;
+    crypto_column_init(&small, CRYPTO_ETHEREUM);
+    crypto_column_parse(&small, ETH_DENOM_GWEI, "3\n-1\n2.5\n0\n-1\n", SIZE_MAX, NULL);
+    crypto_column_sort(&small);
+    char buf[64];
+    size_t len = crypto_column_format(&small, ETH_DENOM_GWEI, buf, sizeof(buf));
+    total_tests++;
+    if (len == strlen("-1\n-1\n0\n2.500000000\n3\n") && strcmp(buf, "-1\n-1\n0\n2.500000000\n3\n") == 0 &&
+        crypto_column_format(&small, ETH_DENOM_GWEI, buf, 4) == len) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected sorted column text\n");
+        failed_tests++;
+    }
+
+    crypto_column_sum(&small, &val);
+    verify_decimal_string(&val, ETH_DENOM_GWEI, "3.500000000");
+
+    // Test 5: Empty columns
+    crypto_column_clear(&small);
+    crypto_set_from_decimal(&val, ETH_DENOM_WEI, "5");
+    total_tests++;
+    if (!crypto_column_min(&small, &val) && !crypto_column_max(&small, &val) &&
+        crypto_column_format(&small, ETH_DENOM_WEI, buf, sizeof(buf)) == 0 && buf[0] == '\0') {
+        passed_tests++;
+    } else {
+        printf("FAIL: Empty column reductions should report no value\n");
+        failed_tests++;
+    }
+    crypto_column_sum(&small, &val);
+    verify_decimal_string(&val, ETH_DENOM_WEI, "0");
+
+    // Test 6: Out of memory is reported and leaves the columns as they were
+    crypto_column_parse(&small, ETH_DENOM_GWEI, "2\n1\n", SIZE_MAX, NULL);
+    crypto_set_allocator(failing_malloc, failing_realloc, free);
+    crypto_column_t empty;
+    crypto_column_init(&empty, CRYPTO_ETHEREUM);
+    error_pos = SIZE_MAX;
+    bool reported = !crypto_column_reserve(&empty, 16) && !crypto_column_append(&empty, &val) &&
+                    crypto_column_parse(&empty, ETH_DENOM_GWEI, "1\n2\n", SIZE_MAX, &error_pos) == CRYPTO_PARSE_NOMEM &&
+                    error_pos == 0 && empty.count == 0 && !crypto_column_sort(&small);
+    crypto_set_allocator(NULL, NULL, NULL);
+    len = crypto_column_format(&small, ETH_DENOM_GWEI, buf, sizeof(buf));
+    total_tests++;
+    if (reported && strcmp(buf, "2\n1\n") == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Out of memory in a column was not reported\n");
+        failed_tests++;
+    }
+    crypto_column_clear(&empty);
+
+    crypto_clear(&val);
+    crypto_column_clear(&col);
+    crypto_column_clear(&small);
+}
+
+static int hook_allocs = 0;
+static int hook_frees = 0;
+
+static void* counting_malloc(size_t n) {
+    hook_allocs++;
+    return malloc(n);
+}
+
+static void* counting_realloc(void* p, size_t n) {
+    hook_allocs += p == NULL;
+    return realloc(p, n);
+}
+
+static void counting_free(void* p) {
+    hook_frees++;
+    free(p);
+}
+
+void test_allocator_hooks() {
+    printf("\n=== Testing Allocator Hooks ===\n");
+
+    crypto_thread_cleanup();
+    crypto_set_allocator(counting_malloc, counting_realloc, counting_free);
+    crypto_val_t val;
+    crypto_init(&val, CRYPTO_ETHEREUM);
+
+    // Test 1: Returned strings come from the hook and go back through crypto_free
+    crypto_set_from_decimal(&val, ETH_DENOM_ETHER, "1.5");
+    char* str = crypto_to_decimal_str(&val, ETH_DENOM_ETHER);
+    total_tests++;
+    if (str != NULL && hook_allocs == 1 && strcmp(str, "1.500000000000000000") == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Expected one hooked allocation for the result string, got %d\n", hook_allocs);
+        failed_tests++;
+    }
+    crypto_free(str);
+
+    // Test 2: Lenient parsing and wide formatting reuse per-thread scratch
+    crypto_set_from_decimal(&val, ETH_DENOM_ETHER, "12.34x");
+    int after_first = hook_allocs;
+    char buf[128];
+    crypto_set_from_decimal(&val, ETH_DENOM_ETHER, "56.78y");
+    crypto_set_from_decimal(&val, ETH_DENOM_WEI, "1000000000000000000000000000000000000000000000000000000000000000000000000000000");
+    crypto_format_to(buf, sizeof(buf), &val, ETH_DENOM_WEI);
+    crypto_format_to(buf, sizeof(buf), &val, ETH_DENOM_WEI);
+    total_tests++;
+    if (after_first == 2 && hook_allocs == 2 && strcmp(buf, "1000000000000000000000000000000000000000000000000000000000000000000000000000000") == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Scratch was not reused (%d then %d allocations)\n", after_first, hook_allocs);
+        failed_tests++;
+    }
+
+    // Test 3: Column storage uses the hook, and cleanup returns everything
+    crypto_column_t col;
+    crypto_column_init(&col, CRYPTO_ETHEREUM);
+    crypto_column_append(&col, &val);
+    crypto_column_clear(&col);
+    crypto_thread_cleanup();
+    crypto_set_allocator(NULL, NULL, NULL);
+    total_tests++;
+    if (hook_allocs > 2 && hook_allocs == hook_frees) {
+        passed_tests++;
+    } else {
+        printf("FAIL: %d hooked allocations but %d frees\n", hook_allocs, hook_frees);
+        failed_tests++;
+    }
+
+    // Test 4: Without scratch, lenient parsing and wide formatting fail, every time
+    crypto_set_allocator(failing_malloc, failing_realloc, free);
+    crypto_val_t small;
+    crypto_init(&small, CRYPTO_ETHEREUM);
+    crypto_set_from_decimal(&small, ETH_DENOM_WEI, "42");
+    bool lenient_ok = crypto_set_from_decimal(&small, ETH_DENOM_ETHER, "12.34x");
+    size_t len_first = crypto_format_to(buf, sizeof(buf), &val, ETH_DENOM_WEI);
+    size_t len_again = crypto_format_to(buf, sizeof(buf), &val, ETH_DENOM_WEI);
+    char* wide_str = crypto_to_decimal_str(&val, ETH_DENOM_WEI);
+    crypto_set_allocator(NULL, NULL, NULL);
+    char small_buf[8];
+    crypto_format_to(small_buf, sizeof(small_buf), &small, ETH_DENOM_WEI);
+    total_tests++;
+    if (!lenient_ok && strcmp(small_buf, "42") == 0 && len_first == CRYPTO_FORMAT_NOMEM
+        && len_again == CRYPTO_FORMAT_NOMEM && wide_str == NULL) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Scratch allocation failures were not reported\n");
+        failed_tests++;
+    }
+    crypto_free(wide_str);
+    crypto_clear(&small);
+
+    crypto_clear(&val);
+}
+
+void test_bulk_convert() {
+    printf("\n=== Testing Bulk Conversion ===\n");
+
+    // Test 1: Small input, error records and delimiter handling
+    const char* input = "1000000000000000000\n1\nabc\n\n-2500000000000000000";
+    crypto_convert_result_t result;
+    total_tests++;
+    if (crypto_convert(&result, input, strlen(input), '\n', ETH_DENOM_WEI, ETH_DENOM_ETHER, 4) &&
+        strcmp(result.output, "1\n0.000000000000000001\n\n\n-2.500000000000000000") == 0 &&
+        result.records == 5 && result.error_count == 2 &&
+        result.errors[0].record == 2 && result.errors[0].offset == 22 && result.errors[0].status == CRYPTO_PARSE_INVALID_CHAR &&
+        result.errors[1].record == 3 && result.errors[1].offset == 26 && result.errors[1].status == CRYPTO_PARSE_EMPTY) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected small conversion result\n");
+        failed_tests++;
+    }
+    crypto_convert_result_clear(&result);
+
+    // Test 2: Many chunks on several threads match one thread, in order
+    enum { RECORDS = 20000 };
+    char* big = malloc(RECORDS * 32);
+    size_t len = 0;
+    for (int i = 0; i < RECORDS; i++) {
+        if (i == 12345) {
+            len += (size_t)sprintf(big + len, "1.2.3,");
+        } else {
+            len += (size_t)sprintf(big + len, "%d.%04d,", i - 10000, i % 10000);
+        }
+    }
+    crypto_convert_result_t serial, parallel;
+    bool ok = crypto_convert(&serial, big, len, ',', BTC_DENOM_BITCOIN, BTC_DENOM_SATOSHI, 1) &&
+              crypto_convert(&parallel, big, len, ',', BTC_DENOM_BITCOIN, BTC_DENOM_SATOSHI, 8);
+    total_tests++;
+    if (ok && serial.output_len == parallel.output_len && strcmp(serial.output, parallel.output) == 0 &&
+        parallel.records == RECORDS && parallel.error_count == 1 && parallel.errors[0].record == 12345 &&
+        parallel.errors[0].status == CRYPTO_PARSE_MULTIPLE_DOTS &&
+        strncmp(parallel.output, "-1000000000000,-999900010000,", 29) == 0 &&
+        parallel.output[parallel.output_len - 1] == ',') {
+        passed_tests++;
+    } else {
+        printf("FAIL: Parallel conversion differs from serial conversion\n");
+        failed_tests++;
+    }
+    crypto_convert_result_clear(&serial);
+    crypto_convert_result_clear(&parallel);
+    free(big);
+
+    // Test 3: Empty input
+    total_tests++;
+    if (crypto_convert(&result, "", 0, '\n', ETH_DENOM_WEI, ETH_DENOM_GWEI, 0) &&
+        result.output_len == 0 && result.output[0] == '\0' && result.records == 0 && result.error_count == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Empty input should convert to empty output\n");
+        failed_tests++;
+    }
+    crypto_convert_result_clear(&result);
+}
+
 void test_decimal_validation() {
     printf("\n=== Testing Decimal Validation ===\n");
     
@@ -536,15 +2207,189 @@ void test_nonzero_fraction_detection() {
     TEST_NONZERO_FRACTION("-0", false);
 }
 
+#define STRESS_THREADS 8
+#define STRESS_ITERATIONS 5000
+
+// Each worker parses, formats, adds and looks up symbols on its own values and
+// counts every result that differs from what a single thread would produce.
+static void* stress_worker(void* arg) {
+    int t = (int)(intptr_t)arg;
+    int mismatches = 0;
+    char str[64];
+    char buf[64];
+    crypto_val_t val, sum, expected;
+    crypto_init(&val, CRYPTO_ETHEREUM);
+    crypto_init(&sum, CRYPTO_ETHEREUM);
+    crypto_init(&expected, CRYPTO_ETHEREUM);
+    for (int i = 0; i < STRESS_ITERATIONS; i++) {
+        snprintf(str, sizeof(str), "%d.%018d", t, i + 1);
+        crypto_set_from_decimal(&val, ETH_DENOM_ETHER, str);
+        crypto_format_to(buf, sizeof(buf), &val, ETH_DENOM_ETHER);
+        mismatches += strcmp(buf, str) != 0;
+        crypto_add(&sum, &sum, &val);
+
+        // Lenient parsing goes through the per-thread scratch
+        crypto_set_from_decimal(&val, ETH_DENOM_ETHER, "5.5x");
+        crypto_set_from_decimal(&expected, ETH_DENOM_ETHER, "5");
+        mismatches += crypto_cmp(&val, &expected) != 0;
+
+        mismatches += crypto_get_type_for_symbol("DOT") != CRYPTO_POLKADOT;
+        mismatches += crypto_get_denom_for_symbol(CRYPTO_ETHEREUM, "GWEI") != ETH_DENOM_GWEI;
+        mismatches += mpz_cmp_ui(*crypto_denom_scale(BTC_DENOM_BITCOIN), 100000000) != 0;
+    }
+
+    // sum = t * STRESS_ITERATIONS ETH plus 1 + 2 + ... + STRESS_ITERATIONS wei
+    snprintf(str, sizeof(str), "%d", t * STRESS_ITERATIONS);
+    crypto_set_from_decimal(&expected, ETH_DENOM_ETHER, str);
+    crypto_set_from_decimal(&val, ETH_DENOM_WEI, "12502500");
+    crypto_add(&expected, &expected, &val);
+    mismatches += crypto_cmp(&sum, &expected) != 0;
+
+    crypto_clear(&val);
+    crypto_clear(&sum);
+    crypto_clear(&expected);
+    crypto_thread_cleanup();
+    return (void*)(intptr_t)mismatches;
+}
+
+// Runs first so the workers also race the one-time table initialization
+void test_thread_safety() {
+    printf("\n=== Testing Thread Safety ===\n");
+
+    pthread_t threads[STRESS_THREADS];
+    int started = 0;
+    for (int t = 0; t < STRESS_THREADS; t++) {
+        if (pthread_create(&threads[t], NULL, stress_worker, (void*)(intptr_t)t) == 0) {
+            started++;
+        }
+    }
+    int mismatches = 0;
+    for (int t = 0; t < started; t++) {
+        void* result;
+        pthread_join(threads[t], &result);
+        mismatches += (int)(intptr_t)result;
+    }
+    total_tests++;
+    if (started == STRESS_THREADS && mismatches == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: %d of %d threads started, %d mismatched results\n", started, STRESS_THREADS, mismatches);
+        failed_tests++;
+    }
+}
+
+static bool count_csv_row(void* ctx, crypto_denom_t denom, const crypto_val_t* amount) {
+    (void)denom;
+    (void)amount;
+    return ++*(int*)ctx < 2;
+}
+
+void test_csv_import() {
+    printf("\n=== Testing CSV Import ===\n");
+
+    char path[] = "/tmp/cryptomath_csv_XXXXXX";
+    int fd = mkstemp(path);
+    const char* csv =
+        "account,asset,amount,unit\n"
+        "a,ETH,1.5,ETH\n"
+        "b,\"ETH\",\"2,5\",GWEI\n"
+        "c,ETH,-0.25,ETH\r\n"
+        "d,BTC,100000000,SAT\n"
+        "\"e\nf\",BTC,0.5,BTC\n"
+        "g,XYZ,1,XYZ\n"
+        "h,ETH,1x,ETH\n"
+        "i,ETH\n"
+        "\n"
+        "j,BTC,-2,BTC";
+    bool written = fd >= 0 && write(fd, csv, strlen(csv)) == (ssize_t)strlen(csv);
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    // Test 1: Per-type totals, with rejected rows counted and skipped
+    crypto_csv_spec_t spec = { .delim = ',', .header = true, .amount_column = 2, .symbol_column = 1, .denom_column = 3 };
+    crypto_csv_totals_t totals;
+    crypto_csv_stats_t stats;
+    crypto_csv_totals_init(&totals);
+    char sum[64], min[64], max[64];
+    total_tests++;
+    if (written && crypto_csv_sum(path, &spec, &totals, &stats) &&
+        crypto_format_to(sum, sizeof(sum), &totals.sum[CRYPTO_ETHEREUM], ETH_DENOM_GWEI) > 0 &&
+        crypto_format_to(min, sizeof(min), &totals.min[CRYPTO_ETHEREUM], ETH_DENOM_ETHER) > 0 &&
+        crypto_format_to(max, sizeof(max), &totals.max[CRYPTO_ETHEREUM], ETH_DENOM_ETHER) > 0 &&
+        strcmp(sum, "1250000000") == 0 && strcmp(min, "-0.250000000000000000") == 0 && strcmp(max, "1.500000000000000000") == 0 &&
+        totals.count[CRYPTO_ETHEREUM] == 2 && totals.count[CRYPTO_BITCOIN] == 3 &&
+        stats.rows == 9 && stats.rejected == 4 && stats.first_rejected_row == 1 && stats.first_rejected_offset == 40) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected CSV totals (rows %zu, rejected %zu)\n", stats.rows, stats.rejected);
+        failed_tests++;
+    }
+    crypto_format_to(sum, sizeof(sum), &totals.sum[CRYPTO_BITCOIN], BTC_DENOM_BITCOIN);
+    total_tests++;
+    if (strcmp(sum, "-0.50000000") == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: BTC CSV total should be -0.50000000, got %s\n", sum);
+        failed_tests++;
+    }
+    crypto_csv_totals_clear(&totals);
+
+    // Test 2: Rows of one type into a column, TSV from a buffer, and stopping early
+    crypto_column_t col;
+    crypto_column_init(&col, CRYPTO_BITCOIN);
+    crypto_csv_spec_t tsv = { .delim = '\t', .amount_column = 0, .symbol_column = 1, .denom_column = -1 };
+    int seen = 0;
+    total_tests++;
+    if (crypto_csv_to_column(path, &spec, &col, &stats) && col.count == 3 &&
+        crypto_csv_read_buffer("1\tBTC\n2\tETH\n3\tBTC\n", 18, &tsv, count_csv_row, &seen, &stats) &&
+        seen == 2 && stats.rows == 2 && stats.rejected == 0) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Unexpected CSV column or TSV result\n");
+        failed_tests++;
+    }
+    crypto_column_clear(&col);
+
+    // Test 3: Missing files report errno
+    unlink(path);
+    total_tests++;
+    if (!crypto_csv_read(path, &spec, count_csv_row, &seen, &stats) && errno == ENOENT) {
+        passed_tests++;
+    } else {
+        printf("FAIL: Reading a missing CSV file should fail with ENOENT\n");
+        failed_tests++;
+    }
+}
+
 int main() {
     printf("Starting Cryptomath Test Suite\n");
 
+    test_thread_safety();
     test_decimal_string_parsing();
     test_decimal_string_conversion();
     test_arithmetic_operations();
     test_comparison_operations();
     test_zero_comparison();
     test_multiplication_division();
+    test_prepared_divisor();
+    test_inline_representation();
+    test_single_pass_parsing();
+    test_format_to();
+    test_pow10_table();
+    test_symbol_lookup();
+    test_asset_registry();
+    test_blob_encoding();
+    test_partial_sums();
+    test_decimals_kernels();
+    test_vector_scanning();
+    test_rate_table();
+    test_ingest_pipeline();
+    test_batch_operations();
+    test_column();
+    test_allocator_hooks();
+    test_bulk_convert();
+    test_csv_import();
     test_decimal_validation();
     test_nonzero_fraction_detection();
     printf("\nTest Suite Summary:\n");
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <sqlite3.h>
@@ -44,7 +45,8 @@ static int failed_tests = 0;
 
 void verify_string_parsing(crypto_val_t* val, const char* expected_val_as_str) {
     total_tests++;
-    char* str = mpz_get_str(NULL, 10, val->value);
+    mpz_t view;
+    char* str = mpz_get_str(NULL, 10, crypto_view(val, view));
     if (!str) {
         printf("ERROR: Failed to convert result to string\n");
         failed_tests++;
@@ -104,9 +106,10 @@ void verify_zero_comparison(const crypto_val_t* a, int comparison, int expected_
             return;
     }
     total_tests++;
+    mpz_t view;
     printf("%s %s %s %s: %s\n",
             expected_result == 1 ? "" : "NOT",
-            mpz_get_str(NULL, 10, a->value),
+            mpz_get_str(NULL, 10, crypto_view(a, view)),
             a->crypto_type == CRYPTO_BITCOIN ? "SAT" : "Unknown",
             comparison == 0 ? "== 0" : (comparison > 0 ? "> 0" : "< 0"),
             cmp_result == expected_result ? "✓ PASSED" : "✗ FAILED");
@@ -181,6 +184,46 @@ static void verify_sql_runtime_error(sqlite3 *db, const char* sql, const char* t
     sqlite3_finalize(stmt);
 }
 
+// Helper function to verify that a SQL statement runs without error
+static void verify_sql_exec(sqlite3 *db, const char* sql, const char* test_name) {
+    char *err_msg = NULL;
+    int rc = sqlite3_exec(db, sql, NULL, NULL, &err_msg);
+    total_tests++;
+    if (rc == SQLITE_OK) {
+        printf("PASS: %s\n", test_name);
+        passed_tests++;
+    } else {
+        printf("FAIL: %s. Error: %s\n", test_name, err_msg);
+        failed_tests++;
+    }
+    sqlite3_free(err_msg);
+}
+
+// Helper function to verify that the query plan of a statement mentions a given index
+static void verify_sql_plan_uses(sqlite3 *db, const char* sql, const char* index_name, const char* test_name) {
+    sqlite3_stmt *stmt = NULL;
+    char *plan_sql = sqlite3_mprintf("EXPLAIN QUERY PLAN %s", sql);
+    int rc = sqlite3_prepare_v2(db, plan_sql, -1, &stmt, 0);
+    sqlite3_free(plan_sql);
+    total_tests++;
+    int found = 0;
+    if (rc == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* detail = (const char*)sqlite3_column_text(stmt, 3);
+            if (detail && strstr(detail, index_name)) {
+                found = 1;
+            }
+        }
+    }
+    if (found) {
+        printf("PASS: %s\n", test_name);
+        passed_tests++;
+    } else {
+        printf("FAIL: %s did not use index %s\n", test_name, index_name);
+        failed_tests++;
+    }
+    sqlite3_finalize(stmt);
+}
 
 void test_sqlite_extension() {
     printf("\n=== Testing SQLite Extension ===\n");
@@ -273,6 +316,41 @@ void test_sqlite_extension() {
         "765432109999999999",
         "Basic min test");
 
+    // Aggregates skip operands that are not valid decimals
+    verify_sql_result(db,
+        "SELECT crypto_sum('ETH', 'ETH', 'WEI', v) FROM (SELECT '1' AS v UNION ALL SELECT '1.2.3' UNION ALL SELECT ' 2 ')",
+        "3000000000000000000",
+        "Sum skips invalid operands");
+
+    verify_sql_result(db,
+        "SELECT crypto_max('ETH', 'ETH', 'WEI', v) FROM (SELECT '1' AS v UNION ALL SELECT '9x' UNION ALL SELECT '-2')",
+        "1000000000000000000",
+        "Max skips invalid operands");
+
+    verify_sql_result(db,
+        "SELECT crypto_add('USDC', 'μUSDC', '1', '2')",
+        "3",
+        "Addition with a UTF-8 denomination symbol");
+
+    // Cached symbols and scalars must follow arguments that change between rows
+    verify_sql_result(db,
+        "SELECT group_concat(crypto_add(t, d, '1', '1'), ',') FROM "
+        "(SELECT 'ETH' AS t, 'ETH' AS d UNION ALL SELECT 'ETH', 'GWEI' UNION ALL SELECT 'BTC', 'SAT')",
+        "2,2,2",
+        "Addition with per-row symbols");
+
+    verify_sql_result(db,
+        "SELECT crypto_sum('ETH', d, 'GWEI', '1') FROM "
+        "(SELECT 'ETH' AS d UNION ALL SELECT 'GWEI' UNION ALL SELECT 'ETH')",
+        "2000000001",
+        "Sum with per-row operand denominations");
+
+    verify_sql_result(db,
+        "SELECT group_concat(crypto_mul('ETH', 'GWEI', '10', k), ',') FROM "
+        "(SELECT '2' AS k UNION ALL SELECT '0.5' UNION ALL SELECT '2')",
+        "20,5,20",
+        "Multiplication with per-row scalars");
+
     // Test cases for crypto_sub
     verify_sql_result(db,
         "SELECT crypto_sub('ETH', 'GWEI', '2', '1')",
@@ -323,6 +401,57 @@ void test_sqlite_extension() {
         "SELECT crypto_mul('ETH', 'GWEI', '2')",
         "Wrong number of arguments handling for multiplication");
 
+    verify_sql_result(db,
+        "SELECT crypto_mul('ETH', 'WEI', '3000000000000000000000', '0.000000000000000000001')",
+        "3",
+        "Multiplication by a scalar with more than 19 decimals");
+
+    verify_sql_result(db,
+        "SELECT crypto_mul('ETH', 'GWEI', '3', '1.5')",
+        "4.500000000",
+        "Multiplication by a scalar with whole and fraction parts");
+
+    // Fused multiply-divide with a single rounding
+    verify_sql_result(db,
+        "SELECT crypto_muldiv('BTC', 'SAT', '10', '1.5', '4', 'trunc') || ' ' || "
+        "crypto_muldiv('BTC', 'SAT', '10', '1.5', '4', 'half_up') || ' ' || "
+        "crypto_muldiv('BTC', 'SAT', '-10', '1.5', '4', 'half_up') || ' ' || "
+        "crypto_muldiv('BTC', 'SAT', '10', '1.5', '4', 'floor') || ' ' || "
+        "crypto_muldiv('BTC', 'SAT', '-10', '1.5', '4', 'ceil')",
+        "3 4 -4 3 -3",
+        "crypto_muldiv rounding modes");
+
+    verify_sql_result(db,
+        "SELECT group_concat(crypto_muldiv('BTC', 'SAT', v, '1', '2', 'HALF_EVEN'), ',') "
+        "FROM (SELECT '1' AS v UNION ALL SELECT '3' UNION ALL SELECT '5' UNION ALL SELECT '-5')",
+        "0,2,2,-2",
+        "crypto_muldiv half_even over rows with a constant ratio");
+
+    verify_sql_result(db,
+        "SELECT crypto_muldiv('BTC', 'SAT', '1', '0.5', '0.5', 'trunc') || ' ' || "
+        "crypto_div_trunc('BTC', 'SAT', crypto_mul('BTC', 'SAT', '1', '0.5'), '0.5')",
+        "1 0",
+        "crypto_muldiv keeps the intermediate exact where nested calls truncate");
+
+    verify_sql_result(db,
+        "SELECT group_concat(crypto_muldiv('ETH', 'GWEI', '100', n, '3', 'half_up'), ',') "
+        "FROM (SELECT '1' AS n UNION ALL SELECT '2' UNION ALL SELECT '0.5')",
+        "33.333333333,66.666666667,16.666666667",
+        "crypto_muldiv with per-row numerators");
+
+    verify_sql_result(db,
+        "SELECT crypto_from_blob('ETH', 'GWEI', crypto_muldiv('ETH', 'GWEI', crypto_to_blob('ETH', 'GWEI', '3'), '2', '4', 'trunc'))",
+        "1.500000000",
+        "crypto_muldiv returns a BLOB for a BLOB amount");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_muldiv('ETH', 'GWEI', '1', '1', '0', 'trunc')",
+        "crypto_muldiv division by zero");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_muldiv('ETH', 'GWEI', '1', '1', '2', 'bankers')",
+        "crypto_muldiv rejects an unknown rounding mode");
+
     // Test cases for crypto_div
     verify_sql_result(db,
         "SELECT crypto_div_trunc('ETH', 'GWEI', '6', '2')",
@@ -344,6 +473,13 @@ void test_sqlite_extension() {
         "-3",
         "Division by negative numbers");
 
+    verify_sql_result(db,
+        "SELECT group_concat(crypto_div_trunc('BTC', 'SAT', v, '3') || '/' || "
+        "crypto_div_floor('BTC', 'SAT', v, '3') || '/' || crypto_div_ceil('BTC', 'SAT', v, '-0.3'), ',') "
+        "FROM (SELECT '7' AS v UNION ALL SELECT '-7' UNION ALL SELECT '6')",
+        "2/2/-23,-2/-3/24,2/2/-20",
+        "Truncate, floor and ceil with a constant divisor over rows of both signs");
+
     verify_sql_result(db,
         "SELECT crypto_div_trunc('BTC', 'BTC', '1', '3')",
         "0.33333333",
@@ -408,6 +544,598 @@ void test_sqlite_extension() {
         "SELECT crypto_cmp('ETH', 'GWEI', '1.0')",
         "Wrong number of arguments handling for comparison");
 
+    // BLOB encoding and BLOB operands
+    verify_sql_result(db,
+        "SELECT hex(crypto_to_blob('BTC', 'BTC', '1'))",
+        "0100008405F5E100",
+        "Encode an amount as a BLOB");
+
+    verify_sql_result(db,
+        "SELECT crypto_from_blob('BTC', 'BTC', crypto_to_blob('BTC', 'SAT', '150000000'))",
+        "1.50000000",
+        "Decode a BLOB in another denomination");
+
+    verify_sql_result(db,
+        "SELECT typeof(crypto_add('ETH', 'GWEI', crypto_to_blob('ETH', 'GWEI', '1'), '2')) || ' ' || "
+        "crypto_from_blob('ETH', 'GWEI', crypto_mul('ETH', 'GWEI', crypto_add('ETH', 'GWEI', crypto_to_blob('ETH', 'GWEI', '1'), '2'), '1.5'))",
+        "blob 4.500000000",
+        "Arithmetic on BLOB operands returns a BLOB");
+
+    verify_sql_result(db,
+        "SELECT group_concat(v, ',') FROM (SELECT v FROM (SELECT '2' AS v UNION ALL SELECT '-0.5' "
+        "UNION ALL SELECT '10' UNION ALL SELECT '-3' UNION ALL SELECT '0') ORDER BY crypto_to_blob('ETH', 'ETH', v))",
+        "-3,-0.5,0,2,10",
+        "BLOB order matches numeric order");
+
+    verify_sql_result(db,
+        "SELECT crypto_sum('ETH', 'WEI', 'GWEI', crypto_to_blob('ETH', 'GWEI', v)) || ' ' || "
+        "crypto_cmp('ETH', 'GWEI', crypto_to_blob('ETH', 'GWEI', '2'), '1.5') || ' ' || "
+        "crypto_scale('ETH', 'WEI', 'GWEI', crypto_to_blob('ETH', 'GWEI', '5')) "
+        "FROM (SELECT '1' AS v UNION ALL SELECT '2.5')",
+        "3.500000000 1 5",
+        "Aggregates, comparison and scaling accept BLOB operands");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_add('BTC', 'BTC', crypto_to_blob('ETH', 'ETH', '1'), '1')",
+        "BLOB of another crypto type is rejected");
+
+    // Window functions: sliding frames use xInverse and must match a full recomputation
+    verify_sql_exec(db,
+        "CREATE TABLE ticks AS WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 300) "
+        "SELECT i AS ts, CASE WHEN i % 37 = 0 THEN NULL WHEN i % 41 = 0 THEN 'bad' "
+        "ELSE CAST((i * 7919) % 1000 - 500 AS TEXT) END AS amount FROM n",
+        "Create window test data");
+
+    verify_sql_result(db,
+        "SELECT count(*) FROM (SELECT "
+        "crypto_sum('ETH', 'WEI', 'WEI', amount) OVER w AS s, "
+        "crypto_max('ETH', 'WEI', 'WEI', amount) OVER w AS mx, "
+        "crypto_min('ETH', 'WEI', 'WEI', amount) OVER w AS mn, "
+        "CAST(sum(CAST(amount AS INTEGER)) FILTER (WHERE amount <> 'bad') OVER w AS TEXT) AS s2, "
+        "CAST(max(CAST(amount AS INTEGER)) FILTER (WHERE amount <> 'bad') OVER w AS TEXT) AS mx2, "
+        "CAST(min(CAST(amount AS INTEGER)) FILTER (WHERE amount <> 'bad') OVER w AS TEXT) AS mn2 "
+        "FROM ticks WINDOW w AS (ORDER BY ts ROWS BETWEEN 9 PRECEDING AND CURRENT ROW)) "
+        "WHERE s IS NOT s2 OR mx IS NOT mx2 OR mn IS NOT mn2",
+        "0",
+        "Sliding window sum, max and min match built-in aggregates");
+
+    verify_sql_result(db,
+        "SELECT group_concat(coalesce(s, 'NULL'), ',') FROM (SELECT "
+        "crypto_sum('BTC', 'BTC', 'SAT', v) OVER (ORDER BY k ROWS BETWEEN 1 FOLLOWING AND 1 FOLLOWING) AS s "
+        "FROM (SELECT 1 AS k, '1' AS v UNION ALL SELECT 2, '0.5' UNION ALL SELECT 3, '2'))",
+        "50000000,200000000,NULL",
+        "Window sum over an empty frame is NULL");
+
+    verify_sql_result(db,
+        "SELECT group_concat(m, ',') FROM (SELECT "
+        "crypto_max('BTC', 'BTC', 'BTC', v) OVER (ORDER BY k ROWS BETWEEN 1 PRECEDING AND CURRENT ROW) AS m "
+        "FROM (SELECT 1 AS k, '3' AS v UNION ALL SELECT 2, '2' UNION ALL SELECT 3, '1' UNION ALL SELECT 4, '1.5'))",
+        "3,3,2,1.50000000",
+        "Sliding window max over decreasing values");
+
+    // Multi-asset sum in one pass, one row per asset in its base unit
+    verify_sql_exec(db,
+        "CREATE TABLE ledger(asset TEXT, unit TEXT, amount); "
+        "INSERT INTO ledger VALUES ('ETH', 'GWEI', '1500000000'), ('BTC', 'SAT', '250000000'), "
+        "('ETH', 'ETH', '-0.25'), ('BTC', 'BTC', '0.5'), ('SOL', 'SOL', NULL), ('ETH', 'WEI', 'bad'), "
+        "('BTC', 'BTC', crypto_to_blob('BTC', 'SAT', '1'))",
+        "Create mixed-asset ledger");
+
+    verify_sql_result(db,
+        "SELECT group_concat(asset || ':' || denom || ':' || total || ':' || count, ' ') "
+        "FROM crypto_sum_all('SELECT asset, unit, amount FROM ledger')",
+        "BTC:BTC:3.00000001:3 ETH:ETH:1.250000000000000000:2",
+        "crypto_sum_all totals per asset");
+
+    verify_sql_result(db,
+        "SELECT count(*) FROM crypto_sum_all('SELECT asset, unit, amount FROM ledger WHERE 0')",
+        "0",
+        "crypto_sum_all over no rows");
+
+    verify_sql_runtime_error(db,
+        "SELECT * FROM crypto_sum_all('SELECT ''XYZ'', ''XYZ'', ''1''')",
+        "crypto_sum_all rejects an unknown asset");
+
+    verify_sql_runtime_error(db,
+        "SELECT * FROM crypto_sum_all('SELECT asset FROM ledger')",
+        "crypto_sum_all needs three columns");
+
+    verify_sql_runtime_error(db,
+        "SELECT * FROM crypto_sum_all",
+        "crypto_sum_all needs a query");
+
+    verify_sql_runtime_error(db,
+        "SELECT * FROM crypto_sum_all('DELETE FROM ledger RETURNING ''ETH'', ''ETH'', ''1''')",
+        "crypto_sum_all refuses a write query");
+
+    verify_sql_exec(db,
+        "PRAGMA trusted_schema = 1; "
+        "CREATE VIEW ledger_sums AS SELECT * FROM crypto_sum_all('SELECT asset, unit, amount FROM ledger')",
+        "Create a view over crypto_sum_all");
+
+    verify_sql_parse_error(db,
+        "SELECT * FROM ledger_sums",
+        "crypto_sum_all cannot be used from a view");
+
+    verify_sql_result(db,
+        "SELECT count(*) FROM ledger",
+        "7",
+        "Refused queries leave the ledger intact");
+
+    verify_sql_exec(db, "DROP VIEW ledger_sums; PRAGMA trusted_schema = 0", "Drop the crypto_sum_all view");
+
+    // Per-account balances kept at a checkpoint of the ledger's rowids
+    verify_sql_exec(db,
+        "CREATE TABLE postings(id INTEGER PRIMARY KEY AUTOINCREMENT, account, asset TEXT, unit TEXT, amount); "
+        "INSERT INTO postings(account, asset, unit, amount) VALUES ('alice', 'ETH', 'GWEI', '1500000000'), "
+        "('bob', 'BTC', 'SAT', '250000000'), ('alice', 'ETH', 'ETH', '-0.25'), ('alice', 'BTC', 'BTC', '0.5'), "
+        "('bob', 'BTC', 'BTC', NULL), (7, 'BTC', 'BTC', crypto_to_blob('BTC', 'SAT', '1')), ('bob', 'ETH', 'WEI', 'bad'); "
+        "CREATE VIRTUAL TABLE balances USING crypto_balances(postings, account, asset, unit, amount)",
+        "Create crypto_balances over a ledger");
+
+    verify_sql_result(db,
+        "SELECT group_concat(account || ':' || asset || ':' || balance || ':' || count, ' ') "
+        "FROM (SELECT * FROM balances ORDER BY account, asset)",
+        "7:BTC:0.00000001:1 alice:BTC:0.50000000:1 alice:ETH:1.250000000000000000:2 bob:BTC:2.50000000:1",
+        "crypto_balances sums the rows after the checkpoint");
+
+    verify_sql_exec(db, "INSERT INTO balances(command) VALUES ('checkpoint')", "crypto_balances checkpoint");
+
+    verify_sql_result(db,
+        "SELECT (SELECT checkpoint FROM balances_state) || ' ' || "
+        "(SELECT total FROM balances_totals WHERE account = 'alice' AND asset = 'ETH')",
+        "7 1.250000000000000000",
+        "Checkpoint persists totals up to the last rowid read");
+
+    verify_sql_exec(db,
+        "INSERT INTO postings(account, asset, unit, amount) VALUES ('alice', 'ETH', 'ETH', '1'), ('carol', 'ETH', 'WEI', '5')",
+        "Append to the ledger after a checkpoint");
+
+    verify_sql_result(db,
+        "SELECT group_concat(asset || ':' || balance || ':' || count, ' ') FROM balances WHERE account = 'alice'",
+        "BTC:0.50000000:1 ETH:2.250000000000000000:3",
+        "crypto_balances merges persisted totals with new rows");
+
+    verify_sql_exec(db,
+        "INSERT INTO balances(command) VALUES ('checkpoint'); DELETE FROM postings WHERE id = 8",
+        "Delete a ledger row under the checkpoint");
+
+    // The ledger is taken to be append-only; a read does not look below the checkpoint
+    verify_sql_result(db,
+        "SELECT group_concat(account || ':' || balance, ' ') FROM balances WHERE asset = 'ETH'",
+        "alice:2.250000000000000000 carol:0.000000000000000005",
+        "crypto_balances reads only the rows after the checkpoint");
+
+    verify_sql_exec(db, "INSERT INTO balances(command) VALUES ('rebuild')", "crypto_balances rebuild after a delete");
+
+    verify_sql_result(db,
+        "SELECT checkpoint || ' ' || "
+        "(SELECT total FROM balances_totals WHERE account = 'alice' AND asset = 'ETH') FROM balances_state",
+        "9 1.250000000000000000",
+        "Rebuild recomputes totals from the ledger");
+
+    verify_sql_exec(db,
+        "UPDATE postings SET amount = '2' WHERE id = 9; INSERT INTO balances(command) VALUES ('rebuild')",
+        "crypto_balances rebuild after an update");
+
+    verify_sql_result(db,
+        "SELECT balance FROM balances WHERE account = 'carol'",
+        "0.000000000000000002",
+        "Rebuild picks up an update under the checkpoint");
+
+    sqlite3_db_config(db, SQLITE_DBCONFIG_DEFENSIVE, 1, NULL);
+    verify_sql_parse_error(db,
+        "UPDATE balances_state SET checkpoint = 0",
+        "crypto_balances state is a read-only shadow table in defensive mode");
+    sqlite3_db_config(db, SQLITE_DBCONFIG_DEFENSIVE, 0, NULL);
+
+    verify_sql_runtime_error(db,
+        "INSERT INTO balances(account, asset, balance) VALUES ('dave', 'ETH', '1')",
+        "crypto_balances rows are read-only");
+
+    verify_sql_runtime_error(db,
+        "INSERT INTO balances(command) VALUES ('vacuum')",
+        "crypto_balances rejects an unknown command");
+
+    verify_sql_runtime_error(db,
+        "CREATE VIRTUAL TABLE bad_balances USING crypto_balances(postings, owner, asset, unit, amount)",
+        "crypto_balances rejects a missing ledger column");
+
+    verify_sql_exec(db, "CREATE TABLE reused(id INTEGER PRIMARY KEY, account, asset, unit, amount)",
+        "Create a ledger without AUTOINCREMENT");
+
+    verify_sql_runtime_error(db,
+        "CREATE VIRTUAL TABLE bad_balances USING crypto_balances(reused, account, asset, unit, amount)",
+        "crypto_balances rejects a ledger that reuses rowids");
+
+    verify_sql_exec(db, "CREATE TABLE noted(id INTEGER PRIMARY KEY, autoincrement_note, account, asset, unit, amount)",
+        "Create a ledger with AUTOINCREMENT only in a column name");
+
+    verify_sql_runtime_error(db,
+        "CREATE VIRTUAL TABLE bad_balances USING crypto_balances(noted, account, asset, unit, amount)",
+        "crypto_balances checks the key column for AUTOINCREMENT");
+
+    verify_sql_result(db,
+        "SELECT count(*) FROM sqlite_schema WHERE name LIKE 'balances%'",
+        "3",
+        "crypto_balances creates two shadow tables");
+
+    verify_sql_exec(db, "ALTER TABLE balances RENAME TO wallet", "Rename a crypto_balances table");
+
+    verify_sql_result(db,
+        "SELECT (SELECT count(*) FROM wallet) || ' ' || (SELECT count(*) FROM wallet_totals)",
+        "5 5",
+        "Renaming moves the shadow tables");
+
+    verify_sql_exec(db, "DROP TABLE wallet", "Drop a crypto_balances table");
+
+    verify_sql_result(db,
+        "SELECT count(*) FROM sqlite_schema WHERE name LIKE 'wallet%'",
+        "0",
+        "Dropping removes the shadow tables");
+
+    // Assets registered at runtime work everywhere built-in ones do
+    verify_sql_result(db, "SELECT crypto_register_type('USDE', 'Ethena USDe', 18)", "1", "crypto_register_type");
+
+    verify_sql_result(db, "SELECT crypto_register_denom('USDE', 'WEI', 'Wei', 0)", "1", "crypto_register_denom");
+
+    verify_sql_result(db,
+        "SELECT crypto_scale('USDE', 'USDE', 'WEI', crypto_add('USDE', 'USDE', '1.25', '0.25'))",
+        "1500000000000000000",
+        "Arithmetic on a registered asset");
+
+    verify_sql_result(db,
+        "SELECT hex(crypto_to_blob('USDE', 'USDE', '1')) || ' ' || crypto_from_blob('USDE', 'WEI', crypto_to_blob('USDE', 'USDE', '1'))",
+        "020455534445880DE0B6B3A7640000 1000000000000000000",
+        "A registered asset's blob carries its symbol");
+
+    verify_sql_result(db,
+        "SELECT name FROM crypto_types WHERE symbol = 'USDE'",
+        "Ethena USDe",
+        "crypto_types lists registered types");
+
+    verify_sql_result(db,
+        "SELECT group_concat(symbol || ':' || decimals) FROM crypto_denoms WHERE crypto_symbol = 'USDE'",
+        "USDE:18,WEI:0",
+        "crypto_denoms lists registered denominations");
+
+    verify_sql_exec(db,
+        "CREATE TABLE tokens(symbol TEXT, name TEXT, decimals INT);"
+        "INSERT INTO tokens VALUES ('PYUSD', 'PayPal USD', 6), ('TUSD', 'TrueUSD', 18)",
+        "Create token table");
+
+    verify_sql_result(db,
+        "SELECT sum(crypto_register_type(symbol, name, decimals)) FROM tokens",
+        "2",
+        "Register assets from a table");
+
+    verify_sql_result(db,
+        "SELECT asset || '=' || total FROM crypto_sum_all("
+        "'SELECT ''PYUSD'', ''PYUSD'', ''1.5'' UNION ALL SELECT ''TUSD'', ''TUSD'', ''2''') "
+        "WHERE asset = 'PYUSD'",
+        "PYUSD=1.500000",
+        "crypto_sum_all totals a registered asset");
+
+    verify_sql_result(db, "SELECT crypto_register_type('USDE', 'Ethena USDe', 18)", "1", "Registering again is a no-op");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_register_type('USDE', 'Ethena USDe', 6)",
+        "crypto_register_type rejects conflicting decimals");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_register_denom('NOPE', 'X', 'X', 0)",
+        "crypto_register_denom rejects an unknown type");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_register_type('BAD SYMBOL', 'Bad', 2)",
+        "crypto_register_type rejects an invalid symbol");
+
+    char registry_path[] = "/tmp/cryptomath_assets_XXXXXX";
+    int registry_fd = mkstemp(registry_path);
+    const char *registry = "# test assets\nasset FDUSD 18 First Digital USD\ndenom FDUSD WEI 0 Wei\n";
+    if (registry_fd >= 0) {
+        if (write(registry_fd, registry, strlen(registry)) != (ssize_t)strlen(registry)) {
+            printf("Failed to write %s\n", registry_path);
+        }
+        close(registry_fd);
+    }
+    char *load_sql = sqlite3_mprintf("SELECT crypto_load_assets(%Q)", registry_path);
+    verify_sql_result(db, load_sql, "1", "crypto_load_assets");
+    sqlite3_free(load_sql);
+    unlink(registry_path);
+
+    verify_sql_result(db,
+        "SELECT crypto_scale('FDUSD', 'FDUSD', 'WEI', '2')",
+        "2000000000000000000",
+        "Asset loaded from a file");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_load_assets('/nonexistent/assets.txt')",
+        "crypto_load_assets reports a missing file");
+
+    // Symbol and type constraints are answered from the symbol index
+    verify_sql_plan_uses(db,
+        "SELECT name FROM crypto_types WHERE symbol = 'ETH'",
+        "INDEX 1:",
+        "crypto_types seeks by symbol");
+
+    verify_sql_result(db, "SELECT name FROM crypto_types WHERE symbol = 'ETH'", "Ethereum", "crypto_types symbol lookup");
+
+    verify_sql_result(db, "SELECT count(*) FROM crypto_types WHERE symbol = 'NOPE'", "0", "crypto_types unknown symbol");
+
+    verify_sql_result(db,
+        "SELECT name FROM crypto_types WHERE symbol = 'eth' COLLATE NOCASE",
+        "Ethereum",
+        "crypto_types NOCASE comparison scans");
+
+    verify_sql_plan_uses(db,
+        "SELECT name FROM crypto_denoms WHERE crypto_symbol = 'ETH' AND symbol = 'GWEI'",
+        "INDEX 3:",
+        "crypto_denoms seeks by type and symbol");
+
+    verify_sql_result(db,
+        "SELECT decimals FROM crypto_denoms WHERE crypto_symbol = 'ETH' AND symbol = 'GWEI'",
+        "9",
+        "crypto_denoms type and symbol lookup");
+
+    verify_sql_result(db,
+        "SELECT group_concat(symbol) FROM crypto_denoms WHERE crypto_symbol = 'ETH'",
+        "ETH,GWEI,WEI",
+        "crypto_denoms of one type");
+
+    verify_sql_result(db,
+        "SELECT (SELECT group_concat(crypto_symbol) FROM crypto_denoms WHERE symbol = 'WEI') = "
+        "(SELECT group_concat(crypto_symbol) FROM crypto_denoms WHERE symbol || '' = 'WEI')",
+        "1",
+        "crypto_denoms symbol lookup matches a scan");
+
+    verify_sql_result(db,
+        "SELECT count(*) FROM crypto_denoms WHERE crypto_symbol = 'NOPE' OR symbol = x'574549'",
+        "0",
+        "crypto_denoms unknown type and blob symbol");
+
+    verify_sql_result(db,
+        "SELECT group_concat(t.symbol || ':' || d.decimals) FROM crypto_types t "
+        "JOIN crypto_denoms d ON d.crypto_symbol = t.symbol AND d.symbol = t.symbol "
+        "WHERE t.symbol IN ('BTC', 'ETH')",
+        "BTC:8,ETH:18",
+        "Join base denominations to their types");
+
+    // Partial sums computed per shard merge exactly into the sum of the whole ledger
+    verify_sql_exec(db,
+        "CREATE TABLE shard_ledger(shard INT, crypto TEXT, amount TEXT);"
+        "INSERT INTO shard_ledger VALUES (1, 'ETH', '1.5'), (1, 'ETH', '-0.25'), (2, 'ETH', '0.000000001'),"
+        "(2, 'ETH', NULL), (3, 'ETH', '10'), (3, 'BTC', '0.5'), (4, 'BTC', '0.25');"
+        "CREATE TABLE shard_partials AS SELECT shard, crypto, crypto_sum_partial(crypto, crypto, amount) AS partial "
+        "FROM shard_ledger GROUP BY shard, crypto",
+        "Partial sums per shard");
+
+    verify_sql_result(db,
+        "SELECT typeof(partial) FROM shard_partials WHERE shard = 1",
+        "blob",
+        "crypto_sum_partial returns a BLOB");
+
+    verify_sql_result(db,
+        "SELECT crypto_partial_sum(crypto_sum_merge(partial), 'GWEI') || ',' || "
+        "crypto_partial_min(crypto_sum_merge(partial), 'ETH') || ',' || "
+        "crypto_partial_max(crypto_sum_merge(partial), 'ETH') || ',' || "
+        "crypto_partial_count(crypto_sum_merge(partial)) FROM shard_partials WHERE crypto = 'ETH'",
+        "11250000001,-0.250000000000000000,10,4",
+        "crypto_sum_merge combines shard partials");
+
+    verify_sql_result(db,
+        "SELECT (SELECT crypto_partial_sum(crypto_sum_merge(partial), 'ETH') FROM shard_partials WHERE crypto = 'ETH') = "
+        "(SELECT crypto_sum('ETH', 'ETH', 'ETH', amount) FROM shard_ledger WHERE crypto = 'ETH')",
+        "1",
+        "Merged partial equals crypto_sum");
+
+    verify_sql_result(db,
+        "SELECT group_concat(crypto || '=' || crypto_partial_sum(p, crypto), ' ') FROM ("
+        "SELECT crypto, crypto_sum_merge(partial) AS p FROM shard_partials GROUP BY crypto ORDER BY crypto)",
+        "BTC=0.75000000 ETH=11.250000001000000000",
+        "Merge partials per crypto type");
+
+    verify_sql_result(db,
+        "SELECT crypto_partial_sum(crypto_sum_merge(p), 'ETH') FROM ("
+        "SELECT crypto_sum_merge(partial) AS p FROM shard_partials WHERE crypto = 'ETH' GROUP BY shard % 2)",
+        "11.250000001000000000",
+        "Merging a merged partial");
+
+    verify_sql_result(db,
+        "SELECT crypto_sum_merge(partial) IS NULL FROM shard_partials WHERE 0",
+        "1",
+        "crypto_sum_merge of no rows is NULL");
+
+    verify_sql_result(db,
+        "SELECT crypto_partial_min(crypto_sum_partial('ETH', 'ETH', amount), 'ETH') IS NULL "
+        "FROM shard_ledger WHERE crypto = 'ETH' AND amount IS NULL",
+        "1",
+        "crypto_partial_min of an all-NULL partial");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_sum_merge(partial) FROM shard_partials",
+        "crypto_sum_merge rejects mixed crypto types");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_sum_merge(crypto_to_blob('ETH', 'ETH', '1'))",
+        "crypto_sum_merge rejects an amount blob");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_partial_sum(x'5000', 'ETH')",
+        "crypto_partial_sum rejects a truncated partial");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_partial_sum(partial, 'SAT') FROM shard_partials WHERE crypto = 'ETH'",
+        "crypto_partial_sum rejects a denomination of another type");
+
+    // Operands are memoized by text and denomination, never by text alone
+    verify_sql_result(db,
+        "SELECT crypto_scale('ETH', 'GWEI', 'WEI', '1.5') || ',' || crypto_scale('ETH', 'ETH', 'WEI', '1.5')",
+        "1500000000,1500000000000000000",
+        "Same operand text in two denominations");
+
+    verify_sql_result(db,
+        "SELECT group_concat(crypto_cmp('ETH', 'ETH', amount, '1') || ':' || crypto_add('ETH', 'ETH', amount, amount)) "
+        "FROM (SELECT '0.5' AS amount UNION ALL SELECT '2' UNION ALL SELECT '0.5')",
+        "-1:1,1:4,-1:1",
+        "Same cell used by several functions");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_add('ETH', 'ETH', '1.5', '1.5'), crypto_add('ETH', 'ETH', '1.5', '1.5x')",
+        "Invalid operand after a memoized prefix");
+
+    verify_sql_result(db,
+        "SELECT crypto_add('ETH', 'WEI', '123456789012345678901234567890123456789012345678901', '1')",
+        "123456789012345678901234567890123456789012345678902",
+        "Operand longer than the memo holds");
+
+    // Rates loaded once from a price table value amounts of other types in one pass
+    verify_sql_exec(db,
+        "CREATE TABLE prices(asset TEXT, price TEXT);"
+        "INSERT INTO prices VALUES ('BTC', '15.25'), ('DOT', '0.0125');"
+        "CREATE TABLE holdings(asset TEXT, amount TEXT);"
+        "INSERT INTO holdings VALUES ('BTC', '0.5'), ('DOT', '100'), ('ETH', '1')",
+        "Price and holdings tables");
+
+    verify_sql_result(db,
+        "SELECT sum(crypto_set_rate(asset, asset, 'ETH', 'ETH', price)) FROM prices",
+        "2",
+        "crypto_set_rate loads a price table");
+
+    verify_sql_result(db,
+        "SELECT crypto_value_in('ETH', 'ETH', 'BTC', 'BTC', '0.5')",
+        "7.625000000000000000",
+        "crypto_value_in converts between types");
+
+    verify_sql_result(db,
+        "SELECT crypto_value_in('ETH', 'GWEI', 'BTC', 'SAT', '1')",
+        "152.500000000",
+        "crypto_value_in in other denominations");
+
+    verify_sql_result(db,
+        "SELECT crypto_sum('ETH', 'ETH', 'ETH', crypto_value_in('ETH', 'ETH', asset, asset, amount)) FROM holdings",
+        "9.875000000000000000",
+        "Portfolio value across types");
+
+    verify_sql_result(db,
+        "SELECT crypto_set_rate('ETH', 'ETH', 'BTC', 'BTC', '0.0655') || ',' || "
+        "crypto_value_in('BTC', 'SAT', 'ETH', 'WEI', '1') || ',' || "
+        "crypto_value_in('BTC', 'SAT', 'ETH', 'WEI', '1', 'ceil') || ',' || "
+        "crypto_value_in('BTC', 'SAT', 'ETH', 'WEI', '-1', 'floor')",
+        "1,0,1,-1",
+        "crypto_value_in rounding modes");
+
+    verify_sql_result(db,
+        "SELECT crypto_from_blob('ETH', 'ETH', crypto_value_in('ETH', 'ETH', 'BTC', 'BTC', crypto_to_blob('BTC', 'BTC', '0.5')))",
+        "7.625000000000000000",
+        "crypto_value_in of a BLOB amount");
+
+    verify_sql_result(db,
+        "SELECT crypto_set_rate('BTC', 'SAT', 'ETH', 'GWEI', '200') || ',' || crypto_value_in('ETH', 'ETH', 'BTC', 'BTC', '0.5')",
+        "1,10",
+        "crypto_set_rate replaces a rate");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_value_in('DOT', 'DOT', 'ETH', 'ETH', '1')",
+        "crypto_value_in without a rate");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_set_rate('BTC', 'BTC', 'ETH', 'ETH', '-15')",
+        "crypto_set_rate rejects a negative price");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_set_rate('BTC', 'BTC', 'BTC', 'SAT', '100000000')",
+        "crypto_set_rate rejects a rate within one type");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_value_in('ETH', 'ETH', 'BTC', 'BTC', '1', 'sideways')",
+        "crypto_value_in rejects an unknown rounding mode");
+
+    verify_sql_result(db, "SELECT crypto_clear_rates()", "3", "crypto_clear_rates");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_value_in('ETH', 'ETH', 'BTC', 'BTC', '0.5')",
+        "No rates after crypto_clear_rates");
+
+    verify_sql_result(db,
+        "SELECT crypto_value_in('ETH', 'GWEI', 'ETH', 'ETH', '1.5')",
+        "1500000000",
+        "crypto_value_in within a type needs no rate");
+
+    // Instrumentation counters; the table is empty unless built with CRYPTO_STATS
+#ifdef CRYPTO_STATS
+    verify_sql_result(db, "SELECT crypto_stats_reset()", "1", "crypto_stats_reset");
+
+    verify_sql_result(db, "SELECT crypto_add('ETH', 'ETH', '1', '2')", "3", "crypto_add while counting");
+
+    verify_sql_runtime_error(db,
+        "SELECT crypto_add('ETH', 'ETH', '1', 'x')",
+        "crypto_add with an invalid operand while counting");
+
+    verify_sql_result(db,
+        "SELECT value FROM crypto_stats WHERE name = 'crypto_add.calls'",
+        "2",
+        "crypto_stats counts calls");
+
+    verify_sql_result(db,
+        "SELECT value FROM crypto_stats WHERE name = 'parse_failures'",
+        "1",
+        "crypto_stats counts parse failures");
+
+    verify_sql_result(db,
+        "SELECT value > 0 FROM crypto_stats WHERE name = 'fast_path'",
+        "1",
+        "crypto_stats counts fast-path arithmetic");
+
+    verify_sql_result(db,
+        "SELECT value > 0 FROM crypto_stats WHERE name = 'memo_hits'",
+        "1",
+        "crypto_stats counts operands reused from the parse memo");
+
+    verify_sql_result(db, "SELECT crypto_stats_reset()", "1", "crypto_stats_reset again");
+
+    verify_sql_result(db,
+        "SELECT sum(value) FROM crypto_stats",
+        "0",
+        "crypto_stats_reset zeroes every counter");
+#else
+    verify_sql_result(db, "SELECT crypto_stats_reset()", "0", "crypto_stats_reset without CRYPTO_STATS");
+
+    verify_sql_result(db,
+        "SELECT count(*) FROM crypto_stats",
+        "0",
+        "crypto_stats is empty without CRYPTO_STATS");
+#endif
+
+    // Deterministic functions can back generated columns and expression indexes
+    verify_sql_exec(db,
+        "CREATE TABLE fills(amount TEXT, "
+        "amount_wei TEXT GENERATED ALWAYS AS (crypto_scale('ETH', 'ETH', 'WEI', amount)) VIRTUAL)",
+        "Generated column using crypto_scale");
+
+    verify_sql_exec(db,
+        "CREATE INDEX fills_wei ON fills(crypto_scale('ETH', 'ETH', 'WEI', amount))",
+        "Expression index using crypto_scale");
+
+    verify_sql_exec(db,
+        "INSERT INTO fills(amount) VALUES ('1.5'), ('0.25'), ('3')",
+        "Insert into table with crypto expression index");
+
+    verify_sql_result(db,
+        "SELECT amount_wei FROM fills WHERE amount = '0.25'",
+        "250000000000000000",
+        "Generated column value");
+
+    verify_sql_plan_uses(db,
+        "SELECT amount FROM fills WHERE crypto_scale('ETH', 'ETH', 'WEI', amount) = '1500000000000000000'",
+        "fills_wei",
+        "Lookup through the expression index");
+
+    verify_sql_result(db,
+        "SELECT amount FROM fills WHERE crypto_scale('ETH', 'ETH', 'WEI', amount) = '1500000000000000000'",
+        "1.5",
+        "Expression index lookup result");
+
     sqlite3_close(db);
 }
 